@@ -2,7 +2,14 @@
 // Distributed under the MIT license. See the LICENSE file in the project root for more information.
 
 #include "Geometry.h"
+#include "MeshOptimization.h"
+#include "MeshSimplification.h"
+#include "Meshlets.h"
 #include "Utilities/IOStream.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cfloat>
+#include <thread>
 
 namespace Quantum::tools {
     namespace {
@@ -35,102 +42,200 @@ namespace Quantum::tools {
             }
         }
 		
-        void process_normals(mesh& m, f32 smoothing_angle)
+        // NOTE: a wedge is one corner of a triangle, i.e. one element of raw_indices. Normals and uvs are
+        //       stored per wedge. Wedges that end up with the same position, normal and uv are welded into one vertex.
+
+        // Lists the wedges that use each position, so that we don't have to search for them.
+        // The wedges of position p are wedges[offsets[p]] .. wedges[offsets[p + 1] - 1] in increasing order.
+        struct position_wedges
+        {
+            util::vector<u32>   offsets;
+            util::vector<u32>   wedges;
+        };
+
+        void get_position_wedges(const mesh& m, position_wedges& pw)
+        {
+            const u32 num_indices{ (u32)m.raw_indices.size() };
+            const u32 num_positions{ (u32)m.positions.size() };
+
+            pw.offsets.resize(num_positions + 1, 0);
+            for (u32 i{ 0 }; i < num_indices; ++i)
+            {
+                assert(m.raw_indices[i] < num_positions);
+                ++pw.offsets[m.raw_indices[i] + 1];
+            }
+
+            for (u32 i{ 0 }; i < num_positions; ++i) pw.offsets[i + 1] += pw.offsets[i];
+
+            util::vector<u32> next(pw.offsets);
+            pw.wedges.resize(num_indices);
+            for (u32 i{ 0 }; i < num_indices; ++i)
+            {
+                pw.wedges[next[m.raw_indices[i]]++] = i;
+            }
+        }
+
+        // Averages the normals of wedges that share a position if the angle between them is less than the smoothing angle.
+        // NOTE: wedges that are smoothed together all get exactly the same normal, so the welding step can merge them.
+        // NOTE: the wedges of a position are grouped the same way as before welding was added: a group starts with the
+        //       first wedge that's left and takes every later wedge within the smoothing angle of its running normal.
+        //       This costs O(wedges * groups) per position, not O(wedges). Which group a wedge joins depends on the
+        //       running normals of the groups before it, so the groups can't be found with a counting sort.
+        void process_normals(mesh& m, const position_wedges& pw, f32 smoothing_angle, util::vector<v3>& normals)
         {
             const f32 cos_alpha{ XMScalarCos(pi - smoothing_angle * pi / 180.f) };
             const bool is_hard_edge{ XMScalarNearEqual(smoothing_angle, 180.f, epsilon) };
             const bool is_soft_edge{ XMScalarNearEqual(smoothing_angle, 0.f, epsilon) };
             const u32 num_indices{ (u32)m.raw_indices.size() };
-            const u32 num_vertices{ (u32)m.positions.size() };
-            assert(num_indices && num_vertices);
-			
-            m.indices.resize(num_indices);
-			
-            util::vector<util::vector<u32>> idx_ref(num_vertices);
-            for (u32 i{ 0 }; i < num_vertices; ++i)
-                idx_ref[m.raw_indices[i]].emplace_back(i);
-				
-            for (u32 i{ 0 }; i < num_vertices; ++i)
+            const u32 num_positions{ (u32)m.positions.size() };
+            assert(num_indices && num_positions);
+            assert(m.normals.size() == num_indices);
+
+            normals.resize(num_indices);
+            if (is_hard_edge)
             {
-                auto& refs{ idx_ref[i] };
-                u32 num_refs{ (u32)refs.size() };
-                for (u32 j{ 0 }; j < num_refs; ++j)
+                memcpy(normals.data(), m.normals.data(), num_indices * sizeof(v3));
+                return;
+            }
+
+            // Wedges of the current position that aren't part of a smoothing group yet and the members of the current group.
+            util::vector<u32> refs;
+            util::vector<u32> group;
+
+            for (u32 p{ 0 }; p < num_positions; ++p)
+            {
+                const u32 first{ pw.offsets[p] };
+                const u32 last{ pw.offsets[p + 1] };
+                refs.clear();
+                for (u32 i{ first }; i < last; ++i) refs.emplace_back(pw.wedges[i]);
+
+                while (!refs.empty())
                 {
-                    m.indices[refs[j]] = (u32)m.vertices.size();
-                    vertex& v{ m.vertices.emplace_back() };
-                    v.position = m.positions[m.raw_indices[refs[j]]];
-					
-                    XMVECTOR n1{ XMLoadFloat3(&m.normals[refs[j]]) };
-                    if (!is_hard_edge)
+                    group.clear();
+                    group.emplace_back(refs[0]);
+                    XMVECTOR n1{ XMLoadFloat3(&m.normals[refs[0]]) };
+                    u32 num_refs{ 0 };
+
+                    for (u32 k{ 1 }; k < refs.size(); ++k)
                     {
-                        for (u32 k{ j + 1 }; k < num_refs; ++k)
+                        // this value represents the cosine of the angle between normals.
+                        f32 cos_theta{ 0.f };
+                        XMVECTOR n2{ XMLoadFloat3(&m.normals[refs[k]]) };
+                        if (!is_soft_edge)
+                        {
+                            // NOTE: we're accounting for the length of n1 in this calculation because
+                            //       it can possibly change in this loop iteration. We assume unit length
+                            //       for n2.
+                            //       cos(angle) = dot(n1, n2) / (||n1||*||n2||)
+                            XMStoreFloat(&cos_theta, XMVector3Dot(n1, n2) * XMVector3ReciprocalLength(n1));
+                        }
+
+                        if (is_soft_edge || cos_theta >= cos_alpha)
                         {
-                            // this value represents the cosine of the angle between normals.
-                            f32 cos_theta{ 0.f };
-                            XMVECTOR n2{ XMLoadFloat3(&m.normals[refs[k]]) };
-                            if (!is_soft_edge)
-                            {
-                                // NOTE: we're accounting for the length of n1 in this calculation because
-                                //       it can possibly change in this loop iteration. We assume unit length
-                                //       for n2.
-                                //       cos(angle) = dot(n1, n2) / (||n1||*||n2||)
-                                XMStoreFloat(&cos_theta, XMVector3Dot(n1, n2) * XMVector3ReciprocalLength(n1));
-                            }
-							
-                            if (is_soft_edge || cos_theta >= cos_alpha)
-                            {
-                                n1 += n2;
-								
-                                m.indices[refs[k]] = m.indices[refs[j]];
-                                refs.erase(refs.begin() + k);
-                                --num_refs;
-                                --k;
-                            }
+                            n1 += n2;
+                            group.emplace_back(refs[k]);
+                        }
+                        else
+                        {
+                            // NOTE: keep the wedges that weren't smoothed in their original order for the next group.
+                            refs[num_refs++] = refs[k];
                         }
                     }
-                    XMStoreFloat3(&v.normal, XMVector3Normalize(n1));
+
+                    refs.resize(num_refs);
+
+                    v3 n;
+                    XMStoreFloat3(&n, XMVector3Normalize(n1));
+                    for (u32 wedge : group) normals[wedge] = n;
                 }
             }
         }
-		
-        void process_uvs(mesh& m) {
-            util::vector<vertex> old_vertices;
-            old_vertices.swap(m.vertices);
-            util::vector<u32> old_indices(m.indices.size());
-            old_indices.swap(m.indices);
-			
-            const u32 num_vertices{ (u32)old_vertices.size() };
-            const u32 num_indices{ (u32)old_indices.size() };
-            assert(num_vertices && num_indices);
-			
-            util::vector<util::vector<u32>> idx_ref(num_vertices);
-            for (u32 i{ 0 }; i < num_vertices; ++i)
-                idx_ref[old_indices[i]].emplace_back(i);
-			
-            for (u32 i{ 0 }; i < num_vertices; ++i)
+
+        struct weld_key
+        {
+            u32 position;
+            u32 normal[3];
+            u32 uv[2];
+
+            constexpr bool operator==(const weld_key& o) const
+            {
+                return position == o.position &&
+                    normal[0] == o.normal[0] && normal[1] == o.normal[1] && normal[2] == o.normal[2] &&
+                    uv[0] == o.uv[0] && uv[1] == o.uv[1];
+            }
+        };
+
+        // Rounds to a multiple of 1 / scale and returns the bits of the result. Values that are closer
+        // than half a step will most likely get the same bits (unless they're on both sides of a rounding boundary).
+        u32 quantize(f32 value, f32 scale)
+        {
+            // NOTE: adding 0 turns -0 into +0, so that they have the same bits.
+            const f32 q{ std::round(value * scale) + 0.f };
+            u32 bits;
+            memcpy(&bits, &q, sizeof(u32));
+            return bits;
+        }
+
+        u64 hash(const weld_key& key)
+        {
+            u64 h{ key.position };
+            const u32* const values{ &key.normal[0] };
+            for (u32 i{ 0 }; i < 5; ++i)
+            {
+                h = (h ^ values[i]) * 0x9e3779b97f4a7c15ull;
+                h ^= h >> 32;
+            }
+            return h;
+        }
+
+        // Makes one vertex for every unique combination of position, normal and uv using a hash table,
+        // so the cost is linear in the number of wedges.
+        void weld_vertices(mesh& m, const util::vector<v3>& normals)
+        {
+            constexpr f32 normal_scale{ 32767.f };     // same precision as the packed 16 bit normals.
+            constexpr f32 uv_scale{ 1024.f * 1024.f };
+            const u32 num_indices{ (u32)m.raw_indices.size() };
+            const bool has_uvs{ !m.uv_sets.empty() && m.uv_sets[0].size() == num_indices };
+            assert(num_indices && normals.size() == num_indices);
+
+            m.vertices.clear();
+            m.vertices.reserve(m.positions.size());
+            m.indices.resize(num_indices);
+
+            // NOTE: the table is at most half full, because there can't be more vertices than wedges.
+            u32 table_size{ 1 };
+            while (table_size < 2 * num_indices) table_size <<= 1;
+            util::vector<u32> table(table_size, u32_invalid_id);
+            util::vector<weld_key> keys;
+            keys.reserve(m.positions.size());
+
+            for (u32 i{ 0 }; i < num_indices; ++i)
             {
-                auto& refs{ idx_ref[i] };
-                u32 num_refs{ (u32)refs.size() };
-                for (u32 j{ 0 }; j < num_refs; ++j)
+                const v3& n{ normals[i] };
+                weld_key key{ m.raw_indices[i], { quantize(n.x, normal_scale), quantize(n.y, normal_scale), quantize(n.z, normal_scale) }, {} };
+                if (has_uvs)
                 {
-                    m.indices[refs[j]] = (u32)m.vertices.size();
-                    vertex& v{ old_vertices[old_indices[refs[j]]] };
-                    v.uv = m.uv_sets[0][refs[j]];
-                    m.vertices.emplace_back(v);
-					
-                    for (u32 k{ j + 1 }; k < num_refs; ++k)
-                    {
-                        v2& uv1{ m.uv_sets[0][refs[k]] };
-                        if (XMScalarNearEqual(v.uv.x, uv1.x, epsilon) &&
-                            XMScalarNearEqual(v.uv.y, uv1.y, epsilon))
-                        {
-                            m.indices[refs[k]] = m.indices[refs[j]];
-                            refs.erase(refs.begin() + k);
-                            --num_refs;
-                            --k;
-                        }
-                    }
+                    key.uv[0] = quantize(m.uv_sets[0][i].x, uv_scale);
+                    key.uv[1] = quantize(m.uv_sets[0][i].y, uv_scale);
+                }
+
+                u32 slot{ (u32)hash(key) & (table_size - 1) };
+                while (table[slot] != u32_invalid_id && !(keys[table[slot]] == key))
+                {
+                    slot = (slot + 1) & (table_size - 1);
+                }
+
+                if (table[slot] == u32_invalid_id)
+                {
+                    table[slot] = (u32)m.vertices.size();
+                    keys.emplace_back(key);
+                    vertex& v{ m.vertices.emplace_back() };
+                    v.position = m.positions[key.position];
+                    v.normal = n;
+                    if (has_uvs) v.uv = m.uv_sets[0][i];
                 }
+
+                m.indices[i] = table[slot];
             }
         }
 		
@@ -150,20 +255,77 @@ namespace Quantum::tools {
                 case elements_type::skeletal_normal_texture_color:          return sizeof(skeletal_normal_texture_color);
             }
 			
+            if (elements_type & elements_type::quantized)
+            {
+                // NOTE: quantization only changes the layout of element types that have uvs.
+                const elements_type::type type{ (elements_type::type)(elements_type & ~elements_type::quantized) };
+                switch (type)
+                {
+                    case elements_type::static_normal_texture:              return sizeof(static_normal_texture_quantized);
+                    case elements_type::skeletal_normal_texture:            return sizeof(skeletal_normal_texture_quantized);
+                    case elements_type::skeletal_normal_texture_color:      return sizeof(skeletal_normal_texture_color_quantized);
+                    default:                                                return get_vertex_element_size(type);
+                }
+            }
+			
             return 0;
         }
 		
-        void pack_vertices(mesh& m)
+        u64 get_position_size(elements::elements_type::type elements_type)
+        {
+            return (elements_type & elements::elements_type::quantized) ? sizeof(elements::position_quantized) : sizeof(math::v3);
+        }
+		
+        // Stores positions as 16 bit unorms in the bounding box of the mesh. The largest error per axis is
+        // half the size of a quantization step, i.e. box size / 65535 / 2.
+        void quantize_positions(mesh& m)
         {
             const u32 num_vertices{ (u32)m.vertices.size() };
-            assert(num_vertices);
+            XMVECTOR min_p{ XMVectorReplicate(FLT_MAX) };
+            XMVECTOR max_p{ XMVectorReplicate(-FLT_MAX) };
+            for (const vertex& v : m.vertices)
+            {
+                const XMVECTOR p{ XMLoadFloat3(&v.position) };
+                min_p = XMVectorMin(min_p, p);
+                max_p = XMVectorMax(max_p, p);
+            }
 			
-            m.position_buffer.resize(sizeof(math::v3) * num_vertices);
-            math::v3* const position_buffer{ (math::v3* const)m.position_buffer.data() };
+            constexpr f32 intervals{ (f32)((1 << 16) - 1) };
+            const XMVECTOR extent{ max_p - min_p };
+            XMStoreFloat3(&m.position_offset, min_p);
+            XMStoreFloat3(&m.position_scale, extent / intervals);
+            // NOTE: flat meshes have no extent along one axis. Their positions on that axis are all 0.
+            const XMVECTOR inv_extent{ XMVectorSelect(XMVectorReciprocal(extent), XMVectorZero(), XMVectorEqual(extent, XMVectorZero())) };
 			
+            m.position_buffer.resize(sizeof(elements::position_quantized) * num_vertices);
+            elements::position_quantized* const position_buffer{ (elements::position_quantized* const)m.position_buffer.data() };
             for (u32 i{ 0 }; i < num_vertices; ++i)
             {
-                position_buffer[i] = m.vertices[i].position;
+                v3 p;
+                XMStoreFloat3(&p, XMVectorSaturate((XMLoadFloat3(&m.vertices[i].position) - min_p) * inv_extent));
+                position_buffer[i] = { { (u16)pack_unit_float<16>(p.x), (u16)pack_unit_float<16>(p.y), (u16)pack_unit_float<16>(p.z) }, 0 };
+            }
+        }
+		
+        void pack_vertices(mesh& m)
+        {
+            const u32 num_vertices{ (u32)m.vertices.size() };
+            assert(num_vertices);
+			
+            const bool quantized{ (m.elements_type & elements::elements_type::quantized) != 0 };
+            if (quantized)
+            {
+                quantize_positions(m);
+            }
+            else
+            {
+                m.position_buffer.resize(sizeof(math::v3) * num_vertices);
+                math::v3* const position_buffer{ (math::v3* const)m.position_buffer.data() };
+				
+                for (u32 i{ 0 }; i < num_vertices; ++i)
+                {
+                    position_buffer[i] = m.vertices[i].position;
+                }
             }
 			
             struct u16v2 { u16 x, y; };
@@ -210,10 +372,22 @@ namespace Quantum::tools {
                     // NOTE: w3 will be calculated in shader since joint weights sum to one(1).
                     }
                 }
+			
+            util::vector<u16v2>     half_uvs;
+            if (quantized && (m.elements_type & elements::elements_type::static_normal_texture) == elements::elements_type::static_normal_texture)
+            {
+                half_uvs.resize(num_vertices);
+                for (u32 i{ 0 }; i < num_vertices; ++i)
+                {
+                    const v2& uv{ m.vertices[i].uv };
+                    half_uvs[i] = { PackedVector::XMConvertFloatToHalf(uv.x), PackedVector::XMConvertFloatToHalf(uv.y) };
+                }
+            }
+			
             m.element_buffer.resize(get_vertex_element_size(m.elements_type)* num_vertices);
             using namespace elements;
 			
-            switch (m.elements_type)
+            switch (m.elements_type & ~elements_type::quantized)
             {
             case elements_type::static_color:
             {
@@ -237,6 +411,17 @@ namespace Quantum::tools {
             break;
             case elements_type::static_normal_texture:
             {
+                if (quantized)
+                {
+                    static_normal_texture_quantized *const element_buffer{ (static_normal_texture_quantized *const)m.element_buffer.data() };
+                    for (u32 i{ 0 }; i < num_vertices; ++i)
+                    {
+                        vertex& v{ m.vertices[i] };
+                        element_buffer[i] = { { v.red, v.green, v.blue }, t_signs[i], {normals[i].x, normals[i].y}, {tangents[i].x, tangents[i].y}, {half_uvs[i].x, half_uvs[i].y} };
+                    }
+                    break;
+                }
+				
                 static_normal_texture *const element_buffer{ (static_normal_texture *const)m.element_buffer.data() };
                 for (u32 i{ 0 }; i < num_vertices; ++i)
                 {
@@ -297,6 +482,20 @@ namespace Quantum::tools {
             break;
             case elements_type::skeletal_normal_texture:
             {
+                if (quantized)
+                {
+                    skeletal_normal_texture_quantized *const element_buffer{ (skeletal_normal_texture_quantized *const)m.element_buffer.data() };
+                    for (u32 i{ 0 }; i < num_vertices; ++i)
+                    {
+                        vertex& v{ m.vertices[i] };
+                        const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y, (u16)v.joint_indices.z, (u16)v.joint_indices.w };
+                        element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, t_signs[i],
+                                            {indices[0], indices[1], indices[2], indices[3]},
+                                            {normals[i].x, normals[i].y}, {tangents[i].x, tangents[i].y}, {half_uvs[i].x, half_uvs[i].y} };
+                    }
+                    break;
+                }
+				
                 skeletal_normal_texture *const element_buffer{ (skeletal_normal_texture *const)m.element_buffer.data() };
                 for (u32 i{ 0 }; i < num_vertices; ++i)
                 {
@@ -310,6 +509,21 @@ namespace Quantum::tools {
             break;
             case elements_type::skeletal_normal_texture_color:
             {
+                if (quantized)
+                {
+                    skeletal_normal_texture_color_quantized *const element_buffer{ (skeletal_normal_texture_color_quantized *const)m.element_buffer.data() };
+                    for (u32 i{ 0 }; i < num_vertices; ++i)
+                    {
+                        vertex& v{ m.vertices[i] };
+                        const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y, (u16)v.joint_indices.z, (u16)v.joint_indices.w };
+                        element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, t_signs[i],
+                                            {indices[0], indices[1], indices[2], indices[3]},
+                                            {normals[i].x, normals[i].y}, {tangents[i].x, tangents[i].y}, {half_uvs[i].x, half_uvs[i].y},
+                                            {v.red, v.green, v.blue}, {} };
+                    }
+                    break;
+                }
+				
                 skeletal_normal_texture_color *const element_buffer{ (skeletal_normal_texture_color *const)m.element_buffer.data() };
                 for (u32 i{ 0 }; i < num_vertices; ++i)
                 {
@@ -349,6 +563,7 @@ namespace Quantum::tools {
 			return type;
         }
 		
+        // Turns the raw per-wedge data into welded vertices and indices.
         void process_vertices(mesh& m, const geometry_import_settings& settings)
         {
             assert((m.raw_indices.size() % 3) == 0);
@@ -357,14 +572,39 @@ namespace Quantum::tools {
                 recalculate_normals(m);
             }
 			
-            process_normals(m, settings.smothing_angle);
+            position_wedges pw{};
+            get_position_wedges(m, pw);
+            util::vector<v3> normals;
+            process_normals(m, pw, settings.smothing_angle, normals);
+            weld_vertices(m, normals);
+            m.elements_type = determine_elements_type(m);
+        }
+		
+        void optimize_and_pack_vertices(mesh& m, const geometry_import_settings& settings)
+        {
+            if (settings.optimize_vertex_cache)
+            {
+                optimize_vertex_cache(m.indices, (u32)m.vertices.size());
+                optimize_overdraw(m.indices, m.vertices);
+            }
 			
-            if (!m.uv_sets.empty())
+            // NOTE: building meshlets changes the order of the triangles, but not the vertices they reference,
+            //       so it goes between the triangle order and the vertex order optimizations.
+            if (settings.build_meshlets)
             {
-                process_uvs(m);
+                build_meshlets(m.indices, m.vertices, m.meshlets);
+            }
+			
+            if (settings.optimize_vertex_cache)
+            {
+                optimize_vertex_fetch(m.indices, m.vertices);
+            }
+			
+            if (settings.quantize_vertices)
+            {
+                m.elements_type = (elements::elements_type::type)(m.elements_type | elements::elements_type::quantized);
             }
 			
-            m.elements_type = determine_elements_type(m);
             pack_vertices(m);
         }
 		
@@ -372,7 +612,7 @@ namespace Quantum::tools {
         {
             const u64 num_vertices{ m.vertices.size() };
             const u64 position_buffer_size{ m.position_buffer.size() };
-            assert(position_buffer_size == sizeof(math::v3) * num_vertices);
+            assert(position_buffer_size == get_position_size(m.elements_type) * num_vertices);
             const u64 element_buffer_size{ m.element_buffer.size() };
             assert(element_buffer_size == get_vertex_element_size(m.elements_type) * num_vertices);
             const u64 index_size{ (num_vertices < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
@@ -387,9 +627,12 @@ namespace Quantum::tools {
                 su32 + // index size (16 bit or 32 bit)
                 su32 + // number of indices
                 sizeof(f32) + // LOD threshold
+                ((m.elements_type & elements::elements_type::quantized) ? sizeof(math::v3) * 2 : 0) + // position offset and scale
                 position_buffer_size + // room for vertex positions
                 element_buffer_size + // room for vertex elements
-                index_buffer_size // room for indices
+                index_buffer_size + // room for indices
+                su32 + // number of meshlets
+                sizeof(meshlet) * m.meshlets.size() // room for meshlets
             };
 			
             return size;
@@ -447,8 +690,14 @@ namespace Quantum::tools {
             blob.write(num_indices);
             // LOD threshold
             blob.write(m.lod_threshold);
+            // position offset and scale (only for quantized positions)
+            if (m.elements_type & elements::elements_type::quantized)
+            {
+                blob.write((const u8*)&m.position_offset, sizeof(math::v3));
+                blob.write((const u8*)&m.position_scale, sizeof(math::v3));
+            }
             // position buffer
-            assert(m.position_buffer.size() == sizeof(math::v3) * num_vertices);
+            assert(m.position_buffer.size() == get_position_size(m.elements_type) * num_vertices);
             blob.write(m.position_buffer.data(), m.position_buffer.size());
             // element buffer
             assert(m.element_buffer.size() == element_size * num_vertices);
@@ -465,6 +714,12 @@ namespace Quantum::tools {
                 data = (const u8*)indices.data();
             }
             blob.write(data, index_buffer_size);
+            // meshlets
+            blob.write((u32)m.meshlets.size());
+            if (m.meshlets.size())
+            {
+                blob.write((const u8*)m.meshlets.data(), sizeof(meshlet) * m.meshlets.size());
+            }
         }
 		
 		bool split_meshes_by_material(u32 material_idx, const mesh& m, mesh& submesh)
@@ -483,7 +738,7 @@ namespace Quantum::tools {
 				const u32 mtl_idx{ m.material_indices[i] };
 				if (mtl_idx != material_idx) continue;
 				
-				const u32 index{ i + 3 };
+				const u32 index{ i * 3 };
 				for (u32 j = index; j < index + 3; ++j)
 				{
 					const u32 v_idx{ m.raw_indices[j] };
@@ -522,40 +777,270 @@ namespace Quantum::tools {
 			return !submesh.raw_indices.empty();
 		}
 		
+		// Calls fn(i) for every i in [0, count) using a bounded number of threads. The calling thread takes part
+		// in the work and is the only thread that calls report(done), so progress callbacks never run concurrently.
+		// NOTE: every item must only write to data that belongs to that item. Items are handed out in order,
+		//       so callers should put the most expensive items first.
+		template<typename Fn, typename Report>
+		void parallel_for_each(u32 count, Fn&& fn, Report&& report)
+		{
+			constexpr u32 max_threads{ 16 };
+			const u32 thread_count{ std::min({ std::max(std::thread::hardware_concurrency(), 1u), max_threads, count }) };
+			
+			std::atomic<u32> next_item{ 0 };
+			std::atomic<u32> done{ 0 };
+			auto work{ [&]() {
+				for (u32 i{ next_item++ }; i < count; i = next_item++)
+				{
+					fn(i);
+					done.fetch_add(1, std::memory_order_release);
+					done.notify_one();
+				}
+			} };
+			
+			util::vector<std::thread> helpers;
+			helpers.reserve(thread_count);
+			for (u32 i{ 1 }; i < thread_count; ++i) helpers.emplace_back(work);
+			
+			u32 reported{ 0 };
+			for (u32 i{ next_item++ }; i < count; i = next_item++)
+			{
+				fn(i);
+				done.fetch_add(1, std::memory_order_release);
+				for (const u32 d{ done.load(std::memory_order_acquire) }; reported < d;) report(++reported);
+			}
+			
+			// No more items to hand out. Keep reporting while the helpers finish what they're working on.
+			for (u32 d{ done.load(std::memory_order_acquire) }; reported < count; d = done.load(std::memory_order_acquire))
+			{
+				while (reported < d) report(++reported);
+				if (reported < count) done.wait(d, std::memory_order_acquire);
+			}
+			
+			for (auto& t : helpers) t.join();
+		}
+		
 		void split_meshes_by_material(scene& scene, progression *const progression)
 		{
 			assert(progression);
 			progression->callback(0, 0);
 			
+			// Split all meshes of all LOD groups in parallel. Every source mesh gets its own slot for
+			// the resulting submeshes, so the output order is the same as with a serial split.
+			struct split_item
+			{
+				mesh*				source;
+				util::vector<mesh>	submeshes;
+			};
+			
+			u32 num_meshes{ 0 };
+			for (const auto& lod : scene.lod_groups) num_meshes += (u32)lod.meshes.size();
+			
+			util::vector<split_item> items;
+			items.reserve(num_meshes);
+			for (auto& lod : scene.lod_groups)
+				for (auto& m : lod.meshes)
+					items.emplace_back(split_item{ &m });
+			
+			parallel_for_each((u32)items.size(), [&items](u32 idx) {
+				split_item& item{ items[idx] };
+				const mesh& m{ *item.source };
+				// If more than one material is used in this mesh
+				// then split it into submeshes.
+				const u32 num_materials{ (u32)m.material_used.size() };
+				for (u32 i{ 0 }; num_materials > 1 && i < num_materials; ++i)
+				{
+					mesh submesh{};
+					if (split_meshes_by_material(m.material_used[i], m, submesh))
+					{
+						item.submeshes.emplace_back(std::move(submesh));
+					}
+				}
+			}, [](u32) {});
+			
+			u32 item_idx{ 0 };
 			for (auto& lod : scene.lod_groups)
 			{
 				util::vector<mesh> new_meshes;
 				
-				for (const auto& m : lod.meshes)
+				for (auto& m : lod.meshes)
 				{
-					// If more than one material is used in this mesh
-					// then split it into submeshes.
-					const u32 num_materials{ (u32)m.material_used.size() };
-					if (num_materials > 1)
+					split_item& item{ items[item_idx++] };
+					assert(item.source == &m);
+					if (m.material_used.size() > 1)
 					{
-						for (u32 i{ 0 }; i < num_materials; ++i)
-						{
-							mesh submesh{};
-							if (split_meshes_by_material(m.material_used[i], m, submesh))
-							{
-								new_meshes.emplace_back(submesh);
-							}
-						}
+						for (auto& submesh : item.submeshes) new_meshes.emplace_back(std::move(submesh));
 					}
 					else
 					{
-						new_meshes.emplace_back(m);
+						new_meshes.emplace_back(std::move(m));
 					}
 				}
 				
 				new_meshes.swap(lod.meshes);
-				progression->callback(progression->value(), progression->max_value() + (u32)new_meshes.size());
+				progression->callback(progression->value(), progression->max_value() + (u32)lod.meshes.size());
+			}
+		}
+		
+		// Every generated LOD has about half the triangles of the previous one. A LOD is only kept if it
+		// actually got smaller, and no edge is collapsed if that moves the surface by more than 10% of the mesh size.
+		constexpr f32 lod_triangle_ratio{ 0.5f };
+		constexpr f32 lod_min_reduction{ 0.85f };
+		constexpr f32 lod_max_relative_error{ 0.1f };
+		// LOD thresholds are camera distances at which the simplification error is smaller than lod_pixel_error
+		// pixels on a 1080 pixel high screen with a 60 degree vertical field of view.
+		constexpr f32 lod_pixel_error{ 1.f };
+		constexpr f32 lod_projection_scale{ 1080.f / (2.f * 0.57735027f) };
+		
+		// Adds simplified versions of all meshes of a LOD group as LODs 1 to generated_lod_count. Only groups
+		// without authored LODs are simplified. Expects welded vertices (see process_vertices()).
+		u32 generate_lods(scene& scene, const geometry_import_settings& settings)
+		{
+			const u32 lod_count{ settings.generated_lod_count };
+			if (!lod_count) return 0;
+			
+			struct lod_level
+			{
+				util::vector<vertex>	vertices;
+				util::vector<u32>		indices;
+				f32						error;		// accumulated error of all LODs up to this one
+			};
+			
+			struct lod_item
+			{
+				const mesh*					source;
+				util::vector<lod_level>		levels;
+			};
+			
+			util::vector<lod_item> items;
+			for (auto& lod : scene.lod_groups)
+			{
+				if (lod.meshes.empty()) continue;
+				const u32 lod_id{ lod.meshes[0].lod_id };
+				if (std::any_of(lod.meshes.begin(), lod.meshes.end(), [lod_id](const mesh& m) { return m.lod_id != lod_id; })) continue;
+				
+				for (auto& m : lod.meshes)
+				{
+					if (m.lod_id == u32_invalid_id) m.lod_id = 0;
+					items.emplace_back(lod_item{ &m });
+				}
 			}
+			
+			// NOTE: every LOD is simplified from the previous one, which is a lot cheaper than starting from
+			//       the source mesh each time. The errors add up, which gives us an upper bound for each LOD.
+			parallel_for_each((u32)items.size(), [&items, lod_count](u32 idx) {
+				lod_item& item{ items[idx] };
+				const mesh& m{ *item.source };
+				
+				XMVECTOR min_p{ XMVectorReplicate(FLT_MAX) };
+				XMVECTOR max_p{ XMVectorReplicate(-FLT_MAX) };
+				for (const auto& v : m.vertices)
+				{
+					min_p = XMVectorMin(min_p, XMLoadFloat3(&v.position));
+					max_p = XMVectorMax(max_p, XMLoadFloat3(&v.position));
+				}
+				const f32 max_error{ XMVectorGetX(XMVector3Length(max_p - min_p)) * lod_max_relative_error };
+				
+				item.levels.resize(lod_count);
+				for (u32 i{ 0 }; i < lod_count; ++i)
+				{
+					const util::vector<vertex>& previous_vertices{ i ? item.levels[i - 1].vertices : m.vertices };
+					const util::vector<u32>& previous_indices{ i ? item.levels[i - 1].indices : m.indices };
+					const f32 previous_error{ i ? item.levels[i - 1].error : 0.f };
+					
+					lod_level& level{ item.levels[i] };
+					level.indices = previous_indices;
+					const u32 target_index_count{ (u32)((f32)(level.indices.size() / 3) * lod_triangle_ratio) * 3 };
+					level.error = previous_error + simplify_mesh(level.indices, previous_vertices, target_index_count, max_error);
+					
+					// Stop if this mesh can't be simplified any further, e.g. because all its edges are seams.
+					if (level.indices.empty() || (f32)level.indices.size() > lod_min_reduction * (f32)previous_indices.size())
+					{
+						item.levels.resize(i);
+						break;
+					}
+					
+					// NOTE: the next LOD only has to look at the vertices that are still used.
+					level.vertices = previous_vertices;
+					optimize_vertex_fetch(level.indices, level.vertices);
+				}
+			}, [](u32) {});
+			
+			// Every LOD has to contain all meshes of the group. Meshes that couldn't be simplified as
+			// often as the others use their last LOD (or the source mesh) for the remaining LODs.
+			auto get_level{ [&items](u32 item, u32 level, const util::vector<vertex>*& vertices, const util::vector<u32>*& indices) {
+				const lod_item& i{ items[item] };
+				if (i.levels.empty())
+				{
+					vertices = &i.source->vertices;
+					indices = &i.source->indices;
+					return 0.f;
+				}
+				
+				const lod_level& l{ i.levels[std::min(level, (u32)i.levels.size() - 1)] };
+				vertices = &l.vertices;
+				indices = &l.indices;
+				return l.error;
+			} };
+			
+			u32 item_idx{ 0 };
+			u32 added_meshes{ 0 };
+			for (auto& lod : scene.lod_groups)
+			{
+				if (item_idx == items.size()) break;
+				if (lod.meshes.empty() || items[item_idx].source != &lod.meshes[0]) continue;
+				
+				const u32 first_item{ item_idx };
+				const u32 mesh_count{ (u32)lod.meshes.size() };
+				item_idx += mesh_count;
+				
+				u32 previous_triangles{ 0 };
+				for (const auto& m : lod.meshes) previous_triangles += (u32)m.indices.size() / 3;
+				f32 previous_threshold{ std::max(lod.meshes[0].lod_threshold, 0.f) };
+				
+				util::vector<mesh> new_meshes;
+				for (u32 level{ 0 }; level < lod_count; ++level)
+				{
+					u32 triangles{ 0 };
+					f32 error{ 0.f };
+					for (u32 i{ first_item }; i < first_item + mesh_count; ++i)
+					{
+						const util::vector<vertex>* vertices;
+						const util::vector<u32>* indices;
+						error = std::max(error, get_level(i, level, vertices, indices));
+						triangles += (u32)indices->size() / 3;
+					}
+					
+					if ((f32)triangles > lod_min_reduction * (f32)previous_triangles) break;
+					
+					// NOTE: thresholds have to be strictly increasing.
+					const f32 threshold{ std::max(error * lod_projection_scale / lod_pixel_error, std::nextafter(previous_threshold, FLT_MAX)) };
+					for (u32 i{ first_item }; i < first_item + mesh_count; ++i)
+					{
+						const mesh& source{ *items[i].source };
+						const util::vector<vertex>* vertices;
+						const util::vector<u32>* indices;
+						get_level(i, level, vertices, indices);
+						
+						mesh& m{ new_meshes.emplace_back() };
+						m.name = source.name + "_LOD" + std::to_string(level + 1);
+						m.material_used = source.material_used;
+						m.elements_type = source.elements_type;
+						m.lod_id = source.lod_id + level + 1;
+						m.lod_threshold = threshold;
+						m.vertices = *vertices;
+						m.indices = *indices;
+					}
+					
+					previous_triangles = triangles;
+					previous_threshold = threshold;
+				}
+				
+				added_meshes += (u32)new_meshes.size();
+				for (auto& m : new_meshes) lod.meshes.emplace_back(std::move(m));
+			}
+			
+			return added_meshes;
 		}
 		
 		template <typename T> void append_to_vector_pod(util::vector<T>& dst, const util::vector<T>& src)
@@ -572,12 +1057,42 @@ namespace Quantum::tools {
 		assert(progression);
 		split_meshes_by_material(scene, progression);
 		
+        // Meshes are independent of each other and processed in place, so the order in which they're
+        // processed doesn't change the output. Start with the largest ones to keep all threads busy.
+        util::vector<mesh*> meshes;
         for (auto& lod : scene.lod_groups)
             for (auto& m : lod.meshes)
-            {
-                process_vertices(m, settings);
-				progression->callback(progression->value() + 1, progression->max_value());
-            }
+                meshes.emplace_back(&m);
+		
+        std::stable_sort(meshes.begin(), meshes.end(), [](const mesh* a, const mesh* b) {
+            return a->raw_indices.size() > b->raw_indices.size();
+        });
+		
+        // NOTE: split_meshes_by_material() set the progress maximum to the number of meshes. Every mesh is visited
+        //       twice, once for welding and once for optimizing and packing, so we add room for the second visit.
+        u32 first_value{ progression->value() };
+        progression->callback(first_value, progression->max_value() + (u32)meshes.size());
+        parallel_for_each((u32)meshes.size(),
+            [&](u32 i) { process_vertices(*meshes[i], settings); },
+            [&](u32 done) { progression->callback(first_value + done, progression->max_value()); });
+		
+        if (const u32 lod_meshes{ generate_lods(scene, settings) })
+        {
+            progression->callback(progression->value(), progression->max_value() + lod_meshes);
+            meshes.clear();
+            for (auto& lod : scene.lod_groups)
+                for (auto& m : lod.meshes)
+                    meshes.emplace_back(&m);
+			
+            std::stable_sort(meshes.begin(), meshes.end(), [](const mesh* a, const mesh* b) {
+                return a->indices.size() > b->indices.size();
+            });
+        }
+		
+        first_value = progression->value();
+        parallel_for_each((u32)meshes.size(),
+            [&](u32 i) { optimize_and_pack_vertices(*meshes[i], settings); },
+            [&](u32 done) { progression->callback(first_value + done, progression->max_value()); });
     }
 	
     void pack_data(const scene& scene, scene_data& data)
@@ -31,6 +31,9 @@ namespace Quantum::tools {
                 skeletal_normal_color = skeletal_normal | static_color,
                 skeletal_normal_texture = skeletal | static_normal_texture,
                 skeletal_normal_texture_color = skeletal_normal_texture | static_color,
+                // Flag that can be combined with any of the above. Positions are stored as 16 bit unorms relative
+                // to the bounding box of the mesh (see position_quantized) and uvs as half floats.
+                quantized = 0x10,
             };
         };
 		
@@ -56,6 +59,15 @@ namespace Quantum::tools {
             math::v2    uv;
         };
 		
+        struct static_normal_texture_quantized
+        {
+            u8          color[3];
+            u8          t_sign;             // bit 0: tangent handness * (tangent.z sign), bit 1: normal.z sing (0 means -1, 1 means +1).
+            u16         normal[2];
+            u16         tangent[2];
+            u16         uv[2];              // half floats
+        };
+		
         struct skeletal
         {
             u8          joint_weights[3];   // normalized joint weights for up to 4 joints.
@@ -101,6 +113,16 @@ namespace Quantum::tools {
             math::v2    uv;
         };
 		
+        struct skeletal_normal_texture_quantized
+        {
+            u8          joint_weights[3];   // normalize joint weights for up to 4 joints.
+            u8          t_sign;             // bit 0: tangent handness * (tangent.z sign), bit 1: normal.z sing (0 means -1, 1 means +1).
+            u16         joint_indices[4];
+            u16         normal[2];
+            u16         tangent[2];
+            u16         uv[2];              // half floats
+        };
+		
         struct skeletal_normal_texture_color
         {
             u8          joint_weights[3];   // normalize joint weights for up to 4 joints.
@@ -112,8 +134,43 @@ namespace Quantum::tools {
             u8          color[3];
             u8          pad;
         };
+		
+        struct skeletal_normal_texture_color_quantized
+        {
+            u8          joint_weights[3];   // normalize joint weights for up to 4 joints.
+            u8          t_sign;             // bit 0: tangent handness * (tangent.z sign), bit 1: normal.z sing (0 means -1, 1 means +1).
+            u16         joint_indices[4];
+            u16         normal[2];
+            u16         tangent[2];
+            u16         uv[2];              // half floats
+            u8          color[3];
+            u8          pad;
+        };
+		
+        // Position of a vertex in a mesh with elements_type::quantized. The original position is
+        // position_offset + position * position_scale, with the offset and scale stored per mesh.
+        struct position_quantized
+        {
+            u16         position[3];
+            u16         pad;
+        };
     } // namespace elements
 	
+    // A cluster of up to max_meshlet_vertices vertices and max_meshlet_triangles triangles. The triangles of a
+    // meshlet are stored contiguously in the mesh's index buffer, starting at first_index.
+    // A meshlet is back-facing for every camera at position c for which
+    // dot(center - c, cone_axis) >= cone_cutoff * length(center - c) + radius.
+    // Meshlets that don't have a useful normal cone have cone_axis = 0 and cone_cutoff = 1.
+    struct meshlet
+    {
+        math::v3        center;             // bounding sphere center
+        f32             radius;             // bounding sphere radius
+        math::v3        cone_axis;          // average direction of the triangle normals
+        f32             cone_cutoff;        // sine of the cone's half angle
+        u32             first_index;
+        u32             index_count;
+    };
+	
     struct mesh
     {
         // Initial data
@@ -136,6 +193,9 @@ namespace Quantum::tools {
         elements::elements_type::type                       elements_type;
         util::vector<u8>                                    position_buffer;
         util::vector<u8>                                    element_buffer;
+        util::vector<meshlet>                               meshlets;
+        math::v3                                            position_offset{};          // only for quantized positions
+        math::v3                                            position_scale{ 1.f, 1.f, 1.f };
 		
         f32                                                 lod_threshold{ -1.f };
         u32                                                 lod_id{ u32_invalid_id };
@@ -162,6 +222,10 @@ namespace Quantum::tools {
         u8 import_embeded_textures;
         u8 import_animations;
         u8 coalesce_meshes;
+        u8 optimize_vertex_cache;
+        u8 generated_lod_count;
+        u8 build_meshlets;
+        u8 quantize_vertices;
     };
 	
     struct scene_data
@@ -0,0 +1,111 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "MeshEncoder.h"
+
+namespace Quantum::tools {
+    namespace {
+
+        constexpr u64 control_size(u32 count)
+        {
+            return ((u64)count + 3) / 4;
+        }
+
+        constexpr u32 zigzag(u32 difference)
+        {
+            return (difference << 1) ^ (u32)((s32)difference >> 31);
+        }
+
+        constexpr u16 zigzag16(u16 difference)
+        {
+            return (u16)((difference << 1) ^ (u16)((s16)difference >> 15));
+        }
+
+        // Writes the control bytes and values of a stream. get_value(i) returns the i-th (already zigzag encoded) value.
+        template<typename value_fn>
+        u64 encode_stream(u8* const buffer, u32 count, value_fn get_value)
+        {
+            u8* const control{ buffer };
+            u8* values{ buffer + control_size(count) };
+            memset(control, 0, control_size(count));
+
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                const u32 v{ get_value(i) };
+                const u32 length{ v < (1u << 8) ? 1u : v < (1u << 16) ? 2u : v < (1u << 24) ? 3u : 4u };
+                control[i / 4] |= (u8)((length - 1) << ((i % 4) * 2));
+                for (u32 byte{ 0 }; byte < length; ++byte) *values++ = (u8)(v >> (byte * 8));
+            }
+
+            return (u64)(values - buffer);
+        }
+    } // anonymous namespace
+
+    u64 encode_vertex_buffer_bound(u32 vertex_count, u32 vertex_size)
+    {
+        assert((vertex_size % sizeof(u16)) == 0);
+        return (vertex_size / sizeof(u16)) * (control_size(vertex_count) + sizeof(u16) * (u64)vertex_count);
+    }
+
+    u64 encode_vertex_buffer(u8* const buffer, const void* const vertices, u32 vertex_count, u32 vertex_size)
+    {
+        assert(buffer && vertices && vertex_size && (vertex_size % sizeof(u16)) == 0);
+        const u32 word_count{ vertex_size / (u32)sizeof(u16) };
+        const u16* const words{ (const u16*)vertices };
+        u8* at{ buffer };
+
+        for (u32 word{ 0 }; word < word_count; ++word)
+        {
+            at += encode_stream(at, vertex_count, [&](u32 i) {
+                const u16 previous{ i ? words[(u64)(i - 1) * word_count + word] : (u16)0 };
+                return (u32)zigzag16((u16)(words[(u64)i * word_count + word] - previous));
+            });
+        }
+
+        assert((u64)(at - buffer) <= encode_vertex_buffer_bound(vertex_count, vertex_size));
+        return (u64)(at - buffer);
+    }
+
+    u64 encode_index_buffer_bound(u32 index_count)
+    {
+        return control_size(index_count) + sizeof(u32) * (u64)index_count;
+    }
+
+    u64 encode_index_buffer(u8* const buffer, const void* const indices, u32 index_count, u32 index_size)
+    {
+        assert(buffer && indices && (index_size == sizeof(u16) || index_size == sizeof(u32)));
+        auto get_index{ [&](u32 i) {
+            return index_size == sizeof(u16) ? (u32)((const u16*)indices)[i] : ((const u32*)indices)[i];
+        } };
+
+        const u64 size{ encode_stream(buffer, index_count, [&](u32 i) {
+            return zigzag(get_index(i) - (i ? get_index(i - 1) : 0u));
+        }) };
+
+        assert(size <= encode_index_buffer_bound(index_count));
+        return size;
+    }
+
+    // Encodes the positions, elements and indices of a submesh for the engine, in that order. 'buffer' must have
+    // room for GetEncodedSubmeshSizeBound() bytes. Returns the number of bytes that were written.
+    EDITOR_INTERFACE u32 EncodeSubmesh(u8* const buffer, const u8* const positions, u32 position_size, const u8* const elements, u32 element_size,
+                                       u32 vertex_count, const u8* const indices, u32 index_size, u32 index_count)
+    {
+        assert(buffer && positions && indices && vertex_count && index_count);
+        u8* at{ buffer };
+        at += encode_vertex_buffer(at, positions, vertex_count, position_size);
+        // NOTE: element size is 0 for position-only vertex formats.
+        if (element_size) at += encode_vertex_buffer(at, elements, vertex_count, element_size);
+        at += encode_index_buffer(at, indices, index_count, index_size);
+        return (u32)(at - buffer);
+    }
+
+    EDITOR_INTERFACE u32 GetEncodedSubmeshSizeBound(u32 position_size, u32 element_size, u32 vertex_count, u32 index_count)
+    {
+        const u64 size{ encode_vertex_buffer_bound(vertex_count, position_size) +
+                        (element_size ? encode_vertex_buffer_bound(vertex_count, element_size) : 0) +
+                        encode_index_buffer_bound(index_count) };
+        assert(size < u32_invalid_id);
+        return (u32)size;
+    }
+}
@@ -0,0 +1,20 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "ToolsCommon.h"
+
+// Encoders for the compressed vertex and index buffer format of submeshes.
+// The format is described in Engine/Content/MeshDecoder.h, where the matching decoders are.
+namespace Quantum::tools {
+
+    // Largest number of bytes that encode_vertex_buffer() can write for these vertices.
+    u64 encode_vertex_buffer_bound(u32 vertex_count, u32 vertex_size);
+    // Encodes vertex_count vertices of vertex_size bytes (a multiple of 2) and returns the number of bytes written to 'buffer'.
+    u64 encode_vertex_buffer(u8* const buffer, const void* const vertices, u32 vertex_count, u32 vertex_size);
+
+    // Largest number of bytes that encode_index_buffer() can write for these indices.
+    u64 encode_index_buffer_bound(u32 index_count);
+    // Encodes index_count indices of index_size bytes (2 or 4) and returns the number of bytes written to 'buffer'.
+    u64 encode_index_buffer(u8* const buffer, const void* const indices, u32 index_count, u32 index_size);
+}
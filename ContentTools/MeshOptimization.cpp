@@ -0,0 +1,383 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "MeshOptimization.h"
+#include <algorithm>
+
+namespace Quantum::tools {
+    namespace {
+
+        using namespace math;
+        using namespace DirectX;
+
+        // Size of the LRU cache that is modeled by the vertex cache optimizer. Modern GPUs don't have a
+        // fixed size FIFO cache anymore, but orders that are good for this model are good for them too.
+        constexpr u32 forsyth_cache_size{ 32 };
+        constexpr u32 forsyth_max_valence{ 32 };
+        constexpr f32 forsyth_last_triangle_score{ 0.75f };
+        constexpr f32 forsyth_cache_decay_power{ 1.5f };
+        constexpr f32 forsyth_valence_boost_scale{ 2.f };
+        constexpr f32 forsyth_valence_boost_power{ 0.5f };
+
+        // Cache size that's used to find cluster boundaries for overdraw optimization.
+        constexpr u32 cluster_cache_size{ 16 };
+
+        // FIFO cache simulation. A vertex is in the cache if fewer than cache_size vertices were
+        // transformed after it. Bumping the time by more than cache_size flushes the cache.
+        class fifo_cache
+        {
+        public:
+            fifo_cache(u32 vertex_count, u32 cache_size) : _timestamps(vertex_count, 0u), _time{ cache_size + 1 }, _cache_size{ cache_size } {}
+
+            [[nodiscard]] u32 triangle_misses(const u32* const triangle)
+            {
+                u32 misses{ 0 };
+                for (u32 i{ 0 }; i < 3; ++i)
+                {
+                    u32& timestamp{ _timestamps[triangle[i]] };
+                    if (_time - timestamp >= _cache_size)
+                    {
+                        timestamp = _time++;
+                        ++misses;
+                    }
+                }
+                return misses;
+            }
+
+            void flush() { _time += _cache_size + 1; }
+
+        private:
+            util::vector<u32>   _timestamps;
+            u32                 _time;
+            const u32           _cache_size;
+        };
+
+        // Per-vertex score from Forsyth's "Linear-Speed Vertex Cache Optimisation". Vertices that are
+        // in the cache and vertices with few remaining triangles score higher.
+        struct forsyth_scores
+        {
+            f32 cache[forsyth_cache_size]{};
+            f32 valence[forsyth_max_valence]{};
+
+            forsyth_scores()
+            {
+                for (u32 i{ 0 }; i < forsyth_cache_size; ++i)
+                {
+                    cache[i] = i < 3
+                        ? forsyth_last_triangle_score
+                        : powf(1.f - (f32)(i - 3) / (f32)(forsyth_cache_size - 3), forsyth_cache_decay_power);
+                }
+
+                for (u32 i{ 1 }; i < forsyth_max_valence; ++i)
+                {
+                    valence[i] = forsyth_valence_boost_scale * powf((f32)i, -forsyth_valence_boost_power);
+                }
+            }
+
+            [[nodiscard]] f32 score(u32 cache_position, u32 live_triangles) const
+            {
+                if (!live_triangles) return -1.f;
+                const f32 cache_score{ cache_position < forsyth_cache_size ? cache[cache_position] : 0.f };
+                return cache_score + valence[std::min(live_triangles, forsyth_max_valence - 1)];
+            }
+        };
+
+        struct cluster
+        {
+            u32 first_triangle;
+            u32 triangle_count;
+            f32 sort_key;
+        };
+
+    } // anonymous namespace
+
+    vertex_cache_statistics
+    analyze_vertex_cache(const u32* const indices, u32 index_count, u32 vertex_count, u32 cache_size /* = 16 */)
+    {
+        assert(indices && (index_count % 3) == 0 && cache_size);
+        vertex_cache_statistics stats{};
+        if (!index_count || !vertex_count) return stats;
+
+        fifo_cache cache{ vertex_count, cache_size };
+        for (u32 i{ 0 }; i < index_count; i += 3)
+        {
+            stats.vertices_transformed += cache.triangle_misses(&indices[i]);
+        }
+
+        stats.acmr = (f32)stats.vertices_transformed / (f32)(index_count / 3);
+        stats.atvr = (f32)stats.vertices_transformed / (f32)vertex_count;
+        return stats;
+    }
+
+    void
+    optimize_vertex_cache(util::vector<u32>& indices, u32 vertex_count)
+    {
+        const u32 index_count{ (u32)indices.size() };
+        const u32 triangle_count{ index_count / 3 };
+        assert((index_count % 3) == 0);
+        if (triangle_count < 2 || !vertex_count) return;
+
+        static const forsyth_scores scores{};
+
+        // Triangles that use each vertex. Only the first live_triangles[v] entries of a vertex are
+        // still waiting to be emitted.
+        util::vector<u32> offsets(vertex_count + 1, 0u);
+        for (u32 i{ 0 }; i < index_count; ++i)
+        {
+            assert(indices[i] < vertex_count);
+            ++offsets[indices[i] + 1];
+        }
+        for (u32 i{ 0 }; i < vertex_count; ++i) offsets[i + 1] += offsets[i];
+
+        util::vector<u32> live_triangles(vertex_count, 0u);
+        util::vector<u32> vertex_triangles(index_count);
+        for (u32 i{ 0 }; i < index_count; ++i)
+        {
+            const u32 v{ indices[i] };
+            vertex_triangles[offsets[v] + live_triangles[v]++] = i / 3;
+        }
+
+        util::vector<u32> cache_position(vertex_count, u32_invalid_id);
+        util::vector<f32> vertex_score(vertex_count);
+        for (u32 i{ 0 }; i < vertex_count; ++i)
+        {
+            vertex_score[i] = scores.score(u32_invalid_id, live_triangles[i]);
+        }
+
+        util::vector<f32> triangle_score(triangle_count);
+        util::vector<u8> emitted(triangle_count, (u8)0);
+        for (u32 t{ 0 }; t < triangle_count; ++t)
+        {
+            const u32* const tri{ &indices[t * 3] };
+            triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+        }
+
+        util::vector<u32> result(index_count);
+        u32 cache[forsyth_cache_size + 3];
+        u32 cache_count{ 0 };
+        u32 best_triangle{ u32_invalid_id };
+        u32 next_unemitted{ 0 };
+
+        for (u32 n{ 0 }; n < triangle_count; ++n)
+        {
+            // NOTE: if none of the cached vertices has a live triangle, we continue with the next one in input order
+            //       instead of searching all triangles for the best score. This keeps the algorithm linear.
+            if (best_triangle == u32_invalid_id)
+            {
+                while (emitted[next_unemitted]) ++next_unemitted;
+                best_triangle = next_unemitted;
+            }
+
+            const u32* const tri{ &indices[best_triangle * 3] };
+            memcpy(&result[n * 3], tri, 3 * sizeof(u32));
+            emitted[best_triangle] = 1;
+
+            // Remove the triangle from the live triangles of its vertices.
+            for (u32 i{ 0 }; i < 3; ++i)
+            {
+                const u32 v{ tri[i] };
+                u32* const begin{ &vertex_triangles[offsets[v]] };
+                u32* const end{ begin + live_triangles[v] };
+                u32* const it{ std::find(begin, end, best_triangle) };
+                assert(it != end);
+                *it = *(end - 1);
+                --live_triangles[v];
+            }
+
+            // Move the triangle's vertices to the front of the cache and push the other ones back.
+            u32 new_cache[forsyth_cache_size + 3];
+            u32 new_cache_count{ 0 };
+            for (u32 i{ 0 }; i < 3; ++i) new_cache[new_cache_count++] = tri[i];
+            for (u32 i{ 0 }; i < cache_count; ++i)
+            {
+                const u32 v{ cache[i] };
+                if (v != tri[0] && v != tri[1] && v != tri[2]) new_cache[new_cache_count++] = v;
+            }
+
+            for (u32 i{ 0 }; i < new_cache_count; ++i)
+            {
+                const u32 v{ new_cache[i] };
+                cache_position[v] = i < forsyth_cache_size ? i : u32_invalid_id;
+                vertex_score[v] = scores.score(cache_position[v], live_triangles[v]);
+            }
+
+            // Only triangles that use a vertex whose score changed need a new score.
+            best_triangle = u32_invalid_id;
+            f32 best_score{ -1.f };
+            for (u32 i{ 0 }; i < new_cache_count; ++i)
+            {
+                const u32 v{ new_cache[i] };
+                for (u32 j{ 0 }; j < live_triangles[v]; ++j)
+                {
+                    const u32 t{ vertex_triangles[offsets[v] + j] };
+                    const u32* const t_tri{ &indices[t * 3] };
+                    const f32 score{ vertex_score[t_tri[0]] + vertex_score[t_tri[1]] + vertex_score[t_tri[2]] };
+                    triangle_score[t] = score;
+                    if (score > best_score)
+                    {
+                        best_score = score;
+                        best_triangle = t;
+                    }
+                }
+            }
+
+            cache_count = std::min(new_cache_count, forsyth_cache_size);
+            memcpy(cache, new_cache, cache_count * sizeof(u32));
+        }
+
+        indices.swap(result);
+    }
+
+    void
+    optimize_overdraw(util::vector<u32>& indices, const util::vector<vertex>& vertices, f32 threshold /* = 1.05f */)
+    {
+        const u32 index_count{ (u32)indices.size() };
+        const u32 triangle_count{ index_count / 3 };
+        const u32 vertex_count{ (u32)vertices.size() };
+        assert((index_count % 3) == 0 && threshold >= 1.f);
+        if (triangle_count < 2) return;
+
+        // Hard boundaries are where the vertex cache optimizer had to start over, i.e. triangles
+        // that miss the cache with all three vertices. Reordering clusters there is free.
+        util::vector<u32> hard_boundaries;
+        {
+            fifo_cache cache{ vertex_count, cluster_cache_size };
+            for (u32 t{ 0 }; t < triangle_count; ++t)
+            {
+                if (cache.triangle_misses(&indices[t * 3]) == 3) hard_boundaries.emplace_back(t);
+            }
+            assert(hard_boundaries.size() && hard_boundaries[0] == 0);
+            hard_boundaries.emplace_back(triangle_count);
+        }
+
+        // Soft boundaries split hard clusters further at points where starting with a cold cache
+        // keeps the cluster's cache miss ratio within threshold of the whole hard cluster.
+        util::vector<cluster> clusters;
+        fifo_cache cache{ vertex_count, cluster_cache_size };
+        for (u32 i{ 0 }; i < hard_boundaries.size() - 1; ++i)
+        {
+            const u32 begin{ hard_boundaries[i] };
+            const u32 end{ hard_boundaries[i + 1] };
+
+            cache.flush();
+            u32 misses{ 0 };
+            for (u32 t{ begin }; t < end; ++t) misses += cache.triangle_misses(&indices[t * 3]);
+            const f32 max_acmr{ threshold * (f32)misses / (f32)(end - begin) };
+
+            cache.flush();
+            u32 cluster_begin{ begin };
+            misses = 0;
+            for (u32 t{ begin }; t < end; ++t)
+            {
+                misses += cache.triangle_misses(&indices[t * 3]);
+                if (t + 1 < end && (f32)misses <= max_acmr * (f32)(t + 1 - cluster_begin))
+                {
+                    clusters.emplace_back(cluster{ cluster_begin, t + 1 - cluster_begin, 0.f });
+                    cluster_begin = t + 1;
+                    misses = 0;
+                    cache.flush();
+                }
+            }
+            clusters.emplace_back(cluster{ cluster_begin, end - cluster_begin, 0.f });
+        }
+
+        if (clusters.size() < 2) return;
+
+        // Sort key is how much a cluster faces away from the center of the mesh. Clusters on the outside
+        // that face outward are likely to occlude the rest, so they're drawn first.
+        XMVECTOR mesh_center{ XMVectorZero() };
+        for (const auto& v : vertices) mesh_center += XMLoadFloat3(&v.position);
+        mesh_center /= (f32)vertex_count;
+
+        for (auto& c : clusters)
+        {
+            XMVECTOR center{ XMVectorZero() };
+            XMVECTOR normal{ XMVectorZero() };
+            f32 area{ 0.f };
+            for (u32 t{ c.first_triangle }; t < c.first_triangle + c.triangle_count; ++t)
+            {
+                const u32* const tri{ &indices[t * 3] };
+                const XMVECTOR v0{ XMLoadFloat3(&vertices[tri[0]].position) };
+                const XMVECTOR v1{ XMLoadFloat3(&vertices[tri[1]].position) };
+                const XMVECTOR v2{ XMLoadFloat3(&vertices[tri[2]].position) };
+                // NOTE: the length of the cross product is twice the triangle's area, so the sum of cross
+                //       products is an area weighted normal.
+                const XMVECTOR n{ XMVector3Cross(v1 - v0, v2 - v0) };
+                const f32 a{ XMVectorGetX(XMVector3Length(n)) };
+                center += (v0 + v1 + v2) * (a / 3.f);
+                normal += n;
+                area += a;
+            }
+
+            if (area > 0.f) center /= area;
+            c.sort_key = XMVectorGetX(XMVector3Dot(center - mesh_center, XMVector3Normalize(normal)));
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const cluster& a, const cluster& b) { return a.sort_key > b.sort_key; });
+
+        util::vector<u32> result(index_count);
+        u32* dst{ result.data() };
+        for (const auto& c : clusters)
+        {
+            memcpy(dst, &indices[c.first_triangle * 3], c.triangle_count * 3 * sizeof(u32));
+            dst += c.triangle_count * 3;
+        }
+        assert(dst == result.data() + index_count);
+
+        indices.swap(result);
+    }
+
+    void
+    optimize_vertex_fetch(util::vector<u32>& indices, util::vector<vertex>& vertices)
+    {
+        const u32 vertex_count{ (u32)vertices.size() };
+        util::vector<u32> remap(vertex_count, u32_invalid_id);
+        util::vector<vertex> new_vertices;
+        new_vertices.reserve(vertex_count);
+
+        for (auto& index : indices)
+        {
+            assert(index < vertex_count);
+            u32& new_index{ remap[index] };
+            if (new_index == u32_invalid_id)
+            {
+                new_index = (u32)new_vertices.size();
+                new_vertices.emplace_back(vertices[index]);
+            }
+            index = new_index;
+        }
+
+        vertices.swap(new_vertices);
+    }
+
+    void
+    build_position_remap(const util::vector<vertex>& vertices, util::vector<u32>& position_remap)
+    {
+        const u32 vertex_count{ (u32)vertices.size() };
+        position_remap.resize(vertex_count);
+
+        u32 table_size{ 1 };
+        while (table_size < 2 * vertex_count) table_size <<= 1;
+        util::vector<u32> table(table_size, u32_invalid_id);
+
+        for (u32 i{ 0 }; i < vertex_count; ++i)
+        {
+            const v3& p{ vertices[i].position };
+            u32 bits[3];
+            memcpy(bits, &p, sizeof(bits));
+            u64 h{ ((u64)bits[0] << 32 | bits[1]) ^ ((u64)bits[2] * 0x9e3779b97f4a7c15ull) };
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+
+            u32 slot{ (u32)h & (table_size - 1) };
+            while (table[slot] != u32_invalid_id && memcmp(&vertices[table[slot]].position, &p, sizeof(v3)))
+            {
+                slot = (slot + 1) & (table_size - 1);
+            }
+
+            if (table[slot] == u32_invalid_id) table[slot] = i;
+            position_remap[i] = table[slot];
+        }
+    }
+}
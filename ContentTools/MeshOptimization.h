@@ -0,0 +1,30 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Geometry.h"
+
+namespace Quantum::tools {
+
+    struct vertex_cache_statistics
+    {
+        u32 vertices_transformed;   // number of cache misses
+        f32 acmr;                   // average cache miss ratio: transformed vertices per triangle (0.5 is the best case for large grids)
+        f32 atvr;                   // average transformed vertex ratio: transformed vertices per vertex (1.0 is the best case)
+    };
+
+    // Simulates a FIFO post-transform cache of the given size for a triangle list.
+    vertex_cache_statistics analyze_vertex_cache(const u32* const indices, u32 index_count, u32 vertex_count, u32 cache_size = 16);
+
+    // Reorders triangles so that they reuse recently transformed vertices (Forsyth's linear-speed algorithm).
+    void optimize_vertex_cache(util::vector<u32>& indices, u32 vertex_count);
+    // Splits the triangle list into clusters that keep the vertex cache efficiency within threshold of the input order
+    // and sorts them so that outward facing clusters are drawn first, which reduces overdraw.
+    // NOTE: expects the indices to already be optimized for the vertex cache.
+    void optimize_overdraw(util::vector<u32>& indices, const util::vector<vertex>& vertices, f32 threshold = 1.05f);
+    // Reorders vertices in the order in which they're first referenced by the indices and drops unused vertices.
+    void optimize_vertex_fetch(util::vector<u32>& indices, util::vector<vertex>& vertices);
+    // Maps every vertex to the first vertex with the same position. Vertices that only differ in their
+    // other attributes (the wedges of a position along uv seams and hard edges) get the same value.
+    void build_position_remap(const util::vector<vertex>& vertices, util::vector<u32>& position_remap);
+}
@@ -0,0 +1,411 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "MeshSimplification.h"
+#include "MeshOptimization.h"
+#include <algorithm>
+
+namespace Quantum::tools {
+    namespace {
+
+        using namespace math;
+        using namespace DirectX;
+
+        // Border and seam edges get an extra quadric for the plane that goes through the edge and is perpendicular
+        // to the triangle. The weight makes moving them more expensive than moving vertices inside a surface.
+        constexpr f32 edge_quadric_weight{ 10.f };
+        // Collapses that turn a triangle's normal by more than about 80 degrees are rejected.
+        constexpr f32 min_normal_cosine{ 0.2f };
+        // Positions around one vertex that can be mapped during a collapse. Vertices with more wedges aren't moved.
+        constexpr u32 max_wedges{ 16 };
+
+        struct quadric
+        {
+            f64 a00, a11, a22;
+            f64 a01, a02, a12;
+            f64 b0, b1, b2;
+            f64 c;
+            f64 w;
+
+            quadric& operator+=(const quadric& q)
+            {
+                a00 += q.a00; a11 += q.a11; a22 += q.a22;
+                a01 += q.a01; a02 += q.a02; a12 += q.a12;
+                b0 += q.b0; b1 += q.b1; b2 += q.b2;
+                c += q.c;
+                w += q.w;
+                return *this;
+            }
+        };
+
+        // Quadric of the squared distance to the plane dot(n, p) + d = 0. n must be normalized.
+        quadric plane_quadric(const v3& n, f32 d, f32 weight)
+        {
+            const f64 x{ n.x }, y{ n.y }, z{ n.z }, w{ weight };
+            return {
+                w * x * x, w * y * y, w * z * z,
+                w * x * y, w * x * z, w * y * z,
+                w * x * d, w * y * d, w * z * d,
+                w * d * d,
+                w
+            };
+        }
+
+        // Weighted average of the squared distances to all planes of the quadric.
+        f64 evaluate(const quadric& q, const v3& p)
+        {
+            const f64 x{ p.x }, y{ p.y }, z{ p.z };
+            const f64 r{
+                q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+                2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+                q.c };
+            return q.w > 0.0 ? std::abs(r) / q.w : 0.0;
+        }
+
+        u64 hash(u64 key)
+        {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdull;
+            key ^= key >> 33;
+            return key;
+        }
+
+        // Set of directed edges (a, b) using open addressing.
+        class edge_set
+        {
+        public:
+            explicit edge_set(u32 max_edges)
+            {
+                u32 size{ 1 };
+                while (size < 2 * max_edges) size <<= 1;
+                _keys.resize(size, empty_key);
+                _mask = size - 1;
+            }
+
+            void insert(u32 a, u32 b)
+            {
+                const u64 key{ ((u64)a << 32) | b };
+                u32 slot{ (u32)hash(key) & _mask };
+                while (_keys[slot] != empty_key && _keys[slot] != key) slot = (slot + 1) & _mask;
+                _keys[slot] = key;
+            }
+
+            [[nodiscard]] bool contains(u32 a, u32 b) const
+            {
+                const u64 key{ ((u64)a << 32) | b };
+                u32 slot{ (u32)hash(key) & _mask };
+                while (_keys[slot] != empty_key)
+                {
+                    if (_keys[slot] == key) return true;
+                    slot = (slot + 1) & _mask;
+                }
+                return false;
+            }
+
+        private:
+            static constexpr u64    empty_key{ ~0ull };
+            util::vector<u64>       _keys;
+            u32                     _mask{ 0 };
+        };
+
+        struct collapse
+        {
+            f32 error;
+            u32 from;   // position that is removed
+            u32 to;     // position that it's moved onto
+        };
+
+        // NOTE: the length of the result is twice the triangle's area.
+        XMVECTOR triangle_normal(const v3& p0, const v3& p1, const v3& p2)
+        {
+            const XMVECTOR v0{ XMLoadFloat3(&p0) };
+            return XMVector3Cross(XMLoadFloat3(&p1) - v0, XMLoadFloat3(&p2) - v0);
+        }
+
+        void add_quadrics(const util::vector<u32>& indices, const util::vector<v3>& positions,
+                          const util::vector<u32>& position_remap, util::vector<quadric>& quadrics)
+        {
+            const u32 index_count{ (u32)indices.size() };
+
+            edge_set vertex_edges{ index_count };
+            for (u32 i{ 0 }; i < index_count; i += 3)
+                for (u32 j{ 0 }; j < 3; ++j)
+                    vertex_edges.insert(indices[i + j], indices[i + (j + 1) % 3]);
+
+            for (u32 i{ 0 }; i < index_count; i += 3)
+            {
+                const u32 r[3]{ position_remap[indices[i]], position_remap[indices[i + 1]], position_remap[indices[i + 2]] };
+                const XMVECTOR normal{ triangle_normal(positions[r[0]], positions[r[1]], positions[r[2]]) };
+                const f32 length{ XMVectorGetX(XMVector3Length(normal)) };
+                if (length <= 0.f) continue;
+
+                v3 unit_normal;
+                XMStoreFloat3(&unit_normal, normal / length);
+                const XMVECTOR p0{ XMLoadFloat3(&positions[r[0]]) };
+                const f32 d{ -XMVectorGetX(XMVector3Dot(normal / length, p0)) };
+                const quadric q{ plane_quadric(unit_normal, d, length * 0.5f) };
+                for (u32 j{ 0 }; j < 3; ++j) quadrics[r[j]] += q;
+
+                // An edge without a twin is either on an open border (no twin by position either)
+                // or on a seam where the vertices on the other side have different attributes.
+                for (u32 j{ 0 }; j < 3; ++j)
+                {
+                    const u32 a{ indices[i + j] };
+                    const u32 b{ indices[i + (j + 1) % 3] };
+                    if (vertex_edges.contains(b, a)) continue;
+
+                    const XMVECTOR pa{ XMLoadFloat3(&positions[r[j]]) };
+                    const XMVECTOR pb{ XMLoadFloat3(&positions[r[(j + 1) % 3]]) };
+                    const XMVECTOR edge{ pb - pa };
+                    const f32 edge_length{ XMVectorGetX(XMVector3Length(edge)) };
+                    if (edge_length <= 0.f) continue;
+
+                    v3 edge_normal;
+                    XMStoreFloat3(&edge_normal, XMVector3Normalize(XMVector3Cross(edge, normal)));
+                    const f32 edge_d{ -XMVectorGetX(XMVector3Dot(XMLoadFloat3(&edge_normal), pa)) };
+                    const quadric eq{ plane_quadric(edge_normal, edge_d, edge_length * edge_length * edge_quadric_weight) };
+                    quadrics[r[j]] += eq;
+                    quadrics[r[(j + 1) % 3]] += eq;
+                }
+            }
+        }
+
+    } // anonymous namespace
+
+    f32
+    simplify_mesh(util::vector<u32>& indices, const util::vector<vertex>& vertices, u32 target_index_count, f32 max_error)
+    {
+        assert((indices.size() % 3) == 0);
+        const u32 vertex_count{ (u32)vertices.size() };
+        if (indices.size() <= target_index_count || !vertex_count) return 0.f;
+
+        // Work in a unit box, so that the quadrics have about the same precision for any mesh size.
+        XMVECTOR min_p{ XMLoadFloat3(&vertices[0].position) };
+        XMVECTOR max_p{ min_p };
+        for (const auto& v : vertices)
+        {
+            const XMVECTOR p{ XMLoadFloat3(&v.position) };
+            min_p = XMVectorMin(min_p, p);
+            max_p = XMVectorMax(max_p, p);
+        }
+        v3 size;
+        XMStoreFloat3(&size, max_p - min_p);
+        const f32 extent{ std::max({ size.x, size.y, size.z }) };
+        const f32 scale{ extent > 0.f ? 1.f / extent : 1.f };
+
+        util::vector<v3> positions(vertex_count);
+        for (u32 i{ 0 }; i < vertex_count; ++i)
+        {
+            XMStoreFloat3(&positions[i], (XMLoadFloat3(&vertices[i].position) - min_p) * scale);
+        }
+
+        util::vector<u32> position_remap;
+        build_position_remap(vertices, position_remap);
+
+        util::vector<quadric> quadrics(vertex_count, quadric{});
+        add_quadrics(indices, positions, position_remap, quadrics);
+
+        const f64 max_error_sq{ (f64)max_error * scale * (f64)max_error * scale };
+        f64 result_error_sq{ 0.0 };
+
+        util::vector<u32> triangle_offsets;
+        util::vector<u32> vertex_triangles;
+        util::vector<u32> remap(vertex_count);
+        util::vector<u8> locked(vertex_count);
+        util::vector<u8> on_border(vertex_count);
+        util::vector<collapse> collapses;
+        util::vector<u32> neighbor_stamp(vertex_count, 0u);
+        util::vector<u32> opposite_stamp(vertex_count, 0u);
+        u32 stamp{ 0 };
+
+        // Every pass collapses the cheapest edges that don't touch each other. Connectivity is rebuilt after
+        // each pass, which is simpler than updating it in place and keeps the whole thing at O(n log n) per pass.
+        while (indices.size() > target_index_count)
+        {
+            const u32 index_count{ (u32)indices.size() };
+
+            // Triangles around each position.
+            triangle_offsets.clear();
+            triangle_offsets.resize(vertex_count + 1, 0u);
+            for (u32 i{ 0 }; i < index_count; ++i) ++triangle_offsets[position_remap[indices[i]] + 1];
+            for (u32 i{ 0 }; i < vertex_count; ++i) triangle_offsets[i + 1] += triangle_offsets[i];
+            vertex_triangles.resize(index_count);
+            {
+                util::vector<u32> fill(vertex_count, 0u);
+                for (u32 i{ 0 }; i < index_count; ++i)
+                {
+                    const u32 r{ position_remap[indices[i]] };
+                    vertex_triangles[triangle_offsets[r] + fill[r]++] = i / 3;
+                }
+            }
+
+            // Positions on open borders. Collapsing them is only allowed along the border.
+            edge_set position_edges{ index_count };
+            for (u32 i{ 0 }; i < index_count; i += 3)
+                for (u32 j{ 0 }; j < 3; ++j)
+                    position_edges.insert(position_remap[indices[i + j]], position_remap[indices[i + (j + 1) % 3]]);
+
+            memset(on_border.data(), 0, vertex_count);
+            for (u32 i{ 0 }; i < index_count; i += 3)
+                for (u32 j{ 0 }; j < 3; ++j)
+                {
+                    const u32 a{ position_remap[indices[i + j]] };
+                    const u32 b{ position_remap[indices[i + (j + 1) % 3]] };
+                    if (!position_edges.contains(b, a)) on_border[a] = on_border[b] = 1;
+                }
+
+            // Candidates in both directions for every edge. Edges that have a twin are only visited once.
+            collapses.clear();
+            for (u32 i{ 0 }; i < index_count; i += 3)
+                for (u32 j{ 0 }; j < 3; ++j)
+                {
+                    const u32 a{ position_remap[indices[i + j]] };
+                    const u32 b{ position_remap[indices[i + (j + 1) % 3]] };
+                    if (a == b || (a > b && position_edges.contains(b, a))) continue;
+
+                    quadric q{ quadrics[a] };
+                    q += quadrics[b];
+                    collapses.emplace_back(collapse{ (f32)evaluate(q, positions[b]), a, b });
+                    collapses.emplace_back(collapse{ (f32)evaluate(q, positions[a]), b, a });
+                }
+
+            std::sort(collapses.begin(), collapses.end(), [](const collapse& x, const collapse& y) {
+                return x.error < y.error || (x.error == y.error && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+            });
+
+            for (u32 i{ 0 }; i < vertex_count; ++i) remap[i] = i;
+            memset(locked.data(), 0, vertex_count);
+
+            const u32 triangles_to_remove{ (index_count - target_index_count) / 3 };
+            u32 removed_triangles{ 0 };
+            u32 collapse_count{ 0 };
+
+            for (const auto& c : collapses)
+            {
+                if (removed_triangles >= triangles_to_remove || c.error > max_error_sq) break;
+
+                const u32 u{ c.from };
+                const u32 v{ c.to };
+                if (locked[u] || locked[v]) continue;
+
+                // Border positions can only slide along the border.
+                if (on_border[u] && position_edges.contains(u, v) && position_edges.contains(v, u)) continue;
+
+                // Every wedge of u has to be connected to exactly one wedge of v. Otherwise moving u would
+                // drag attributes across a seam.
+                u32 wedge_from[max_wedges];
+                u32 wedge_to[max_wedges];
+                u32 wedge_count{ 0 };
+                u32 shared_triangles{ 0 };
+                bool valid{ true };
+
+                ++stamp;
+                const u32* const triangles{ &vertex_triangles[triangle_offsets[u]] };
+                const u32 count{ triangle_offsets[u + 1] - triangle_offsets[u] };
+                for (u32 t{ 0 }; t < count && valid; ++t)
+                {
+                    const u32* const tri{ &indices[triangles[t] * 3] };
+                    u32 corner_u{ u32_invalid_id };
+                    u32 corner_v{ u32_invalid_id };
+                    for (u32 k{ 0 }; k < 3; ++k)
+                    {
+                        const u32 r{ position_remap[tri[k]] };
+                        if (r == u) corner_u = k;
+                        else if (r == v) corner_v = k;
+                    }
+                    assert(corner_u != u32_invalid_id);
+
+                    u32 w{ 0 };
+                    while (w < wedge_count && wedge_from[w] != tri[corner_u]) ++w;
+                    if (w == wedge_count)
+                    {
+                        if (wedge_count == max_wedges) { valid = false; break; }
+                        wedge_from[wedge_count] = tri[corner_u];
+                        wedge_to[wedge_count++] = u32_invalid_id;
+                    }
+
+                    for (u32 k{ 0 }; k < 3; ++k) neighbor_stamp[position_remap[tri[k]]] = stamp;
+
+                    if (corner_v != u32_invalid_id)
+                    {
+                        opposite_stamp[position_remap[tri[3 - corner_u - corner_v]]] = stamp;
+                        ++shared_triangles;
+                        if (wedge_to[w] == u32_invalid_id) wedge_to[w] = tri[corner_v];
+                        else if (wedge_to[w] != tri[corner_v]) valid = false;
+                        continue;
+                    }
+
+                    // Reject collapses that flip or squash the triangles that stay.
+                    const v3& p0{ positions[position_remap[tri[0]]] };
+                    const v3& p1{ positions[position_remap[tri[1]]] };
+                    const v3& p2{ positions[position_remap[tri[2]]] };
+                    const XMVECTOR n0{ triangle_normal(p0, p1, p2) };
+                    const XMVECTOR n1{ triangle_normal(corner_u == 0 ? positions[v] : p0,
+                                                       corner_u == 1 ? positions[v] : p1,
+                                                       corner_u == 2 ? positions[v] : p2) };
+                    const f32 l0{ XMVectorGetX(XMVector3Length(n0)) };
+                    const f32 l1{ XMVectorGetX(XMVector3Length(n1)) };
+                    if (l1 <= 0.f || XMVectorGetX(XMVector3Dot(n0, n1)) < min_normal_cosine * l0 * l1) valid = false;
+                }
+
+                for (u32 w{ 0 }; w < wedge_count && valid; ++w)
+                {
+                    if (wedge_to[w] == u32_invalid_id) valid = false;
+                }
+
+                // Link condition: u and v may only have the neighbors in common that are opposite to the edge
+                // in the triangles that are removed. Otherwise the collapse pinches the surface.
+                const u32* const v_triangles{ &vertex_triangles[triangle_offsets[v]] };
+                const u32 v_count{ triangle_offsets[v + 1] - triangle_offsets[v] };
+                for (u32 t{ 0 }; t < v_count && valid; ++t)
+                {
+                    const u32* const tri{ &indices[v_triangles[t] * 3] };
+                    for (u32 k{ 0 }; k < 3; ++k)
+                    {
+                        const u32 r{ position_remap[tri[k]] };
+                        if (r != u && r != v && neighbor_stamp[r] == stamp && opposite_stamp[r] != stamp) valid = false;
+                    }
+                }
+
+                if (!valid || !shared_triangles) continue;
+
+                for (u32 w{ 0 }; w < wedge_count; ++w) remap[wedge_from[w]] = wedge_to[w];
+                quadrics[v] += quadrics[u];
+
+                // Lock the whole neighborhood. The flip test above relies on positions that don't change in this pass.
+                for (u32 t{ 0 }; t < count; ++t)
+                {
+                    const u32* const tri{ &indices[triangles[t] * 3] };
+                    for (u32 k{ 0 }; k < 3; ++k) locked[position_remap[tri[k]]] = 1;
+                }
+
+                removed_triangles += shared_triangles;
+                result_error_sq = std::max(result_error_sq, (f64)c.error);
+                ++collapse_count;
+            }
+
+            if (!collapse_count) break;
+
+            // Apply the collapses and remove the triangles that became degenerate.
+            u32 write{ 0 };
+            for (u32 i{ 0 }; i < index_count; i += 3)
+            {
+                const u32 a{ remap[indices[i]] };
+                const u32 b{ remap[indices[i + 1]] };
+                const u32 c{ remap[indices[i + 2]] };
+                const u32 ra{ position_remap[a] }, rb{ position_remap[b] }, rc{ position_remap[c] };
+                if (ra == rb || rb == rc || rc == ra) continue;
+
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+
+            assert(write < index_count);
+            indices.resize(write);
+        }
+
+        return (f32)(std::sqrt(result_error_sq) * extent);
+    }
+}
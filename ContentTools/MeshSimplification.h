@@ -0,0 +1,18 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Geometry.h"
+
+namespace Quantum::tools {
+
+    // Reduces the number of triangles in an indexed triangle list to about target_index_count / 3 by collapsing
+    // edges in the order of their quadric error (Garland-Heckbert). Collapses move a vertex onto one of its
+    // neighbors, so no new vertices or attributes are created and the indices keep referring to 'vertices'.
+    // Open borders and attribute seams (vertices that share a position but have different normals or uvs)
+    // are only collapsed along themselves, so uv charts and hard edges stay intact.
+    // Returns the largest error of all collapses as a distance in mesh units. Collapses with an error above
+    // max_error aren't performed, so the result can have more triangles than requested.
+    // NOTE: vertices that are no longer referenced by the indices aren't removed.
+    f32 simplify_mesh(util::vector<u32>& indices, const util::vector<vertex>& vertices, u32 target_index_count, f32 max_error);
+}
@@ -0,0 +1,271 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "Meshlets.h"
+#include "MeshOptimization.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace Quantum::tools {
+    namespace {
+
+        using namespace math;
+        using namespace DirectX;
+
+        // Normal cones that are wider than this (half angle in radians) can't cull anything useful,
+        // so we don't store them.
+        constexpr f32 max_cone_half_angle{ XM_PIDIV2 * 0.95f };
+
+        // Triangles around each position as offsets into a single array. We use positions rather than
+        // vertices, so that triangles on both sides of a uv seam or hard edge are neighbors as well.
+        struct position_adjacency
+        {
+            util::vector<u32>   position_remap;
+            util::vector<u32>   offsets;
+            util::vector<u32>   triangles;
+        };
+
+        void build_adjacency(const util::vector<u32>& indices, const util::vector<vertex>& vertices, position_adjacency& adjacency)
+        {
+            const u32 index_count{ (u32)indices.size() };
+            const u32 vertex_count{ (u32)vertices.size() };
+            build_position_remap(vertices, adjacency.position_remap);
+
+            adjacency.offsets.resize(vertex_count + 1, 0u);
+            for (u32 i{ 0 }; i < index_count; ++i) ++adjacency.offsets[adjacency.position_remap[indices[i]] + 1];
+            for (u32 i{ 0 }; i < vertex_count; ++i) adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+            adjacency.triangles.resize(index_count);
+            util::vector<u32> fill(vertex_count, 0u);
+            for (u32 i{ 0 }; i < index_count; ++i)
+            {
+                const u32 p{ adjacency.position_remap[indices[i]] };
+                adjacency.triangles[adjacency.offsets[p] + fill[p]++] = i / 3;
+            }
+        }
+
+        // Ritter's bounding sphere: start with the sphere around two distant points and grow it for
+        // every point that's still outside. The result is at most a few percent larger than optimal.
+        void compute_bounding_sphere(const u32* const indices, u32 index_count, const util::vector<vertex>& vertices, meshlet& m)
+        {
+            assert(index_count);
+            auto farthest_from{ [&](XMVECTOR p) {
+                XMVECTOR result{ p };
+                f32 max_distance{ -1.f };
+                for (u32 i{ 0 }; i < index_count; ++i)
+                {
+                    const XMVECTOR q{ XMLoadFloat3(&vertices[indices[i]].position) };
+                    const f32 distance{ XMVectorGetX(XMVector3LengthSq(q - p)) };
+                    if (distance > max_distance)
+                    {
+                        max_distance = distance;
+                        result = q;
+                    }
+                }
+                return result;
+            } };
+
+            const XMVECTOR a{ farthest_from(XMLoadFloat3(&vertices[indices[0]].position)) };
+            const XMVECTOR b{ farthest_from(a) };
+            XMVECTOR center{ (a + b) * 0.5f };
+            f32 radius{ XMVectorGetX(XMVector3Length(b - a)) * 0.5f };
+
+            for (u32 i{ 0 }; i < index_count; ++i)
+            {
+                const XMVECTOR p{ XMLoadFloat3(&vertices[indices[i]].position) };
+                const f32 distance{ XMVectorGetX(XMVector3Length(p - center)) };
+                if (distance > radius)
+                {
+                    // Move the center towards p, so that the new sphere just touches the old one on the far side.
+                    const f32 new_radius{ (radius + distance) * 0.5f };
+                    center += (p - center) * ((new_radius - radius) / distance);
+                    radius = new_radius;
+                }
+            }
+
+            XMStoreFloat3(&m.center, center);
+            m.radius = radius;
+        }
+
+        void compute_normal_cone(const u32* const indices, u32 index_count, const util::vector<vertex>& vertices, meshlet& m)
+        {
+            util::vector<XMVECTOR> normals;
+            normals.reserve(index_count / 3);
+            XMVECTOR sum{ XMVectorZero() };
+            for (u32 i{ 0 }; i < index_count; i += 3)
+            {
+                const XMVECTOR p0{ XMLoadFloat3(&vertices[indices[i]].position) };
+                const XMVECTOR p1{ XMLoadFloat3(&vertices[indices[i + 1]].position) };
+                const XMVECTOR p2{ XMLoadFloat3(&vertices[indices[i + 2]].position) };
+                const XMVECTOR n{ XMVector3Cross(p1 - p0, p2 - p0) };
+                // NOTE: degenerate triangles are invisible, so they don't restrict the cone.
+                if (XMVector3Equal(n, XMVectorZero())) continue;
+                normals.emplace_back(XMVector3Normalize(n));
+                sum += normals.back();
+            }
+
+            m.cone_axis = {};
+            m.cone_cutoff = 1.f;
+            if (normals.empty() || XMVectorGetX(XMVector3LengthSq(sum)) < FLT_EPSILON) return;
+
+            const XMVECTOR axis{ XMVector3Normalize(sum) };
+            f32 min_dot{ 1.f };
+            for (const XMVECTOR& n : normals)
+            {
+                min_dot = std::min(min_dot, XMVectorGetX(XMVector3Dot(axis, n)));
+            }
+
+            if (min_dot <= XMScalarCos(max_cone_half_angle)) return;
+
+            XMStoreFloat3(&m.cone_axis, axis);
+            // All triangles are back-facing if the view direction is within 90 degrees minus the half angle
+            // of the cone axis. The cosine of that angle is the sine of the half angle.
+            m.cone_cutoff = sqrt(1.f - min_dot * min_dot);
+        }
+    } // anonymous namespace
+
+    void
+    build_meshlets(util::vector<u32>& indices, const util::vector<vertex>& vertices, util::vector<meshlet>& meshlets)
+    {
+        assert((indices.size() % 3) == 0);
+        const u32 index_count{ (u32)indices.size() };
+        const u32 triangle_count{ index_count / 3 };
+        const u32 vertex_count{ (u32)vertices.size() };
+        meshlets.clear();
+        if (!triangle_count) return;
+
+        position_adjacency adjacency{};
+        build_adjacency(indices, vertices, adjacency);
+        const util::vector<u32>& position_remap{ adjacency.position_remap };
+
+        // Number of triangles that still have to be added to a meshlet for each position.
+        util::vector<u32> live_triangles(vertex_count);
+        for (u32 i{ 0 }; i < vertex_count; ++i) live_triangles[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+
+        util::vector<u8> emitted(triangle_count, (u8)0);
+        // Index of the meshlet that a vertex was last added to.
+        util::vector<u32> vertex_meshlet(vertex_count, u32_invalid_id);
+        util::vector<u32> meshlet_vertices;
+        meshlet_vertices.reserve(max_meshlet_vertices);
+
+        util::vector<u32> new_indices;
+        new_indices.reserve(index_count);
+
+        u32 meshlet_index{ 0 };
+        u32 meshlet_triangles{ 0 };
+        u32 last_triangle{ u32_invalid_id };
+        u32 next_seed{ 0 };
+        XMVECTOR meshlet_min{};
+        XMVECTOR meshlet_max{};
+
+        auto new_vertex_count{ [&](u32 t) {
+            u32 count{ 0 };
+            for (u32 i{ 0 }; i < 3; ++i) count += vertex_meshlet[indices[t * 3 + i]] != meshlet_index;
+            return count;
+        } };
+
+        // Picks the neighbor of 'v' that adds the fewest vertices to the meshlet. Among those, triangles
+        // whose positions have few remaining triangles go first, so we don't leave small islands behind.
+        auto find_best_neighbor{ [&](u32 v, u32& best, u32& best_new_vertices, u32& best_live) {
+            const u32 p{ position_remap[v] };
+            for (u32 j{ adjacency.offsets[p] }; j < adjacency.offsets[p + 1]; ++j)
+            {
+                const u32 t{ adjacency.triangles[j] };
+                if (emitted[t]) continue;
+
+                const u32 new_vertices{ new_vertex_count(t) };
+                if (new_vertices > best_new_vertices || meshlet_vertices.size() + new_vertices > max_meshlet_vertices) continue;
+
+                const u32* const triangle{ &indices[t * 3] };
+                const u32 live{ live_triangles[position_remap[triangle[0]]] + live_triangles[position_remap[triangle[1]]] + live_triangles[position_remap[triangle[2]]] };
+                if (new_vertices < best_new_vertices || (new_vertices == best_new_vertices && live < best_live))
+                {
+                    best = t;
+                    best_new_vertices = new_vertices;
+                    best_live = live;
+                }
+            }
+        } };
+
+        auto finish_meshlet{ [&]() {
+            meshlet& m{ meshlets.emplace_back() };
+            m.index_count = meshlet_triangles * 3;
+            m.first_index = (u32)new_indices.size() - m.index_count;
+            compute_bounding_sphere(&new_indices[m.first_index], m.index_count, vertices, m);
+            compute_normal_cone(&new_indices[m.first_index], m.index_count, vertices, m);
+
+            ++meshlet_index;
+            meshlet_triangles = 0;
+            meshlet_min = XMVectorReplicate(FLT_MAX);
+            meshlet_max = XMVectorReplicate(-FLT_MAX);
+            meshlet_vertices.clear();
+            last_triangle = u32_invalid_id;
+        } };
+
+        // Triangles that don't share vertices with the meshlet can still be added if they're close to it.
+        // This keeps meshlets of faceted meshes (where no two triangles share a vertex) from being tiny.
+        auto is_close_to_meshlet{ [&](u32 t) {
+            if (meshlet_vertices.size() + new_vertex_count(t) > max_meshlet_vertices) return false;
+            const XMVECTOR p0{ XMLoadFloat3(&vertices[indices[t * 3]].position) };
+            const XMVECTOR p1{ XMLoadFloat3(&vertices[indices[t * 3 + 1]].position) };
+            const XMVECTOR p2{ XMLoadFloat3(&vertices[indices[t * 3 + 2]].position) };
+            const XMVECTOR centroid{ (p0 + p1 + p2) * (1.f / 3.f) };
+            const XMVECTOR extent{ meshlet_max - meshlet_min };
+            const XMVECTOR margin{ XMVectorMax(XMVectorMax(XMVectorSplatX(extent), XMVectorSplatY(extent)), XMVectorSplatZ(extent)) };
+            return XMVector3InBounds(centroid - (meshlet_min + meshlet_max) * 0.5f, extent * 0.5f + margin);
+        } };
+
+        meshlet_min = XMVectorReplicate(FLT_MAX);
+        meshlet_max = XMVectorReplicate(-FLT_MAX);
+        for (u32 emitted_count{ 0 }; emitted_count < triangle_count; ++emitted_count)
+        {
+            u32 best{ u32_invalid_id };
+            u32 best_new_vertices{ 4 };
+            u32 best_live{ u32_invalid_id };
+
+            // Grow the meshlet around the last triangle first. If that's boxed in, try all of its vertices.
+            if (last_triangle != u32_invalid_id)
+            {
+                for (u32 i{ 0 }; i < 3; ++i) find_best_neighbor(indices[last_triangle * 3 + i], best, best_new_vertices, best_live);
+                if (best == u32_invalid_id)
+                {
+                    for (u32 v : meshlet_vertices) find_best_neighbor(v, best, best_new_vertices, best_live);
+                }
+            }
+
+            if (best == u32_invalid_id)
+            {
+                // Nothing connected fits anymore: continue with the next triangle in input order,
+                // in a new meshlet unless it's close to the current one.
+                while (emitted[next_seed]) ++next_seed;
+                if (meshlet_triangles && !is_close_to_meshlet(next_seed)) finish_meshlet();
+                best = next_seed;
+            }
+
+            emitted[best] = 1;
+            for (u32 i{ 0 }; i < 3; ++i)
+            {
+                const u32 v{ indices[best * 3 + i] };
+                new_indices.emplace_back(v);
+                --live_triangles[position_remap[v]];
+                if (vertex_meshlet[v] != meshlet_index)
+                {
+                    vertex_meshlet[v] = meshlet_index;
+                    meshlet_vertices.emplace_back(v);
+                    const XMVECTOR p{ XMLoadFloat3(&vertices[v].position) };
+                    meshlet_min = XMVectorMin(meshlet_min, p);
+                    meshlet_max = XMVectorMax(meshlet_max, p);
+                }
+            }
+
+            assert(meshlet_vertices.size() <= max_meshlet_vertices);
+            last_triangle = best;
+            if (++meshlet_triangles == max_meshlet_triangles) finish_meshlet();
+        }
+
+        if (meshlet_triangles) finish_meshlet();
+
+        assert(new_indices.size() == index_count);
+        indices.swap(new_indices);
+    }
+}
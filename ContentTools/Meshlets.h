@@ -0,0 +1,17 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Geometry.h"
+
+namespace Quantum::tools {
+
+    constexpr u32 max_meshlet_vertices{ 64 };
+    constexpr u32 max_meshlet_triangles{ 124 };
+
+    // Groups the triangles of an indexed triangle list into meshlets of neighboring triangles and computes
+    // their bounding spheres and normal cones. The indices are reordered so that the triangles of each
+    // meshlet are contiguous. Triangles keep the order of the input as much as possible, so it's best to
+    // optimize the indices for the vertex cache first.
+    void build_meshlets(util::vector<u32>& indices, const util::vector<vertex>& vertices, util::vector<meshlet>& meshlets);
+}
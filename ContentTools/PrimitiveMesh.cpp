@@ -28,6 +28,9 @@ namespace Quantum::tools {
         };
 		
         static_assert(_countof(creators) == primitive_mesh_type::count);
+
+        // NOTE: the editor has its own (lower) limits. This is high enough to generate test meshes with millions of triangles.
+        constexpr u32 max_segments{ 1024 };
 		
         struct axis {
             enum : u32 {
@@ -42,10 +45,10 @@ namespace Quantum::tools {
             v3 offset = { -0.5f, 0.f, -0.5f }, v2 u_range = { 0.f, 1.f }, v2 v_range = { 0.f, 1.f })
         {
             assert(horizontal_index < 3 && vertical_index < 3);
-            assert(vertical_index != vertical_index);
+            assert(horizontal_index != vertical_index);
 			
-            const u32 horizontal_count{ clamp(info.segments[horizontal_index], 1u, 10u) };
-            const u32 vertical_count{ clamp(info.segments[vertical_index], 1u, 10u) };
+            const u32 horizontal_count{ clamp(info.segments[horizontal_index], 1u, max_segments) };
+            const u32 vertical_count{ clamp(info.segments[vertical_index], 1u, max_segments) };
             const f32 horizontal_step{ 1.f / horizontal_count };
             const f32 vertical_step{ 1.f / vertical_count };
             const f32 u_step{ (u_range.y - u_range.x) / horizontal_count };
@@ -109,8 +112,8 @@ namespace Quantum::tools {
 		
         mesh create_uv_sphere(const primitive_init_info& info)
         {
-            const u32 phi_count{ clamp(info.segments[axis::x], 3u, 64u) };
-            const u32 theta_count{ clamp(info.segments[axis::y], 2u, 64u) };
+            const u32 phi_count{ clamp(info.segments[axis::x], 3u, max_segments) };
+            const u32 theta_count{ clamp(info.segments[axis::y], 2u, max_segments) };
             const f32 theta_step{ pi / theta_count };
             const f32 phi_step{ two_pi / phi_count };
             const u32 num_indices{ 2 * 3 * phi_count + 2 * 3 * phi_count * (theta_count - 2) };
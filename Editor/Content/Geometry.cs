@@ -9,6 +9,7 @@ using System.Collections.ObjectModel;
 using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Numerics;
 using System.Text;
 using System.Windows;
 
@@ -30,7 +31,8 @@ namespace Editor.Content
         Normals = 0x01,
         TSpace = 0x03,
         Joints = 0x04,
-        Colors = 0x08
+        Colors = 0x08,
+        Quantized = 0x10
     }
 	
     enum PrimitiveTopology
@@ -45,6 +47,17 @@ namespace Editor.Content
     class Mesh : ViewModelBase
     {
         public static int PositionSize => sizeof(float) * 3;
+        // Positions stored as 16 bit unorms in the bounding box of the mesh (x, y, z and padding).
+        public static int QuantizedPositionSize => sizeof(ushort) * 4;
+        // Bounding sphere (4 floats), normal cone (4 floats), first index and index count.
+        public static int MeshletSize => sizeof(float) * 8 + sizeof(int) * 2;
+        // Set in the upper 16 bits of the primitive topology when packed for the engine.
+        public static int HasMeshletsFlag => 0x01 << 16;
+        public static int QuantizedPositionsFlag => 0x02 << 16;
+        public static int CompressedFlag => 0x04 << 16;
+        // Uncompressed vertex buffers are padded to this many bytes when packed for the engine
+        // (same as content::submesh_buffer_alignment in the engine).
+        public static int BufferAlignment => 4;
 		
         private int _elementSize;
         public int ElementSize
@@ -135,8 +148,15 @@ namespace Editor.Content
 		
         public PrimitiveTopology PrimitiveTopology { get; set; }
         public byte[] Positions { get; set; }
+        // Decoding of quantized positions: position = PositionOffset + quantized * PositionScale.
+        public Vector3 PositionOffset { get; set; }
+        public Vector3 PositionScale { get; set; } = Vector3.One;
+        public bool IsQuantized => ElementsType.HasFlag(ElementsType.Quantized);
+        public int GetPositionSize() => IsQuantized ? QuantizedPositionSize : PositionSize;
         public byte[] Elements { get; set; }
         public byte[] Indices { get; set; }
+        public int MeshletCount { get; set; }
+        public byte[] Meshlets { get; set; }
     }
 	
     class MeshLOD : ViewModelBase
@@ -291,6 +311,78 @@ namespace Editor.Content
 			}
 		}
 		
+		private bool _optimizeVertexCache;
+		public bool OptimizeVertexCache
+		{
+			get => _optimizeVertexCache;
+			set
+			{
+				if (_optimizeVertexCache != value)
+				{
+					_optimizeVertexCache = value;
+					OnPropertyChanged(nameof(OptimizeVertexCache));
+				}
+			}
+		}
+		
+		private int _generatedLodCount;
+		public int GeneratedLodCount
+		{
+			get => _generatedLodCount;
+			set
+			{
+				if (_generatedLodCount != value)
+				{
+					_generatedLodCount = value;
+					OnPropertyChanged(nameof(GeneratedLodCount));
+				}
+			}
+		}
+		
+		private bool _buildMeshlets;
+		public bool BuildMeshlets
+		{
+			get => _buildMeshlets;
+			set
+			{
+				if (_buildMeshlets != value)
+				{
+					_buildMeshlets = value;
+					OnPropertyChanged(nameof(BuildMeshlets));
+				}
+			}
+		}
+		
+		private bool _quantizeVertices;
+		public bool QuantizeVertices
+		{
+			get => _quantizeVertices;
+			set
+			{
+				if (_quantizeVertices != value)
+				{
+					_quantizeVertices = value;
+					OnPropertyChanged(nameof(QuantizeVertices));
+				}
+			}
+		}
+		
+		// Only used when packing for the engine. The vertex and index buffers are stored with the
+		// delta codec in ContentTools and decoded by the engine when the geometry is loaded.
+		private bool _compressMeshes;
+		public bool CompressMeshes
+		{
+			get => _compressMeshes;
+			set
+			{
+				if (_compressMeshes != value)
+				{
+					_compressMeshes = value;
+					OnPropertyChanged(nameof(CompressMeshes));
+				}
+			}
+		}
+		
 		public GeometryImportSettings()
         {
             CalculateNormals = false;
@@ -300,6 +392,11 @@ namespace Editor.Content
             ImportEmbeddedTextures = true;
             ImportAnimations = true;
 			CoalesceMeshes = false;
+			OptimizeVertexCache = true;
+			GeneratedLodCount = 0;
+			BuildMeshlets = false;
+			QuantizeVertices = false;
+			CompressMeshes = false;
         }
 		
         internal void ToBinary(BinaryWriter writer)
@@ -311,9 +408,21 @@ namespace Editor.Content
             writer.Write(ImportEmbeddedTextures);
             writer.Write(ImportAnimations);
             writer.Write(CoalesceMeshes);
+            writer.Write(OptimizeVertexCache);
+            writer.Write(GeneratedLodCount);
+            writer.Write(BuildMeshlets);
+            writer.Write(QuantizeVertices);
+            writer.Write(CompressMeshes);
         }
 		
         public void FromBinary(BinaryReader reader)
+        {
+            FromBinary(reader, Geometry.FormatVersion);
+        }
+		
+        // NOTE: settings of unversioned geometry files (format version 0) end after CoalesceMeshes.
+        //       Settings that were added later get their default values.
+        internal void FromBinary(BinaryReader reader, int formatVersion)
         {
             CalculateNormals = reader.ReadBoolean();
             CalculateTangents = reader.ReadBoolean();
@@ -322,6 +431,22 @@ namespace Editor.Content
             ImportEmbeddedTextures = reader.ReadBoolean();
             ImportAnimations = reader.ReadBoolean();
 			CoalesceMeshes = reader.ReadBoolean();
+			if (formatVersion == 0)
+			{
+				var defaults = new GeometryImportSettings();
+				OptimizeVertexCache = defaults.OptimizeVertexCache;
+				GeneratedLodCount = defaults.GeneratedLodCount;
+				BuildMeshlets = defaults.BuildMeshlets;
+				QuantizeVertices = defaults.QuantizeVertices;
+				CompressMeshes = defaults.CompressMeshes;
+				return;
+			}
+			
+			OptimizeVertexCache = reader.ReadBoolean();
+			GeneratedLodCount = reader.ReadInt32();
+			BuildMeshlets = reader.ReadBoolean();
+			QuantizeVertices = reader.ReadBoolean();
+			CompressMeshes = reader.ReadBoolean();
         }
 
 		void IAssetImportSettings.ToBinary(BinaryWriter writer)
@@ -332,6 +457,13 @@ namespace Editor.Content
 	
     class Geometry : Asset
     {
+        // Version of the data that follows the asset file header. Version 0 files were written before the
+        // format had a version: they start with the import settings, whose first byte is a bool (0 or 1).
+        // Versioned files start with a marker byte that can't be a bool, followed by the version.
+        // Version 1 added the newer import settings and the meshlets of each mesh.
+        internal const int FormatVersion = 1;
+        private const byte FormatVersionMarker = 0xff;
+		
         private readonly List<LODGroup> _lodGroups = new();
         private readonly object _lock = new();
 		
@@ -395,6 +527,15 @@ namespace Editor.Content
             return lodList;
         }
 		
+        private static Vector3 ReadVector3(BinaryReader reader) => new(reader.ReadSingle(), reader.ReadSingle(), reader.ReadSingle());
+		
+        private static void WriteVector3(BinaryWriter writer, Vector3 v)
+        {
+            writer.Write(v.X);
+            writer.Write(v.Y);
+            writer.Write(v.Z);
+        }
+		
         private static void ReadMeshes(BinaryReader reader, List<int> lodIds, List<MeshLOD> lodList)
         {
             // get mesh's name
@@ -420,13 +561,20 @@ namespace Editor.Content
             mesh.IndexSize = reader.ReadInt32();
             mesh.IndexCount = reader.ReadInt32();
             var lodThreshold = reader.ReadSingle();
+            if (mesh.IsQuantized)
+            {
+                mesh.PositionOffset = ReadVector3(reader);
+                mesh.PositionScale = ReadVector3(reader);
+            }
 			
             var elementsBufferSize = mesh.ElementSize * mesh.VertexCount;
             var indexBufferSize = mesh.IndexSize * mesh.IndexCount;
 			
-            mesh.Positions = reader.ReadBytes(Mesh.PositionSize * mesh.VertexCount);
+            mesh.Positions = reader.ReadBytes(mesh.GetPositionSize() * mesh.VertexCount);
             mesh.Elements = reader.ReadBytes(elementsBufferSize);
             mesh.Indices = reader.ReadBytes(indexBufferSize);
+            mesh.MeshletCount = reader.ReadInt32();
+            mesh.Meshlets = reader.ReadBytes(Mesh.MeshletSize * mesh.MeshletCount);
 			
             MeshLOD lod;
             if (ID.IsValid(lodId) && lodIds.Contains(lodId))
@@ -508,10 +656,12 @@ namespace Editor.Content
             try
             {
                 byte[] data = null;
+                int formatVersion;
                 using (var reader = new BinaryReader(File.Open(file, FileMode.Open, FileAccess.Read)))
                 {
                     ReadAssetFileHeader(reader);
-                    ImportSettings.FromBinary(reader);
+                    formatVersion = ReadFormatVersion(reader);
+                    ImportSettings.FromBinary(reader, formatVersion);
                     int dataLength = reader.ReadInt32();
                     Debug.Assert(dataLength > 0);
                     data = reader.ReadBytes(dataLength);
@@ -527,7 +677,7 @@ namespace Editor.Content
 					
                     for (int i = 0; i < lodGroupCount; ++i)
                     {
-                        lodGroup.LODs.Add(BinaryToLOD(reader));
+                        lodGroup.LODs.Add(BinaryToLOD(reader, formatVersion));
                     }
 					
                     _lodGroups.Clear();
@@ -592,6 +742,8 @@ namespace Editor.Content
                     using (var writer = new BinaryWriter(File.Open(meshFileName, FileMode.Create, FileAccess.Write)))
                     {
                         WriteAssetFileHeader(writer);
+                        writer.Write(FormatVersionMarker);
+                        writer.Write(FormatVersion);
                         ImportSettings.ToBinary(writer);
                         writer.Write(data.Length);
                         writer.Write(data);
@@ -625,10 +777,19 @@ namespace Editor.Content
         ///          u32 isze_of_submeshes,
         ///          struct {
         ///              u32 elemet_size, u32 vertex_count,
-        ///              u32 index_count, u32 element_type, u32 primitive_topology
-        ///              u8 positions[sizeof(f32) * 3 * vertex_count], // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
+        ///              u32 index_count, u32 element_type,
+        ///              u32 primitive_topology, // the upper 16 bits are submesh flags
+        ///              // only if the positions are quantized:
+        ///              f32 position_offset[3], f32 position_scale[3],
+        ///              // only if the buffers are compressed (see Engine/Content/MeshDecoder.h):
+        ///              u32 compressed_size, u8 compressed_buffers[compressed_size],
+        ///              // otherwise:
+        ///              u8 positions[position_size * vertex_count], // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
         ///              u8 element[sizeof(element_size) * vertex_count], // sizeof(elements) must be a multiple of 4 bytes. Pad if needed.
         ///              u8 indices[index_size * index_count],
+        ///              // only if the submesh has meshlets:
+        ///              u32 meshlet_count,
+        ///              u8 meshlets[sizeof(meshlet) * meshlet_count],
         ///         } submeshes[submesh_count]
         ///      } mesh_lods[lod_count]
         // } geometry;
@@ -651,16 +812,38 @@ namespace Editor.Content
                     writer.Write(mesh.VertexCount);
                     writer.Write(mesh.IndexCount);
                     writer.Write((int)mesh.ElementsType);
-                    writer.Write((int)mesh.PrimitiveTopology);
+                    writer.Write((int)mesh.PrimitiveTopology | (mesh.MeshletCount > 0 ? Mesh.HasMeshletsFlag : 0) |
+                                 (mesh.IsQuantized ? Mesh.QuantizedPositionsFlag : 0) |
+                                 (ImportSettings.CompressMeshes ? Mesh.CompressedFlag : 0));
+                    if (mesh.IsQuantized)
+                    {
+                        WriteVector3(writer, mesh.PositionOffset);
+                        WriteVector3(writer, mesh.PositionScale);
+                    }
 					
-                    var alignedPositionBuffer = new byte[MathUtil.AlignSizeUp(mesh.Positions.Length, 4)];
-                    Array.Copy(mesh.Positions, alignedPositionBuffer, mesh.Positions.Length);
-                    var alignedElementBuffer = new byte[MathUtil.AlignSizeUp(mesh.Positions.Length, 4)];
-                    Array.Copy(mesh.Positions, alignedPositionBuffer, mesh.Positions.Length);
+                    if (ImportSettings.CompressMeshes)
+                    {
+                        var compressedBuffers = ContentToolsAPI.EncodeSubmesh(mesh);
+                        writer.Write(compressedBuffers.Length);
+                        writer.Write(compressedBuffers);
+                    }
+                    else
+                    {
+                        var alignedPositionBuffer = new byte[MathUtil.AlignSizeUp(mesh.Positions.Length, Mesh.BufferAlignment)];
+                        Array.Copy(mesh.Positions, alignedPositionBuffer, mesh.Positions.Length);
+                        var alignedElementBuffer = new byte[MathUtil.AlignSizeUp(mesh.Elements.Length, Mesh.BufferAlignment)];
+                        Array.Copy(mesh.Elements, alignedElementBuffer, mesh.Elements.Length);
+						
+                        writer.Write(alignedPositionBuffer);
+                        writer.Write(alignedElementBuffer);
+                        writer.Write(mesh.Indices);
+                    }
 					
-                    writer.Write(alignedPositionBuffer);
-                    writer.Write(alignedElementBuffer);
-                    writer.Write(mesh.Indices);
+                    if (mesh.MeshletCount > 0)
+                    {
+                        writer.Write(mesh.MeshletCount);
+                        writer.Write(mesh.Meshlets);
+                    }
                 }
 				
                 var endOfSubmeshes = writer.BaseStream.Position;
@@ -702,9 +885,16 @@ namespace Editor.Content
                 writer.Write(mesh.VertexCount);
                 writer.Write(mesh.IndexSize);
                 writer.Write(mesh.IndexCount);
+                if (mesh.IsQuantized)
+                {
+                    WriteVector3(writer, mesh.PositionOffset);
+                    WriteVector3(writer, mesh.PositionScale);
+                }
                 writer.Write(mesh.Positions);
                 writer.Write(mesh.Elements);
                 writer.Write(mesh.Indices);
+                writer.Write(mesh.MeshletCount);
+                writer.Write(mesh.Meshlets);
             }
 			
             var meshDataSize = writer.BaseStream.Position - meshDataBegin;
@@ -713,7 +903,25 @@ namespace Editor.Content
             hash = ContentHelper.ComputeHash(buffer, (int)meshDataBegin, (int)meshDataSize);
         }
 		
-        private MeshLOD BinaryToLOD(BinaryReader reader)
+        private static int ReadFormatVersion(BinaryReader reader)
+        {
+            if (reader.ReadByte() != FormatVersionMarker)
+            {
+                // Unversioned file: the byte belongs to the import settings.
+                reader.BaseStream.Position -= 1;
+                return 0;
+            }
+			
+            var version = reader.ReadInt32();
+            if (version > FormatVersion)
+            {
+                throw new InvalidDataException($"Geometry format version {version} is newer than the supported version {FormatVersion}.");
+            }
+			
+            return version;
+        }
+		
+        private MeshLOD BinaryToLOD(BinaryReader reader, int formatVersion)
         {
             var lod = new MeshLOD();
             lod.Name = reader.ReadString();
@@ -733,9 +941,17 @@ namespace Editor.Content
                     IndexCount = reader.ReadInt32(),
                 };
 				
-                mesh.Positions = reader.ReadBytes(Mesh.PositionSize * mesh.VertexCount);
+                if (mesh.IsQuantized)
+                {
+                    mesh.PositionOffset = ReadVector3(reader);
+                    mesh.PositionScale = ReadVector3(reader);
+                }
+                mesh.Positions = reader.ReadBytes(mesh.GetPositionSize() * mesh.VertexCount);
                 mesh.Elements = reader.ReadBytes(mesh.ElementSize * mesh.VertexCount);
                 mesh.Indices = reader.ReadBytes(mesh.IndexSize * mesh.IndexCount);
+                // NOTE: meshes of version 0 files have no meshlets.
+                mesh.MeshletCount = formatVersion > 0 ? reader.ReadInt32() : 0;
+                mesh.Meshlets = reader.ReadBytes(Mesh.MeshletSize * mesh.MeshletCount);
 				
                 lod.Meshes.Add(mesh);
             }
@@ -113,6 +113,10 @@ namespace Editor.ContentToolSAPIStructs
         public byte ImportEmbededTextures = 1;
         public byte ImportAnimations = 1;
         public byte CoalesceMeshes = 0;
+        public byte OptimizeVertexCache = 1;
+        public byte GeneratedLodCount = 0;
+        public byte BuildMeshlets = 0;
+        public byte QuantizeVertices = 0;
 		
         private byte ToByte(bool value) => value ? (byte)1 : (byte)0;
 		
@@ -127,6 +131,10 @@ namespace Editor.ContentToolSAPIStructs
             ImportEmbededTextures = ToByte(settings.ImportEmbeddedTextures);
             ImportAnimations = ToByte(settings.ImportAnimations);
 			CoalesceMeshes = ToByte(settings.CoalesceMeshes);
+			OptimizeVertexCache = ToByte(settings.OptimizeVertexCache);
+			GeneratedLodCount = (byte)settings.GeneratedLodCount;
+			BuildMeshlets = ToByte(settings.BuildMeshlets);
+			QuantizeVertices = ToByte(settings.QuantizeVertices);
         }
     }
 	
@@ -402,6 +410,26 @@ namespace Editor.DLLWrappers
             GeometryFromSceneData(geometry, (sceneData) => ImportFbx(file, sceneData, callback), $"Failed to import from FBX file: {file}");
         }
 		
+        [DllImport(_toolsDLL)]
+        private static extern int GetEncodedSubmeshSizeBound(int positionSize, int elementSize, int vertexCount, int indexCount);
+        [DllImport(_toolsDLL)]
+        private static extern int EncodeSubmesh([Out] byte[] buffer, byte[] positions, int positionSize, byte[] elements, int elementSize,
+                                                int vertexCount, byte[] indices, int indexSize, int indexCount);
+		
+        // Returns the compressed vertex and index buffers of the mesh, as the engine expects them for submeshes
+        // that have Mesh.CompressedFlag set.
+        public static byte[] EncodeSubmesh(Mesh mesh)
+        {
+            Debug.Assert(mesh.VertexCount > 0 && mesh.IndexCount > 0);
+            var positionSize = mesh.GetPositionSize();
+            var buffer = new byte[GetEncodedSubmeshSizeBound(positionSize, mesh.ElementSize, mesh.VertexCount, mesh.IndexCount)];
+            var size = EncodeSubmesh(buffer, mesh.Positions, positionSize, mesh.Elements, mesh.ElementSize,
+                                     mesh.VertexCount, mesh.Indices, mesh.IndexSize, mesh.IndexCount);
+            Debug.Assert(size > 0 && size <= buffer.Length);
+            Array.Resize(ref buffer, size);
+            return buffer;
+        }
+		
 		#endregion Geometry
 	}
 }
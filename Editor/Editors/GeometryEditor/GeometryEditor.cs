@@ -216,9 +216,20 @@ namespace Editor.Editors
                     for (int i = 0; i < mesh.VertexCount; i++)
                     {
                         // Read positions
-                        var posX = reader.ReadSingle();
-                        var posY = reader.ReadSingle();
-                        var posZ = reader.ReadSingle();
+                        float posX, posY, posZ;
+                        if (mesh.IsQuantized)
+                        {
+                            posX = mesh.PositionOffset.X + reader.ReadUInt16() * mesh.PositionScale.X;
+                            posY = mesh.PositionOffset.Y + reader.ReadUInt16() * mesh.PositionScale.Y;
+                            posZ = mesh.PositionOffset.Z + reader.ReadUInt16() * mesh.PositionScale.Z;
+                            reader.ReadUInt16(); // skip padding.
+                        }
+                        else
+                        {
+                            posX = reader.ReadSingle();
+                            posY = reader.ReadSingle();
+                            posZ = reader.ReadSingle();
+                        }
 						
                         vertexData.Positions.Add(new Point3D(posX, posY, posZ));
 						
@@ -249,8 +260,8 @@ namespace Editor.Editors
                         if (mesh.ElementsType.HasFlag(ElementsType.TSpace))
                         {
                             reader.BaseStream.Position += sizeof(short) * 2; // skip tangents.
-                            var u = reader.ReadSingle();
-                            var v = reader.ReadSingle();
+                            var u = mesh.IsQuantized ? (float)reader.ReadHalf() : reader.ReadSingle();
+                            var v = mesh.IsQuantized ? (float)reader.ReadHalf() : reader.ReadSingle();
                             vertexData.Uvs.Add(new System.Windows.Point(u, v));
                         }
 							
@@ -14,7 +14,6 @@ namespace Quantum::id {
 	} // detail namespace
 
 	constexpr id_type invalid_id{ id_type(-1) };
-	constexpr u32 min_deleted_elements{ 1024 };
 
 	using generation_type = std::conditional_t<detail::generation_bits <= 16, std::conditional_t<detail::generation_bits <= 8, u8, u16>, u32>;
 	static_assert(sizeof(generation_type) * 8 >= detail::generation_bits);
@@ -40,6 +39,120 @@ namespace Quantum::id {
 		return index(id) | (generation << detail::index_bits);
 	}
 
+	// Hands out generational ids. Free slots are linked through the slot array itself and
+	// recycled in FIFO order, so generations are spread over all slots. A slot whose generation
+	// can't be incremented any more is retired and never handed out again.
+	// NOTE: an allocated slot stores its own id, a free slot stores the index of the next free slot
+	//       and the generation of the id it will hand out next.
+	// NOTE: ids of an allocator have to be decoded with its own index() and generation(). Only ids
+	//       of the default split can also be decoded with id::index() and id::generation(), so ids that
+	//       are passed to other modules (e.g. entity ids) should use the default split.
+	template<u32 index_bit_count = detail::index_bits, u32 generation_bit_count = detail::generation_bits>
+	class allocator {
+		static_assert(index_bit_count + generation_bit_count == sizeof(id_type) * 8);
+		static_assert(index_bit_count > 0 && generation_bit_count > 0);
+	public:
+		static constexpr id_type index_mask{ (id_type{1} << index_bit_count) - 1 };
+		static constexpr id_type generation_mask{ (id_type{1} << generation_bit_count) - 1 };
+		static constexpr id_type max_generation{ generation_mask - 1 };
+		static constexpr id_type end_of_list{ index_mask };
+
+		[[nodiscard]] static constexpr id_type index(id_type id) {
+			assert((id & index_mask) != index_mask);
+			return id & index_mask;
+		}
+
+		[[nodiscard]] static constexpr id_type generation(id_type id) {
+			return (id >> index_bit_count) & generation_mask;
+		}
+
+		[[nodiscard]] static constexpr id_type make_id(id_type index, id_type generation) {
+			assert(index < index_mask && generation <= max_generation);
+			return index | (generation << index_bit_count);
+		}
+
+		allocator() = default;
+		explicit allocator(u32 count) {
+			_slots.reserve(count);
+		}
+
+		[[nodiscard]] constexpr id_type allocate() {
+			id_type id{ invalid_id };
+			if (_free_head == end_of_list)
+			{
+				id = make_id((id_type)_slots.size(), 0);
+				_slots.emplace_back(id);
+			}
+			else
+			{
+				const id_type index{ _free_head };
+				const id_type slot{ _slots[index] };
+				_free_head = slot & index_mask;
+				if (_free_head == end_of_list) _free_tail = end_of_list;
+				id = make_id(index, generation(slot));
+				_slots[index] = id;
+				--_free_count;
+			}
+			++_size;
+			return id;
+		}
+
+		constexpr void release(id_type id) {
+			assert(is_alive(id));
+			if (!is_alive(id)) return;
+
+			const id_type index{ allocator::index(id) };
+			const id_type next_generation{ generation(id) + 1 };
+			--_size;
+			if (next_generation > max_generation)
+			{
+				// NOTE: this slot's generations are used up. Retire it, so that stale ids stay invalid.
+				_slots[index] = invalid_id;
+				++_retired_count;
+				return;
+			}
+
+			_slots[index] = end_of_list | (next_generation << index_bit_count);
+			if (_free_tail == end_of_list) _free_head = index;
+			else _slots[_free_tail] = (_slots[_free_tail] & ~index_mask) | index;
+			_free_tail = index;
+			++_free_count;
+		}
+
+		// Adds slots up to slot_count as allocated ids with generation 0. This is used when indices
+		// were handed out by other means (e.g. an atomic counter) and need to be tracked from now on.
+		constexpr void grow(u32 slot_count) {
+			if (slot_count <= _slots.size()) return;
+			if (_slots.capacity() < slot_count) _slots.reserve(std::max((u64)slot_count, _slots.capacity() + _slots.capacity() / 2));
+			_size += slot_count - (u32)_slots.size();
+			for (id_type index{ (id_type)_slots.size() }; index < slot_count; ++index)
+			{
+				_slots.emplace_back(make_id(index, 0));
+			}
+		}
+
+		[[nodiscard]] constexpr bool is_alive(id_type id) const {
+			assert(id != invalid_id);
+			const id_type index{ id & index_mask };
+			return index < _slots.size() && _slots[index] == id;
+		}
+
+		// Number of allocated ids.
+		[[nodiscard]] constexpr u32 size() const { return _size; }
+		// Number of slots that can be reused without growing.
+		[[nodiscard]] constexpr u32 free_count() const { return _free_count; }
+		[[nodiscard]] constexpr u32 retired_count() const { return _retired_count; }
+		[[nodiscard]] constexpr u32 capacity() const { return (u32)_slots.size(); }
+
+	private:
+		util::vector<id_type>	_slots;
+		id_type					_free_head{ end_of_list };
+		id_type					_free_tail{ end_of_list };
+		u32						_size{ 0 };
+		u32						_free_count{ 0 };
+		u32						_retired_count{ 0 };
+	};
+
 	#if _DEBUG
 	namespace detail {
 		struct id_base {
@@ -21,4 +21,5 @@ constexpr u32 u32_invalid_id{ 0xffff'ffff };
 constexpr u16 u16_invalid_id{ 0xffff };
 constexpr u8 u8_invalid_id{ 0xff };
 
-using f32 = float;
\ No newline at end of file
+using f32 = float;
+using f64 = double;
\ No newline at end of file
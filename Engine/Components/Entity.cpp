@@ -4,13 +4,290 @@
 #include "Entity.h"
 #include "Transform.h"
 #include "Script.h"
+#include "Core/JobSystem.h"
 
 namespace Quantum::game_entity {
 	namespace {
-		util::vector<transform::component>  transforms;
-        util::vector<script::component>     scripts;
-		util::vector<id::generation_type>   generations;
-		util::deque<entity_id>              free_ids;
+        constexpr u32 chunk_size{ 16 * 1024 };
+        constexpr u32 column_alignment{ 16 };
+
+        // NOTE: the order of this array defines the column index of each component type.
+        //       Every chunk starts with an entity id column, followed by the columns of the
+        //       components in the archetype, in this order.
+        struct component_column
+        {
+            u32 type;
+            u32 size;
+        };
+
+        constexpr component_column component_columns[]
+        {
+            { component_type::transform, sizeof(transform::component) },
+            { component_type::script, sizeof(script::component) },
+        };
+
+        constexpr u32 transform_column{ 0 };
+        constexpr u32 script_column{ 1 };
+        constexpr u32 component_type_count{ _countof(component_columns) };
+
+        // A chunk is a 16 KB block of SoA columns. All chunks of an archetype are full except the last one.
+        struct chunk
+        {
+            u8*     data{ nullptr };
+            u32     count{ 0 };
+        };
+
+        // An archetype stores all entities that have exactly the same set of components.
+        struct archetype
+        {
+            u32                 component_mask{ 0 };
+            u32                 row_size{ 0 };
+            u32                 capacity{ 0 };
+            u32                 column_offsets[component_type_count]{};
+            util::vector<chunk> chunks;
+        };
+
+        struct entity_location
+        {
+            u32 archetype{ u32_invalid_id };
+            u32 chunk{ u32_invalid_id };
+            u32 row{ u32_invalid_id };
+        };
+
+        // Structural changes that were recorded on a worker thread. They're applied in apply_commands().
+        struct create_command
+        {
+            entity_id               id;
+            transform::init_info    transform;
+            script::init_info       script;
+        };
+
+        struct add_script_command
+        {
+            entity_id               id;
+            script::init_info       script;
+        };
+
+        struct command_buffer
+        {
+            util::vector<create_command>        creates;
+            util::vector<add_script_command>    add_scripts;
+            util::vector<entity_id>             removes;
+        };
+
+        constexpr u32 reserved_pool_size{ 1024 };
+
+        // NOTE: all chunks have the same size, so they're recycled through a block pool.
+        util::block_pool                    chunk_pool{ chunk_size };
+        util::vector<archetype>             archetypes;
+        util::vector<entity_location>       locations;
+        // NOTE: entity ids are also the ids of their components, which other modules decode with id::index(),
+        //       so they have to use the default index/generation split.
+        id::allocator<>                     entity_ids;
+
+        // NOTE: ids are handed out to any thread from a pool of recycled ids without locking.
+        //       The pool is only refilled in apply_commands(), when no other thread reserves ids.
+        //       Once it runs dry, new indices are taken from next_index. entity_ids only hands out
+        //       recycled slots, new slots are added to it with grow() to match next_index.
+        util::vector<entity_id>             reserved_ids;
+        u32                                 reserved_count{ 0 };
+        std::atomic<u32>                    reserved_cursor{ 0 };
+        std::atomic<u32>                    next_index{ 0 };
+
+        // NOTE: each job system worker records into its own buffer. Threads that don't belong
+        //       to the job system share one buffer that is protected by a mutex.
+        command_buffer                      worker_buffers[jobs::max_workers];
+        command_buffer                      shared_buffer;
+        std::mutex                          shared_buffer_mutex;
+
+        [[nodiscard]] entity_id* const
+        id_column(const chunk& c)
+        {
+            return (entity_id* const)c.data;
+        }
+
+        template<typename T>
+        [[nodiscard]] T* const
+        component_data(const archetype& a, const chunk& c, u32 column)
+        {
+            assert(sizeof(T) == component_columns[column].size);
+            const u32 offset{ a.column_offsets[column] };
+            return offset == u32_invalid_id ? nullptr : (T* const)(c.data + offset);
+        }
+
+        u32 get_archetype(u32 component_mask)
+        {
+            const u32 count{ (u32)archetypes.size() };
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                if (archetypes[i].component_mask == component_mask) return i;
+            }
+
+            archetype& a{ archetypes.emplace_back() };
+            a.component_mask = component_mask;
+            a.row_size = sizeof(entity_id);
+            for (u32 i{ 0 }; i < component_type_count; ++i)
+            {
+                if (component_mask & component_columns[i].type) a.row_size += component_columns[i].size;
+            }
+
+            // NOTE: leave room for padding each column to the column alignment.
+            a.capacity = (chunk_size - column_alignment * component_type_count) / a.row_size;
+            u32 offset{ (u32)math::align_size_up<column_alignment>(a.capacity * sizeof(entity_id)) };
+            for (u32 i{ 0 }; i < component_type_count; ++i)
+            {
+                if (component_mask & component_columns[i].type)
+                {
+                    a.column_offsets[i] = offset;
+                    offset = (u32)math::align_size_up<column_alignment>(offset + a.capacity * component_columns[i].size);
+                }
+                else
+                {
+                    a.column_offsets[i] = u32_invalid_id;
+                }
+            }
+            assert(offset <= chunk_size);
+
+            return count;
+        }
+
+        entity_location add_row(u32 archetype_index, entity_id id)
+        {
+            archetype& a{ archetypes[archetype_index] };
+            if (a.chunks.empty() || a.chunks.back().count == a.capacity)
+            {
+                a.chunks.emplace_back(chunk{ (u8*)chunk_pool.allocate(), 0 });
+                assert(a.chunks.back().data);
+                util::memory::track(util::allocator_type::pool, util::memory_tag::entities, chunk_size, 1);
+            }
+
+            chunk& c{ a.chunks.back() };
+            const entity_location location{ archetype_index, (u32)a.chunks.size() - 1, c.count };
+            id_column(c)[location.row] = id;
+            ++c.count;
+            return location;
+        }
+
+        // Removes a row by moving the last row of the archetype into its place, so chunks stay packed.
+        void remove_row(const entity_location& location)
+        {
+            archetype& a{ archetypes[location.archetype] };
+            chunk& last_chunk{ a.chunks.back() };
+            assert(last_chunk.count);
+            const u32 last_row{ last_chunk.count - 1 };
+            const u32 last_chunk_index{ (u32)a.chunks.size() - 1 };
+
+            if (location.chunk != last_chunk_index || location.row != last_row)
+            {
+                chunk& c{ a.chunks[location.chunk] };
+                const entity_id moved_id{ id_column(last_chunk)[last_row] };
+                id_column(c)[location.row] = moved_id;
+                for (u32 i{ 0 }; i < component_type_count; ++i)
+                {
+                    const u32 offset{ a.column_offsets[i] };
+                    if (offset == u32_invalid_id) continue;
+                    const u32 size{ component_columns[i].size };
+                    memcpy(c.data + offset + location.row * size, last_chunk.data + offset + last_row * size, size);
+                }
+
+                locations[entity_ids.index(moved_id)] = location;
+            }
+
+            --last_chunk.count;
+            if (!last_chunk.count)
+            {
+                chunk_pool.deallocate(last_chunk.data);
+                util::memory::track(util::allocator_type::pool, util::memory_tag::entities, -(s64)chunk_size);
+                a.chunks.resize(last_chunk_index);
+            }
+        }
+
+        entity_id reserve_id()
+        {
+            const u32 slot{ reserved_cursor.fetch_add(1, std::memory_order_relaxed) };
+            if (slot < reserved_count) return reserved_ids[slot];
+
+            const u32 index{ next_index.fetch_add(1, std::memory_order_relaxed) };
+            assert(index < id::detail::index_mask);
+            return entity_id{ (id::id_type)index };
+        }
+
+        // Makes sure entity_ids and locations cover all indices that have been reserved so far.
+        void grow_to_reserved_indices()
+        {
+            const u32 index_count{ next_index.load(std::memory_order_relaxed) };
+            if (locations.size() >= index_count) return;
+
+            if (locations.capacity() < index_count)
+            {
+                locations.reserve(std::max((u64)index_count, locations.capacity() + locations.capacity() / 2));
+            }
+            locations.resize(index_count);
+            entity_ids.grow(index_count);
+            assert(entity_ids.capacity() == locations.size());
+        }
+
+        // Moves the unused ids to the front of the pool and tops it up with recycled ids.
+        void refill_reserved_ids()
+        {
+            const u32 used{ std::min(reserved_cursor.load(std::memory_order_relaxed), reserved_count) };
+            const u32 unused{ reserved_count - used };
+            if (used && unused) memmove(reserved_ids.data(), reserved_ids.data() + used, unused * sizeof(entity_id));
+
+            reserved_ids.resize(reserved_pool_size);
+            reserved_count = unused;
+            while (reserved_count < reserved_pool_size && entity_ids.free_count())
+            {
+                reserved_ids[reserved_count++] = entity_id{ entity_ids.allocate() };
+            }
+
+            reserved_cursor.store(0, std::memory_order_relaxed);
+        }
+
+        command_buffer& get_command_buffer(std::unique_lock<std::mutex>& lock)
+        {
+            const u32 worker_index{ jobs::current_worker_index() };
+            if (worker_index < jobs::max_workers) return worker_buffers[worker_index];
+
+            lock = std::unique_lock{ shared_buffer_mutex };
+            return shared_buffer;
+        }
+
+        entity create_with_id(entity_id id, const entity_info& info)
+        {
+            const entity new_entity{ id };
+            const id::id_type index{ entity_ids.index(id) };
+            assert(locations[index].archetype == u32_invalid_id);
+
+            const bool has_script{ info.script && info.script->script_creator };
+            const u32 component_mask{ component_type::transform | (has_script ? component_type::script : 0u) };
+            const entity_location location{ add_row(get_archetype(component_mask), id) };
+            locations[index] = location;
+
+            const archetype& a{ archetypes[location.archetype] };
+            const chunk& c{ a.chunks[location.chunk] };
+
+            // Create transform component
+            transform::component& transform_component{ component_data<transform::component>(a, c, transform_column)[location.row] };
+            transform_component = transform::create(*info.transform, new_entity);
+            if (!transform_component.is_valid())
+            {
+                remove_row(location);
+                locations[index] = {};
+                entity_ids.release(id);
+                return {};
+            }
+
+            // Create script component
+            if (has_script)
+            {
+                script::component& script_component{ component_data<script::component>(a, c, script_column)[location.row] };
+                script_component = script::create(*info.script, new_entity);
+                assert(script_component.is_valid());
+            }
+
+            return new_entity;
+        }
 	} // anonymous namespace
 
 	entity create(entity_info info) {
@@ -20,75 +297,177 @@ namespace Quantum::game_entity {
 
 		entity_id id;
 
-		if (free_ids.size() > id::min_deleted_elements)
+		if (entity_ids.free_count())
 		{
-			id = free_ids.front();
-			assert(!is_alive( id ));
-			free_ids.pop_front();
-			id = entity_id{ id::new_generation(id) };
-			++generations[id::index(id)];
+			id = entity_id{ entity_ids.allocate() };
 		}
 		else
 		{
-			id = entity_id{ (id::id_type)generations.size() };
-			generations.push_back(0);
-			transforms.emplace_back();
-            scripts.emplace_back();
+			id = reserve_id();
+            grow_to_reserved_indices();
 		}
 
-		const entity new_entity{ id };
-		const id::id_type index{ id::index(id) };
-
-		// Create transform component
-		assert(!transforms[index].is_valid());
-		transforms[index] = transform::create(*info.transform, new_entity);
-		if (!transforms[index].is_valid()) return {};
-        // Create script component
-        if (info.script && info.script->script_creator)
-        {
-            assert(!scripts[index].is_valid());
-            scripts[index] = script::create(*info.script, new_entity);
-            assert(scripts[index].is_valid());
-        }
-
-		return new_entity;
+		return create_with_id(id, info);
 	}
 
 	void remove(entity_id id) 
 	{
-		const id::id_type index{ id::index(id) };
+		const id::id_type index{ entity_ids.index(id) };
 		assert(is_alive(id));
 
-        if (scripts[index].is_valid())
+        const entity_location location{ locations[index] };
+        const archetype& a{ archetypes[location.archetype] };
+        const chunk& c{ a.chunks[location.chunk] };
+
+        const script::component* const scripts{ component_data<script::component>(a, c, script_column) };
+        if (scripts && scripts[location.row].is_valid())
         {
-            script::remove(scripts[index]);
-            scripts[index] = {};
+            script::remove(scripts[location.row]);
         }
 
-        transform::remove(transforms[index]);
-		transforms[index] = {};
-		free_ids.push_back(id);
+        transform::remove(component_data<transform::component>(a, c, transform_column)[location.row]);
+        remove_row(location);
+        locations[index] = {};
+		entity_ids.release(id);
 	}
 
 	bool is_alive(entity_id id) 
     {
 		assert(id::is_valid(id));
-		const id::id_type index{ id::index(id) };
-		assert(index < generations.size());
-		return (generations[index] == id::generation(id) && transforms[index].is_valid());
+        // NOTE: ids reserved on other threads aren't known to entity_ids until the next apply_commands().
+		return entity_ids.is_alive(id) && locations[entity_ids.index(id)].archetype != u32_invalid_id;
 	}
 
+    void add_script(entity_id id, const script::init_info& info)
+    {
+        assert(is_alive(id) && info.script_creator);
+        const entity_location old_location{ locations[entity_ids.index(id)] };
+        const u32 component_mask{ archetypes[old_location.archetype].component_mask };
+        assert(!(component_mask & component_type::script));
+        if (component_mask & component_type::script) return;
+
+        // NOTE: get_archetype() and add_row() can reallocate, so get the references afterwards.
+        const u32 archetype_index{ get_archetype(component_mask | component_type::script) };
+        const entity_location location{ add_row(archetype_index, id) };
+        const archetype& old_a{ archetypes[old_location.archetype] };
+        const archetype& a{ archetypes[location.archetype] };
+        const chunk& c{ a.chunks[location.chunk] };
+
+        component_data<transform::component>(a, c, transform_column)[location.row] =
+            component_data<transform::component>(old_a, old_a.chunks[old_location.chunk], transform_column)[old_location.row];
+        remove_row(old_location);
+        locations[entity_ids.index(id)] = location;
+
+        component_data<script::component>(a, c, script_column)[location.row] = script::create(info, entity{ id });
+    }
+
+    entity_id defer_create(const entity_info& info)
+    {
+        assert(info.transform);
+        if (!info.transform) return entity_id{ id::invalid_id };
+
+        const entity_id id{ reserve_id() };
+        std::unique_lock<std::mutex> lock{};
+        command_buffer& buffer{ get_command_buffer(lock) };
+        create_command& command{ buffer.creates.emplace_back() };
+        command.id = id;
+        command.transform = *info.transform;
+        command.script = info.script ? *info.script : script::init_info{};
+        return id;
+    }
+
+    void defer_remove(entity_id id)
+    {
+        assert(id::is_valid(id));
+        std::unique_lock<std::mutex> lock{};
+        get_command_buffer(lock).removes.emplace_back(id);
+    }
+
+    void defer_add_script(entity_id id, const script::init_info& info)
+    {
+        assert(id::is_valid(id) && info.script_creator);
+        std::unique_lock<std::mutex> lock{};
+        get_command_buffer(lock).add_scripts.emplace_back(add_script_command{ id, info });
+    }
+
+    void apply_commands()
+    {
+        grow_to_reserved_indices();
+
+        // NOTE: creates go first so that commands recorded in the same frame can refer to the new
+        //       entities. Removes go last, so an entity can be created and removed in one frame.
+        for (u32 i{ 0 }; i <= jobs::max_workers; ++i)
+        {
+            command_buffer& buffer{ i < jobs::max_workers ? worker_buffers[i] : shared_buffer };
+            for (create_command& command : buffer.creates)
+            {
+                entity_info info{ &command.transform, command.script.script_creator ? &command.script : nullptr };
+                [[maybe_unused]] const entity new_entity{ create_with_id(command.id, info) };
+                assert(new_entity.is_valid());
+            }
+            buffer.creates.clear();
+        }
+
+        for (u32 i{ 0 }; i <= jobs::max_workers; ++i)
+        {
+            command_buffer& buffer{ i < jobs::max_workers ? worker_buffers[i] : shared_buffer };
+            for (const add_script_command& command : buffer.add_scripts)
+            {
+                if (is_alive(command.id)) add_script(command.id, command.script);
+            }
+            buffer.add_scripts.clear();
+        }
+
+        for (u32 i{ 0 }; i <= jobs::max_workers; ++i)
+        {
+            command_buffer& buffer{ i < jobs::max_workers ? worker_buffers[i] : shared_buffer };
+            // NOTE: several threads may have asked to remove the same entity.
+            for (const entity_id id : buffer.removes)
+            {
+                if (is_alive(id)) remove(id);
+            }
+            buffer.removes.clear();
+        }
+
+        refill_reserved_ids();
+    }
+
+    void for_each_chunk(u32 component_mask, chunk_callback callback, void* const data)
+    {
+        assert(callback);
+        for (const archetype& a : archetypes)
+        {
+            if ((a.component_mask & component_mask) != component_mask) continue;
+
+            for (const chunk& c : a.chunks)
+            {
+                if (!c.count) continue;
+                const entity_chunk view
+                {
+                    id_column(c),
+                    component_data<transform::component>(a, c, transform_column),
+                    component_data<script::component>(a, c, script_column),
+                    c.count
+                };
+                callback(view, data);
+            }
+        }
+    }
+
 	transform::component entity::transform() const
 	{
 		assert(is_alive(_id));
-		const id::id_type index{ id::index(_id) };
-		return transforms[index];
+        const entity_location& location{ locations[entity_ids.index(_id)] };
+        const archetype& a{ archetypes[location.archetype] };
+		return component_data<transform::component>(a, a.chunks[location.chunk], transform_column)[location.row];
 	}
 
     script::component entity::script() const
     {
         assert(is_alive(_id));
-        const id::id_type index{ id::index(_id) };
-        return scripts[index];
+        const entity_location& location{ locations[entity_ids.index(_id)] };
+        const archetype& a{ archetypes[location.archetype] };
+        const script::component* const scripts{ component_data<script::component>(a, a.chunks[location.chunk], script_column) };
+        return scripts ? scripts[location.row] : script::component{};
     }
-}
\ No newline at end of file
+}
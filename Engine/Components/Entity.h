@@ -19,8 +19,47 @@ namespace Quantum {
             script::init_info* script{ nullptr };
 		};
 
+        struct component_type {
+            enum type : u32 {
+                transform = 0x01,
+                script = 0x02,
+            };
+        };
+
+        // A packed block of entities that all have the same set of components.
+        // Columns for components that these entities don't have are nullptr.
+        struct entity_chunk
+        {
+            const entity_id*                ids;
+            const transform::component*     transforms;
+            const script::component*        scripts;
+            u32                             count;
+        };
+
+        using chunk_callback = void(*)(const entity_chunk& chunk, void* const data);
+
+		// NOTE: create(), remove() and add_script() change the entity storage right away and
+		//       may only be called from the main thread, outside of apply_commands().
 		entity create(entity_info info);
 		void remove(entity_id id);
 		bool is_alive(entity_id id);
+        void add_script(entity_id id, const script::init_info& info);
+
+        // Thread-safe versions of the above. The returned id is reserved immediately and can be
+        // referred to by other deferred commands, but the entity only comes alive in apply_commands().
+        entity_id defer_create(const entity_info& info);
+        void defer_remove(entity_id id);
+        void defer_add_script(entity_id id, const script::init_info& info);
+        // Applies the commands from all threads: creates first, then added components, then removes.
+        // Must be called from the main thread while no other thread records commands.
+        void apply_commands();
+        // Calls the callback for every chunk of entities that have at least the components in component_mask.
+        void for_each_chunk(u32 component_mask, chunk_callback callback, void* const data);
+
+        template<typename Fn>
+        void for_each_chunk(u32 component_mask, Fn&& fn)
+        {
+            for_each_chunk(component_mask, [](const entity_chunk& chunk, void* const data) { (*(std::remove_reference_t<Fn>*)data)(chunk); }, (void*)std::addressof(fn));
+        }
 	}
 }
@@ -4,21 +4,72 @@
 #include "Script.h"
 #include "Entity.h"
 #include "Transform.h"
-
-#define USE_TRANSFORM_CACHE_MAP 0
+#include "Core/JobSystem.h"
 
 namespace Quantum::script {
     namespace {
-        util::vector<detail::script_ptr>            entity_scripts;
-        util::vector<id::id_type>                   id_mapping;
+        // All scripts of one class. The scripts themselves live in the class' script pool.
+        struct script_type
+        {
+            const detail::script_type_info*     info{ nullptr };
+            util::vector<detail::script_ptr>    scripts;
+            util::vector<script_id>             ids;
+        };
 
-        util::vector<id::generation_type>           generations;
-        util::deque<script_id>                      free_ids;
+        struct script_location
+        {
+            u32 type{ u32_invalid_id };
+            u32 index{ u32_invalid_id };
+        };
+
+        // A range of scripts of one type that is updated by one worker.
+        struct work_item
+        {
+            u32 type;
+            u32 begin;
+            u32 end;
+        };
+
+        constexpr u32 scripts_per_work_item{ 256 };
+
+        util::vector<script_type>                   script_types;
+        util::vector<script_location>               id_mapping;
+        id::allocator<>                             script_ids;
+
+        // NOTE: script types sorted by update group. Rebuilt when a new script type shows up.
+        util::vector<u32>                           update_order;
+        bool                                        update_order_changed{ false };
+        util::vector<work_item>                     work_items;
+        util::vector<u32>                           pending_types;
+        util::vector<u32>                           batch_types;
+        f32                                         update_dt{ 0.f };
+
+        // NOTE: each job system worker has its own transform cache, so scripts can write transforms in parallel.
+        //       cache_indices is a sparse set over cache: cache_indices[id::index(transform_id)] is the position of
+        //       that transform's entry in the cache. An entry is only valid if it's inside the cache and the cached
+        //       id matches (which also checks the generation), so we never have to clear this table.
+        struct transform_cache
+        {
+            util::vector<transform::component_cache>    cache;
+            util::vector<u32>                           cache_indices;
+        };
+
+        transform_cache                             worker_caches[jobs::max_workers];
+
+        // NOTE: called after each batch, so that transform changes are applied in the order the scripts were
+        //       updated in, whichever worker updated them.
+        void flush_transform_caches()
+        {
+            for (transform_cache& worker_cache : worker_caches)
+            {
+                if (worker_cache.cache.size())
+                {
+                    transform::update(worker_cache.cache.data(), (u32)worker_cache.cache.size());
+                    worker_cache.cache.clear();
+                }
+            }
+        }
 
-        util::vector<transform::component_cache>    transform_cache;
-#if USE_TRANSFORM_CACHE_MAP
-        std::unordered_map<id::id_type, u32>       cache_map;
-#endif
         using script_registry = std::unordered_map<size_t, detail::script_creator>;
         script_registry& registry()
         {
@@ -43,59 +94,149 @@ namespace Quantum::script {
         bool exists(script_id id)
         {
             assert(id::is_valid(id));
-            const id::id_type index{ id::index(id) };
-            assert(index < generations.size() && id_mapping[index] < entity_scripts.size());
-            assert(generations[index] == id::generation(id));
-            return (generations[index] == id::generation(id)) &&
-                entity_scripts[id_mapping[index]] &&
-                entity_scripts[id_mapping[index]]->is_valid();
+            const id::id_type index{ script_ids.index(id) };
+            assert(script_ids.is_alive(id));
+            if (!script_ids.is_alive(id)) return false;
+            const script_location& location{ id_mapping[index] };
+            assert(location.type < script_types.size() && location.index < script_types[location.type].scripts.size());
+            const detail::script_ptr& script{ script_types[location.type].scripts[location.index] };
+            return script && script->is_valid();
         }
 
-#if USE_TRANSFORM_CACHE_MAP
-        transform::component_cache* const get_change_ptr(const game_entity::entity* const entity)
+        u32 get_script_type(const detail::script_type_info* const info)
         {
-            assert(game_entity::is_alive((*entity).get_id()));
-            const transform::transform_id id{ (*entity).transform().get_id() };
+            const u32 count{ (u32)script_types.size() };
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                if (script_types[i].info == info) return i;
+            }
 
-            u32 index{ u32_invalid_id };
-            auto pair = cache_map.try_emplace(id, id::invalid_id);
+            script_types.emplace_back().info = info;
+            update_order_changed = true;
+            return count;
+        }
+
+        void sort_update_order()
+        {
+            update_order.resize(script_types.size());
+            for (u32 i{ 0 }; i < update_order.size(); ++i) update_order[i] = i;
+            std::stable_sort(update_order.begin(), update_order.end(), [](u32 a, u32 b) {
+                return script_types[a].info->schedule.group < script_types[b].info->schedule.group;
+            });
+            update_order_changed = false;
+        }
+
+        // NOTE: script types that may write anything are never batched with other types, so that
+        //       they run on the calling thread, like they did before scripts were updated in parallel.
+        constexpr bool conflicts(const update_schedule& a, const update_schedule& b)
+        {
+            if (a.writes == access::all || b.writes == access::all) return true;
+            return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
+        }
+
+        void update_work_item(u32 item_index)
+        {
+            const work_item& item{ work_items[item_index] };
+            detail::script_ptr* const scripts{ script_types[item.type].scripts.data() };
+            for (u32 i{ item.begin }; i < item.end; ++i)
+            {
+                scripts[i]->update(update_dt);
+            }
+        }
 
-            // cache_map didn't have and entry for tis id, m=new entry inserted
-            if (pair.second)
+        // Updates a set of script types that don't conflict with each other.
+        void update_batch()
+        {
+            work_items.clear();
+            for (const u32 type : batch_types)
             {
-                index = (u32)transform_cache.size();
-                transform_cache.emplace_back();
-                transform_cache.back().id = id;
-                cache_map[id] = index;
+                const u32 count{ (u32)script_types[type].scripts.size() };
+                // NOTE: scripts that write something share it with all other scripts of their type,
+                //       so they're updated one after another by the same worker.
+                const u32 step{ script_types[type].info->schedule.writes ? count : scripts_per_work_item };
+                for (u32 begin{ 0 }; begin < count; begin += step)
+                {
+                    work_items.emplace_back(work_item{ type, begin, std::min(begin + step, count) });
+                }
+            }
+
+            // NOTE: a single work item is updated on the calling thread. This way scripts with the
+            //       default schedule are still updated on the main thread.
+            if (work_items.size() == 1)
+            {
+                update_work_item(0);
             }
             else
             {
-                index = cache_map[id];
+                jobs::parallel_for((u32)work_items.size(), 1, [](u32 begin, u32 end) {
+                    for (u32 i{ begin }; i < end; ++i) update_work_item(i);
+                });
             }
 
-            assert(index < transform_cache.size());
-            return &transform_cache[index];
+            flush_transform_caches();
+        }
+
+        // Splits the script types of one update group into batches that can run in parallel.
+        void update_group(const u32* const types, u32 count)
+        {
+            pending_types.clear();
+            for (u32 i{ 0 }; i < count; ++i) pending_types.emplace_back(types[i]);
+
+            while (!pending_types.empty())
+            {
+                batch_types.clear();
+                u32 remaining{ 0 };
+                for (const u32 type : pending_types)
+                {
+                    const update_schedule& schedule{ script_types[type].info->schedule };
+                    bool can_run{ true };
+                    for (const u32 other : batch_types)
+                    {
+                        if (conflicts(schedule, script_types[other].info->schedule))
+                        {
+                            can_run = false;
+                            break;
+                        }
+                    }
+
+                    if (can_run) batch_types.emplace_back(type);
+                    else pending_types[remaining++] = type;
+                }
+
+                pending_types.resize(remaining);
+                update_batch();
+            }
         }
-#else 
+
         transform::component_cache* const get_cache_ptr(const game_entity::entity* const entity)
         {
             assert(game_entity::is_alive((*entity).get_id()));
             const transform::transform_id id{ (*entity).transform().get_id() };
+            const id::id_type index{ id::index(id) };
 
-            for (auto& cache : transform_cache)
+            // NOTE: threads that don't belong to the job system use the first cache, like the main thread.
+            const u32 worker_index{ jobs::current_worker_index() };
+            transform_cache& worker_cache{ worker_caches[worker_index < jobs::max_workers ? worker_index : 0] };
+            util::vector<u32>& cache_indices{ worker_cache.cache_indices };
+            util::vector<transform::component_cache>& cache{ worker_cache.cache };
+
+            if (index >= cache_indices.size())
             {
-                if (cache.id == id)
-                {
-                    return &cache;
-                }
+                // NOTE: grow geometrically, so that the table is only resized a few times while entities are being added.
+                cache_indices.resize(std::max((u64)index + 1, cache_indices.size() * 2), u32_invalid_id);
             }
 
-            transform_cache.emplace_back();
-            transform_cache.back().id = id;
+            const u32 cache_index{ cache_indices[index] };
+            if (cache_index < cache.size() && cache[cache_index].id == id)
+            {
+                return &cache[cache_index];
+            }
 
-            return &transform_cache.back();
+            cache_indices[index] = (u32)cache.size();
+            transform::component_cache& entry{ cache.emplace_back() };
+            entry.id = id;
+            return &entry;
         }
-#endif
     } // anonymous namespace
 
     namespace detail {
@@ -128,27 +269,21 @@ namespace Quantum::script {
         assert(entity.is_valid());
         assert(info.script_creator);
 
-        script_id id{};
-        if (free_ids.size() > id::min_deleted_elements)
+        const script_id id{ script_ids.allocate() };
+        if (script_ids.index(id) >= id_mapping.size())
         {
-            id = free_ids.front();
-            assert(!exists(id));
-            free_ids.pop_front();
-            id = script_id{ id::new_generation(id) };
-            ++generations[id::index(id)];
-        }
-        else 
-        { 
-            id = script_id{ (id::id_type)id_mapping.size() };
+            assert(script_ids.index(id) == id_mapping.size());
             id_mapping.emplace_back();
-            generations.push_back(0);
         }
 
         assert(id::is_valid(id));
-        const id::id_type index{ (id::id_type)entity_scripts.size() };
-        entity_scripts.emplace_back(info.script_creator(entity));
-        assert(entity_scripts.back()->get_id() == entity.get_id());
-        id_mapping[id::index(id)] = index;
+        detail::script_ptr script{ info.script_creator(entity) };
+        assert(script && script->get_id() == entity.get_id());
+        const u32 type_index{ get_script_type(script.get_deleter().type) };
+        script_type& type{ script_types[type_index] };
+        id_mapping[script_ids.index(id)] = { type_index, (u32)type.scripts.size() };
+        type.scripts.emplace_back(std::move(script));
+        type.ids.emplace_back(id);
         return component{ id };
     }
 
@@ -156,34 +291,40 @@ namespace Quantum::script {
     {
         assert(c.is_valid() && exists(c.get_id()));
         const script_id id{ c.get_id() };
-        const id::id_type index{ id_mapping[id::index(id)] };
-        const script_id last_id{ entity_scripts.back()->script().get_id() };
-        util::erase_unordered(entity_scripts, index);
-        id_mapping[id::index(last_id)] = index;
-        id_mapping[id::index(id)] = id::invalid_id;
+        const script_location location{ id_mapping[script_ids.index(id)] };
+        script_type& type{ script_types[location.type] };
+        const script_id last_id{ type.ids.back() };
+        util::erase_unordered(type.scripts, location.index);
+        util::erase_unordered(type.ids, location.index);
+        id_mapping[script_ids.index(last_id)].index = location.index;
+        id_mapping[script_ids.index(id)] = {};
+        script_ids.release(id);
     }
 
     void update(float dt)
     {
-        for (auto& ptr : entity_scripts)
-        {
-            ptr->update(dt);
-        }
+        if (update_order_changed) sort_update_order();
+        update_dt = dt;
 
-        if (transform_cache.size())
+        const u32 type_count{ (u32)update_order.size() };
+        u32 first{ 0 };
+        while (first < type_count)
         {
-            transform::update(transform_cache.data(), (u32)transform_cache.size());
-            transform_cache.clear();
-#if USE_TRANSFORM_CACHE_MAP
-            cache_map.clear();
-#endif
+            const u32 group{ script_types[update_order[first]].info->schedule.group };
+            u32 last{ first + 1 };
+            while (last < type_count && script_types[update_order[last]].info->schedule.group == group) ++last;
+            update_group(&update_order[first], last - first);
+            first = last;
         }
+
+        // NOTE: also applies changes made outside of script updates when there are no scripts.
+        flush_transform_caches();
     }
 
     void entity_script::set_rotation(const game_entity::entity* const entity, math::v4 rotation_quaternion)
     {
         transform::component_cache& cache{ *get_cache_ptr(entity) };
-        cache.flags |= transform::component_flags::orientation;
+        cache.flags |= transform::component_flags::rotation;
         cache.rotation = rotation_quaternion;
     }
 
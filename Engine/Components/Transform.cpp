@@ -3,39 +3,287 @@
 
 #include "Transform.h"
 #include "Entity.h"
+#include "Core/JobSystem.h"
 
 namespace Quantum::transform {
 	namespace {
-        util::vector<math::m4x4>    to_world;
-        util::vector<math::m4x4>    inv_world;
-        util::vector<math::v4>      rotations;
-		util::vector<math::v3>      positions;
-        util::vector<math::v3>      orientations;
-		util::vector<math::v3>      scales;
-        util::vector<u8>            has_transform;
-        util::vector<u8>            changes_from_previous_frame;
-        u8                          read_write_flag;
+        template<typename T>
+        using transform_vector = util::vector<T, true, util::heap_allocator<util::memory_tag::transforms>>;
+        // NOTE: temporary arrays that only live inside one function. They must be declared after a scratch_scope.
+        template<typename T>
+        using scratch_vector = util::vector<T, true, util::scratch_allocator<util::memory_tag::transforms>>;
+
+        transform_vector<math::m4x4>      to_world;
+        transform_vector<math::m4x4>      inv_world;
+        transform_vector<math::v4>        rotations;
+		transform_vector<math::v3>        positions;
+        transform_vector<math::v3>        orientations;
+		transform_vector<math::v3>        scales;
+        transform_vector<u8>              has_transform;
+        transform_vector<u8>              changes_from_previous_frame;
+        u8                                read_write_flag;
+
+        transform_vector<id::id_type>     dirty_ids;
+        // NOTE: a transform can be computed lazily (has_transform is set again) while it's still in dirty_ids,
+        //       so we keep a separate flag to add each index to dirty_ids only once.
+        transform_vector<u8>              is_queued;
+
+        // NOTE: transforms that have a parent are also kept in an array sorted by their depth in the
+        //       hierarchy (all children of roots first, then their children, etc.). This way local-to-world
+        //       propagation is one linear pass in which parents are always processed before their children.
+        //       Root transforms don't have a slot in this array.
+        transform_vector<id::id_type>     parents;
+        transform_vector<u32>             child_counts;
+        transform_vector<u32>             hierarchy_slots;
+        transform_vector<id::id_type>     hierarchy;
+        transform_vector<math::m4x4>      local_world;
+        transform_vector<math::m4x4>      local_inv_world;
+        transform_vector<u32>             level_offsets;
+        transform_vector<u32>             world_update_pass;
+        transform_vector<u32>             world_versions;
+        u32                               update_pass{ 0 };
+        bool                              hierarchy_changed{ false };
+
+        struct matrix_target
+        {
+            math::m4x4* world;
+            math::m4x4* inverse_world;
+        };
+
+        // Root transforms write their matrices directly as world matrices, while transforms with a parent
+        // write them to the local matrix arrays to be combined with the parent's world matrix later.
+        matrix_target get_target(id::id_type index)
+        {
+            const u32 slot{ hierarchy_slots[index] };
+            return slot == u32_invalid_id ?
+                matrix_target{ &to_world[index], &inv_world[index] } :
+                matrix_target{ &local_world[slot], &local_inv_world[slot] };
+        }
 
+        // NOTE: the world matrix is S * R * T. The inverse world matrix is only used to transform normals,
+        //       so translation is left out (F. Luna, Intro to DirectX 12, section 8.2.2). Instead of doing
+        //       a general 4x4 inverse we use (S * R)^-1 = R^T * S^-1, i.e. row i of the inverse is
+        //       column i of the rotation matrix divided by the scale.
         void calculate_transform_metrics(id::id_type index)
         {
-            assert(rotations.size() >= index);
-            assert(positions.size() >= index);
-            assert(scales.size() >= index);
+            assert(rotations.size() > index);
+            assert(positions.size() > index);
+            assert(scales.size() > index);
 
             using namespace DirectX;
             XMVECTOR r{ XMLoadFloat4(&rotations[index]) };
             XMVECTOR t{ XMLoadFloat3(&positions[index]) };
             XMVECTOR s{ XMLoadFloat3(&scales[index]) };
 
-            XMMATRIX world{ XMMatrixAffineTransformation(s, XMQuaternionIdentity(), r,t) };
-            XMStoreFloat4x4(&to_world[index], world);
+            const matrix_target target{ get_target(index) };
+            XMMATRIX world{ XMMatrixAffineTransformation(s, XMQuaternionIdentity(), r, t) };
+            XMStoreFloat4x4(target.world, world);
 
-            // NOTE: (F. Luna() Intro to DirectxX 12 section 8.2.2
-            world.r[3] = XMVectorSet(0.f, 0.f, 0.f, 1.f);
-            XMMATRIX inverse_world{ XMMatrixInverse(nullptr, world) };
-            XMStoreFloat4x4(&inv_world[index], inverse_world);
+            const XMVECTOR inv_scale{ XMVectorSetW(XMVectorReciprocal(s), 1.f) };
+            XMMATRIX inverse_world{ XMMatrixTranspose(XMMatrixRotationQuaternion(r)) };
+            inverse_world.r[0] = XMVectorMultiply(inverse_world.r[0], inv_scale);
+            inverse_world.r[1] = XMVectorMultiply(inverse_world.r[1], inv_scale);
+            inverse_world.r[2] = XMVectorMultiply(inverse_world.r[2], inv_scale);
+            XMStoreFloat4x4(target.inverse_world, inverse_world);
+
+            has_transform[index] = 1;
+            world_update_pass[index] = update_pass;
+            ++world_versions[index];
+        }
+
+        // Calculates the world and inverse world matrices of 4 transforms at once. The inputs are transposed
+        // so that each SIMD lane works on a different transform (i.e. structure of arrays in registers).
+        void calculate_transform_metrics_x4(const id::id_type* const indices)
+        {
+            using namespace DirectX;
+            const id::id_type i0{ indices[0] }, i1{ indices[1] }, i2{ indices[2] }, i3{ indices[3] };
+
+            // Load and transpose: q.r[0] holds the x component of all 4 quaternions, etc.
+            const XMMATRIX q{ XMMatrixTranspose(XMMATRIX{ XMLoadFloat4(&rotations[i0]), XMLoadFloat4(&rotations[i1]),
+                                                          XMLoadFloat4(&rotations[i2]), XMLoadFloat4(&rotations[i3]) }) };
+            const XMMATRIX p{ XMMatrixTranspose(XMMATRIX{ XMLoadFloat3(&positions[i0]), XMLoadFloat3(&positions[i1]),
+                                                          XMLoadFloat3(&positions[i2]), XMLoadFloat3(&positions[i3]) }) };
+            const XMMATRIX s{ XMMatrixTranspose(XMMATRIX{ XMLoadFloat3(&scales[i0]), XMLoadFloat3(&scales[i1]),
+                                                          XMLoadFloat3(&scales[i2]), XMLoadFloat3(&scales[i3]) }) };
+
+            const XMVECTOR one{ g_XMOne.v };
+            const XMVECTOR two{ XMVectorReplicate(2.f) };
+            const XMVECTOR x{ q.r[0] }, y{ q.r[1] }, z{ q.r[2] }, w{ q.r[3] };
+            const XMVECTOR x2{ XMVectorMultiply(x, two) }, y2{ XMVectorMultiply(y, two) }, z2{ XMVectorMultiply(z, two) };
+            const XMVECTOR xx{ XMVectorMultiply(x, x2) }, yy{ XMVectorMultiply(y, y2) }, zz{ XMVectorMultiply(z, z2) };
+            const XMVECTOR xy{ XMVectorMultiply(x, y2) }, xz{ XMVectorMultiply(x, z2) }, yz{ XMVectorMultiply(y, z2) };
+            const XMVECTOR wx{ XMVectorMultiply(w, x2) }, wy{ XMVectorMultiply(w, y2) }, wz{ XMVectorMultiply(w, z2) };
+
+            // Rotation matrix (row vector convention, same as XMMatrixRotationQuaternion).
+            const XMVECTOR r00{ XMVectorSubtract(one, XMVectorAdd(yy, zz)) };
+            const XMVECTOR r01{ XMVectorAdd(xy, wz) };
+            const XMVECTOR r02{ XMVectorSubtract(xz, wy) };
+            const XMVECTOR r10{ XMVectorSubtract(xy, wz) };
+            const XMVECTOR r11{ XMVectorSubtract(one, XMVectorAdd(xx, zz)) };
+            const XMVECTOR r12{ XMVectorAdd(yz, wx) };
+            const XMVECTOR r20{ XMVectorAdd(xz, wy) };
+            const XMVECTOR r21{ XMVectorSubtract(yz, wx) };
+            const XMVECTOR r22{ XMVectorSubtract(one, XMVectorAdd(xx, yy)) };
+
+            const XMVECTOR sx{ s.r[0] }, sy{ s.r[1] }, sz{ s.r[2] };
+            const XMVECTOR rsx{ XMVectorReciprocal(sx) }, rsy{ XMVectorReciprocal(sy) }, rsz{ XMVectorReciprocal(sz) };
+            const XMVECTOR zero{ XMVectorZero() };
+
+            // World = S * R * T: rows of R scaled by S and the translation in the last row.
+            XMMATRIX row0{ XMMatrixTranspose(XMMATRIX{ XMVectorMultiply(r00, sx), XMVectorMultiply(r01, sx), XMVectorMultiply(r02, sx), zero }) };
+            XMMATRIX row1{ XMMatrixTranspose(XMMATRIX{ XMVectorMultiply(r10, sy), XMVectorMultiply(r11, sy), XMVectorMultiply(r12, sy), zero }) };
+            XMMATRIX row2{ XMMatrixTranspose(XMMATRIX{ XMVectorMultiply(r20, sz), XMVectorMultiply(r21, sz), XMVectorMultiply(r22, sz), zero }) };
+            XMMATRIX row3{ XMMatrixTranspose(XMMATRIX{ p.r[0], p.r[1], p.r[2], one }) };
+
+            const matrix_target targets[4]{ get_target(i0), get_target(i1), get_target(i2), get_target(i3) };
+            for (u32 i{ 0 }; i < 4; ++i)
+            {
+                XMStoreFloat4x4(targets[i].world, XMMATRIX{ row0.r[i], row1.r[i], row2.r[i], row3.r[i] });
+            }
+
+            // Inverse world = R^T * S^-1.
+            row0 = XMMatrixTranspose(XMMATRIX{ XMVectorMultiply(r00, rsx), XMVectorMultiply(r10, rsy), XMVectorMultiply(r20, rsz), zero });
+            row1 = XMMatrixTranspose(XMMATRIX{ XMVectorMultiply(r01, rsx), XMVectorMultiply(r11, rsy), XMVectorMultiply(r21, rsz), zero });
+            row2 = XMMatrixTranspose(XMMATRIX{ XMVectorMultiply(r02, rsx), XMVectorMultiply(r12, rsy), XMVectorMultiply(r22, rsz), zero });
+            const XMVECTOR identity_row3{ g_XMIdentityR3.v };
 
+            for (u32 i{ 0 }; i < 4; ++i)
+            {
+                XMStoreFloat4x4(targets[i].inverse_world, XMMATRIX{ row0.r[i], row1.r[i], row2.r[i], identity_row3 });
+                has_transform[indices[i]] = 1;
+                world_update_pass[indices[i]] = update_pass;
+                ++world_versions[indices[i]];
+            }
+        }
+
+        // world = local * parent world. Since the inverse world matrices don't have translation, the inverse is
+        // just the product of the inverses in reverse order: inverse world = parent inverse world * local inverse.
+        void combine_with_parent(u32 slot)
+        {
+            using namespace DirectX;
+            const id::id_type index{ hierarchy[slot] };
+            const id::id_type parent{ parents[index] };
+            const XMMATRIX world{ XMMatrixMultiply(XMLoadFloat4x4(&local_world[slot]), XMLoadFloat4x4(&to_world[parent])) };
+            const XMMATRIX inverse_world{ XMMatrixMultiply(XMLoadFloat4x4(&inv_world[parent]), XMLoadFloat4x4(&local_inv_world[slot])) };
+            XMStoreFloat4x4(&to_world[index], world);
+            XMStoreFloat4x4(&inv_world[index], inverse_world);
             has_transform[index] = 1;
+            ++world_versions[index];
+        }
+
+        // Called for every transform in hierarchy order. Only recalculates the world matrix if the local transform
+        // or the parent's world matrix changed during this pass, so untouched subtrees are skipped.
+        void update_from_parent(u32 slot)
+        {
+            const id::id_type index{ hierarchy[slot] };
+            const id::id_type parent{ parents[index] };
+            const bool parent_changed{ world_update_pass[parent] == update_pass };
+            if (!parent_changed && world_update_pass[index] != update_pass) return;
+
+            combine_with_parent(slot);
+            world_update_pass[index] = update_pass;
+            // NOTE: moving a parent moves all of its children, so they also report the parent's changes.
+            if (parent_changed) changes_from_previous_frame[index] |= changes_from_previous_frame[parent];
+        }
+
+        // Recalculates the world matrix of a single transform (and its ancestors if they're out of date).
+        void calculate_world(id::id_type index)
+        {
+            calculate_transform_metrics(index);
+            const u32 slot{ hierarchy_slots[index] };
+            if (slot == u32_invalid_id) return;
+
+            const id::id_type parent{ parents[index] };
+            if (!has_transform[parent]) calculate_world(parent);
+            combine_with_parent(slot);
+        }
+
+        void mark_dirty(id::id_type index)
+        {
+            has_transform[index] = 0;
+            if (!is_queued[index])
+            {
+                is_queued[index] = 1;
+                dirty_ids.emplace_back(index);
+            }
+        }
+
+        void detach_from_parent(id::id_type index)
+        {
+            const u32 slot{ hierarchy_slots[index] };
+            assert(slot < hierarchy.size() && id::is_valid(parents[index]));
+            assert(child_counts[parents[index]]);
+            --child_counts[parents[index]];
+            parents[index] = id::invalid_id;
+            hierarchy_slots[index] = u32_invalid_id;
+
+            const u32 last{ (u32)hierarchy.size() - 1 };
+            if (slot != last)
+            {
+                hierarchy[slot] = hierarchy[last];
+                hierarchy_slots[hierarchy[slot]] = slot;
+            }
+
+            hierarchy.resize(last);
+            local_world.resize(last);
+            local_inv_world.resize(last);
+            hierarchy_changed = true;
+            // NOTE: the transform is a root now, so its world matrix is its local transform.
+            mark_dirty(index);
+        }
+
+        // Sorts the transforms that have a parent by their depth using a counting sort.
+        void rebuild_hierarchy()
+        {
+            util::scratch_scope scratch{};
+            const u32 count{ (u32)hierarchy.size() };
+            scratch_vector<u32> depths(count);
+            u32 max_depth{ 0 };
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                u32 depth{ 1 };
+                id::id_type parent{ parents[hierarchy[i]] };
+                while (hierarchy_slots[parent] != u32_invalid_id)
+                {
+                    ++depth;
+                    parent = parents[parent];
+                }
+
+                depths[i] = depth;
+                max_depth = std::max(max_depth, depth);
+            }
+
+            // level_offsets[d - 1] is the first slot of depth d and the last entry is the total count.
+            level_offsets.clear();
+            level_offsets.resize(max_depth + 1, 0);
+            for (u32 i{ 0 }; i < count; ++i) ++level_offsets[depths[i]];
+            u32 offset{ 0 };
+            for (u32 level{ 0 }; level < max_depth; ++level)
+            {
+                const u32 level_count{ level_offsets[level + 1] };
+                level_offsets[level] = offset;
+                offset += level_count;
+            }
+            level_offsets[max_depth] = count;
+
+            transform_vector<id::id_type> sorted(count);
+            scratch_vector<u32> next(max_depth + 1);
+            memcpy(next.data(), level_offsets.data(), next.size() * sizeof(u32));
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                sorted[next[depths[i] - 1]++] = hierarchy[i];
+            }
+
+            hierarchy.swap(sorted);
+            for (u32 slot{ 0 }; slot < count; ++slot)
+            {
+                const id::id_type index{ hierarchy[slot] };
+                hierarchy_slots[index] = slot;
+                // NOTE: local matrices are stored by slot, so they have to be recalculated after reordering.
+                mark_dirty(index);
+            }
+
+            hierarchy_changed = false;
         }
 
         math::v3 calculate_orientation(math::v4 rotation)
@@ -53,7 +301,7 @@ namespace Quantum::transform {
             const u32 index{ id::index(id) };
             rotations[index] = rotation_quaternion;
             orientations[index] = calculate_orientation(rotation_quaternion);
-            has_transform[index] = 0;
+            mark_dirty(index);
             changes_from_previous_frame[index] |= component_flags::rotation;
         }
 
@@ -66,15 +314,15 @@ namespace Quantum::transform {
         {
             const u32 index{ id::index(id) };
             positions[index] = position;
-            has_transform[index] = 0;
+            mark_dirty(index);
             changes_from_previous_frame[index] |= component_flags::position;
         }
 
         void set_scale(transform_id id, const math::v3& scale)
         {
             const u32 index{ id::index(id) };
-            positions[index] = scale;
-            has_transform[index] = 0;
+            scales[index] = scale;
+            mark_dirty(index);
             changes_from_previous_frame[index] |= component_flags::scale;
         }
 
@@ -85,39 +333,125 @@ namespace Quantum::transform {
 		assert(entity.is_valid());
 		const id::id_type entity_index{ id::index(entity.get_id()) };
 
-        if (positions.size() > entity_index)
-        {
-            math::v4 rotation{ info.rotation };
-            rotations[entity_index] = math::v4(info.rotation);
-            orientations[entity_index] = calculate_orientation(rotation);
-            positions[entity_index] = math::v3{ info.position };
-            scales[entity_index] = math::v3{ info.scale };
-            has_transform[entity_index] = 0;
-            changes_from_previous_frame[entity_index] = (u8)component_flags::all;
-		}
-		else
-		{
-			assert(positions.size() == entity_index);
-            to_world.emplace_back();
-            inv_world.emplace_back();
-			rotations.emplace_back();
-            orientations.emplace_back(calculate_orientation(math::v4{ info.rotation }));
-			positions.emplace_back(info.position);
-			scales.emplace_back(info.scale);
-            has_transform.emplace_back((u8)0);
-            changes_from_previous_frame.emplace_back((u8)component_flags::all);
-		}
+        if (positions.size() <= entity_index)
+        {
+            // NOTE: entity ids can be reserved from several threads, so transforms aren't necessarily
+            //       created in index order. Grow all arrays to cover the new index.
+            const u64 new_size{ (u64)entity_index + 1 };
+            const u64 new_capacity{ std::max(new_size, positions.capacity() + positions.capacity() / 2) };
+            auto grow{ [new_size, new_capacity](auto& v, const auto&... value) { if (v.capacity() < new_size) v.reserve(new_capacity); v.resize(new_size, value...); } };
+            grow(to_world);
+            grow(inv_world);
+            grow(rotations);
+            grow(orientations);
+            grow(positions);
+            grow(scales);
+            grow(has_transform, (u8)1);
+            grow(is_queued, (u8)0);
+            grow(changes_from_previous_frame, (u8)0);
+            grow(parents, id::invalid_id);
+            grow(child_counts, 0u);
+            grow(hierarchy_slots, u32_invalid_id);
+            grow(world_update_pass, 0u);
+            grow(world_versions, 0u);
+        }
+
+        assert(!id::is_valid(parents[entity_index]) && !child_counts[entity_index]);
+        assert(hierarchy_slots[entity_index] == u32_invalid_id);
+        const math::v4 rotation{ info.rotation };
+        rotations[entity_index] = rotation;
+        orientations[entity_index] = calculate_orientation(rotation);
+        positions[entity_index] = math::v3{ info.position };
+        scales[entity_index] = math::v3{ info.scale };
+        mark_dirty(entity_index);
+        changes_from_previous_frame[entity_index] = (u8)component_flags::all;
+
+        if (id::is_valid(info.parent))
+        {
+            assert(game_entity::is_alive(game_entity::entity_id{ info.parent }));
+            const id::id_type parent_index{ id::index(info.parent) };
+            assert(parent_index != entity_index);
+            parents[entity_index] = parent_index;
+            ++child_counts[parent_index];
+            hierarchy_slots[entity_index] = (u32)hierarchy.size();
+            hierarchy.emplace_back(entity_index);
+            local_world.emplace_back();
+            local_inv_world.emplace_back();
+            hierarchy_changed = true;
+        }
 
         // NOTE: each entity has a transform component. There for, id's for transform components
         //       are exactly the same as entity ids.
         return component{ transform_id{ entity.get_id() } };
 	}
 
-	void remove([[maybe_unused]] component c)
+	void remove(component c)
 	{
 		assert(c.is_valid());
+        const id::id_type index{ id::index(c.get_id()) };
+
+        // NOTE: children of a removed transform become roots and keep their local transform.
+        if (child_counts[index])
+        {
+            for (u32 i{ (u32)hierarchy.size() }; i > 0; --i)
+            {
+                const id::id_type child{ hierarchy[i - 1] };
+                if (parents[child] == index) detach_from_parent(child);
+            }
+        }
+        assert(!child_counts[index]);
+
+        if (hierarchy_slots[index] != u32_invalid_id)
+        {
+            detach_from_parent(index);
+        }
 	}
 
+    void update_world_matrices()
+    {
+        if (hierarchy_changed) rebuild_hierarchy();
+
+        const u32 count{ (u32)dirty_ids.size() };
+        if (!count) return;
+        ++update_pass;
+
+        const id::id_type* const ids{ dirty_ids.data() };
+        // NOTE: every dirty transform is written exactly once, so batches can be processed in parallel.
+        jobs::parallel_for(count, 1024, [ids](u32 begin, u32 end) {
+            u32 i{ begin };
+            for (; i + 4 <= end; i += 4)
+            {
+                calculate_transform_metrics_x4(&ids[i]);
+            }
+
+            for (; i < end; ++i)
+            {
+                calculate_transform_metrics(ids[i]);
+            }
+
+            for (i = begin; i < end; ++i)
+            {
+                is_queued[ids[i]] = 0;
+            }
+        });
+
+        dirty_ids.clear();
+
+        // Propagate local-to-world one depth level at a time. Transforms on the same level
+        // only depend on the previous level, so each level can be processed in parallel.
+        const u32 level_count{ level_offsets.size() ? (u32)level_offsets.size() - 1 : 0 };
+        for (u32 level{ 0 }; level < level_count; ++level)
+        {
+            const u32 first{ level_offsets[level] };
+            jobs::parallel_for(level_offsets[level + 1] - first, 1024, [first](u32 begin, u32 end) {
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    update_from_parent(first + i);
+                }
+            });
+        }
+    }
+
     void get_transform_matrics(const game_entity::entity_id id, math::m4x4& world, math::m4x4& inverse_world)
     {
         assert(game_entity::entity{ id }.is_valid());
@@ -125,13 +459,29 @@ namespace Quantum::transform {
         const id::id_type entity_index{ id::index(id) };
         if (!has_transform[entity_index])
         {
-            calculate_transform_metrics(entity_index);
+            calculate_world(entity_index);
         }
 
         world = to_world[entity_index];
         inverse_world = inv_world[entity_index];
     }
 
+    void get_world_versions(const game_entity::entity_id* const ids, u32 count, u32* const versions)
+    {
+        assert(ids && count && versions);
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            assert(game_entity::entity{ ids[i] }.is_valid());
+            const id::id_type entity_index{ id::index(ids[i]) };
+            if (!has_transform[entity_index])
+            {
+                calculate_world(entity_index);
+            }
+
+            versions[i] = world_versions[entity_index];
+        }
+    }
+
     void get_updated_component_flags(const game_entity::entity_id* const ids, u32 count, u8* const flags)
     {
         assert(ids && count && flags);
@@ -150,6 +500,11 @@ namespace Quantum::transform {
 
         // NOTE: clearing "changes_from_previous_frame" happens once every frame when there will be no reads and the caches are
         //       about to be applied by calling tis function (i.e. the rest of the current frame will only have writes).
+        if (read_write_flag)
+        {
+            memset(changes_from_previous_frame.data(), 0, changes_from_previous_frame.size());
+            read_write_flag = 0;
+        }
         for (u32 i{ 0 }; i < count; ++i)
         {
             const component_cache& c{ cache[i] };
@@ -11,6 +11,8 @@ namespace Quantum::transform {
 		f32 position[3]{};
 		f32 rotation[4]{};
 		f32 scale[3]{1.f, 1.f, 1.f};
+        // NOTE: entity id of the parent. Position, rotation and scale are relative to the parent if set.
+        id::id_type parent{ id::invalid_id };
 	};
 
     struct component_flags {
@@ -36,7 +38,13 @@ namespace Quantum::transform {
 
 	component create(init_info info, game_entity::entity entity);
 	void remove(component c);
+    // Recalculates world and inverse world matrices of all transforms that changed since the last call.
+    void update_world_matrices();
     void get_transform_matrics(const game_entity::entity_id id, math::m4x4& world, math::m4x4& inverse_world);
+    // Counts how many times the world matrix of each transform was recalculated, including when its parent moved.
+    // Unlike the component flags, versions are never reset, so a renderer can tell if a world matrix changed since
+    // it last read it, whatever happened in between.
+    void get_world_versions(const game_entity::entity_id* const ids, u32 count, u32* const versions);
     void get_updated_component_flags(const game_entity::entity_id* const ids, u32 count, u8* const flags);
     void update(const component_cache* const cache, u32 count);
 }
@@ -0,0 +1,211 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "ContentCache.h"
+#include "Platform/MappedFile.h"
+#include <string>
+#include <unordered_map>
+
+namespace Quantum::content {
+    namespace {
+
+        constexpr u64 default_budget{ 512ull * 1024 * 1024 };
+
+        struct entry
+        {
+            const std::string*      path{ nullptr };    // key of this entry in entries.
+            id::id_type             resource_id{ id::invalid_id };
+            asset_type::type        type{};
+            u64                     size{ 0 };
+            u32                     ref_count{ 0 };
+            // Unreferenced entries are in a list that goes from the least to the most recently used.
+            entry*                  prev{ nullptr };
+            entry*                  next{ nullptr };
+        };
+
+        // NOTE: entries are nodes of the unordered_map, so pointers to them stay valid until they're erased.
+        std::unordered_map<std::string, entry>      entries;
+        std::unordered_map<u64, entry*>             resource_entries;
+        entry*                                      lru_head{ nullptr };
+        entry*                                      lru_tail{ nullptr };
+        cache_stats                                 stats{ 0, 0, 0, 0, default_budget, 0, 0 };
+        std::mutex                                  cache_mutex;
+
+        constexpr u64 resource_key(id::id_type id, asset_type::type type)
+        {
+            return ((u64)type << 32) | (u64)id;
+        }
+
+        // NOTE: cache_mutex should be locked before the following functions are called.
+        void lru_remove(entry& e)
+        {
+            if (e.prev) e.prev->next = e.next;
+            else lru_head = e.next;
+            if (e.next) e.next->prev = e.prev;
+            else lru_tail = e.prev;
+            e.prev = e.next = nullptr;
+        }
+
+        void lru_push_back(entry& e)
+        {
+            assert(!e.prev && !e.next && lru_head != &e);
+            e.prev = lru_tail;
+            if (lru_tail) lru_tail->next = &e;
+            else lru_head = &e;
+            lru_tail = &e;
+        }
+
+        void add_reference(entry& e)
+        {
+            if (!e.ref_count++)
+            {
+                lru_remove(e);
+                ++stats.referenced_count;
+            }
+        }
+
+        // Takes the least recently used entries out of the cache until the resident size fits in 'budget'.
+        // The resources are added to 'evicted', so they can be destroyed without holding the lock.
+        void evict(u64 budget, util::vector<entry>& evicted)
+        {
+            while (stats.resident_bytes > budget && lru_head)
+            {
+                entry& e{ *lru_head };
+                assert(!e.ref_count);
+                lru_remove(e);
+                stats.resident_bytes -= e.size;
+                --stats.resident_count;
+                ++stats.evictions;
+                resource_entries.erase(resource_key(e.resource_id, e.type));
+                evicted.emplace_back(entry{ nullptr, e.resource_id, e.type, e.size });
+                entries.erase(entries.find(*e.path));
+            }
+        }
+
+        void destroy_evicted(const util::vector<entry>& evicted)
+        {
+            for (const entry& e : evicted) destroy_resource(e.resource_id, e.type);
+        }
+
+    } // anonymous namespace
+
+    id::id_type
+    acquire_resource(const char* path, asset_type::type type)
+    {
+        assert(path);
+        const std::string key{ path };
+        {
+            std::lock_guard lock{ cache_mutex };
+            auto it{ entries.find(key) };
+            if (it != entries.end())
+            {
+                assert(it->second.type == type);
+                add_reference(it->second);
+                ++stats.hits;
+                return it->second.resource_id;
+            }
+        }
+
+        // NOTE: the resource is created without holding the lock, so that threads can load different files at
+        //       the same time. If another thread loaded the same file in the meantime, we use its resource.
+        id::id_type resource_id{ id::invalid_id };
+        u64 size{ 0 };
+        {
+            const platform::mapped_file file{ key };
+            if (!file.is_open()) return id::invalid_id;
+            resource_id = create_resource(file.data(), type);
+            // NOTE: compressed meshes upload more than the size of their file, so we count what the resource
+            //       uploads. Resources that don't upload anything count the size of their file.
+            const u64 resource_size{ get_resource_size(file.data(), type) };
+            size = resource_size ? resource_size : file.size();
+        }
+        if (!id::is_valid(resource_id)) return id::invalid_id;
+
+        util::vector<entry> evicted;
+        id::id_type result{ resource_id };
+        {
+            std::lock_guard lock{ cache_mutex };
+            auto [it, inserted] = entries.try_emplace(key);
+            entry& e{ it->second };
+            if (inserted)
+            {
+                e.path = &it->first;
+                e.resource_id = resource_id;
+                e.type = type;
+                e.size = size;
+                e.ref_count = 1;
+                resource_entries[resource_key(resource_id, type)] = &e;
+                stats.resident_bytes += size;
+                ++stats.resident_count;
+                ++stats.referenced_count;
+                ++stats.misses;
+                resource_id = id::invalid_id;
+                evict(stats.budget, evicted);
+            }
+            else
+            {
+                add_reference(e);
+                ++stats.hits;
+                result = e.resource_id;
+            }
+        }
+
+        if (id::is_valid(resource_id)) destroy_resource(resource_id, type);
+        destroy_evicted(evicted);
+        return result;
+    }
+
+    void
+    release_resource(id::id_type id, asset_type::type type)
+    {
+        util::vector<entry> evicted;
+        {
+            std::lock_guard lock{ cache_mutex };
+            auto it{ resource_entries.find(resource_key(id, type)) };
+            assert(it != resource_entries.end());
+            if (it == resource_entries.end()) return;
+
+            entry& e{ *it->second };
+            assert(e.ref_count);
+            if (--e.ref_count) return;
+
+            --stats.referenced_count;
+            lru_push_back(e);
+            evict(stats.budget, evicted);
+        }
+
+        destroy_evicted(evicted);
+    }
+
+    void
+    set_cache_budget(u64 bytes)
+    {
+        util::vector<entry> evicted;
+        {
+            std::lock_guard lock{ cache_mutex };
+            stats.budget = bytes;
+            evict(bytes, evicted);
+        }
+
+        destroy_evicted(evicted);
+    }
+
+    void
+    trim_cache()
+    {
+        util::vector<entry> evicted;
+        {
+            std::lock_guard lock{ cache_mutex };
+            evict(0, evicted);
+        }
+
+        destroy_evicted(evicted);
+    }
+
+    cache_stats
+    get_cache_stats()
+    {
+        std::lock_guard lock{ cache_mutex };
+        return stats;
+    }
+}
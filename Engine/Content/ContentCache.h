@@ -0,0 +1,38 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include "ContentToEngine.h"
+
+// Shares resources that are created from asset files. acquire_resource() creates the resource the first time
+// a file is used and returns the same resource (with one more reference) after that. Resources that are no
+// longer referenced stay resident, so they can be acquired again without loading, until the resident size goes
+// over the budget. Then the least recently used unreferenced resources are destroyed first. Resources that are
+// still referenced are never evicted, so the budget can be exceeded if they don't fit.
+// NOTE: the size of a resource is what it uploads to the GPU (see get_resource_size()), or the size of its file
+//       for resources that don't upload anything.
+namespace Quantum::content {
+
+    struct cache_stats
+    {
+        u64     hits;
+        u64     misses;
+        u64     evictions;
+        u64     resident_bytes;
+        u64     budget;
+        u32     resident_count;
+        u32     referenced_count;
+    };
+
+    // Returns the resource that was created from the file at 'path' and adds a reference to it.
+    // The resource is created if it isn't resident. Returns id::invalid_id if that fails.
+    [[nodiscard]] id::id_type acquire_resource(const char* path, asset_type::type type);
+    // Removes a reference that was added by acquire_resource().
+    void release_resource(id::id_type id, asset_type::type type);
+
+    void set_cache_budget(u64 bytes);
+    // Destroys all resources that aren't referenced.
+    void trim_cache();
+    [[nodiscard]] cache_stats get_cache_stats();
+}
@@ -3,11 +3,13 @@
 
 #pragma once
 #include "CommonHeaders.h"
+#include "Platform/MappedFile.h"
 #if !defined(SHIPPING) && defined(_WIN64)
 namespace Quantum::content {
     bool load_game();
     void unload_game();
 
-    bool load_engine_shaders(std::unique_ptr<u8[]>& shaders, u64& size);
+    // The shader blob stays mapped, because the engine's shaders point into it.
+    bool load_engine_shaders(platform::mapped_file& shaders);
 }
 #endif // !defined(SHIPPING)
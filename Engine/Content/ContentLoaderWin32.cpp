@@ -9,7 +9,6 @@
 
 #if !defined(SHIPPING) && defined(_WIN64)
 
-#include <fstream>
 #include <filesystem>
 #include <Windows.h>
 
@@ -71,36 +70,14 @@ namespace Quantum::content {
             read_script,
         };
         static_assert(_countof(component_readers) == component_type::count);
-
-        bool read_file(std::filesystem::path path, std::unique_ptr<u8[]>& data, u64& size)
-        {
-            if (!std::filesystem::exists(path)) return false;
-
-            size = std::filesystem::file_size(path);
-            assert(size);
-            if (!size) return false;
-            data = std::make_unique<u8[]>(size);
-            std::ifstream file{ path, std::ios::in | std::ios::binary };
-            if (!file || !file.read((char*)data.get(), size))
-            {
-                file.close();
-                return false;
-            }
-
-            file.close();
-            return true;
-        }
-
     } // anonymous namespace
 
     bool load_game() {
 
-        // read game.bin and create the entities.
-        std::unique_ptr<u8[]> game_data{};
-        u64 size{ 0 };
-        if (!read_file("game.bin", game_data, size)) return false;
-        assert(game_data.get());
-        const u8* at{ game_data.get() };
+        // map game.bin and create the entities.
+        platform::mapped_file game_data{ "game.bin" };
+        if (!game_data.is_open()) return false;
+        const u8* at{ game_data.data() };
         constexpr u32 su32{ sizeof(u32) };
         const u32 num_entities{ *at }; at += su32;
         if (!num_entities) return false;
@@ -127,7 +104,7 @@ namespace Quantum::content {
             entities.emplace_back(entity);
         }
 
-        assert(at == game_data.get() + size);
+        assert(at == game_data.data() + game_data.size());
         return true;
     }
 
@@ -138,10 +115,10 @@ namespace Quantum::content {
         }
     }
 
-    bool load_engine_shaders(std::unique_ptr<u8[]>& shaders, u64& size)
+    bool load_engine_shaders(platform::mapped_file& shaders)
     {
         auto path = graphics::get_engine_shaders_path();
-        return read_file(path, shaders, size);
+        return shaders.open(path);
     }
 }
 #endif  // !defined(SHIPPING)
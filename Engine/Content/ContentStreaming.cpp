@@ -0,0 +1,288 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "ContentStreaming.h"
+#include "Core/JobSystem.h"
+#include "Platform/MappedFile.h"
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+
+namespace Quantum::content {
+    namespace {
+
+        // Files that are mapped and waiting for (or being processed by) a job. This keeps the I/O thread
+        // from paging in much more than the workers can create resources for.
+        constexpr u32 max_loading_requests{ 4 };
+        constexpr u64 page_size{ 4096 };
+
+        struct request
+        {
+            std::string             path;
+            asset_type::type        type{};
+            u32                     priority{ 0 };
+            request_status::status  status{ request_status::queued };
+            id::id_type             resource_id{ id::invalid_id };
+            bool                    cancelled{ false };
+        };
+
+        // NOTE: a request can be in the queue more than once if its priority was changed. Only the entry
+        //       with the current priority is used and the others are skipped when they're popped.
+        struct queue_entry
+        {
+            u32                     priority;
+            u64                     sequence;
+            request_id              id;
+
+            // Orders the heap so that the highest priority (and the oldest request among those) comes first.
+            constexpr bool operator<(const queue_entry& o) const
+            {
+                return priority < o.priority || (priority == o.priority && sequence > o.sequence);
+            }
+        };
+
+        struct load_job
+        {
+            request_id              id;
+            asset_type::type        type;
+            platform::mapped_file   file;
+        };
+
+        id::allocator<>                 request_ids;
+        // NOTE: a deque, so that requests don't move when it grows.
+        util::deque<request>            requests;
+        util::vector<queue_entry>       queue;
+        util::vector<request_id>        finished;
+        u64                             next_sequence{ 0 };
+        u32                             loading_count{ 0 };
+        bool                            running{ false };
+        std::mutex                      request_mutex;
+        std::condition_variable         io_condition;
+        std::thread                     io_thread;
+        jobs::counter                   load_counter;
+
+        request& get_request(request_id id)
+        {
+            assert(request_ids.is_alive(id));
+            return requests[request_ids.index(id)];
+        }
+
+        // NOTE: request_mutex should be locked before this function is called.
+        void finish_request(request_id id, request_status::status status)
+        {
+            request& r{ get_request(id) };
+            r.status = status;
+            finished.emplace_back(id);
+        }
+
+        // Touches every page of the file, so that the job doesn't have to wait for the disk.
+        void page_in(const platform::mapped_file& file)
+        {
+            const u8* const data{ file.data() };
+            u8 sum{ 0 };
+            for (u64 offset{ 0 }; offset < file.size(); offset += page_size) sum += data[offset];
+            [[maybe_unused]] volatile u8 sink{ sum };
+        }
+
+        void load_resource(void* data)
+        {
+            std::unique_ptr<load_job> job{ (load_job*)data };
+            bool cancelled{ false };
+            {
+                std::lock_guard lock{ request_mutex };
+                cancelled = get_request(job->id).cancelled;
+            }
+
+            id::id_type resource_id{ id::invalid_id };
+            if (!cancelled && job->file.is_open()) resource_id = create_resource(job->file.data(), job->type);
+            job->file.close();
+
+            {
+                std::lock_guard lock{ request_mutex };
+                request& r{ get_request(job->id) };
+                --loading_count;
+                if (r.cancelled)
+                {
+                    finish_request(job->id, request_status::cancelled);
+                }
+                else
+                {
+                    r.resource_id = resource_id;
+                    finish_request(job->id, id::is_valid(resource_id) ? request_status::completed : request_status::failed);
+                    resource_id = id::invalid_id;
+                }
+            }
+
+            io_condition.notify_one();
+            // NOTE: the request was cancelled while we were creating the resource, so nobody will use it.
+            if (id::is_valid(resource_id)) destroy_resource(resource_id, job->type);
+        }
+
+        void io_thread_proc()
+        {
+            std::unique_lock lock{ request_mutex };
+            while (true)
+            {
+                io_condition.wait(lock, [] { return !running || (!queue.empty() && loading_count < max_loading_requests); });
+                if (!running) break;
+
+                std::pop_heap(queue.begin(), queue.end());
+                const queue_entry entry{ queue.back() };
+                queue.resize(queue.size() - 1);
+
+                if (!request_ids.is_alive(entry.id)) continue;
+                request& r{ get_request(entry.id) };
+                if (r.status != request_status::queued || r.priority != entry.priority) continue;
+
+                r.status = request_status::loading;
+                ++loading_count;
+                const std::string path{ r.path };
+                std::unique_ptr<load_job> job{ new load_job{ entry.id, r.type, {} } };
+                lock.unlock();
+
+                // NOTE: if the file can't be opened, the job reports the request as failed.
+                if (job->file.open(path)) page_in(job->file);
+                jobs::run({ &load_resource, job.release() }, &load_counter);
+
+                lock.lock();
+            }
+        }
+
+    } // anonymous namespace
+
+    bool
+    initialize_streaming()
+    {
+        std::lock_guard lock{ request_mutex };
+        assert(!running);
+        running = true;
+        io_thread = std::thread{ io_thread_proc };
+        return true;
+    }
+
+    void
+    shutdown_streaming()
+    {
+        {
+            std::lock_guard lock{ request_mutex };
+            if (!running) return;
+            running = false;
+        }
+
+        io_condition.notify_one();
+        io_thread.join();
+        jobs::wait(&load_counter);
+
+        {
+            std::lock_guard lock{ request_mutex };
+            assert(!loading_count);
+            for (const queue_entry& entry : queue)
+            {
+                if (request_ids.is_alive(entry.id) && get_request(entry.id).status == request_status::queued)
+                {
+                    finish_request(entry.id, request_status::cancelled);
+                }
+            }
+            queue.clear();
+        }
+
+        util::vector<request_result> results;
+        poll_requests(results);
+        for (const request_result& result : results)
+        {
+            if (result.status == request_status::completed) destroy_resource(result.resource_id, result.type);
+        }
+    }
+
+    request_id
+    request_resource(const char* path, asset_type::type type, u32 priority)
+    {
+        assert(path);
+        std::lock_guard lock{ request_mutex };
+        assert(running);
+        const request_id id{ request_ids.allocate() };
+        const u32 index{ request_ids.index(id) };
+        if (index >= requests.size()) requests.resize(index + 1);
+
+        request& r{ requests[index] };
+        r = {};
+        r.path = path;
+        r.type = type;
+        r.priority = priority;
+
+        queue.emplace_back(queue_entry{ priority, next_sequence++, id });
+        std::push_heap(queue.begin(), queue.end());
+        io_condition.notify_one();
+        return id;
+    }
+
+    bool
+    set_request_priority(request_id id, u32 priority)
+    {
+        std::lock_guard lock{ request_mutex };
+        request& r{ get_request(id) };
+        if (r.status != request_status::queued) return false;
+        if (r.priority == priority) return true;
+
+        r.priority = priority;
+        queue.emplace_back(queue_entry{ priority, next_sequence++, id });
+        std::push_heap(queue.begin(), queue.end());
+        io_condition.notify_one();
+        return true;
+    }
+
+    void
+    cancel_request(request_id id)
+    {
+        id::id_type resource_id{ id::invalid_id };
+        asset_type::type type{};
+        {
+            std::lock_guard lock{ request_mutex };
+            request& r{ get_request(id) };
+            switch (r.status)
+            {
+            case request_status::queued:
+                finish_request(id, request_status::cancelled);
+                break;
+            case request_status::loading:
+                // NOTE: the job sees this flag when it's done and finishes the request.
+                r.cancelled = true;
+                break;
+            case request_status::completed:
+                // Already in the finished list, so we only change what we report.
+                resource_id = r.resource_id;
+                type = r.type;
+                r.resource_id = id::invalid_id;
+                r.status = request_status::cancelled;
+                break;
+            default: break;
+            }
+        }
+
+        if (id::is_valid(resource_id)) destroy_resource(resource_id, type);
+    }
+
+    request_status::status
+    get_request_status(request_id id)
+    {
+        std::lock_guard lock{ request_mutex };
+        return get_request(id).status;
+    }
+
+    u32
+    poll_requests(util::vector<request_result>& results)
+    {
+        std::lock_guard lock{ request_mutex };
+        const u32 count{ (u32)finished.size() };
+        for (const request_id id : finished)
+        {
+            request& r{ get_request(id) };
+            results.emplace_back(request_result{ id, r.resource_id, r.type, r.status });
+            r.path.clear();
+            request_ids.release(id);
+        }
+
+        finished.clear();
+        return count;
+    }
+}
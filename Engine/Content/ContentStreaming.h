@@ -0,0 +1,61 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include "ContentToEngine.h"
+
+// Asynchronous loading of asset files. request_resource() queues a file and returns right away. An I/O thread
+// takes the queued request with the highest priority, maps the file and pages it in. Then a job on the job
+// system creates the resource, the same way create_resource() does. Finished requests are collected with
+// poll_requests(), once per frame, which hands their resource ids over to the caller.
+namespace Quantum::content {
+
+    DEFINE_TYPED_ID(request_id);
+
+    struct request_status {
+        enum status : u32 {
+            queued,             // waiting for the I/O thread.
+            loading,            // the file is being read or the resource is being created.
+            completed,
+            failed,
+            cancelled,
+        };
+    };
+
+    // Requests with a higher priority are loaded first. Requests with the same priority are loaded in the
+    // order they were made. Any value can be used, these are just the common ones.
+    struct request_priority {
+        enum priority : u32 {
+            low = 0,
+            normal = 100,
+            high = 200,
+        };
+    };
+
+    struct request_result
+    {
+        request_id              id;
+        id::id_type             resource_id;    // only valid if status is completed.
+        asset_type::type        type;
+        request_status::status  status;
+    };
+
+    // Starts the I/O thread. Resources are created on the job system, so it should be initialized first.
+    bool initialize_streaming();
+    // Cancels pending requests and waits for the ones that are loading. Resources of requests that weren't
+    // polled yet are destroyed.
+    void shutdown_streaming();
+
+    [[nodiscard]] request_id request_resource(const char* path, asset_type::type type, u32 priority = request_priority::normal);
+    // Changes the priority of a request. Returns false if the request already left the queue.
+    bool set_request_priority(request_id id, u32 priority);
+    // Cancels a request that wasn't polled yet. If its resource was already created, it's destroyed.
+    // poll_requests() reports the request as cancelled.
+    void cancel_request(request_id id);
+    // Status of a request that wasn't polled yet.
+    [[nodiscard]] request_status::status get_request_status(request_id id);
+    // Adds the requests that finished (completed, failed or cancelled) since the last call to 'results'
+    // and returns how many there were. Their ids are released and can't be used anymore.
+    u32 poll_requests(util::vector<request_result>& results);
+}
@@ -1,6 +1,7 @@
 // Copyright (c) Andrey Trepalin. 
 // Distributed under the MIT license. See the LICENSE file in the project root for more information.
 #include "ContentToEngine.h"
+#include "Graphics/LodSelection.h"
 #include "Graphics/Renderer.h"
 #include "Utilities/IOStream.h"
 
@@ -50,6 +51,14 @@ namespace Quantum::content {
             [[nodiscard]] constexpr f32* thresholds() const { return _thresholds; }
             [[nodiscard]] constexpr lod_offset* lod_offsets() const { return _lod_offsets; }
             [[nodiscard]] constexpr id::id_type* gpu_ids() const { return _gpu_ids; }
+
+            // Size of the hierarchy buffer in bytes. Same as get_geometry_hierarchy_buffer_size().
+            [[nodiscard]] u32 buffer_size() const
+            {
+                u32 id_count{ 0 };
+                for (u32 i{ 0 }; i < _lod_count; ++i) id_count += _lod_offsets[i].count;
+                return (u32)(sizeof(u32) + (sizeof(f32) + sizeof(lod_offset)) * _lod_count + sizeof(id::id_type) * id_count);
+            }
 			
         private:
             u8* const               _buffer;
@@ -61,7 +70,7 @@ namespace Quantum::content {
 		
         // NOTE: This is needed to maintain compatibility with STL vector.
         struct noexcept_map {
-            std::unordered_map<u32, std::unique_ptr<u8[]>> map;
+            std::unordered_map<u32, util::unique_buffer<util::memory_tag::shaders>> map;
             noexcept_map() = default;
             noexcept_map(const noexcept_map&) = default;
             noexcept_map(noexcept_map&&) noexcept = default;
@@ -71,6 +80,8 @@ namespace Quantum::content {
 		
         // This constant indicates that an element in geometry_hierarchiees is not a pointer, but a gpu_id
         constexpr uintptr_t                 single_mesh_marker{ (uintptr_t)0x01 };
+        // NOTE: hierarchy buffers are small (a few hundred bytes at most), so they come from block pools.
+        using hierarchy_allocator = util::pool_allocator<util::memory_tag::geometry>;
         util::free_list<u8*>                geometry_hierarchies;
         std::mutex                          geometry_mutex;
 		
@@ -106,7 +117,7 @@ namespace Quantum::content {
         {
             assert(data);
             const u32 size{ get_geometry_hierarchy_buffer_size(data) };
-            u8* const hierarchy_buffer{ (u8* const)malloc(size) };
+            u8* const hierarchy_buffer{ (u8* const)hierarchy_allocator::allocate(size) };
 
             util::blob_stream_reader blob{ (const u8*)data };
             const u32 lod_count{ blob.read<u32>() };
@@ -199,10 +210,19 @@ namespace Quantum::content {
         //          u32 isze_of_submeshes,
         //          struct {
         //              u32 elemet_size, u32 vertex_count,
-        //              u32 index_count, u32 element_type, u32 primitive_topology
-        //              u8 positions[sizeof(f32) * 3 * vertex_count], // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
-        //              u8 element[sizeof(element_size) * vertex_count], // sizeof(elements) must be a multiple of 4 bytes. Pad if needed.
+        //              u32 index_count, u32 element_type,
+        //              u32 primitive_topology, // the upper 16 bits are submesh_flags
+        //              // only if submesh_flags::quantized_positions is set:
+        //              f32 position_offset[3], f32 position_scale[3],
+        //              // if submesh_flags::compressed is set, the buffers are encoded as described in MeshDecoder.h:
+        //              u32 compressed_size, u8 compressed_buffers[compressed_size],
+        //              // otherwise:
+        //              u8 positions[position_size * vertex_count], // padded to a multiple of submesh_buffer_alignment bytes.
+        //              u8 element[sizeof(element_size) * vertex_count], // padded to a multiple of submesh_buffer_alignment bytes.
         //              u8 indices[index_size * index_count],
+        //              // only if submesh_flags::has_meshlets is set:
+        //              u32 meshlet_count,
+        //              meshlet meshlets[meshlet_count],
         //          } submeshes[submesh_count]
         //       } mesh_lods[lod_count]
         // } geometry;
@@ -225,6 +245,53 @@ namespace Quantum::content {
         // (gpu_id << 32) | 0x01
         //
 
+        // Number of bytes that graphics::add_submesh() uploads for the submeshes of all LODs. Compressed
+        // submeshes are counted with their decoded size.
+        // NOTE: expects the same data as create_geometry_resource()
+        u64 get_geometry_resource_size(const void* const data)
+        {
+            assert(data);
+            util::blob_stream_reader blob{ (const u8*)data };
+            const u32 lod_count{ blob.read<u32>() };
+            u64 size{ 0 };
+
+            for (u32 lod_idx{ 0 }; lod_idx < lod_count; ++lod_idx)
+            {
+                // skip threshold
+                blob.skip(sizeof(f32));
+                const u32 submesh_count{ blob.read<u32>() };
+                blob.skip(sizeof(u32)); // skip over size_of_submeshes
+                for (u32 submesh_idx{ 0 }; submesh_idx < submesh_count; ++submesh_idx)
+                {
+                    const u32 element_size{ blob.read<u32>() };
+                    const u32 vertex_count{ blob.read<u32>() };
+                    const u32 index_count{ blob.read<u32>() };
+                    blob.skip(sizeof(u32)); // skip element_type
+                    const u32 flags{ blob.read<u32>() >> 16 };
+                    const bool quantized_positions{ (flags & submesh_flags::quantized_positions) != 0 };
+                    if (quantized_positions) blob.skip(2 * sizeof(math::v3));
+
+                    // NOTE: same sizes as graphics::add_submesh(). Vertex buffers are padded to submesh_buffer_alignment.
+                    const u32 position_size{ quantized_positions ? (u32)sizeof(u16) * 4 : (u32)sizeof(math::v3) };
+                    const u32 index_size{ (vertex_count < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
+                    const u64 buffer_size{ math::align_size_up<submesh_buffer_alignment>((u64)position_size * vertex_count) +
+                                           math::align_size_up<submesh_buffer_alignment>((u64)element_size * vertex_count) +
+                                           (u64)index_size * index_count };
+                    size += buffer_size;
+                    blob.skip((flags & submesh_flags::compressed) ? blob.read<u32>() : (u32)buffer_size);
+
+                    if (flags & submesh_flags::has_meshlets)
+                    {
+                        const u32 meshlet_buffer_size{ (u32)sizeof(meshlet) * blob.read<u32>() };
+                        size += meshlet_buffer_size;
+                        blob.skip(meshlet_buffer_size);
+                    }
+                }
+            }
+
+            return size;
+        }
+
         id::id_type create_geometry_resource(const void *const data)
         {
             assert(data);
@@ -251,9 +318,9 @@ namespace Quantum::content {
                         graphics::remove_submesh(stream.gpu_ids()[id_index++]);
                     }
                 }
-            }
 
-            free(pointer);
+                hierarchy_allocator::deallocate(pointer, stream.buffer_size());
+            }
 
             geometry_hierarchies.remove(id);
         }
@@ -314,6 +381,16 @@ namespace Quantum::content {
         }
     }
 
+    u64 get_resource_size(const void* const data, asset_type::type type)
+    {
+        assert(data);
+        switch (type)
+        {
+            case asset_type::mesh: return get_geometry_resource_size(data);
+            default: return 0;
+        }
+    }
+
     // NOTE: expect shaders to be an array of pointers to compiled_shaders
     // NOTE: the editor is responsible for making sure that there are no duplicate shaders. If there are, we'll happily and then!
     id::id_type add_shader_group(const u8 *const * shaders, u32 num_shaders, const u32* const keys)
@@ -325,7 +402,7 @@ namespace Quantum::content {
             assert(shaders[i]);
             const compiled_shader_ptr shader_ptr{ (const compiled_shader_ptr)shaders[i] };
             const u64 size{ shader_ptr->buffer_size() };
-            std::unique_ptr<u8[]> shader{ std::make_unique<u8[]>(size) };
+            util::unique_buffer<util::memory_tag::shaders> shader{ util::make_unique_buffer<util::memory_tag::shaders>(size) };
             memcpy(shader.get(), shaders[i], size);
             group.map[keys[i]] = std::move(shader);
         }
@@ -348,16 +425,10 @@ namespace Quantum::content {
         std::lock_guard lock{ shader_mutex };
         assert(id::is_valid(id));
 
-        for (const auto& [key, value] : shader_groups[id].map)
-        {
-            if (key == shader_key)
-            {
-                return (const compiled_shader_ptr)value.get();
-            }
-        }
-
-        assert(false); // should never occure.
-        return nullptr;
+        const auto& map{ shader_groups[id].map };
+        const auto it{ map.find(shader_key) };
+        assert(it != map.end()); // should never occure.
+        return it != map.end() ? (const compiled_shader_ptr)it->second.get() : nullptr;
     }
 
     void get_submesh_gpu_ids(id::id_type geometry_content_id, u32 id_count, id::id_type* const gpu_ids)
@@ -384,10 +455,10 @@ namespace Quantum::content {
         }
     }
 
-    void get_lod_offset(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, util::vector<lod_offset>& offsets)
+    // NOTE: offsets must have room for id_count elements.
+    void get_lod_offset(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, lod_offset* const offsets)
     {
-        assert(geometry_ids && thresholds && id_count);
-        assert(offsets.empty());
+        assert(geometry_ids && thresholds && id_count && offsets);
 
         std::lock_guard lock{ geometry_mutex };
 
@@ -396,14 +467,37 @@ namespace Quantum::content {
             u8* const pointer{ geometry_hierarchies[geometry_ids[i]] };
             if ((uintptr_t)pointer & single_mesh_marker)
             {
-                offsets.emplace_back(lod_offset{ 0, 1 });
+                offsets[i] = lod_offset{ 0, 1 };
             }
             else
             {
                 geometry_hierarchy_stream stream{ pointer };
                 const u32 lod{ stream.lod_from_thresholds(thresholds[i]) };
-                offsets.emplace_back(stream.lod_offsets()[lod]);
+                offsets[i] = stream.lod_offsets()[lod];
             }
         } 
     }
+
+    void get_lod_offset(const id::id_type* const geometry_ids, const f32* const distances, u32 id_count, lod_offset* const offsets, u32* const lods)
+    {
+        assert(geometry_ids && distances && id_count && offsets && lods);
+
+        std::lock_guard lock{ geometry_mutex };
+
+        for (u32 i{ 0 }; i < id_count; ++i)
+        {
+            u8* const pointer{ geometry_hierarchies[geometry_ids[i]] };
+            if ((uintptr_t)pointer & single_mesh_marker)
+            {
+                offsets[i] = lod_offset{ 0, 1 };
+                lods[i] = 0;
+            }
+            else
+            {
+                geometry_hierarchy_stream stream{ pointer };
+                lods[i] = graphics::select_lod(stream.thresholds(), stream.lod_count(), distances[i], lods[i]);
+                offsets[i] = stream.lod_offsets()[lods[i]];
+            }
+        }
+    }
 }
@@ -52,13 +52,46 @@ namespace Quantum::content {
         u16 count;
     };
 	
+    // Flags in the upper 16 bits of a submesh's primitive topology.
+    struct submesh_flags {
+        enum flags : u32 {
+            none = 0x00,
+            has_meshlets = 0x01,
+            quantized_positions = 0x02,
+            compressed = 0x04,
+        };
+    };
+	
+    // Uncompressed vertex buffers of a submesh are padded to this many bytes in geometry blobs, and the buffers
+    // are laid out the same way on the GPU. The editor pads with the same value when it packs meshes.
+    constexpr u32 submesh_buffer_alignment{ 4 };
+
+    // A cluster of triangles in a submesh's index buffer with its bounding sphere and normal cone.
+    // The cluster is back-facing for a camera at position c if
+    // dot(center - c, cone_axis) >= cone_cutoff * length(center - c) + radius.
+    struct meshlet
+    {
+        math::v3    center;
+        f32         radius;
+        math::v3    cone_axis;
+        f32         cone_cutoff;
+        u32         first_index;
+        u32         index_count;
+    };
+	
     id::id_type create_resource(const void* const data, asset_type::type type);
     void destroy_resource(id::id_type id, asset_type::type type);
+    // Number of bytes that create_resource() uploads to the GPU for 'data', e.g. the decoded vertex, index and
+    // meshlet buffers of a mesh. Returns 0 for asset types that don't upload anything.
+    [[nodiscard]] u64 get_resource_size(const void* const data, asset_type::type type);
 	
     id::id_type add_shader_group(const u8 *const * shaders, u32 num_shaders, const u32 *const keys);
     void remove_shader_group(id::id_type id);
     compiled_shader_ptr get_shader(id::id_type id, u32 shader_key);
 	
     void get_submesh_gpu_ids(id::id_type geometry_content_id, u32 id_count, id::id_type* const gpu_ids);
-    void get_lod_offset(const id::id_type *const geometry_ids, const f32 *const thresholds, u32 id_count, util::vector<lod_offset>& offsets);
+    void get_lod_offset(const id::id_type *const geometry_ids, const f32 *const thresholds, u32 id_count, lod_offset *const offsets);
+    // Picks LODs with graphics::select_lod() for distances from graphics::calculate_lod_distances(). 'lods' holds
+    // the LODs that were used last time and is updated with the new ones.
+    void get_lod_offset(const id::id_type *const geometry_ids, const f32 *const distances, u32 id_count, lod_offset *const offsets, u32 *const lods);
 }
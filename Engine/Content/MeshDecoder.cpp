@@ -0,0 +1,199 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "MeshDecoder.h"
+#include <immintrin.h>
+#include <intrin.h>
+#include <algorithm>
+
+namespace Quantum::content {
+    namespace {
+
+        // For every control byte: the shuffle that moves the bytes of its 4 values into 4 u32 lanes
+        // and the total number of bytes of the 4 values.
+        struct control_table
+        {
+            alignas(16) u8  shuffles[256][16];
+            u8              lengths[256];
+
+            constexpr control_table() : shuffles{}, lengths{}
+            {
+                for (u32 control{ 0 }; control < 256; ++control)
+                {
+                    u32 offset{ 0 };
+                    for (u32 lane{ 0 }; lane < 4; ++lane)
+                    {
+                        const u32 length{ ((control >> (lane * 2)) & 0x03) + 1 };
+                        for (u32 byte{ 0 }; byte < 4; ++byte)
+                        {
+                            // NOTE: pshufb writes 0 for indices that have the top bit set.
+                            shuffles[control][lane * 4 + byte] = (u8)(byte < length ? offset + byte : 0x80);
+                        }
+                        offset += length;
+                    }
+                    lengths[control] = (u8)offset;
+                }
+            }
+        };
+
+        constexpr control_table table{};
+
+        bool cpu_has_ssse3()
+        {
+            s32 info[4]{};
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+        }
+
+        // NOTE: the decoder needs SSSE3 for pshufb. On CPUs without it every group is decoded without SIMD.
+        //       We only check the CPU once, when the engine starts.
+        const bool use_ssse3{ cpu_has_ssse3() };
+
+        constexpr u32 unzigzag(u32 v)
+        {
+            return (v >> 1) ^ (0u - (v & 1));
+        }
+
+        // Decodes a stream of 'count' values and passes groups of 4 decoded values to 'store', together with the
+        // index of the first value in the group. The last group may have fewer than 4 valid values.
+        // Returns the position after the stream or nullptr if it doesn't fit in [data, end).
+        template<bool ssse3, typename store_fn>
+        const u8* decode_stream(const u8* const data, const u8* const end, u32 count, store_fn store)
+        {
+            const u32 control_count{ (count + 3) / 4 };
+            if ((u64)(end - data) < control_count) return nullptr;
+
+            const u8* control{ data };
+            const u8* values{ data + control_count };
+            __m128i previous{ _mm_setzero_si128() };
+            const __m128i one{ _mm_set1_epi32(1) };
+
+            // NOTE: every group loads 16 bytes, which may be more than the group needs. The last few groups
+            //       of the buffer are decoded without SIMD, so that we never read past its end.
+            const u32 full_groups{ ssse3 ? count / 4 : 0 };
+            u32 group{ 0 };
+            for (; group < full_groups && (u64)(end - values) >= 16; ++group)
+            {
+                const u8 c{ control[group] };
+                __m128i v{ _mm_loadu_si128((const __m128i*)values) };
+                v = _mm_shuffle_epi8(v, _mm_load_si128((const __m128i*)table.shuffles[c]));
+                values += table.lengths[c];
+
+                v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+                // prefix sum of the 4 differences plus the last value of the previous group.
+                v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+                v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+                v = _mm_add_epi32(v, previous);
+                previous = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+
+                store(group * 4, v);
+            }
+
+            u32 last{ (u32)_mm_cvtsi128_si32(previous) };
+            for (; group < control_count; ++group)
+            {
+                const u8 c{ control[group] };
+                alignas(16) u32 decoded[4]{};
+                const u32 group_count{ std::min(4u, count - group * 4) };
+                for (u32 lane{ 0 }; lane < group_count; ++lane)
+                {
+                    const u32 length{ ((c >> (lane * 2)) & 0x03) + 1 };
+                    if ((u64)(end - values) < length) return nullptr;
+                    u32 v{ 0 };
+                    for (u32 byte{ 0 }; byte < length; ++byte) v |= (u32)values[byte] << (byte * 8);
+                    values += length;
+                    last += unzigzag(v);
+                    decoded[lane] = last;
+                }
+
+                store(group * 4, _mm_load_si128((const __m128i*)decoded));
+            }
+
+            return values;
+        }
+
+        template<bool ssse3>
+        u64 decode_vertices(void* const vertices, u32 vertex_count, u32 vertex_size, const u8* const data, u64 data_size)
+        {
+            assert(vertices && data && vertex_size && (vertex_size % sizeof(u16)) == 0);
+            const u32 word_count{ vertex_size / (u32)sizeof(u16) };
+            const u8* const end{ data + data_size };
+            const u8* at{ data };
+
+            for (u32 word{ 0 }; word < word_count; ++word)
+            {
+                u16* const out{ (u16*)vertices + word };
+                at = decode_stream<ssse3>(at, end, vertex_count, [&](u32 first, __m128i v) {
+                    const u32 count{ std::min(4u, vertex_count - first) };
+                    u16* const dst{ out + (u64)first * word_count };
+                    // NOTE: only the low 16 bits of each lane are used, since the differences are modulo 2^16.
+                    dst[0] = (u16)_mm_extract_epi16(v, 0);
+                    if (count > 1) dst[word_count] = (u16)_mm_extract_epi16(v, 2);
+                    if (count > 2) dst[word_count * 2] = (u16)_mm_extract_epi16(v, 4);
+                    if (count > 3) dst[word_count * 3] = (u16)_mm_extract_epi16(v, 6);
+                });
+
+                assert(at);
+                if (!at) return 0;
+            }
+
+            return (u64)(at - data);
+        }
+
+        template<bool ssse3>
+        u64 decode_indices(void* const indices, u32 index_count, u32 index_size, const u8* const data, u64 data_size)
+        {
+            assert(indices && data && (index_size == sizeof(u16) || index_size == sizeof(u32)));
+            const u8* at{ nullptr };
+
+            if (index_size == sizeof(u16))
+            {
+                u16* const out{ (u16*)indices };
+                // NOTE: 16 bit indices fit in the low half of their lane, so we gather those halves with a shuffle.
+                //       (_mm_packus_epi32() would do the same, but it needs SSE4.1 and the decoder only needs SSSE3.)
+                const __m128i low_words{ _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1) };
+                at = decode_stream<ssse3>(data, data + data_size, index_count, [&](u32 first, __m128i v) {
+                    if (ssse3 && index_count - first >= 4)
+                    {
+                        _mm_storel_epi64((__m128i*)&out[first], _mm_shuffle_epi8(v, low_words));
+                        return;
+                    }
+                    alignas(16) u32 values[4];
+                    _mm_store_si128((__m128i*)values, v);
+                    const u32 last{ std::min(first + 4, index_count) };
+                    for (u32 i{ first }; i < last; ++i) out[i] = (u16)values[i - first];
+                });
+            }
+            else
+            {
+                u32* const out{ (u32*)indices };
+                at = decode_stream<ssse3>(data, data + data_size, index_count, [&](u32 first, __m128i v) {
+                    if (index_count - first >= 4)
+                    {
+                        _mm_storeu_si128((__m128i*)&out[first], v);
+                        return;
+                    }
+                    alignas(16) u32 values[4];
+                    _mm_store_si128((__m128i*)values, v);
+                    const u32 last{ std::min(first + 4, index_count) };
+                    for (u32 i{ first }; i < last; ++i) out[i] = values[i - first];
+                });
+            }
+
+            assert(at);
+            return at ? (u64)(at - data) : 0;
+        }
+    } // anonymous namespace
+
+    u64 decode_vertex_buffer(void* const vertices, u32 vertex_count, u32 vertex_size, const u8* const data, u64 data_size)
+    {
+        return use_ssse3 ? decode_vertices<true>(vertices, vertex_count, vertex_size, data, data_size)
+                         : decode_vertices<false>(vertices, vertex_count, vertex_size, data, data_size);
+    }
+
+    u64 decode_index_buffer(void* const indices, u32 index_count, u32 index_size, const u8* const data, u64 data_size)
+    {
+        return use_ssse3 ? decode_indices<true>(indices, index_count, index_size, data, data_size)
+                         : decode_indices<false>(indices, index_count, index_size, data, data_size);
+    }
+}
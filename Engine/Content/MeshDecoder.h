@@ -0,0 +1,29 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+
+// Vertex and index buffers of submeshes that have submesh_flags::compressed set are stored in this format.
+// They're encoded by ContentTools (see MeshEncoder.h) and decoded when the submesh is added to the renderer.
+//
+// Both buffers are made of streams of unsigned values. A stream of n values starts with (n + 3) / 4 control
+// bytes with 2 bits per value (value i uses bits 2 * (i % 4)) that hold the number of bytes of the value
+// minus one. The lowest bytes of the values follow in little-endian order. Values are the zigzag encoded
+// differences to the previous value of the stream (the first value is relative to 0), so that small positive
+// and negative differences both need one byte.
+//
+// - Index buffers are a single stream of indices.
+// - Vertex buffers are split into 16 bit words, and each word of the vertex is a separate stream: first the
+//   stream of all first words, then the stream of all second words and so on. Differences of words are
+//   modulo 2^16, so their values never need more than 2 bytes.
+namespace Quantum::content {
+
+    // Decodes vertex_count vertices of vertex_size bytes (a multiple of 2) from 'data' into 'vertices'.
+    // Returns the number of bytes that were read, which is never more than data_size.
+    u64 decode_vertex_buffer(void* const vertices, u32 vertex_count, u32 vertex_size, const u8* const data, u64 data_size);
+
+    // Decodes index_count indices of index_size bytes (2 or 4) from 'data' into 'indices'.
+    // Returns the number of bytes that were read, which is never more than data_size.
+    u64 decode_index_buffer(void* const indices, u32 index_count, u32 index_size, const u8* const data, u64 data_size);
+}
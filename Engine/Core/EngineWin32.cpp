@@ -2,8 +2,13 @@
 // Distributed under the MIT license. See the LICENSE file in the project root for more information.
 
 #if !defined(SHIPPING) && defined(_WIN64)
+#include "Content/ContentCache.h"
 #include "Content/ContentLoader.h"
+#include "Content/ContentStreaming.h"
+#include "Core/JobSystem.h"
+#include "Components/Entity.h"
 #include "Components/Script.h"
+#include "Components/Transform.h"
 #include "Platform/PlatformTypes.h"
 #include "Platform/Platform.h"
 #include "Graphics/Renderer.h"
@@ -41,6 +46,8 @@ namespace {
 
 bool engine_initialize()
 {
+    if (!Quantum::jobs::initialize()) return false;
+    if (!Quantum::content::initialize_streaming()) return false;
     if (!Quantum::content::load_game()) return false;
 
     platform::window_init_info info
@@ -52,12 +59,18 @@ bool engine_initialize()
 }
 void engine_update()
 {
+    Quantum::util::memory::begin_frame();
     Quantum::script::update(10.f);
+    Quantum::game_entity::apply_commands();
+    Quantum::transform::update_world_matrices();
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
 }
 void engine_shutdown()
 {
     platform::remove_window(game_window.window.get_id());
     Quantum::content::unload_game();
+    Quantum::content::shutdown_streaming();
+    Quantum::content::trim_cache();
+    Quantum::jobs::shutdown();
 }
 #endif // !defined(SHIPPING)
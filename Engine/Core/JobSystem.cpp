@@ -0,0 +1,303 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "JobSystem.h"
+#include <thread>
+
+namespace Quantum::jobs {
+
+    struct counter_access
+    {
+        static std::atomic<u32>& value(counter& c) { return c._value; }
+    };
+
+    namespace {
+
+        constexpr u32 cache_line_size{ 64 };
+        constexpr u32 spin_count_before_sleep{ 256 };
+
+        struct job
+        {
+            job_function    function{ nullptr };
+            void*           data{ nullptr };
+            counter*        c{ nullptr };
+        };
+
+        // Fixed capacity Chase-Lev work-stealing deque. The owning worker pushes and pops at the
+        // bottom end while other workers steal from the top end.
+        // NOTE: a job slot can only be overwritten by the owner after top moved past it, in which
+        //       case the thief's compare-exchange fails and the (possibly torn) copy is discarded.
+        class work_stealing_queue
+        {
+        public:
+            static constexpr s64 capacity{ 4096 };
+            static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of 2.");
+
+            bool push(const job& j)
+            {
+                const s64 b{ _bottom.load(std::memory_order_relaxed) };
+                const s64 t{ _top.load(std::memory_order_acquire) };
+                if (b - t >= capacity) return false;
+
+                _jobs[b & (capacity - 1)] = j;
+                std::atomic_thread_fence(std::memory_order_release);
+                _bottom.store(b + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            bool pop(job& j)
+            {
+                const s64 b{ _bottom.load(std::memory_order_relaxed) - 1 };
+                _bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                s64 t{ _top.load(std::memory_order_relaxed) };
+
+                if (t > b)
+                {
+                    // The queue was empty.
+                    _bottom.store(b + 1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                j = _jobs[b & (capacity - 1)];
+                if (t != b) return true;
+
+                // This was the last job in the queue. Race against thieves for it.
+                const bool won{ _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) };
+                _bottom.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+
+            bool steal(job& j)
+            {
+                s64 t{ _top.load(std::memory_order_acquire) };
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const s64 b{ _bottom.load(std::memory_order_acquire) };
+                if (t >= b) return false;
+
+                j = _jobs[t & (capacity - 1)];
+                return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            }
+
+        private:
+            alignas(cache_line_size) std::atomic<s64>   _top{ 0 };
+            alignas(cache_line_size) std::atomic<s64>   _bottom{ 0 };
+            alignas(cache_line_size) job                _jobs[capacity]{};
+        };
+
+        std::unique_ptr<work_stealing_queue[]>  queues;
+        std::thread                             threads[max_workers];
+        u32                                     workers{ 0 };
+        std::atomic<bool>                       running{ false };
+
+        // NOTE: jobs that are submitted from threads outside the job system go to this queue.
+        util::deque<job>                        global_queue;
+        std::mutex                              global_queue_mutex;
+        std::atomic<u32>                        global_queue_size{ 0 };
+
+        // Sleeping workers wait for this value to change. It's bumped every time new work is queued.
+        std::atomic<u32>                        work_epoch{ 0 };
+        std::atomic<u32>                        sleeping_workers{ 0 };
+
+        thread_local u32                        this_worker_index{ invalid_worker_index };
+
+        void execute(const job& j)
+        {
+            assert(j.function);
+            j.function(j.data);
+            if (j.c)
+            {
+                [[maybe_unused]] const u32 previous{ counter_access::value(*j.c).fetch_sub(1, std::memory_order_acq_rel) };
+                assert(previous);
+            }
+        }
+
+        bool pop_global(job& j)
+        {
+            if (!global_queue_size.load(std::memory_order_acquire)) return false;
+            std::lock_guard lock{ global_queue_mutex };
+            if (global_queue.empty()) return false;
+            j = global_queue.front();
+            global_queue.pop_front();
+            global_queue_size.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        bool find_job(u32 worker_index, job& j)
+        {
+            if (worker_index < workers && queues[worker_index].pop(j)) return true;
+            if (pop_global(j)) return true;
+
+            // Try to steal from other workers, starting with the next one so that thieves spread out.
+            const u32 start{ worker_index < workers ? worker_index + 1 : 0 };
+            for (u32 i{ 0 }; i < workers; ++i)
+            {
+                const u32 victim{ (start + i) % workers };
+                if (victim == worker_index) continue;
+                if (queues[victim].steal(j)) return true;
+            }
+
+            return false;
+        }
+
+        bool execute_next_job(u32 worker_index)
+        {
+            job j{};
+            if (!find_job(worker_index, j)) return false;
+            execute(j);
+            return true;
+        }
+
+        void wake_workers()
+        {
+            work_epoch.fetch_add(1, std::memory_order_seq_cst);
+            if (sleeping_workers.load(std::memory_order_seq_cst))
+            {
+                work_epoch.notify_all();
+            }
+        }
+
+        void worker_thread(u32 worker_index)
+        {
+            this_worker_index = worker_index;
+            u32 spin{ 0 };
+
+            while (running.load(std::memory_order_acquire))
+            {
+                if (execute_next_job(worker_index))
+                {
+                    spin = 0;
+                    continue;
+                }
+
+                if (++spin < spin_count_before_sleep)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                // NOTE: we have to read the epoch before the last check for work, so that any job
+                //       queued after the check changes the epoch and wait() returns immediately.
+                sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+                const u32 epoch{ work_epoch.load(std::memory_order_seq_cst) };
+                if (running.load(std::memory_order_acquire) && !execute_next_job(worker_index))
+                {
+                    work_epoch.wait(epoch, std::memory_order_seq_cst);
+                }
+                sleeping_workers.fetch_sub(1, std::memory_order_seq_cst);
+                spin = 0;
+            }
+
+            this_worker_index = invalid_worker_index;
+        }
+
+    } // anonymous namespace
+
+    bool
+    initialize(u32 worker_count)
+    {
+        assert(!running && !workers);
+        if (!worker_count) worker_count = std::thread::hardware_concurrency();
+        worker_count = std::clamp(worker_count, 1u, max_workers);
+
+        queues = std::make_unique<work_stealing_queue[]>(worker_count);
+        workers = worker_count;
+        this_worker_index = 0;
+        running = true;
+
+        for (u32 i{ 1 }; i < worker_count; ++i)
+        {
+            threads[i] = std::thread{ worker_thread, i };
+        }
+
+        return true;
+    }
+
+    void
+    shutdown()
+    {
+        if (!workers) return;
+
+        // Finish whatever is still queued before the workers go away.
+        while (execute_next_job(this_worker_index)) {}
+
+        running = false;
+        wake_workers();
+        for (u32 i{ 1 }; i < workers; ++i) threads[i].join();
+
+        queues.reset();
+        workers = 0;
+        this_worker_index = invalid_worker_index;
+        assert(global_queue.empty());
+    }
+
+    u32
+    worker_count()
+    {
+        return workers;
+    }
+
+    u32
+    current_worker_index()
+    {
+        return this_worker_index;
+    }
+
+    void
+    run(const job_decl* const jobs, u32 count, counter* const c)
+    {
+        assert(jobs || !count);
+        if (!count) return;
+
+        if (!running.load(std::memory_order_acquire))
+        {
+            for (u32 i{ 0 }; i < count; ++i) jobs[i].function(jobs[i].data);
+            return;
+        }
+
+        if (c) counter_access::value(*c).fetch_add(count, std::memory_order_acq_rel);
+
+        const u32 worker_index{ this_worker_index };
+        if (worker_index < workers)
+        {
+            work_stealing_queue& queue{ queues[worker_index] };
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                const job j{ jobs[i].function, jobs[i].data, c };
+                // NOTE: if our queue is full we just do the work right away.
+                if (!queue.push(j)) execute(j);
+            }
+        }
+        else
+        {
+            std::lock_guard lock{ global_queue_mutex };
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                global_queue.push_back({ jobs[i].function, jobs[i].data, c });
+            }
+            global_queue_size.fetch_add(count, std::memory_order_release);
+        }
+
+        wake_workers();
+    }
+
+    void
+    run(job_decl job, counter* const c)
+    {
+        run(&job, 1, c);
+    }
+
+    void
+    wait(const counter* const c)
+    {
+        assert(c);
+        const u32 worker_index{ this_worker_index };
+        while (!c->is_done())
+        {
+            if (!running.load(std::memory_order_acquire) || !execute_next_job(worker_index))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
@@ -0,0 +1,117 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include <atomic>
+#include <algorithm>
+
+namespace Quantum::jobs {
+
+    // NOTE: a job is a plain function pointer and a user data pointer. The scheduler
+    //       doesn't own the data, so it must stay alive until the job's counter drops to zero.
+    using job_function = void(*)(void* data);
+
+    struct job_decl
+    {
+        job_function    function{ nullptr };
+        void*           data{ nullptr };
+    };
+
+    // Counts the jobs that are still in flight. A counter acts as a fence:
+    // wait() on it returns once every job that was submitted with it has finished.
+    class counter
+    {
+    public:
+        counter() = default;
+        DISABLE_COPY_AND_MOVE(counter);
+
+        [[nodiscard]] bool is_done() const { return _value.load(std::memory_order_acquire) == 0; }
+        [[nodiscard]] u32 value() const { return _value.load(std::memory_order_acquire); }
+
+    private:
+        friend struct counter_access;
+        std::atomic<u32>    _value{ 0 };
+    };
+
+    constexpr u32 invalid_worker_index{ u32_invalid_id };
+    constexpr u32 max_workers{ 64 };
+
+    // Starts worker_count - 1 threads. The calling thread becomes worker 0 and executes
+    // jobs whenever it waits on a counter. A worker_count of 0 uses all hardware threads.
+    bool initialize(u32 worker_count = 0);
+    void shutdown();
+
+    // Number of workers including the main thread. Returns 0 if the job system isn't initialized.
+    [[nodiscard]] u32 worker_count();
+    // Index of the worker that runs the calling thread, or invalid_worker_index for threads
+    // that don't belong to the job system.
+    [[nodiscard]] u32 current_worker_index();
+
+    // Queues the jobs and increments the counter by count (if provided). Jobs are executed
+    // immediately on the calling thread if the job system isn't running.
+    void run(const job_decl* const jobs, u32 count, counter* const c = nullptr);
+    void run(job_decl job, counter* const c = nullptr);
+    // Executes pending jobs on the calling thread until the counter reaches zero.
+    void wait(const counter* const c);
+
+    namespace detail {
+        template<typename Fn>
+        struct parallel_for_context
+        {
+            Fn*                 fn;
+            u32                 count;
+            u32                 batch_size;
+            u32                 batch_count;
+            std::atomic<u32>    next_batch;
+
+            static void execute(void* data)
+            {
+                parallel_for_context& ctx{ *(parallel_for_context*)data };
+                u32 batch{ ctx.next_batch.fetch_add(1, std::memory_order_relaxed) };
+                while (batch < ctx.batch_count)
+                {
+                    const u32 begin{ batch * ctx.batch_size };
+                    const u32 end{ std::min(begin + ctx.batch_size, ctx.count) };
+                    (*ctx.fn)(begin, end);
+                    batch = ctx.next_batch.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        };
+    } // detail namespace
+
+    // Calls fn(begin, end) for consecutive ranges of at most batch_size indices in [0, count)
+    // and returns when all ranges have been processed. The calling thread takes part in the work.
+    // NOTE: the ranges are handed out dynamically, so workers that finish early pick up more batches.
+    template<typename Fn>
+    void parallel_for(u32 count, u32 batch_size, Fn&& fn)
+    {
+        if (!count) return;
+        batch_size = std::max(batch_size, 1u);
+        const u32 batch_count{ (count + batch_size - 1) / batch_size };
+        const u32 workers{ worker_count() };
+        if (batch_count == 1 || workers < 2)
+        {
+            fn(0, count);
+            return;
+        }
+
+        using context = detail::parallel_for_context<std::remove_reference_t<Fn>>;
+        context ctx{ &fn, count, batch_size, batch_count };
+        ctx.next_batch = 0;
+
+        // NOTE: the caller runs one share of the work itself, so we only need helpers for the rest.
+        constexpr u32 max_helpers{ 63 };
+        const u32 helper_count{ std::min(std::min(workers, batch_count) - 1, max_helpers) };
+        job_decl helpers[max_helpers];
+        for (u32 i{ 0 }; i < helper_count; ++i)
+        {
+            helpers[i] = { &context::execute, &ctx };
+        }
+
+        counter c{};
+        run(&helpers[0], helper_count, &c);
+        context::execute(&ctx);
+        wait(&c);
+    }
+}
@@ -31,6 +31,29 @@ namespace Quantum {
     } // namespace game_entity
 
     namespace script {
+        // Bit masks of the resources a script type reads or writes in update(). What the bits mean
+        // is up to the game. Script types whose masks don't conflict are updated in parallel.
+        // NOTE: transform changes made with set_position() etc. are buffered while script types are
+        //       updated in parallel, so they don't have to be declared as writes. They're applied in update
+        //       order, before the script types that run after them (in a later group or batch) are updated.
+        struct access {
+            enum mask : u64 {
+                none = 0,
+                all = ~0ull,
+            };
+        };
+
+        // Script types can declare 'static constexpr script::update_schedule schedule{ ... };'
+        // Groups are updated one after another in ascending order. By default a script type
+        // may touch anything, so it's updated on its own, one script after another.
+        // Scripts of a type that doesn't write anything are also spread over all workers.
+        struct update_schedule
+        {
+            u32 group{ 0 };
+            u64 reads{ access::all };
+            u64 writes{ access::all };
+        };
+
         class entity_script : public game_entity::entity {
         public:
             virtual ~entity_script() = default;
@@ -51,7 +74,20 @@ namespace Quantum {
         };
 
         namespace detail {
-            using script_ptr = std::unique_ptr<entity_script>;
+            // Describes a script class. There's one instance per class and it also identifies the class.
+            struct script_type_info
+            {
+                void(*release)(entity_script* script);
+                update_schedule schedule;
+            };
+
+            struct script_deleter
+            {
+                const script_type_info* type{ nullptr };
+                void operator()(entity_script* script) const { type->release(script); }
+            };
+
+            using script_ptr = std::unique_ptr<entity_script, script_deleter>;
             using script_creator = script_ptr(*)(game_entity::entity entity);
             using string_hash = std::hash<std::string>;
 
@@ -62,11 +98,96 @@ namespace Quantum {
 #endif // USE_WITH_EDITOR
             script_creator get_script_creator_internal(size_t tag);
 
+            // Allocates scripts of one class from 16 KB blocks, so that scripts of the same class
+            // are next to each other in memory. Freed slots are reused first.
+            // NOTE: the blocks are freed when the last script of the class is released. The pool itself
+            //       is trivially destructible, so scripts can still be released during static destruction.
+            template<class script_class>
+            class script_pool
+            {
+            public:
+                static script_class* allocate(game_entity::entity entity)
+                {
+                    slot* s{ _pool.free_slots };
+                    if (s)
+                    {
+                        _pool.free_slots = s->next;
+                    }
+                    else
+                    {
+                        if (!_pool.blocks || _pool.used_slots == slots_per_block)
+                        {
+                            block* const new_block{ new block{} };
+                            new_block->next = _pool.blocks;
+                            _pool.blocks = new_block;
+                            _pool.used_slots = 0;
+                        }
+                        s = &_pool.blocks->slots[_pool.used_slots++];
+                    }
+
+                    ++_pool.script_count;
+                    return new (s->storage) script_class{ entity };
+                }
+
+                static void release(entity_script* script)
+                {
+                    assert(script && _pool.script_count);
+                    script->~entity_script();
+                    slot* const s{ (slot*)script };
+                    s->next = _pool.free_slots;
+                    _pool.free_slots = s;
+
+                    if (!--_pool.script_count)
+                    {
+                        while (_pool.blocks)
+                        {
+                            block* const next{ _pool.blocks->next };
+                            delete _pool.blocks;
+                            _pool.blocks = next;
+                        }
+                        _pool = {};
+                    }
+                }
+
+            private:
+                union slot
+                {
+                    slot* next;
+                    alignas(script_class) u8 storage[sizeof(script_class)];
+                };
+
+                static constexpr u32 slots_per_block{ std::max((16 * 1024 - (u32)sizeof(void*)) / (u32)sizeof(slot), 1u) };
+
+                struct block
+                {
+                    block*  next;
+                    slot    slots[slots_per_block];
+                };
+
+                struct pool
+                {
+                    block*  blocks{ nullptr };
+                    slot*   free_slots{ nullptr };
+                    u32     used_slots{ 0 };
+                    u32     script_count{ 0 };
+                };
+
+                static inline pool _pool{};
+            };
+
+            template<class script_class>
+            constexpr update_schedule get_schedule()
+            {
+                if constexpr (requires { script_class::schedule; }) return script_class::schedule;
+                else return update_schedule{};
+            }
+
             template<class script_class>
             script_ptr create_script(game_entity::entity entity)
             {
                 assert(entity.is_valid());
-                return std::make_unique<script_class>(entity);
+                static const script_type_info type{ &script_pool<script_class>::release, get_schedule<script_class>() };
+                return script_ptr{ script_pool<script_class>::allocate(entity), script_deleter{ &type } };
             }
 #ifdef USE_WITH_EDITOR
             u8 add_script_name(const char* name);
@@ -0,0 +1,130 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "Culling.h"
+
+namespace Quantum::graphics {
+    namespace {
+
+        // visible flags of 4 spheres as 4 bytes, indexed by the 4 bit visibility mask.
+        constexpr u32 mask_to_flags[16]{
+            0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+            0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101,
+        };
+
+        // number of visible spheres, indexed by the same mask. This way we don't need POPCNT, which isn't part of SSE2.
+        constexpr u8 mask_to_count[16]{ 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+        math::v4 normalize_plane(f32 x, f32 y, f32 z, f32 w)
+        {
+            const f32 inv_length{ 1.f / sqrtf(x * x + y * y + z * z) };
+            return { x * inv_length, y * inv_length, z * inv_length, w * inv_length };
+        }
+
+        constexpr bool is_outside(const frustum& view_frustum, const math::v4& sphere)
+        {
+            for (u32 i{ 0 }; i < frustum::plane_count; ++i)
+            {
+                const math::v4& p{ view_frustum.planes[i] };
+                // NOTE: same order of operations as in cull_spheres(), so that both give the same results.
+                if (((p.x * sphere.x + p.w) + p.y * sphere.y) + p.z * sphere.z < -sphere.w) return true;
+            }
+
+            return false;
+        }
+
+    } // anonymous namespace
+
+    frustum
+    make_frustum(const math::m4x4& view_projection)
+    {
+        // With row vectors, clip space coordinates are dot products with the columns of the matrix. So,
+        // -w <= x is dot(p, column 3 + column 0) >= 0 and so on.
+        const math::m4x4& m{ view_projection };
+        frustum f{};
+        f.planes[0] = normalize_plane(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);    // left
+        f.planes[1] = normalize_plane(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);    // right
+        f.planes[2] = normalize_plane(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);    // bottom
+        f.planes[3] = normalize_plane(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);    // top
+        f.planes[4] = normalize_plane(m._13, m._23, m._33, m._43);                                      // z >= 0
+        f.planes[5] = normalize_plane(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);    // z <= w
+        return f;
+    }
+
+    math::v4
+    transform_bounding_sphere(const math::m4x4& world, math::v4 sphere)
+    {
+        using namespace DirectX;
+        const XMMATRIX m{ XMLoadFloat4x4(&world) };
+        const XMVECTOR center{ XMVector3Transform(XMVectorSet(sphere.x, sphere.y, sphere.z, 1.f), m) };
+        const XMVECTOR scale_sq{ XMVectorMax(XMVectorMax(XMVector3LengthSq(m.r[0]), XMVector3LengthSq(m.r[1])), XMVector3LengthSq(m.r[2])) };
+
+        math::v4 result;
+        XMStoreFloat4(&result, XMVectorSetW(center, sphere.w * sqrtf(XMVectorGetX(scale_sq))));
+        return result;
+    }
+
+    math::v4
+    merge_bounding_spheres(math::v4 a, math::v4 b)
+    {
+        const math::v3 ab{ b.x - a.x, b.y - a.y, b.z - a.z };
+        const f32 distance{ sqrtf(ab.x * ab.x + ab.y * ab.y + ab.z * ab.z) };
+        if (distance + b.w <= a.w) return a;
+        if (distance + a.w <= b.w) return b;
+
+        // The new sphere touches the far sides of both spheres, along the line between their centers.
+        const f32 radius{ (distance + a.w + b.w) * 0.5f };
+        const f32 t{ (radius - a.w) / distance };
+        return { a.x + ab.x * t, a.y + ab.y * t, a.z + ab.z * t, radius };
+    }
+
+    u32
+    cull_spheres(const frustum& view_frustum, const math::v4* const spheres, u32 count, u8* const visible)
+    {
+        assert(spheres && visible);
+        constexpr u32 plane_count{ frustum::plane_count };
+        __m128 plane_x[plane_count], plane_y[plane_count], plane_z[plane_count], plane_w[plane_count];
+        for (u32 i{ 0 }; i < plane_count; ++i)
+        {
+            const math::v4& p{ view_frustum.planes[i] };
+            plane_x[i] = _mm_set1_ps(p.x);
+            plane_y[i] = _mm_set1_ps(p.y);
+            plane_z[i] = _mm_set1_ps(p.z);
+            plane_w[i] = _mm_set1_ps(p.w);
+        }
+
+        u32 visible_count{ 0 };
+        u32 i{ 0 };
+        for (; i + 4 <= count; i += 4)
+        {
+            // Transpose 4 spheres, so that each lane tests a different sphere against the same plane.
+            __m128 x{ _mm_loadu_ps(&spheres[i].x) };
+            __m128 y{ _mm_loadu_ps(&spheres[i + 1].x) };
+            __m128 z{ _mm_loadu_ps(&spheres[i + 2].x) };
+            __m128 r{ _mm_loadu_ps(&spheres[i + 3].x) };
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+
+            const __m128 neg_r{ _mm_sub_ps(_mm_setzero_ps(), r) };
+            __m128 outside{ _mm_setzero_ps() };
+            for (u32 j{ 0 }; j < plane_count; ++j)
+            {
+                __m128 d{ _mm_add_ps(_mm_mul_ps(plane_x[j], x), plane_w[j]) };
+                d = _mm_add_ps(d, _mm_mul_ps(plane_y[j], y));
+                d = _mm_add_ps(d, _mm_mul_ps(plane_z[j], z));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_r));
+            }
+
+            const u32 mask{ ~(u32)_mm_movemask_ps(outside) & 0xf };
+            memcpy(&visible[i], &mask_to_flags[mask], sizeof(u32));
+            visible_count += mask_to_count[mask];
+        }
+
+        for (; i < count; ++i)
+        {
+            visible[i] = is_outside(view_frustum, spheres[i]) ? 0 : 1;
+            visible_count += visible[i];
+        }
+
+        return visible_count;
+    }
+}
@@ -0,0 +1,36 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+
+// View frustum culling of bounding spheres on the CPU. Nothing in here depends on a graphics API, so it can be
+// used (and tested) without a renderer. Bounding spheres are math::v4s with the center in xyz and the radius in w.
+namespace Quantum::graphics {
+
+    // Planes are (normal, distance) with the normals pointing into the frustum and normalized, so that
+    // dot(normal, p) + distance is the signed distance of p to the plane and is positive inside the frustum.
+    struct frustum
+    {
+        static constexpr u32    plane_count{ 6 };
+        math::v4                planes[plane_count];
+    };
+
+    // Extracts the frustum planes from a view-projection matrix in DirectXMath's (row vector) convention with
+    // D3D's clip space depth range of [0, w]. The planes are in the space that the matrix transforms from,
+    // which is world space for a camera's view-projection. Works with reversed depth.
+    [[nodiscard]] frustum make_frustum(const math::m4x4& view_projection);
+
+    // Transforms an object space bounding sphere with a world matrix. The radius is scaled by the largest
+    // scale of the matrix, so the sphere still contains the object if the scale isn't uniform.
+    [[nodiscard]] math::v4 transform_bounding_sphere(const math::m4x4& world, math::v4 sphere);
+
+    // Returns the smallest sphere that contains both spheres.
+    [[nodiscard]] math::v4 merge_bounding_spheres(math::v4 a, math::v4 b);
+
+    // Sets visible[i] to 1 if spheres[i] intersects the frustum and to 0 if it's completely outside.
+    // Returns the number of visible spheres. Tests 4 spheres at a time with SSE.
+    // NOTE: spheres that are outside near a corner of the frustum may be reported as visible, since each plane
+    //       is tested on its own.
+    u32 cull_spheres(const frustum& view_frustum, const math::v4* const spheres, u32 count, u8* const visible);
+}
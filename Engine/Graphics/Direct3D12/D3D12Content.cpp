@@ -4,7 +4,13 @@
 #include "D3D12Core.h"
 #include "Utilities/IOStream.h"
 #include "Content/ContentToEngine.h"
+#include "Content/MeshDecoder.h"
 #include "D3D12GPass.h"
+#include "D3D12Camera.h"
+#include "Components/Entity.h"
+#include "Components/Transform.h"
+#include "Graphics/Culling.h"
+#include "Graphics/LodSelection.h"
 
 namespace Quantum::graphics::d3d12::content {
 
@@ -22,6 +28,11 @@ namespace Quantum::graphics::d3d12::content {
             D3D12_INDEX_BUFFER_VIEW                         index_buffer_view{};
             D3D_PRIMITIVE_TOPOLOGY                          primitive_topology;
             u32                                             element_type{};
+            D3D12_GPU_VIRTUAL_ADDRESS                       meshlet_buffer{};
+            u32                                             meshlet_count{};
+            math::v3                                        position_offset{};
+            math::v3                                        position_scale{ 1.f, 1.f, 1.f };
+            math::v4                                        bounding_sphere{};  // decoded object space, center in xyz and radius in w.
         };
 
         struct d3d12_render_item {
@@ -31,9 +42,17 @@ namespace Quantum::graphics::d3d12::content {
             id::id_type     pso_id;
             id::id_type     depth_pso_id;
         };
+
+        // Used to pick LODs of render items when the application doesn't provide thresholds.
+        struct render_item_lod {
+            math::v4        bounding_sphere;    // of all submeshes, in object space.
+            u32             lod;                // LOD that was used last time.
+        };
             
-        util::free_list<ID3D12Resource*>                    submesh_buffers{};
-        util::free_list<submesh_view>                       submesh_views{};
+        id::allocator<>                                     submesh_ids{};
+        util::vector<ID3D12Resource*>                       submesh_buffers{};
+        util::vector<ID3D12Resource*>                       submesh_meshlet_buffers{};
+        util::vector<submesh_view>                          submesh_views{};
         std::mutex                                          submesh_mutex{};
 
         util::free_list<d3d12_texture>                      textures;
@@ -41,22 +60,21 @@ namespace Quantum::graphics::d3d12::content {
 
         util::vector<ID3D12RootSignature*>		            root_signatures;
         std::unordered_map<u64, id::id_type>                mtl_rs_map; // maps a material's type and shader flags to an index in the array of root signatures.
-        util::free_list<std::unique_ptr<u8[]>>              materials;
+        using material_buffer_ptr = util::unique_buffer<util::memory_tag::materials>;
+        using render_item_ids_ptr = util::unique_buffer<util::memory_tag::render_items, id::id_type>;
+
+        util::free_list<material_buffer_ptr>                materials;
         std::mutex                                          material_mutex{};
 
         util::free_list<d3d12_render_item>                  render_items;
-        util::free_list<std::unique_ptr<id::id_type[]>>     render_item_ids;
+        util::free_list<render_item_ids_ptr>                render_item_ids;
+        util::vector<render_item_lod>                       render_item_lods;   // indexed by render item ids.
         std::mutex                                          render_item_mutex{};
 
         util::vector<ID3D12PipelineState*>                  pipeline_states;
         std::unordered_map<u64, id::id_type>                pso_map;
         std::mutex                                          pso_mutex{};
 
-        struct {
-            util::vector<Quantum::content::lod_offset>      lod_offsets;
-            util::vector<id::id_type>                       geometry_ids;
-        } frame_cache;
-
         id::id_type create_root_signature(material_type::type type, shader_flags::flags flags);
 
         class d3d12_material_stream {
@@ -67,7 +85,7 @@ namespace Quantum::graphics::d3d12::content {
                 initialize();
             }
 
-            explicit d3d12_material_stream(std::unique_ptr<u8[]>& material_buffer, material_init_info info)
+            explicit d3d12_material_stream(material_buffer_ptr& material_buffer, material_init_info info)
             {
                 assert(!material_buffer);
 
@@ -78,7 +96,7 @@ namespace Quantum::graphics::d3d12::content {
                     if (id::is_valid(info.shader_ids[i]))
                     {
                         ++shader_count;
-                        flags != (1 << i);
+                        flags |= (1 << i);
                     }
                 }
 
@@ -93,7 +111,7 @@ namespace Quantum::graphics::d3d12::content {
                     (sizeof(id::id_type) + sizeof(u32)) * info.texture_count    // texture ids and descriptor indices (maybe 0 if no textures used).
                 };
 
-                material_buffer = std::make_unique<u8[]>(buffer_size);
+                material_buffer = util::make_unique_buffer<util::memory_tag::materials>(buffer_size);
                 _buffer = material_buffer.get();
                 u8* const buffer{ _buffer };
 
@@ -307,6 +325,44 @@ namespace Quantum::graphics::d3d12::content {
             }
         }
 
+        // Center of the bounding box of the positions and the distance to the position that's farthest from it.
+        // Quantized positions are decoded the same way the vertex shader does: position * scale + offset.
+        math::v4 calculate_bounding_sphere(const u8* const positions, u32 vertex_count, u32 position_size,
+                                           bool quantized, math::v3 offset, math::v3 scale)
+        {
+            using namespace DirectX;
+            if (!vertex_count) return {};
+
+            const XMVECTOR decode_scale{ XMLoadFloat3(&scale) };
+            const XMVECTOR decode_offset{ XMLoadFloat3(&offset) };
+            auto get_position = [&](u32 i) {
+                const u8* const p{ &positions[i * position_size] };
+                if (!quantized) return XMLoadFloat3((const math::v3*)p);
+                const u16* const q{ (const u16*)p };
+                return XMVectorMultiplyAdd(XMVectorSet(q[0], q[1], q[2], 0.f), decode_scale, decode_offset);
+            };
+
+            XMVECTOR min{ get_position(0) };
+            XMVECTOR max{ min };
+            for (u32 i{ 1 }; i < vertex_count; ++i)
+            {
+                const XMVECTOR p{ get_position(i) };
+                min = XMVectorMin(min, p);
+                max = XMVectorMax(max, p);
+            }
+
+            const XMVECTOR center{ XMVectorScale(XMVectorAdd(min, max), 0.5f) };
+            XMVECTOR radius_sq{ XMVectorZero() };
+            for (u32 i{ 0 }; i < vertex_count; ++i)
+            {
+                radius_sq = XMVectorMax(radius_sq, XMVector3LengthSq(XMVectorSubtract(get_position(i), center)));
+            }
+
+            math::v4 sphere;
+            XMStoreFloat4(&sphere, XMVectorSetW(center, sqrtf(XMVectorGetX(radius_sq))));
+            return sphere;
+        }
+
 #pragma intrinsic(_BitScanForward)
         shader_type::type get_shader_type(u32 flag)
         {
@@ -410,13 +466,24 @@ namespace Quantum::graphics::d3d12::content {
         // NOTE: Expects 'data' to contain:
         // 
         //       u32 elemet_size, u32 vertex_count,
-        //       u32 index_count, u32 element_type, u32 primitive_topology
-        //       u8 positions[sizeof(f32) * 3 * vertex_count], // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
+        //       u32 index_count, u32 element_type,
+        //       u32 primitive_topology, // the upper 16 bits are submesh_flags
+        //       // only if submesh_flags::quantized_positions is set:
+        //       f32 position_offset[3], f32 position_scale[3],
+        //       // if submesh_flags::compressed is set, the buffers are encoded as described in MeshDecoder.h:
+        //       u32 compressed_size, u8 compressed_buffers[compressed_size],
+        //       // otherwise:
+        //       u8 positions[position_size * vertex_count], // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
         //       u8 element[sizeof(element_size) * vertex_count], // sizeof(elements) must be a multiple of 4 bytes. Pad if needed.
         //       u8 indices[index_size * index_count],
+        //       // only if submesh_flags::has_meshlets is set:
+        //       u32 meshlet_count,
+        //       meshlet meshlets[meshlet_count],
         //
         // Remarks:
         // - Advances the data pointer
+        // - Positions are 3 floats, or 4 u16 if they're quantized. Quantized positions are decoded as
+        //   position_offset + position * position_scale. The decoding is folded into the world matrices of the submesh.
         // - Position and element buffers should be padded to be a multiple of 16 bytes in length.
         //   This 16 bytes is defined as D3D12_STANDART_MAXIMUM_ELEMENT_ALIGNMENT_BYTE_MULTIPLE.
         id::id_type add(const u8*& data)
@@ -425,30 +492,86 @@ namespace Quantum::graphics::d3d12::content {
 
             const u32 element_size{ blob.read<u32>() };
             const u32 vertex_count{ blob.read<u32>() };
-            const u32 elements_type{ blob.read<u32>() };
-            const u32 primitive_topology{ blob.read<u32>() };
             const u32 index_count{ blob.read<u32>() };
+            const u32 elements_type{ blob.read<u32>() };
+            const u32 topology_and_flags{ blob.read<u32>() };
+            const u32 primitive_topology{ topology_and_flags & 0xffff };
+            const u32 flags{ topology_and_flags >> 16 };
             const u32 index_size{ (vertex_count < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
 
+            math::v3 position_offset{};
+            math::v3 position_scale{ 1.f, 1.f, 1.f };
+            const bool quantized_positions{ (flags & Quantum::content::submesh_flags::quantized_positions) != 0 };
+            if (quantized_positions)
+            {
+                blob.read((u8*)&position_offset, sizeof(math::v3));
+                blob.read((u8*)&position_scale, sizeof(math::v3));
+            }
+
             // NOTE: element size may be 0, for position-only vertex formats.
-            const u32 position_buffer_size{ sizeof(math::v3) * vertex_count };
+            const u32 position_size{ quantized_positions ? (u32)sizeof(u16) * 4 : (u32)sizeof(math::v3) };
+            const u32 position_buffer_size{ position_size * vertex_count };
             const u32 element_buffer_size{ element_size * vertex_count };
             const u32 index_buffer_size{ index_size * index_count };
 
-            constexpr u32 alignment{ D3D12_STANDARD_MAXIMUM_ELEMENT_ALIGNMENT_BYTE_MULTIPLE };
+            // NOTE: the blob has the padded layout that we upload, so the alignment must match the one the editor packs with.
+            constexpr u32 alignment{ Quantum::content::submesh_buffer_alignment };
+            static_assert(alignment % D3D12_STANDARD_MAXIMUM_ELEMENT_ALIGNMENT_BYTE_MULTIPLE == 0);
             const u32 aligned_position_buffer_size{ (u32)math::align_size_up<alignment>(position_buffer_size) };
-            const u32 aligned_element_buffer_size{ (u32)math::align_size_up<alignment>(position_buffer_size) };
+            const u32 aligned_element_buffer_size{ (u32)math::align_size_up<alignment>(element_buffer_size) };
             const u32 total_buffer_size{ aligned_position_buffer_size + aligned_element_buffer_size + index_buffer_size };
 
-            ID3D12Resource* resource{ d3dx::create_buffer(blob.position(), total_buffer_size) };
+            ID3D12Resource* resource{ nullptr };
+            math::v4 bounding_sphere{};
+            if (flags & Quantum::content::submesh_flags::compressed)
+            {
+                // Decode into the same layout that uncompressed submeshes have in the blob.
+                const u32 compressed_size{ blob.read<u32>() };
+                const u8* const compressed{ blob.position() };
+                util::unique_buffer<util::memory_tag::geometry> buffer{ util::make_unique_buffer<util::memory_tag::geometry>(total_buffer_size) };
+                memset(buffer.get(), 0, total_buffer_size);
+
+                u64 offset{ Quantum::content::decode_vertex_buffer(buffer.get(), vertex_count, position_size, compressed, compressed_size) };
+                if (element_size)
+                {
+                    offset += Quantum::content::decode_vertex_buffer(&buffer[aligned_position_buffer_size], vertex_count, element_size,
+                                                                     compressed + offset, compressed_size - offset);
+                }
+                offset += Quantum::content::decode_index_buffer(&buffer[aligned_position_buffer_size + aligned_element_buffer_size], index_count, index_size,
+                                                                compressed + offset, compressed_size - offset);
+                assert(offset == compressed_size);
+
+                resource = d3dx::create_buffer(buffer.get(), total_buffer_size);
+                bounding_sphere = calculate_bounding_sphere(buffer.get(), vertex_count, position_size, quantized_positions, position_offset, position_scale);
+                blob.skip(compressed_size);
+            }
+            else
+            {
+                resource = d3dx::create_buffer(blob.position(), total_buffer_size);
+                bounding_sphere = calculate_bounding_sphere(blob.position(), vertex_count, position_size, quantized_positions, position_offset, position_scale);
+                blob.skip(total_buffer_size);
+            }
+
+            ID3D12Resource* meshlet_resource{ nullptr };
+            u32 meshlet_count{ 0 };
+            if (flags & Quantum::content::submesh_flags::has_meshlets)
+            {
+                meshlet_count = blob.read<u32>();
+                assert(meshlet_count);
+                const u32 meshlet_buffer_size{ (u32)sizeof(Quantum::content::meshlet) * meshlet_count };
+                meshlet_resource = d3dx::create_buffer(blob.position(), meshlet_buffer_size);
+                blob.skip(meshlet_buffer_size);
+            }
 
-            blob.skip(total_buffer_size);
             data = blob.position();
 
             submesh_view view{};
             view.position_buffer_view.BufferLocation = resource->GetGPUVirtualAddress();
             view.position_buffer_view.SizeInBytes = position_buffer_size;
-            view.position_buffer_view.StrideInBytes = sizeof(math::v3);
+            view.position_buffer_view.StrideInBytes = position_size;
+            view.position_offset = position_offset;
+            view.position_scale = position_scale;
+            view.bounding_sphere = bounding_sphere;
 
             if (element_size)
             {
@@ -464,35 +587,71 @@ namespace Quantum::graphics::d3d12::content {
             view.element_type = elements_type;
             view.primitive_topology = get_d3d_primitive_topology((primitive_topology::type)primitive_topology);
 
+            if (meshlet_resource)
+            {
+                view.meshlet_buffer = meshlet_resource->GetGPUVirtualAddress();
+                view.meshlet_count = meshlet_count;
+            }
+
             std::lock_guard lock{ submesh_mutex };
-            submesh_buffers.add(resource);
-            return submesh_views.add(view);
+            const id::id_type id{ submesh_ids.allocate() };
+            const id::id_type index{ submesh_ids.index(id) };
+            if (index >= submesh_views.size())
+            {
+                assert(index == submesh_views.size());
+                submesh_buffers.emplace_back();
+                submesh_meshlet_buffers.emplace_back();
+                submesh_views.emplace_back();
+            }
+
+            submesh_buffers[index] = resource;
+            submesh_meshlet_buffers[index] = meshlet_resource;
+            submesh_views[index] = view;
+            return id;
         }
 
         void remove(id::id_type id)
         {
             std::lock_guard lock{ submesh_mutex };
-            submesh_views.remove(id);
-
-            core::deferred_release(submesh_buffers[id]);
-            submesh_buffers.remove(id);
+            assert(submesh_ids.is_alive(id));
+            const id::id_type index{ submesh_ids.index(id) };
+            core::deferred_release(submesh_buffers[index]);
+            core::deferred_release(submesh_meshlet_buffers[index]);
+            submesh_views[index] = {};
+            submesh_ids.release(id);
         }
 
         void get_views(const id::id_type* const gpu_ids, u32 id_count, const views_cache& cache)
         {
             assert(gpu_ids && id_count);
             assert(cache.position_buffers && cache.element_buffers && cache.index_buffer_views &&
-                   cache.primitive_topologies && cache.element_types);
+                   cache.primitive_topologies && cache.element_types && cache.position_offsets && cache.position_scales);
 
             std::lock_guard lock{ submesh_mutex };
             for (u32 i{ 0 }; i < id_count; ++i)
             {
-                const submesh_view& view{ submesh_views[gpu_ids[i]] };
+                assert(submesh_ids.is_alive(gpu_ids[i]));
+                const submesh_view& view{ submesh_views[submesh_ids.index(gpu_ids[i])] };
                 cache.position_buffers[i] = view.position_buffer_view.BufferLocation;
                 cache.element_buffers[i] = view.element_buffer_view.BufferLocation;
                 cache.index_buffer_views[i] = view.index_buffer_view;
                 cache.primitive_topologies[i] = view.primitive_topology;
                 cache.element_types[i] = view.element_type;
+                cache.position_offsets[i] = view.position_offset;
+                cache.position_scales[i] = view.position_scale;
+            }
+        }
+
+        void get_meshlet_views(const id::id_type* const gpu_ids, u32 id_count, D3D12_GPU_VIRTUAL_ADDRESS* const meshlet_buffers, u32* const meshlet_counts)
+        {
+            assert(gpu_ids && id_count && meshlet_buffers && meshlet_counts);
+            std::lock_guard lock{ submesh_mutex };
+            for (u32 i{ 0 }; i < id_count; ++i)
+            {
+                assert(submesh_ids.is_alive(gpu_ids[i]));
+                const submesh_view& view{ submesh_views[submesh_ids.index(gpu_ids[i])] };
+                meshlet_buffers[i] = view.meshlet_buffer;
+                meshlet_counts[i] = view.meshlet_count;
             }
         }
     } // namespace submesh
@@ -522,7 +681,7 @@ namespace Quantum::graphics::d3d12::content {
         // } d3d12_material
         id::id_type add(material_init_info info)
         {
-            std::unique_ptr<u8[]> buffer;
+            material_buffer_ptr buffer;
             std::lock_guard lock{ material_mutex };
             d3d12_material_stream stream{ buffer, info };
             assert(buffer);
@@ -538,13 +697,14 @@ namespace Quantum::graphics::d3d12::content {
         void get_materials(const id::id_type* const material_ids, u32 material_count, const material_cache& cache)
         {
             assert(material_ids && material_count);
-            assert(cache.root_signature && cache.material_types);
+            assert(cache.root_signature && cache.root_signature_ids && cache.material_types);
             std::lock_guard lock{ material_mutex };
 
             for (u32 i{ 0 }; i < material_count; ++i)
             {
                 const d3d12_material_stream stream{ materials[material_ids[i]].get() };
                 cache.root_signature[i] = root_signatures[stream.root_signature_id()];
+                cache.root_signature_ids[i] = stream.root_signature_id();
                 cache.material_types[i] = stream.material_type();
             }
         }
@@ -570,13 +730,25 @@ namespace Quantum::graphics::d3d12::content {
                 (D3D12_GPU_VIRTUAL_ADDRESS* const)alloca(material_count * sizeof(D3D12_GPU_VIRTUAL_ADDRESS)),
                 (D3D12_INDEX_BUFFER_VIEW* const)alloca(material_count * sizeof(D3D12_INDEX_BUFFER_VIEW)),
                 (D3D_PRIMITIVE_TOPOLOGY* const)alloca(material_count * sizeof(D3D_PRIMITIVE_TOPOLOGY)),
-                (u32* const)alloca(material_count * sizeof(u32))
+                (u32* const)alloca(material_count * sizeof(u32)),
+                (math::v3* const)alloca(material_count * sizeof(math::v3)),
+                (math::v3* const)alloca(material_count * sizeof(math::v3))
             };
 
             submesh::get_views(gpu_ids, material_count, views_cache);
 
+            math::v4 bounding_sphere{};
+            {
+                std::lock_guard lock{ submesh_mutex };
+                bounding_sphere = submesh_views[submesh_ids.index(gpu_ids[0])].bounding_sphere;
+                for (u32 i{ 1 }; i < material_count; ++i)
+                {
+                    bounding_sphere = merge_bounding_spheres(bounding_sphere, submesh_views[submesh_ids.index(gpu_ids[i])].bounding_sphere);
+                }
+            }
+
             // NOTE: the list of ids starts with geometry id and ends with an invalid id to mark the end of the list.
-            std::unique_ptr<id::id_type[]> items{ std::make_unique<id::id_type[]>(sizeof(id::id_type) * (1 + (u64)material_count + 1)) };
+            render_item_ids_ptr items{ util::make_unique_buffer<util::memory_tag::render_items, id::id_type>(1 + (u64)material_count + 1) };
 
             items[0] = geometry_content_id;
             id::id_type* const item_ids{ &items[1] };
@@ -600,7 +772,10 @@ namespace Quantum::graphics::d3d12::content {
             // mark the end of ids list.
             item_ids[material_count] = id::invalid_id;
 
-            return render_item_ids.add(std::move(items));
+            const id::id_type id{ render_item_ids.add(std::move(items)) };
+            if (id >= render_item_lods.size()) render_item_lods.resize(id + 1);
+            render_item_lods[id] = { bounding_sphere, 0 };
+            return id;
 
         }
 
@@ -618,30 +793,71 @@ namespace Quantum::graphics::d3d12::content {
             render_item_ids.remove(id);
         }
 
-        void get_d3d12_render_item_ids(const frame_info& info, util::vector<id::id_type>& d3d12_render_item_ids)
+        void get_d3d12_render_item_ids(const d3d12_frame_info& d3d12_info, core::transient_vector<id::id_type>& d3d12_render_item_ids)
         {
-            assert(info.render_item_ids && info.thresholds && info.render_item_count);
+            assert(d3d12_info.info && d3d12_info.camera);
+            const frame_info& info{ *d3d12_info.info };
+            assert(info.render_item_ids && info.render_item_count);
             assert(d3d12_render_item_ids.empty());
 
-            frame_cache.lod_offsets.clear();
-            frame_cache.geometry_ids.clear();
             const u32 count{ info.render_item_count };
+            core::transient_vector<id::id_type> geometry_ids(count);
+            core::transient_vector<Quantum::content::lod_offset> lod_offsets(count);
 
             std::lock_guard lock{ render_item_mutex };
 
             for (u32 i{ 0 }; i < count; ++i)
             {
                 const id::id_type* const buffer{ render_item_ids[info.render_item_ids[i]].get() };
-                frame_cache.geometry_ids.emplace_back(buffer[0]);
+                geometry_ids[i] = buffer[0];
+            }
+
+            if (info.thresholds)
+            {
+                Quantum::content::get_lod_offset(geometry_ids.data(), info.thresholds, count, lod_offsets.data());
             }
+            else
+            {
+                core::transient_vector<math::v4> spheres(count);
+                core::transient_vector<f32> scales(count);
+                core::transient_vector<f32> distances(count);
+                core::transient_vector<u32> lods(count);
+
+                for (u32 i{ 0 }; i < count; ++i)
+                {
+                    const id::id_type item_id{ info.render_item_ids[i] };
+                    const render_item_lod& item_lod{ render_item_lods[item_id] };
+                    const id::id_type entity_id{ render_items[render_item_ids[item_id][1]].entity_id };
+                    math::m4x4 world, inverse_world;
+                    transform::get_transform_matrics(game_entity::entity_id{ entity_id }, world, inverse_world);
+                    spheres[i] = transform_bounding_sphere(world, item_lod.bounding_sphere);
+                    scales[i] = item_lod.bounding_sphere.w > 0.f ? spheres[i].w / item_lod.bounding_sphere.w : 1.f;
+                    lods[i] = item_lod.lod;
+                }
+
+                // NOTE: we check the projection matrix instead of the camera type, since only perspective
+                //       projections have 0 in _44. Then _22 is 1 / tan(fov / 2).
+                using namespace DirectX;
+                const camera::d3d12_camera& camera{ *d3d12_info.camera };
+                const XMMATRIX projection{ camera.projection() };
+                const bool is_perspective{ XMVectorGetW(projection.r[3]) == 0.f };
+                const f32 projection_scale{ is_perspective ? XMVectorGetY(projection.r[1]) * (f32)d3d12_info.surface_height * 0.5f : 0.f };
+                math::v3 position;
+                XMStoreFloat3(&position, camera.position());
 
-            Quantum::content::get_lod_offset(frame_cache.geometry_ids.data(), info.thresholds, count, frame_cache.lod_offsets);
-            assert(frame_cache.lod_offsets.size() == count);
+                calculate_lod_distances(make_lod_camera(position, projection_scale), spheres.data(), scales.data(), count, distances.data());
+                Quantum::content::get_lod_offset(geometry_ids.data(), distances.data(), count, lod_offsets.data(), lods.data());
+
+                for (u32 i{ 0 }; i < count; ++i)
+                {
+                    render_item_lods[info.render_item_ids[i]].lod = lods[i];
+                }
+            }
 
             u32 d3d12_render_item_count{ 0 };
             for (u32 i{ 0 }; i < count; ++i)
             {
-                d3d12_render_item_count += frame_cache.lod_offsets[i].count;
+                d3d12_render_item_count += lod_offsets[i].count;
             }
 
             assert(d3d12_render_item_count);
@@ -651,7 +867,7 @@ namespace Quantum::graphics::d3d12::content {
             for (u32 i{ 0 }; i < count; ++i)
             {
                 const id::id_type* const item_ids{ &render_item_ids[info.render_item_ids[i]][1] };
-                const Quantum::content::lod_offset& lod_offset{ frame_cache.lod_offsets[i] };
+                const Quantum::content::lod_offset& lod_offset{ lod_offsets[i] };
                 memcpy(&d3d12_render_item_ids[item_index], &item_ids[lod_offset.offset], sizeof(id::id_type) * lod_offset.count);
                 item_index += lod_offset.count;
                 assert(item_index <= d3d12_render_item_count);
@@ -660,11 +876,26 @@ namespace Quantum::graphics::d3d12::content {
             assert(item_index <= d3d12_render_item_count);
         }
 
+        void get_bounding_spheres(const id::id_type* const d3d12_render_item_ids, u32 id_count, id::id_type* const entity_ids, math::v4* const spheres)
+        {
+            assert(d3d12_render_item_ids && id_count && entity_ids && spheres);
+            std::lock_guard lock1{ render_item_mutex };
+            std::lock_guard lock2{ submesh_mutex };
+
+            for (u32 i{ 0 }; i < id_count; ++i)
+            {
+                const d3d12_render_item& item{ render_items[d3d12_render_item_ids[i]] };
+                assert(submesh_ids.is_alive(item.submesh_gpu_id));
+                entity_ids[i] = item.entity_id;
+                spheres[i] = submesh_views[submesh_ids.index(item.submesh_gpu_id)].bounding_sphere;
+            }
+        }
+
         void get_items(const id::id_type* const d3d12_render_item_ids, u32 id_count, const items_cache& cache)
         {
             assert(d3d12_render_item_ids && id_count);
             assert(cache.entity_ids && cache.submesh_gpu_ids && cache.material_ids &&
-                   cache.gpass_psos && cache.depth_psos);
+                   cache.gpass_psos && cache.depth_psos && cache.gpass_pso_ids && cache.depth_pso_ids);
 
             std::lock_guard lock1{ render_item_mutex };
             std::lock_guard lock2{ pso_mutex };
@@ -677,6 +908,8 @@ namespace Quantum::graphics::d3d12::content {
                 cache.material_ids[i] = item.material_id;
                 cache.gpass_psos[i] = pipeline_states[item.pso_id];
                 cache.depth_psos[i] = pipeline_states[item.depth_pso_id];
+                cache.gpass_pso_ids[i] = item.pso_id;
+                cache.depth_pso_ids[i] = item.depth_pso_id;
             }
         }
     } // namespace render_item
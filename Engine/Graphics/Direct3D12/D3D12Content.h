@@ -3,6 +3,7 @@
 
 #pragma once
 #include "D3D12CommonHeaders.h"
+#include "D3D12Core.h"
 
 namespace Quantum::graphics::d3d12::content {
 
@@ -17,11 +18,14 @@ namespace Quantum::graphics::d3d12::content {
             D3D12_INDEX_BUFFER_VIEW *const          index_buffer_views;
             D3D_PRIMITIVE_TOPOLOGY *const           primitive_topologies;
             u32* const                              element_types;
+            math::v3 *const                         position_offsets;   // decoding of quantized positions. Otherwise 0 and 1.
+            math::v3 *const                         position_scales;
         };
 
         id::id_type add(const u8*& data);
         void remove(id::id_type id);
         void get_views(const id::id_type* const gpu_ids, u32 id_count, const views_cache& cache);
+        void get_meshlet_views(const id::id_type* const gpu_ids, u32 id_count, D3D12_GPU_VIRTUAL_ADDRESS* const meshlet_buffers, u32* const meshlet_counts);
     } // namespace submesh
 
     namespace texture {
@@ -34,6 +38,7 @@ namespace Quantum::graphics::d3d12::content {
 
         struct material_cache {
             ID3D12RootSignature* *const     root_signature;
+            id::id_type *const              root_signature_ids;
             material_type::type* const      material_types;
         };
 
@@ -49,11 +54,17 @@ namespace Quantum::graphics::d3d12::content {
             id::id_type *const          material_ids;
             ID3D12PipelineState* *const gpass_psos;
             ID3D12PipelineState* *const depth_psos;
+            id::id_type *const          gpass_pso_ids;
+            id::id_type *const          depth_pso_ids;
         };
 
         id::id_type add(id::id_type entity_id, id::id_type geometry_content_id, u32 material_count, const id::id_type* const material_ids);
         void remove(id::id_type id);
-        void get_d3d12_render_item_ids(const frame_info& info, util::vector<id::id_type>& d3d12_render_item_ids);
+        // Picks the LOD of each render item and adds the ids of its low-level render items. If the application didn't
+        // provide LOD thresholds in frame_info, LODs are picked from the screen size of the items.
+        void get_d3d12_render_item_ids(const d3d12_frame_info& d3d12_info, core::transient_vector<id::id_type>& d3d12_render_item_ids);
+        // Entity ids and object space bounding spheres of the submeshes of low-level render items.
+        void get_bounding_spheres(const id::id_type* const d3d12_render_item_ids, u32 id_count, id::id_type* const entity_ids, math::v4* const spheres);
         void get_items(const id::id_type* const d3d12_render_item_ids, u32 id_count, const items_cache& cache);
     } // namespace render_item
 }
@@ -9,8 +9,10 @@
 #include "D3D12Content.h"
 #include "D3D12Light.h"
 #include "D3D12LightCulling.h"
+#include "D3D12IndirectDraw.h"
 #include "D3D12Camera.h"
 #include "Shaders/ShaderTypes.h"
+#include "Graphics/ParallelRecording.h"
 
 extern "C" { __declspec(dllexport) extern const UINT D3D12SDKVersion = 610; }
 extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = ".\\D3D12\\"; }
@@ -19,12 +21,17 @@ using namespace Microsoft::WRL;
 
 namespace Quantum::graphics::d3d12::core {
     namespace {
+        // The main command list, plus the command lists of two passes that record on several threads, each
+        // followed by a new main command list.
+        constexpr u32 max_command_lists{ 1 + 2 * (max_command_lists_per_pass + 1) };
+
         class d3d12_command
         {
         public:
             d3d12_command() = default;
             DISABLE_COPY_AND_MOVE(d3d12_command);
             explicit d3d12_command(id3d12_device *const device, D3D12_COMMAND_LIST_TYPE type)
+                : _type{ type }
             {
                 HRESULT hr{ S_OK };
                 D3D12_COMMAND_QUEUE_DESC desc{};
@@ -39,15 +46,15 @@ namespace Quantum::graphics::d3d12::core {
                 for (u32 i{ 0 }; i < frame_buffer_count; ++i)
                 {
                     command_frame& frame{ _cmd_frames[i] };
-                    DXCall(hr = device->CreateCommandAllocator(type, IID_PPV_ARGS(&frame.cmd_allocator)));
+                    DXCall(hr = device->CreateCommandAllocator(type, IID_PPV_ARGS(&frame.cmd_allocators[0])));
                     if (FAILED(hr)) goto _error;
-                    NAME_D3D12_OBJECT_INDEXED(frame.cmd_allocator, i, type == D3D12_COMMAND_LIST_TYPE_DIRECT ? L"GFX Command Allocator" : type == D3D12_COMMAND_LIST_TYPE_COMPUTE ? L"Compute Command Allocator" : L"Command Allocator");
+                    NAME_D3D12_OBJECT_INDEXED(frame.cmd_allocators[0], i, type == D3D12_COMMAND_LIST_TYPE_DIRECT ? L"GFX Command Allocator" : type == D3D12_COMMAND_LIST_TYPE_COMPUTE ? L"Compute Command Allocator" : L"Command Allocator");
                 }
 				
-                DXCall(hr = device->CreateCommandList(0, type, _cmd_frames[0].cmd_allocator, nullptr, IID_PPV_ARGS(&_cmd_list)));
+                DXCall(hr = device->CreateCommandList(0, type, _cmd_frames[0].cmd_allocators[0], nullptr, IID_PPV_ARGS(&_cmd_lists[0])));
                 if (FAILED(hr)) goto _error;
-                DXCall(_cmd_list->Close());
-                NAME_D3D12_OBJECT(_cmd_queue, type == D3D12_COMMAND_LIST_TYPE_DIRECT ? L"GFX Command List" :  type == D3D12_COMMAND_LIST_TYPE_COMPUTE ? L"Compute Command List" : L"Command List");
+                DXCall(_cmd_lists[0]->Close());
+                NAME_D3D12_OBJECT(_cmd_lists[0], type == D3D12_COMMAND_LIST_TYPE_DIRECT ? L"GFX Command List" :  type == D3D12_COMMAND_LIST_TYPE_COMPUTE ? L"Compute Command List" : L"Command List");
 				
                 DXCall(hr = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fence)));
                 if (FAILED(hr)) goto _error;
@@ -65,24 +72,58 @@ namespace Quantum::graphics::d3d12::core {
 			
             ~d3d12_command()
             {
-                assert(!_cmd_queue && !_cmd_list && !_fence);
+                assert(!_cmd_queue && !_cmd_lists[0] && !_fence);
             }
 			
-            // Wait for the current frame to be signalled and reset the command list/allocator.
+            // Wait for the current frame to be signalled and reset the command lists/allocators.
             void begin_frame()
             {
                 command_frame& frame{ _cmd_frames[_frame_index] };
                 frame.wait(_fence_event, _fence);
-                DXCall(frame.cmd_allocator->Reset());
-                DXCall(_cmd_list->Reset(frame.cmd_allocator, nullptr));
+                for (ID3D12CommandAllocator* const allocator : frame.cmd_allocators)
+                {
+                    if (allocator)
+                    {
+                        DXCall(allocator->Reset());
+                    }
+                }
+
+                _list_count = 0;
+                start_command_list();
+            }
+
+            // Closes the current command list and starts 'count' command lists that can be recorded on other
+            // threads. They're executed in order after the current list. Call end_parallel_lists() once they're
+            // recorded to continue in a new command list.
+            id3d12_graphics_command_list* const* begin_parallel_lists(u32 count)
+            {
+                assert(count && _list_count + count < max_command_lists);
+                DXCall(command_list()->Close());
+                const u32 first_list{ _list_count };
+                for (u32 i{ 0 }; i < count; ++i)
+                {
+                    start_command_list();
+                }
+
+                return &_cmd_lists[first_list];
+            }
+
+            // NOTE: the parallel lists must be closed by then.
+            id3d12_graphics_command_list* end_parallel_lists()
+            {
+                return start_command_list();
             }
 			
             // Signal the fence with the new fence value.
             void end_frame(const d3d12_surface& surface)
             {
-                DXCall(_cmd_list->Close());
-                ID3D12CommandList* const cmd_lists[]{ _cmd_list };
-                _cmd_queue->ExecuteCommandLists(_countof(cmd_lists), &cmd_lists[0]);
+                DXCall(command_list()->Close());
+                ID3D12CommandList* cmd_lists[max_command_lists];
+                for (u32 i{ 0 }; i < _list_count; ++i)
+                {
+                    cmd_lists[i] = _cmd_lists[i];
+                }
+                _cmd_queue->ExecuteCommandLists(_list_count, &cmd_lists[0]);
 				
                 // Presenting swap chain buffers happens in lockstep with frame buffers.
                 surface.present();
@@ -115,7 +156,11 @@ namespace Quantum::graphics::d3d12::core {
                 _fence_event = nullptr;
 				
                 core::release(_cmd_queue);
-                core::release(_cmd_list);
+                for (id3d12_graphics_command_list*& cmd_list : _cmd_lists)
+                {
+                    core::release(cmd_list);
+                }
+                _list_count = 0;
 				
                 for (u32 i{ 0 }; i < frame_buffer_count; ++i)
                 {
@@ -124,13 +169,14 @@ namespace Quantum::graphics::d3d12::core {
             }
 			
             constexpr ID3D12CommandQueue* const command_queue() const { return _cmd_queue; }
-            constexpr id3d12_graphics_command_list* const command_list() const { return _cmd_list; }
+            constexpr id3d12_graphics_command_list* const command_list() const { assert(_list_count); return _cmd_lists[_list_count - 1]; }
             constexpr u32 frame_index() const { return _frame_index; }
 			
         private:
             struct command_frame
             {
-                ID3D12CommandAllocator* cmd_allocator{ nullptr };
+                // NOTE: each command list has its own allocator, so that lists can be recorded at the same time.
+                ID3D12CommandAllocator* cmd_allocators[max_command_lists]{};
                 u64                     fence_value{ 0 };
 				
                 void wait(HANDLE fence_event, ID3D12Fence1* fence)
@@ -151,21 +197,57 @@ namespace Quantum::graphics::d3d12::core {
 				
                 void release()
                 {
-                    core::release(cmd_allocator);
+                    for (ID3D12CommandAllocator*& allocator : cmd_allocators)
+                    {
+                        core::release(allocator);
+                    }
                     fence_value = 0;
                 }
             };
+
+            // Resets the next command list of this frame, or creates it (and its allocator) the first time
+            // it's used. The new list becomes the current command list.
+            id3d12_graphics_command_list* start_command_list()
+            {
+                assert(_list_count < max_command_lists);
+                const u32 index{ _list_count };
+                ID3D12CommandAllocator*& allocator{ _cmd_frames[_frame_index].cmd_allocators[index] };
+                id3d12_graphics_command_list*& cmd_list{ _cmd_lists[index] };
+
+                if (!allocator)
+                {
+                    DXCall(core::device()->CreateCommandAllocator(_type, IID_PPV_ARGS(&allocator)));
+                    NAME_D3D12_OBJECT_INDEXED(allocator, _frame_index * max_command_lists + index, L"Command Allocator");
+                }
+
+                if (cmd_list)
+                {
+                    DXCall(cmd_list->Reset(allocator, nullptr));
+                }
+                else
+                {
+                    // NOTE: new command lists are open, so they don't need a reset.
+                    DXCall(core::device()->CreateCommandList(0, _type, allocator, nullptr, IID_PPV_ARGS(&cmd_list)));
+                    NAME_D3D12_OBJECT_INDEXED(cmd_list, index, L"Command List");
+                }
+
+                ++_list_count;
+                return cmd_list;
+            }
 			
             ID3D12CommandQueue*                     _cmd_queue{ nullptr };
-            id3d12_graphics_command_list*           _cmd_list{ nullptr };
+            id3d12_graphics_command_list*           _cmd_lists[max_command_lists]{};
             ID3D12Fence1*                           _fence{ nullptr };
             u64                                     _fence_value{ 0 };
             command_frame                           _cmd_frames[frame_buffer_count]{};
             HANDLE                                  _fence_event{};
             u32                                     _frame_index{ 0 };
+            u32                                     _list_count{ 0 };
+            D3D12_COMMAND_LIST_TYPE                 _type{ D3D12_COMMAND_LIST_TYPE_DIRECT };
         };
 		
         using surface_collection = util::free_list<d3d12_surface>;
+        using transient_arena = util::linear_arena<util::memory_tag::renderer, 256 * 1024>;
 		
         id3d12_device*                      main_device{ nullptr };
         IDXGIFactory7*                      dxgi_factory{ nullptr };
@@ -173,6 +255,7 @@ namespace Quantum::graphics::d3d12::core {
         surface_collection                  surfaces;
         d3dx::d3d12_resource_barrier        resource_barriers{};
         constant_buffer                     constant_buffers[frame_buffer_count];
+        transient_arena                     transient_arenas[frame_buffer_count];
 		
         descriptor_heap                     rtv_desc_heap{ D3D12_DESCRIPTOR_HEAP_TYPE_RTV };
         descriptor_heap                     dsv_desc_heap{ D3D12_DESCRIPTOR_HEAP_TYPE_DSV };
@@ -379,7 +462,8 @@ namespace Quantum::graphics::d3d12::core {
             fx::initialize() &&
             upload::initialize() &&
             content::initialize() &&
-            delight::initialize()))
+            delight::initialize() &&
+            indirect::initialize()))
             return failed_init();
 			
         NAME_D3D12_OBJECT(main_device, L"Main D3D12 Device");
@@ -404,6 +488,7 @@ namespace Quantum::graphics::d3d12::core {
         }
 		
         // shutdown modules
+        indirect::shutdown();
         delight::shutdown();
         content::shutdown();
         upload::shutdown();
@@ -467,6 +552,21 @@ namespace Quantum::graphics::d3d12::core {
     u32 current_frame_index() { return gfx_command.frame_index(); }
 	
     void set_deferred_releases_flag() { deferred_releases_flag[current_frame_index()] = 1; }
+
+    id3d12_graphics_command_list* const* begin_parallel_command_lists(u32 count) { return gfx_command.begin_parallel_lists(count); }
+    id3d12_graphics_command_list* end_parallel_command_lists() { return gfx_command.end_parallel_lists(); }
+
+    void* transient_allocator::allocate(u64 size)
+    {
+        return reallocate(nullptr, 0, size);
+    }
+
+    void* transient_allocator::reallocate(void* const p, u64 old_size, u64 new_size)
+    {
+        void* const new_p{ transient_arenas[current_frame_index()].reallocate(p, old_size, new_size) };
+        if (new_p) util::memory::track(util::allocator_type::frame, util::memory_tag::renderer, (s64)new_size - (s64)(new_p == p ? old_size : 0), new_p == p ? 0 : 1);
+        return new_p;
+    }
 	
     surface create_surface(platform::window window)
     {
@@ -510,6 +610,8 @@ namespace Quantum::graphics::d3d12::core {
         // Reset (clear) the global constant buffer for the current frame.
         constant_buffer& cbuffer{ constant_buffers[frame_idx] };
         cbuffer.clear();
+        // Release the CPU-side arrays that were allocated the last time this frame buffer was used.
+        transient_arenas[frame_idx].reset();
 
         if (deferred_releases_flag[frame_idx])
         {
@@ -536,7 +638,7 @@ namespace Quantum::graphics::d3d12::core {
         gpass::add_transitions_for_depth_prepass(barriers);
         barriers.apply(cmd_list);
         gpass::set_render_targets_for_depth_prepass(cmd_list);
-        gpass::depth_prepass(cmd_list, d3d12_info);
+        cmd_list = gpass::depth_prepass(cmd_list, d3d12_info, barriers);
 
         // Geometry and lighting pass
         light::update_light_buffers(d3d12_info);
@@ -544,7 +646,7 @@ namespace Quantum::graphics::d3d12::core {
         gpass::add_transitions_for_gpass(barriers);
         barriers.apply(cmd_list);
         gpass::set_render_targets_for_gpass(cmd_list);
-        gpass::render(cmd_list, d3d12_info);
+        cmd_list = gpass::render(cmd_list, d3d12_info, barriers);
 
         d3dx::transition_resource(cmd_list, current_back_buffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
 
@@ -56,6 +56,27 @@ namespace Quantum::graphics::d3d12::core {
     [[nodiscard]] u32 current_frame_index();
     void set_deferred_releases_flag();
 
+    // Closes the current command list of the frame and returns 'count' new command lists, for recording draws on
+    // several threads. They're executed in order, after the commands that were recorded so far. Each thread has
+    // to set the descriptor heaps, viewport and render targets in its list, since command lists don't inherit
+    // any state, and close the list when it's done.
+    [[nodiscard]] id3d12_graphics_command_list* const* begin_parallel_command_lists(u32 count);
+    // Returns a new command list for the commands that come after the parallel command lists.
+    [[nodiscard]] id3d12_graphics_command_list* end_parallel_command_lists();
+
+    // Allocates CPU memory for arrays that are rebuilt every frame. Each frame buffer has its own arena,
+    // which is released in one go when the frame buffer is used again, frame_buffer_count frames later.
+    // NOTE: deallocate() does nothing, so transient vectors can simply be dropped or reassigned.
+    struct transient_allocator
+    {
+        [[nodiscard]] static void* allocate(u64 size);
+        [[nodiscard]] static void* reallocate(void* const p, u64 old_size, u64 new_size);
+        static void deallocate(void* const, u64) {}
+    };
+
+    template<typename T>
+    using transient_vector = util::vector<T, false, transient_allocator>;
+
     [[nodiscard]] surface create_surface(platform::window window);
     void remove_surface(surface_id id);
     void resize_surface(surface_id id, u32, u32);
@@ -7,9 +7,14 @@
 #include "D3D12Light.h"
 #include "D3D12Camera.h"
 #include "D3D12LightCulling.h"
+#include "D3D12IndirectDraw.h"
 #include "Shaders/ShaderTypes.h"
 #include "Components/Entity.h"
 #include "Components/Transform.h"
+#include "Core/JobSystem.h"
+#include "Graphics/Culling.h"
+#include "Graphics/DrawSorting.h"
+#include "Graphics/ParallelRecording.h"
 
 namespace Quantum::graphics::d3d12::gpass {
     namespace {
@@ -17,6 +22,15 @@ namespace Quantum::graphics::d3d12::gpass {
         d3d12_render_texture            gpass_main_buffer{};
         d3d12_depth_buffer              gpass_depth_buffer{};
         math::u32v2                     dimensions{ initial_dimensions };
+        constexpr u32                   culling_batch_size{ 4096 };
+        frame_stats                     stats_of_last_frame{};
+
+        struct draw_pass {
+            enum type : u32 {
+                depth_prepass,
+                gpass,
+            };
+        };
 
 #if _DEBUG
         constexpr f32                   clear_value[4]{ 0.5f, 0.5f, 0.5f, 1.f };
@@ -30,22 +44,31 @@ namespace Quantum::graphics::d3d12::gpass {
 #else 
 #define CONSTEXPR constexpr
 #endif
+        // NOTE: all arrays are allocated from the renderer's transient memory, so they're only valid
+        //       during the frame that called prepare_render_frame().
         struct gpass_cache {
-            util::vector<id::id_type>   d3d12_render_item_ids;
+            core::transient_vector<id::id_type> d3d12_render_item_ids;
 
             // NOTE: When adding new arrays, make sure to update resize() and struct_size.
+            u64*                        sort_keys{ nullptr };           // 2 per item: depth prepass, then gpass.
+            u32*                        draw_order{ nullptr };          // 2 per item: cache indices in the order of sort_keys.
             id::id_type*                entity_ids{ nullptr };
             id::id_type*                submesh_gpu_ids{ nullptr };
             id::id_type*                material_ids{ nullptr };
             ID3D12PipelineState**       gpass_pipeline_states{ nullptr };
             ID3D12PipelineState**       depth_pipeline_states{ nullptr };
+            id::id_type*                gpass_pipeline_state_ids{ nullptr };
+            id::id_type*                depth_pipeline_state_ids{ nullptr };
             ID3D12RootSignature**       root_signatures{ nullptr };
+            id::id_type*                root_signature_ids{ nullptr };
             material_type::type*        material_types{ nullptr };
             D3D12_GPU_VIRTUAL_ADDRESS*  position_buffers{ nullptr };
             D3D12_GPU_VIRTUAL_ADDRESS*  element_buffers{ nullptr };
             D3D12_INDEX_BUFFER_VIEW*    index_buffer_views{ nullptr };
             D3D_PRIMITIVE_TOPOLOGY*     primitive_topologies{ nullptr };
             u32*                        element_types{ nullptr };
+            math::v3*                   position_offsets{ nullptr };
+            math::v3*                   position_scales{ nullptr };
             D3D12_GPU_VIRTUAL_ADDRESS*  per_object_data{ nullptr };
              
             constexpr content::render_item::items_cache items_cache() const
@@ -56,6 +79,8 @@ namespace Quantum::graphics::d3d12::gpass {
                     material_ids,
                     gpass_pipeline_states,
                     depth_pipeline_states,
+                    gpass_pipeline_state_ids,
+                    depth_pipeline_state_ids,
                 };
             }
 
@@ -67,6 +92,8 @@ namespace Quantum::graphics::d3d12::gpass {
                     index_buffer_views,
                     primitive_topologies,
                     element_types,
+                    position_offsets,
+                    position_scales,
                 };
             }
 
@@ -74,6 +101,7 @@ namespace Quantum::graphics::d3d12::gpass {
             {
                 return {
                     root_signatures,
+                    root_signature_ids,
                     material_types,
                 };
             }
@@ -85,60 +113,111 @@ namespace Quantum::graphics::d3d12::gpass {
 
             CONSTEXPR void clear()
             {
-                d3d12_render_item_ids.clear();
+                // NOTE: the memory of the previous frame is released in bulk, so we just drop it.
+                d3d12_render_item_ids = core::transient_vector<id::id_type>{};
             }
 
-            CONSTEXPR void resize()
+            void resize()
             {
                 const u64 items_count{ d3d12_render_item_ids.size() };
-                const u64 new_buffer_size{ items_count & struct_size };
-                const u64 old_buffer_size{ _buffer.size() };
-                if (new_buffer_size > old_buffer_size)
-                {
-                    _buffer.resize(new_buffer_size);
-                }
-
-                if (new_buffer_size != old_buffer_size)
-                {
-                    entity_ids = (id::id_type*)_buffer.data();
-                    submesh_gpu_ids = (id::id_type*)(&entity_ids[items_count]);
-                    material_ids = (id::id_type*)(&submesh_gpu_ids[items_count]);
-                    gpass_pipeline_states = (ID3D12PipelineState**)(&material_ids[items_count]);
-                    depth_pipeline_states = (ID3D12PipelineState**)(&gpass_pipeline_states[items_count]);
-                    root_signatures = (ID3D12RootSignature**)(&depth_pipeline_states[items_count]);
-                    material_types = (material_type::type*)(&root_signatures[items_count]);
-                    position_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&material_types[items_count]);
-                    element_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&position_buffers[items_count]);
-                    index_buffer_views = (D3D12_INDEX_BUFFER_VIEW*)(&element_buffers[items_count]);
-                    primitive_topologies = (D3D_PRIMITIVE_TOPOLOGY*)(&index_buffer_views[items_count]);
-                    element_types = (u32*)(&primitive_topologies[items_count]);
-                    per_object_data = (D3D12_GPU_VIRTUAL_ADDRESS*)(&element_types[items_count]);
-                }
+                const u64 buffer_size{ items_count * struct_size };
+                u8* const buffer{ (u8*)core::transient_allocator::allocate(buffer_size) };
+                assert(buffer);
+
+                // NOTE: sort keys are first, so that they're 8 byte aligned.
+                sort_keys = (u64*)buffer;
+                draw_order = (u32*)(&sort_keys[2 * items_count]);
+                entity_ids = (id::id_type*)(&draw_order[2 * items_count]);
+                submesh_gpu_ids = (id::id_type*)(&entity_ids[items_count]);
+                material_ids = (id::id_type*)(&submesh_gpu_ids[items_count]);
+                gpass_pipeline_states = (ID3D12PipelineState**)(&material_ids[items_count]);
+                depth_pipeline_states = (ID3D12PipelineState**)(&gpass_pipeline_states[items_count]);
+                gpass_pipeline_state_ids = (id::id_type*)(&depth_pipeline_states[items_count]);
+                depth_pipeline_state_ids = (id::id_type*)(&gpass_pipeline_state_ids[items_count]);
+                root_signatures = (ID3D12RootSignature**)(&depth_pipeline_state_ids[items_count]);
+                root_signature_ids = (id::id_type*)(&root_signatures[items_count]);
+                material_types = (material_type::type*)(&root_signature_ids[items_count]);
+                position_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&material_types[items_count]);
+                element_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&position_buffers[items_count]);
+                index_buffer_views = (D3D12_INDEX_BUFFER_VIEW*)(&element_buffers[items_count]);
+                primitive_topologies = (D3D_PRIMITIVE_TOPOLOGY*)(&index_buffer_views[items_count]);
+                element_types = (u32*)(&primitive_topologies[items_count]);
+                position_offsets = (math::v3*)(&element_types[items_count]);
+                position_scales = (math::v3*)(&position_offsets[items_count]);
+                per_object_data = (D3D12_GPU_VIRTUAL_ADDRESS*)(&position_scales[items_count]);
             }
 
         private:
             constexpr static u32 struct_size {
+                2 * sizeof(u64) +                           // sort_keys
+                2 * sizeof(u32) +                           // draw_order
                 sizeof(id::id_type) +                       // entity_ids
                 sizeof(id::id_type) +                       // submesh_ids
                 sizeof(id::id_type) +                       // material_ids
                 sizeof(ID3D12PipelineState*) +              // gpass_pipeline_states
                 sizeof(ID3D12PipelineState*) +              // depth_pipeline_states
+                sizeof(id::id_type) +                       // gpass_pipeline_state_ids
+                sizeof(id::id_type) +                       // depth_pipeline_state_ids
                 sizeof(ID3D12RootSignature*) +              // root_signatures
+                sizeof(id::id_type) +                       // root_signature_ids
                 sizeof(material_type::type) +               // material_types
                 sizeof(D3D12_GPU_VIRTUAL_ADDRESS) +         // position_buffers
                 sizeof(D3D12_GPU_VIRTUAL_ADDRESS) +         // element_buffers
                 sizeof(D3D12_INDEX_BUFFER_VIEW) +           // index_buffer_views
                 sizeof(D3D_PRIMITIVE_TOPOLOGY) +            // primitive_topologies
                 sizeof(u32) +                               // element_types
+                sizeof(math::v3) +                          // position_offsets
+                sizeof(math::v3) +                          // position_scales
                 sizeof(D3D12_GPU_VIRTUAL_ADDRESS)           // per_object_data
             };
-
-            util::vector<u8> _buffer;
         } frame_cache;
 
 // Good boy!
 #undef CONSTEXPR
 
+        // Draw groups of the GPU-driven path. The groups of the depth prepass come first, then those of the gpass.
+        // NOTE: the groups are in transient memory, like the arrays of gpass_cache.
+        struct indirect_draws {
+            core::transient_vector<indirect_draw_group> groups;
+            u32                                         depth_group_count{ 0 };
+        } indirect_frame_draws;
+
+        // What the draw record of a low-level render item was made from. If any of it changes, we write the record
+        // again. Otherwise the record in the GPU buffer is still good.
+        struct draw_record_source {
+            id::id_type                 entity_id{ id::invalid_id };
+            id::id_type                 submesh_gpu_id{ id::invalid_id };
+            id::id_type                 material_id{ id::invalid_id };
+            id::id_type                 gpass_pipeline_state_id{ id::invalid_id };
+            id::id_type                 depth_pipeline_state_id{ id::invalid_id };
+            u32                         world_version{ 0 };
+        };
+
+        struct draw_record {
+            draw_record_source          source{};
+            u32                         depth_state_id{ 0 };
+            u32                         gpass_state_id{ 0 };
+        };
+
+        // The state that ExecuteIndirect can't change. Each draw group has exactly one.
+        struct draw_state {
+            ID3D12RootSignature*        root_signature;
+            ID3D12PipelineState*        pipeline_state;
+            id::id_type                 root_signature_id;
+            D3D_PRIMITIVE_TOPOLOGY      primitive_topology;
+            draw_pass::type             pass;
+        };
+
+        // Persistent state of the GPU-driven path. Each low-level render item has its draw record at the index of
+        // its id, in the GPU buffers of d3d12::indirect and in 'records'. Draw states get their ids when they're
+        // first used and keep them until shutdown.
+        struct gpu_driven_draws {
+            util::vector<draw_record>       records;
+            util::vector<draw_state>        states;
+            util::vector<u64>               state_keys;     // sort key of each state, which orders the draw groups.
+            std::unordered_map<u64, u32>    state_ids;      // pass, pipeline state id and topology to state id.
+        } gpu_draws;
+
         bool create_buffers(math::u32v2 size)
         {
             assert(size.x & size.y);
@@ -189,26 +268,44 @@ namespace Quantum::graphics::d3d12::gpass {
             return gpass_main_buffer.resource() && gpass_depth_buffer.resource();
         }
 
-        void fill_per_object_data(const d3d12_frame_info& d3d12_info)
+        // Quantized positions are decoded by scaling and translating them before the world transform.
+        // InvWorld is only used for normals, which aren't quantized, so it stays as it is.
+        void make_per_object_data(const math::m4x4& world, const math::m4x4& inverse_world, const math::v3& offset, const math::v3& scale,
+                                  hlsl::PerObjectData& data)
+        {
+            using namespace DirectX;
+            const XMMATRIX decode{ XMMatrixMultiply(XMMatrixScaling(scale.x, scale.y, scale.z), XMMatrixTranslation(offset.x, offset.y, offset.z)) };
+            XMStoreFloat4x4(&data.World, XMMatrixMultiply(decode, XMLoadFloat4x4(&world)));
+            data.InvWorld = inverse_world;
+        }
+
+        void fill_per_object_data()
         {
             const gpass_cache& cache{ frame_cache };
             const u32 render_items_count{ (u32)cache.size() };
             id::id_type current_entity_id{ id::invalid_id };
+            const math::v3* current_offset{ nullptr };
+            const math::v3* current_scale{ nullptr };
             hlsl::PerObjectData* current_data_pointer{ nullptr };
 
             constant_buffer& cbuffer{ core::cbuffer() };
 
-            using namespace DirectX;
             for (u32 i{ 0 }; i < render_items_count; ++i)
             {
-                if (current_entity_id != cache.entity_ids[i])
+                const math::v3& offset{ cache.position_offsets[i] };
+                const math::v3& scale{ cache.position_scales[i] };
+                // NOTE: submeshes of the same entity share their per object data, unless they have different
+                //       position quantization. Then each submesh gets its own world matrix.
+                if (current_entity_id != cache.entity_ids[i] ||
+                    memcmp(current_offset, &offset, sizeof(math::v3)) || memcmp(current_scale, &scale, sizeof(math::v3)))
                 {
                     current_entity_id = cache.entity_ids[i];
+                    current_offset = &offset;
+                    current_scale = &scale;
+                    math::m4x4 world, inverse_world;
+                    transform::get_transform_matrics(game_entity::entity_id{ current_entity_id }, world, inverse_world);
                     hlsl::PerObjectData data{};
-                    transform::get_transform_matrics(game_entity::entity_id{ current_entity_id }, data.World, data.InvWorld);
-                    XMMATRIX world{ XMLoadFloat4x4(&data.World) };
-                    XMMATRIX wvp{ XMMatrixMultiply(world, d3d12_info.camera->view_projection()) };
-                    XMStoreFloat4x4(&data.WorldViewProjection, wvp);
+                    make_per_object_data(world, inverse_world, offset, scale, data);
 
                     current_data_pointer = cbuffer.allocate<hlsl::PerObjectData>();
                     memcpy(current_data_pointer, &data, sizeof(hlsl::PerObjectData));
@@ -219,6 +316,93 @@ namespace Quantum::graphics::d3d12::gpass {
             }
         }
 
+        // Removes the items whose submesh is outside the camera's view frustum from the list of low-level
+        // render items, so that we don't fill per object data or record draws for them. Also returns the
+        // distance from the camera to each visible item, which we use to sort them.
+        void cull_render_items(const d3d12_frame_info& d3d12_info, core::transient_vector<id::id_type>& d3d12_render_item_ids,
+                               core::transient_vector<f32>& depths)
+        {
+            const u32 items_count{ (u32)d3d12_render_item_ids.size() };
+            core::transient_vector<id::id_type> entity_ids(items_count);
+            core::transient_vector<math::v4> spheres(items_count);
+            core::transient_vector<u8> visible(items_count);
+            content::render_item::get_bounding_spheres(d3d12_render_item_ids.data(), items_count, entity_ids.data(), spheres.data());
+
+            math::m4x4 view_projection;
+            DirectX::XMStoreFloat4x4(&view_projection, d3d12_info.camera->view_projection());
+            const frustum view_frustum{ make_frustum(view_projection) };
+            math::v3 camera_position;
+            DirectX::XMStoreFloat3(&camera_position, d3d12_info.camera->position());
+            depths.resize(items_count);
+
+            // NOTE: world matrices are up to date after transform::update_world_matrices(), so reading them
+            //       from several threads is safe.
+            jobs::parallel_for(items_count, culling_batch_size, [&](u32 begin, u32 end) {
+                id::id_type current_entity_id{ id::invalid_id };
+                math::m4x4 world, inverse_world;
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    // Submeshes of the same entity are next to each other, so we get its world matrix only once.
+                    if (current_entity_id != entity_ids[i])
+                    {
+                        current_entity_id = entity_ids[i];
+                        transform::get_transform_matrics(game_entity::entity_id{ current_entity_id }, world, inverse_world);
+                    }
+
+                    spheres[i] = transform_bounding_sphere(world, spheres[i]);
+                    const math::v3 d{ spheres[i].x - camera_position.x, spheres[i].y - camera_position.y, spheres[i].z - camera_position.z };
+                    depths[i] = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+                }
+
+                cull_spheres(view_frustum, &spheres[begin], end - begin, &visible[begin]);
+            });
+
+            u32 visible_count{ 0 };
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                d3d12_render_item_ids[visible_count] = d3d12_render_item_ids[i];
+                depths[visible_count] = depths[i];
+                visible_count += visible[i];
+            }
+
+            d3d12_render_item_ids.resize(visible_count);
+            depths.resize(visible_count);
+        }
+
+        // Sorts the draws of both passes by their sort keys, so that we change root signatures and pipeline states
+        // as rarely as possible and draw front to back. The depth prepass has its own pipeline states, so it gets
+        // its own keys. Its draws are in the first half of draw_order and the gpass draws in the second half.
+        void sort_render_items(const f32* const depths)
+        {
+            gpass_cache& cache{ frame_cache };
+            const u32 items_count{ cache.size() };
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                const u32 root_signature{ cache.root_signature_ids[i] };
+                const u32 material{ cache.material_ids[i] };
+                const f32 depth{ depths[i] };
+                cache.sort_keys[i] = make_sort_key(draw_pass::depth_prepass, root_signature, cache.depth_pipeline_state_ids[i], material, depth);
+                cache.sort_keys[items_count + i] = make_sort_key(draw_pass::gpass, root_signature, cache.gpass_pipeline_state_ids[i], material, depth);
+                cache.draw_order[i] = i;
+                cache.draw_order[items_count + i] = i;
+            }
+
+            core::transient_vector<u64> temp_keys(2 * (u64)items_count);
+            core::transient_vector<u32> temp_order(2 * (u64)items_count);
+            core::transient_vector<u32> histograms(radix_sort_histogram_size);
+            radix_sort(cache.sort_keys, cache.draw_order, 2 * items_count, temp_keys.data(), temp_order.data(), histograms.data());
+        }
+
+        constexpr u32 get_index_count(const D3D12_INDEX_BUFFER_VIEW& ibv)
+        {
+            return ibv.SizeInBytes >> (ibv.Format == DXGI_FORMAT_R16_UINT ? 1 : 2);
+        }
+
+        constexpr math::u32v2 split_address(D3D12_GPU_VIRTUAL_ADDRESS address)
+        {
+            return { (u32)address, (u32)(address >> 32) };
+        }
+
         void set_root_parameters(id3d12_graphics_command_list* const cmd_list, u32 cache_index)
         {
             gpass_cache& cache{ frame_cache };
@@ -238,27 +422,441 @@ namespace Quantum::graphics::d3d12::gpass {
             }
         }
 
+        // Returns the id of the draw state of item 'cache_index' in 'pass' and adds the state if it's new.
+        u32 get_draw_state_id(draw_pass::type pass, u32 cache_index)
+        {
+            const gpass_cache& cache{ frame_cache };
+            gpu_driven_draws& draws{ gpu_draws };
+            const bool is_depth_prepass{ pass == draw_pass::depth_prepass };
+            const id::id_type pipeline_state_id{ is_depth_prepass ? cache.depth_pipeline_state_ids[cache_index] : cache.gpass_pipeline_state_ids[cache_index] };
+            const D3D_PRIMITIVE_TOPOLOGY topology{ cache.primitive_topologies[cache_index] };
+
+            // NOTE: a pipeline state is made with one root signature, so it doesn't need to be part of the key.
+            const u64 key{ (u64)pipeline_state_id << 32 | (u64)topology << 1 | (u64)pass };
+            auto pair = draws.state_ids.find(key);
+            if (pair != draws.state_ids.end()) return pair->second;
+
+            const u32 state_id{ (u32)draws.states.size() };
+            ID3D12PipelineState* const pipeline_state{ is_depth_prepass ? cache.depth_pipeline_states[cache_index] : cache.gpass_pipeline_states[cache_index] };
+            draws.states.emplace_back(draw_state{ cache.root_signatures[cache_index], pipeline_state, cache.root_signature_ids[cache_index], topology, pass });
+            // ExecuteIndirect can't change the primitive topology either, so it takes the place of the material.
+            draws.state_keys.emplace_back(make_sort_key(pass, cache.root_signature_ids[cache_index], pipeline_state_id, (u32)topology, 0.f));
+            draws.state_ids[key] = state_id;
+            return state_id;
+        }
+
+        // Writes the draw records of the items whose render item or transform changed since we last wrote their
+        // record. Other items keep the records that are in the GPU buffers already.
+        // NOTE: afterwards, the items arrays of the cache only have the items whose record we wrote.
+        void update_draw_records(const d3d12_frame_info& d3d12_info)
+        {
+            gpass_cache& cache{ frame_cache };
+            gpu_driven_draws& draws{ gpu_draws };
+            const u32 items_count{ cache.size() };
+            const id::id_type* const d3d12_render_item_ids{ cache.d3d12_render_item_ids.data() };
+
+            u32 record_count{ 0 };
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                record_count = std::max(record_count, d3d12_render_item_ids[i] + 1);
+            }
+
+            if (record_count > draws.records.size()) draws.records.resize(record_count);
+            if (indirect::reserve_records(record_count))
+            {
+                for (draw_record& record : draws.records) record.source = {};
+            }
+
+            core::transient_vector<u32> world_versions(items_count);
+            transform::get_world_versions((const game_entity::entity_id*)cache.entity_ids, items_count, world_versions.data());
+
+            core::transient_vector<u32> updated_items(items_count);
+            u32 updated_count{ 0 };
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                draw_record& record{ draws.records[d3d12_render_item_ids[i]] };
+                const draw_record_source source{ cache.entity_ids[i], cache.submesh_gpu_ids[i], cache.material_ids[i],
+                                                 cache.gpass_pipeline_state_ids[i], cache.depth_pipeline_state_ids[i], world_versions[i] };
+                if (memcmp(&record.source, &source, sizeof(draw_record_source)))
+                {
+                    record.source = source;
+                    updated_items[updated_count] = i;
+                    ++updated_count;
+                }
+            }
+
+            if (!updated_count) return;
+
+            // Move the items with updated records to the front, so that we only get views and materials for them.
+            core::transient_vector<u32> slots(updated_count);
+            for (u32 k{ 0 }; k < updated_count; ++k)
+            {
+                const u32 i{ updated_items[k] };
+                slots[k] = d3d12_render_item_ids[i];
+                cache.entity_ids[k] = cache.entity_ids[i];
+                cache.submesh_gpu_ids[k] = cache.submesh_gpu_ids[i];
+                cache.material_ids[k] = cache.material_ids[i];
+                cache.gpass_pipeline_states[k] = cache.gpass_pipeline_states[i];
+                cache.depth_pipeline_states[k] = cache.depth_pipeline_states[i];
+                cache.gpass_pipeline_state_ids[k] = cache.gpass_pipeline_state_ids[i];
+                cache.depth_pipeline_state_ids[k] = cache.depth_pipeline_state_ids[i];
+            }
+
+            using namespace content;
+            submesh::get_views(cache.submesh_gpu_ids, updated_count, cache.views_cache());
+            material::get_materials(cache.material_ids, updated_count, cache.materials_cache());
+
+            core::transient_vector<id::id_type> entity_ids(updated_count);
+            core::transient_vector<math::v4> spheres(updated_count);
+            render_item::get_bounding_spheres(slots.data(), updated_count, entity_ids.data(), spheres.data());
+
+            for (u32 k{ 0 }; k < updated_count; ++k)
+            {
+                draw_record& record{ draws.records[slots[k]] };
+                record.depth_state_id = get_draw_state_id(draw_pass::depth_prepass, k);
+                record.gpass_state_id = get_draw_state_id(draw_pass::gpass, k);
+            }
+
+            const indirect::record_updates updates{ indirect::prepare_record_updates(d3d12_info.frame_index, slots.data(), updated_count) };
+
+            // NOTE: world matrices are up to date after transform::get_world_versions(), so reading them from
+            //       several threads is safe.
+            jobs::parallel_for(updated_count, culling_batch_size, [&](u32 begin, u32 end) {
+                for (u32 k{ begin }; k < end; ++k)
+                {
+                    math::m4x4 world, inverse_world;
+                    transform::get_transform_matrics(game_entity::entity_id{ entity_ids[k] }, world, inverse_world);
+
+                    hlsl::PerObjectData data{};
+                    make_per_object_data(world, inverse_world, cache.position_offsets[k], cache.position_scales[k], data);
+
+                    const draw_record& record{ draws.records[slots[k]] };
+                    hlsl::IndirectDrawRecord draw{};
+                    draw.Sphere = transform_bounding_sphere(world, spheres[k]);
+                    draw.DepthStateId = record.depth_state_id;
+                    draw.GPassStateId = record.gpass_state_id;
+
+                    const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[k] };
+                    hlsl::IndirectDrawArguments& arguments{ draw.Arguments };
+                    arguments.PerObjectData = split_address(indirect::per_object_data(slots[k]));
+                    arguments.PositionBuffer = split_address(cache.position_buffers[k]);
+                    arguments.ElementBuffer = split_address(cache.element_buffers[k]);
+                    arguments.IndexBufferLocation = split_address(ibv.BufferLocation);
+                    arguments.IndexBufferSize = ibv.SizeInBytes;
+                    arguments.IndexFormat = ibv.Format;
+                    arguments.IndexCountPerInstance = get_index_count(ibv);
+                    arguments.InstanceCount = 1;
+
+                    // NOTE: updates are in an upload buffer, so we write each one in one go and never read it.
+                    memcpy(updates.per_object_data + (u64)k * indirect::per_object_data_stride, &data, sizeof(hlsl::PerObjectData));
+                    memcpy(&updates.records[k], &draw, sizeof(hlsl::IndirectDrawRecord));
+                }
+            });
+        }
+
+        // Builds the draw groups of both passes with a counting pass over the draw states of the items and fills
+        // this frame's draw list. Each item's record has the same index as its low-level render item id, so the
+        // draw list is the list of ids.
+        void fill_indirect_draws(const d3d12_frame_info& d3d12_info)
+        {
+            const gpass_cache& cache{ frame_cache };
+            const gpu_driven_draws& persistent{ gpu_draws };
+            const u32 items_count{ cache.size() };
+            const u32 state_count{ (u32)persistent.states.size() };
+            const id::id_type* const d3d12_render_item_ids{ cache.d3d12_render_item_ids.data() };
+
+            core::transient_vector<u32> state_ids(2 * (u64)items_count);
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                const draw_record& record{ persistent.records[d3d12_render_item_ids[i]] };
+                state_ids[i] = record.depth_state_id;
+                state_ids[items_count + i] = record.gpass_state_id;
+            }
+
+            core::transient_vector<u32> state_counts(state_count, 0u);
+            count_indirect_draw_states(state_ids.data(), 2 * items_count, state_counts.data());
+
+            indirect_draws& draws{ indirect_frame_draws };
+            core::transient_vector<indirect_draw_slot> state_slots(state_count);
+            draws.groups.resize(state_count);
+            const u32 group_count{ build_indirect_draw_groups(state_counts.data(), persistent.state_keys.data(), state_count,
+                                                              draws.groups.data(), state_slots.data()) };
+            draws.groups.resize(group_count);
+
+            // NOTE: the pass is in the highest bits of the state keys, so the groups of the depth prepass come first.
+            draws.depth_group_count = 0;
+            while (draws.depth_group_count < group_count &&
+                   persistent.states[draws.groups[draws.depth_group_count].state_id].pass == draw_pass::depth_prepass)
+            {
+                ++draws.depth_group_count;
+            }
+
+            const indirect::draw_inputs inputs{ indirect::prepare_draws(d3d12_info.frame_index, items_count, state_count, group_count) };
+            memcpy(inputs.state_slots, state_slots.data(), state_count * sizeof(indirect_draw_slot));
+            static_assert(sizeof(id::id_type) == sizeof(u32));
+            memcpy(inputs.draw_list, d3d12_render_item_ids, items_count * sizeof(u32));
+        }
+
         void prepare_render_frame(const d3d12_frame_info& d3d12_info)
         {
             assert(d3d12_info.info && d3d12_info.camera);
             assert(d3d12_info.info->render_item_ids && d3d12_info.info->render_item_count);
             gpass_cache& cache{ frame_cache };
             cache.clear();
+            stats_of_last_frame = {};
+
+            indirect_frame_draws = {};
 
             using namespace content;
-            render_item::get_d3d12_render_item_ids(*d3d12_info.info, cache.d3d12_render_item_ids);
+            const bool gpu_driven{ d3d12_info.info->gpu_driven_draws };
+            core::transient_vector<f32> depths;
+            render_item::get_d3d12_render_item_ids(d3d12_info, cache.d3d12_render_item_ids);
+            // NOTE: the GPU-driven path culls the items on the GPU, so it keeps all of them.
+            if (!gpu_driven) cull_render_items(d3d12_info, cache.d3d12_render_item_ids, depths);
+            if (!cache.size()) return;
+
             cache.resize();
             const u32 items_count{ cache.size() };
             const render_item::items_cache items_cache{ cache.items_cache() };
             render_item::get_items(cache.d3d12_render_item_ids.data(), items_count, items_cache);
 
+            if (gpu_driven)
+            {
+                update_draw_records(d3d12_info);
+                fill_indirect_draws(d3d12_info);
+                return;
+            }
+
             const submesh::views_cache views_cache{ cache.views_cache() };
             submesh::get_views(items_cache.submesh_gpu_ids, items_count, views_cache);
 
             const material::material_cache materials_cache{ cache.materials_cache() };
             material::get_materials(items_cache.material_ids, items_count, materials_cache);
 
-            fill_per_object_data(d3d12_info);
+            fill_per_object_data();
+            sort_render_items(depths.data());
+        }
+
+        // Command lists don't inherit any state, so each command list that records draws needs this.
+        void set_command_list_state(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, draw_pass::type pass)
+        {
+            ID3D12DescriptorHeap* const heaps[]{ core::srv_heap().heap() };
+            cmd_list->SetDescriptorHeaps(1, &heaps[0]);
+
+            // NOTE: same viewport and scissor rectangle as the surface's.
+            const D3D12_VIEWPORT viewport{ 0.f, 0.f, (f32)d3d12_info.surface_width, (f32)d3d12_info.surface_height, 0.f, 1.f };
+            const D3D12_RECT scissor_rect{ 0, 0, (s32)d3d12_info.surface_width, (s32)d3d12_info.surface_height };
+            cmd_list->RSSetViewports(1, &viewport);
+            cmd_list->RSSetScissorRects(1, &scissor_rect);
+
+            const D3D12_CPU_DESCRIPTOR_HANDLE dsv{ gpass_depth_buffer.dsv() };
+            if (pass == draw_pass::depth_prepass)
+            {
+                cmd_list->OMSetRenderTargets(0, nullptr, 0, &dsv);
+            }
+            else
+            {
+                const D3D12_CPU_DESCRIPTOR_HANDLE rtv{ gpass_main_buffer.rtv(0) };
+                cmd_list->OMSetRenderTargets(1, &rtv, 0, &dsv);
+            }
+        }
+
+        // Sets a root signature and the root parameters that are the same for all draws of the pass.
+        void set_root_signature(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info,
+                                draw_pass::type pass, ID3D12RootSignature* const root_signature)
+        {
+            using idx = opaque_root_parameter;
+            cmd_list->SetGraphicsRootSignature(root_signature);
+            cmd_list->SetGraphicsRootConstantBufferView(idx::global_shader_data, d3d12_info.global_shader_data);
+            if (pass == draw_pass::depth_prepass) return;
+
+            const u32 frame_index{ d3d12_info.frame_index };
+            const id::id_type light_culling_id{ d3d12_info.light_culling_id };
+            cmd_list->SetGraphicsRootShaderResourceView(idx::directional_lights, light::non_cullable_light_buffer(frame_index));
+            cmd_list->SetGraphicsRootShaderResourceView(idx::cullable_lights, light::non_cullable_light_buffer(frame_index));
+            cmd_list->SetGraphicsRootShaderResourceView(idx::light_grid , delight::light_grid_opaque(light_culling_id, frame_index));
+            cmd_list->SetGraphicsRootShaderResourceView(idx::light_index_list, delight::light_index_list_opaque(light_culling_id, frame_index));
+        }
+
+        void record_depth_prepass(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, draw_range range, pass_stats& stats)
+        {
+            const gpass_cache& cache{ frame_cache };
+
+            ID3D12RootSignature* current_root_signature{ nullptr };
+            ID3D12PipelineState* current_pipeline_state{ nullptr };
+
+            for (u32 n{ range.begin }; n < range.end; ++n)
+            {
+                const u32 i{ cache.draw_order[n] };
+                if (current_root_signature != cache.root_signatures[i])
+                {
+                    current_root_signature = cache.root_signatures[i];
+                    set_root_signature(cmd_list, d3d12_info, draw_pass::depth_prepass, current_root_signature);
+                    ++stats.root_signature_changes;
+                }
+
+                if (current_pipeline_state != cache.depth_pipeline_states[i])
+                {
+                    current_pipeline_state = cache.depth_pipeline_states[i];
+                    cmd_list->SetPipelineState(current_pipeline_state);
+                    ++stats.pipeline_state_changes;
+                }
+
+                set_root_parameters(cmd_list, i);
+
+                const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[i] };
+                cmd_list->IASetIndexBuffer(&ibv);
+                cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[i]);
+                cmd_list->DrawIndexedInstanced(get_index_count(ibv), 1, 0, 0, 0);
+            }
+
+            stats.draw_count += range.end - range.begin;
+        }
+
+        void record_gpass(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, draw_range range, pass_stats& stats)
+        {
+            const gpass_cache& cache{ frame_cache };
+            const u32 items_count{ cache.size() };
+
+            ID3D12RootSignature* current_root_signature{ nullptr };
+            ID3D12PipelineState* current_pipeline_state{ nullptr };
+
+            for (u32 n{ range.begin }; n < range.end; ++n)
+            {
+                const u32 i{ cache.draw_order[items_count + n] };
+                if (current_root_signature != cache.root_signatures[i])
+                {
+                    current_root_signature = cache.root_signatures[i];
+                    set_root_signature(cmd_list, d3d12_info, draw_pass::gpass, current_root_signature);
+                    ++stats.root_signature_changes;
+                }
+
+                if (current_pipeline_state != cache.gpass_pipeline_states[i])
+                {
+                    current_pipeline_state = cache.gpass_pipeline_states[i];
+                    cmd_list->SetPipelineState(current_pipeline_state);
+                    ++stats.pipeline_state_changes;
+                }
+
+                set_root_parameters(cmd_list, i);
+
+                const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[i] };
+                cmd_list->IASetIndexBuffer(&ibv);
+                cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[i]);
+                cmd_list->DrawIndexedInstanced(get_index_count(ibv), 1, 0, 0, 0);
+            }
+
+            stats.draw_count += range.end - range.begin;
+        }
+
+        // State of recording one pass, for the command_recorder callbacks.
+        struct pass_recording {
+            const d3d12_frame_info*                 d3d12_info;
+            draw_pass::type                         pass;
+            id3d12_graphics_command_list*           cmd_list;               // the frame's current command list.
+            id3d12_graphics_command_list* const*    parallel_cmd_lists;     // nullptr if we record in cmd_list.
+            pass_stats                              list_stats[max_command_lists_per_pass];
+        };
+
+        void begin_recording(void* data, u32 list_count)
+        {
+            pass_recording& recording{ *(pass_recording*)data };
+            // NOTE: with only one list, we record in the current command list, which already has its state set.
+            if (list_count > 1) recording.parallel_cmd_lists = core::begin_parallel_command_lists(list_count);
+        }
+
+        void record_range(void* data, u32 list_index, draw_range range)
+        {
+            pass_recording& recording{ *(pass_recording*)data };
+            const d3d12_frame_info& d3d12_info{ *recording.d3d12_info };
+            id3d12_graphics_command_list* cmd_list{ recording.cmd_list };
+            if (recording.parallel_cmd_lists)
+            {
+                cmd_list = recording.parallel_cmd_lists[list_index];
+                set_command_list_state(cmd_list, d3d12_info, recording.pass);
+            }
+
+            pass_stats& stats{ recording.list_stats[list_index] };
+            if (recording.pass == draw_pass::depth_prepass) record_depth_prepass(cmd_list, d3d12_info, range, stats);
+            else record_gpass(cmd_list, d3d12_info, range, stats);
+
+            if (recording.parallel_cmd_lists)
+            {
+                DXCall(cmd_list->Close());
+            }
+        }
+
+        void end_recording(void* data, u32)
+        {
+            pass_recording& recording{ *(pass_recording*)data };
+            if (!recording.parallel_cmd_lists) return;
+
+            // The commands after this pass go to a new command list, which needs the state of the old one.
+            recording.cmd_list = core::end_parallel_command_lists();
+            set_command_list_state(recording.cmd_list, *recording.d3d12_info, recording.pass);
+        }
+
+        // Records the draws of a pass on the workers of the job system, in several command lists if there are
+        // enough draws. Returns the command list for the commands after this pass.
+        id3d12_graphics_command_list* record_pass(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, draw_pass::type pass)
+        {
+            pass_recording recording{ &d3d12_info, pass, cmd_list, nullptr, {} };
+            const command_recorder recorder{ &begin_recording, &record_range, &end_recording, &recording };
+            const u32 list_count{ record_draws(recorder, frame_cache.size()) };
+
+            pass_stats& stats{ pass == draw_pass::depth_prepass ? stats_of_last_frame.depth_prepass : stats_of_last_frame.gpass };
+            stats.command_list_count = list_count;
+            for (u32 i{ 0 }; i < list_count; ++i)
+            {
+                stats.draw_count += recording.list_stats[i].draw_count;
+                stats.root_signature_changes += recording.list_stats[i].root_signature_changes;
+                stats.pipeline_state_changes += recording.list_stats[i].pipeline_state_changes;
+            }
+
+            return recording.cmd_list;
+        }
+
+        // Draws each draw group of a pass with one ExecuteIndirect call. The culling shader wrote the arguments
+        // and the number of visible draws of each group.
+        void execute_indirect_draws(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, draw_pass::type pass)
+        {
+            const indirect_draws& draws{ indirect_frame_draws };
+            const gpu_driven_draws& persistent{ gpu_draws };
+            const bool is_depth_prepass{ pass == draw_pass::depth_prepass };
+            const u32 first_group{ is_depth_prepass ? 0 : draws.depth_group_count };
+            const u32 end_group{ is_depth_prepass ? draws.depth_group_count : (u32)draws.groups.size() };
+            pass_stats& stats{ is_depth_prepass ? stats_of_last_frame.depth_prepass : stats_of_last_frame.gpass };
+
+            ID3D12RootSignature* current_root_signature{ nullptr };
+            ID3D12PipelineState* current_pipeline_state{ nullptr };
+
+            for (u32 g{ first_group }; g < end_group; ++g)
+            {
+                const indirect_draw_group& group{ draws.groups[g] };
+                const draw_state& state{ persistent.states[group.state_id] };
+                assert(state.pass == pass);
+                if (current_root_signature != state.root_signature)
+                {
+                    current_root_signature = state.root_signature;
+                    set_root_signature(cmd_list, d3d12_info, pass, current_root_signature);
+                    ++stats.root_signature_changes;
+                }
+
+                if (current_pipeline_state != state.pipeline_state)
+                {
+                    current_pipeline_state = state.pipeline_state;
+                    cmd_list->SetPipelineState(current_pipeline_state);
+                    ++stats.pipeline_state_changes;
+                }
+
+                ID3D12CommandSignature* const signature{ indirect::command_signature(state.root_signature_id, current_root_signature) };
+                cmd_list->IASetPrimitiveTopology(state.primitive_topology);
+                indirect::execute_draws(cmd_list, d3d12_info.frame_index, signature, group, g);
+                stats.draw_count += group.max_draw_count;
+            }
+
+            stats.command_list_count = 1;
+            stats.execute_indirect_count = end_group - first_group;
         }
 
     } // anonymous namespace
@@ -270,6 +868,7 @@ namespace Quantum::graphics::d3d12::gpass {
 
     void shutdown()
     {
+        gpu_draws = {};
         gpass_main_buffer.release();
         gpass_depth_buffer.release();
         dimensions = initial_dimensions;
@@ -285,6 +884,11 @@ namespace Quantum::graphics::d3d12::gpass {
         return gpass_depth_buffer;
     }
 
+    frame_stats stats()
+    {
+        return stats_of_last_frame;
+    }
+
     void set_size(math::u32v2 size) 
     {
         math::u32v2& d{ dimensions };
@@ -295,82 +899,30 @@ namespace Quantum::graphics::d3d12::gpass {
         }
     }
 
-    void depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info)
+    id3d12_graphics_command_list* depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info,
+                                                d3dx::d3d12_resource_barrier& barriers)
     {
         prepare_render_frame(d3d12_info);
+        if (!d3d12_info.info->gpu_driven_draws) return record_pass(cmd_list, d3d12_info, draw_pass::depth_prepass);
 
-        const gpass_cache& cache{ frame_cache };
-        const u32 items_count{ cache.size() };
-
-        ID3D12RootSignature* current_root_signature{ nullptr };
-        ID3D12PipelineState* current_pipeline_state{ nullptr };
-
-        for (u32 i{ 0 }; i < items_count; ++i)
+        if (frame_cache.size())
         {
-            if (current_root_signature != cache.root_signatures[i])
-            {
-                current_root_signature = cache.root_signatures[i];
-                cmd_list->SetGraphicsRootSignature(current_root_signature);
-                cmd_list->SetGraphicsRootConstantBufferView(opaque_root_parameter::global_shader_data, d3d12_info.global_shader_data);
-            }
-
-            if (current_pipeline_state != cache.depth_pipeline_states[i])
-            {
-                current_pipeline_state = cache.depth_pipeline_states[i];
-                cmd_list->SetPipelineState(current_pipeline_state);
-            }
-
-            set_root_parameters(cmd_list, i);
-
-            const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[i] };
-            const u32 index_count{ ibv.SizeInBytes >> (ibv.Format == DXGI_FORMAT_R16_UINT ? 1 : 2) };
-
-            cmd_list->IASetIndexBuffer(&ibv);
-            cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[i]);
-            cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+            indirect::cull_draws(cmd_list, d3d12_info, barriers);
+            execute_indirect_draws(cmd_list, d3d12_info, draw_pass::depth_prepass);
         }
-    };
-
-    void render(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info) 
-    {
-        const gpass_cache& cache{ frame_cache };
-        const u32 items_count{ cache.size() };
-        const u32 frame_index{ d3d12_info.frame_index };
-        const id::id_type light_culling_id{ d3d12_info.light_culling_id };
-
-        ID3D12RootSignature* current_root_signature{ nullptr };
-        ID3D12PipelineState* current_pipeline_state{ nullptr };
 
-        for (u32 i{ 0 }; i < items_count; ++i)
-        {
-            if (current_root_signature != cache.root_signatures[i])
-            {
-                using idx = opaque_root_parameter;
-                current_root_signature = cache.root_signatures[i];
-                cmd_list->SetGraphicsRootSignature(current_root_signature);
-                cmd_list->SetGraphicsRootConstantBufferView(idx::global_shader_data, d3d12_info.global_shader_data);
-                cmd_list->SetGraphicsRootShaderResourceView(idx::directional_lights, light::non_cullable_light_buffer(frame_index));
-                cmd_list->SetGraphicsRootShaderResourceView(idx::cullable_lights, light::non_cullable_light_buffer(frame_index));
-                cmd_list->SetGraphicsRootShaderResourceView(idx::light_grid , delight::light_grid_opaque(light_culling_id, frame_index));
-                cmd_list->SetGraphicsRootShaderResourceView(idx::light_index_list, delight::light_index_list_opaque(light_culling_id, frame_index));
-            }
-
-            if (current_pipeline_state != cache.gpass_pipeline_states[i])
-            {
-                current_pipeline_state = cache.gpass_pipeline_states[i];
-                cmd_list->SetPipelineState(current_pipeline_state);
-            }
-
-            set_root_parameters(cmd_list, i);
+        return cmd_list;
+    }
 
-            const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[i] };
-            const u32 index_count{ ibv.SizeInBytes >> (ibv.Format == DXGI_FORMAT_R16_UINT ? 1 : 2) };
+    id3d12_graphics_command_list* render(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info,
+                                         d3dx::d3d12_resource_barrier& barriers)
+    {
+        if (!d3d12_info.info->gpu_driven_draws) return record_pass(cmd_list, d3d12_info, draw_pass::gpass);
 
-            cmd_list->IASetIndexBuffer(&ibv);
-            cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[i]);
-            cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
-        }
-    };
+        if (frame_cache.size()) execute_indirect_draws(cmd_list, d3d12_info, draw_pass::gpass);
+        indirect::build_hi_z(cmd_list, d3d12_info, barriers);
+        return cmd_list;
+    }
 
     void add_transitions_for_depth_prepass(d3dx::d3d12_resource_barrier& barriers)
     {
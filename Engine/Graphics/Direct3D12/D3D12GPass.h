@@ -30,16 +30,40 @@ namespace Quantum::graphics::d3d12::gpass {
         };
     };
 
+    struct pass_stats {
+        u32             draw_count{ 0 };
+        u32             command_list_count{ 0 };
+        u32             execute_indirect_count{ 0 };
+        u32             root_signature_changes{ 0 };
+        u32             pipeline_state_changes{ 0 };
+    };
+
+    struct frame_stats {
+        pass_stats      depth_prepass;
+        pass_stats      gpass;
+    };
+
     bool initialize();
     void shutdown();
 
     [[nodiscard]] const d3d12_render_texture& main_buffer();
     [[nodiscard]] const d3d12_depth_buffer& depth_buffer();
+    // Draws and state changes that were recorded for the last frame. Draws are sorted by state, so state changes
+    // should be close to the number of different root signatures and pipeline states that are used.
+    // With GPU-driven draws, draw_count is the number of draws before culling.
+    [[nodiscard]] frame_stats stats();
 
     // NOTE:: call this every frame before rendering anything in gpass.
     void set_size(math::u32v2 size);
-    void depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info);
-    void render(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info);
+    // The draws of these passes are recorded on several threads, in command lists of their own if there are
+    // enough of them. They return the command list for the commands that come after the pass.
+    // With GPU-driven draws (see frame_info), depth_prepass() culls the items on the GPU, both passes draw them
+    // with a few ExecuteIndirect calls in cmd_list, and render() builds the Hi-Z buffer for the next frame.
+    // NOTE: render() adds a transition barrier that the caller has to apply.
+    [[nodiscard]] id3d12_graphics_command_list* depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info,
+                                                              d3dx::d3d12_resource_barrier& barriers);
+    [[nodiscard]] id3d12_graphics_command_list* render(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info,
+                                                       d3dx::d3d12_resource_barrier& barriers);
 
     void add_transitions_for_depth_prepass(d3dx::d3d12_resource_barrier& barriers);
     void add_transitions_for_gpass(d3dx::d3d12_resource_barrier& barriers);
@@ -0,0 +1,480 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+#include "D3D12IndirectDraw.h"
+#include "D3D12Core.h"
+#include "D3D12Shaders.h"
+#include "D3D12Camera.h"
+#include "D3D12GPass.h"
+#include "Shaders/ShaderTypes.h"
+#include "Graphics/Culling.h"
+
+namespace Quantum::graphics::d3d12::indirect {
+    namespace {
+
+        struct draw_culling_root_parameter {
+            enum parameter : u32 {
+                constants,
+                draw_records,
+                hi_z_in,
+                draw_list,
+                draw_groups,
+                draw_arguments,
+                draw_counts,
+                hi_z_out,
+
+                count
+            };
+        };
+
+        // Records and per object data of all items, kept from frame to frame.
+        // NOTE: between frames, the record buffer stays in the state that the culling shader needs and the per object
+        //       data in the state that root CBVs need. They're only copy destinations while records are updated.
+        struct record_buffers
+        {
+            d3d12_buffer                    records;
+            d3d12_buffer                    per_object_data;
+            u32                             capacity{ 0 };
+        };
+
+        struct draw_buffers
+        {
+            // Upload buffer with the slots of the draw states, then the draw list.
+            d3d12_buffer                    inputs;
+            u8*                             inputs_cpu_address{ nullptr };
+            u32                             draw_list_offset{ 0 };
+            // Upload buffer with the per object data of the updated records, then the records.
+            d3d12_buffer                    updates;
+            u8*                             updates_cpu_address{ nullptr };
+            u32                             updated_records_offset{ 0 };
+            util::vector<u32>               updated_slots;
+            d3d12_buffer                    arguments;
+            uav_clearable_buffer            counts;
+            u32                             item_count{ 0 };
+            u32                             state_count{ 0 };
+            u32                             group_count{ 0 };
+        };
+
+        struct hi_z_buffer
+        {
+            d3d12_buffer                    buffer;
+            hi_z_layout                     layout{};
+            math::u32v2                     depth_size{};
+            math::m4x4                      view_projection{};
+            // NOTE: only the first cull after building the Hi-Z buffer uses it. If a frame doesn't build it,
+            //       its depth would be more than one frame old.
+            bool                            is_valid{ false };
+        };
+
+        constexpr u32                       cull_group_size{ 64 };
+        constexpr u32                       hi_z_tile_size{ 8 };
+        static_assert(max_hi_z_mips == _countof(hlsl::DrawCullingParameters::HiZMips));
+        // The culling shader reads the slots of the draw states as uint2.
+        static_assert(sizeof(indirect_draw_slot) == sizeof(math::u32v2));
+
+        ID3D12RootSignature*                draw_culling_root_signature{ nullptr };
+        ID3D12PipelineState*                cull_draws_pso{ nullptr };
+        ID3D12PipelineState*                build_hi_z_pso{ nullptr };
+        std::unordered_map<id::id_type, ID3D12CommandSignature*> command_signatures;
+        record_buffers                      persistent_records{};
+        draw_buffers                        frame_buffers[frame_buffer_count]{};
+        hi_z_buffer                         hi_z{};
+
+        bool create_root_signature()
+        {
+            assert(!draw_culling_root_signature);
+            using param = draw_culling_root_parameter;
+            d3dx::d3d12_root_parameter parameters[param::count]{};
+            parameters[param::constants].as_cbv(D3D12_SHADER_VISIBILITY_ALL, 0);
+            parameters[param::draw_records].as_srv(D3D12_SHADER_VISIBILITY_ALL, 0);
+            parameters[param::hi_z_in].as_srv(D3D12_SHADER_VISIBILITY_ALL, 1);
+            parameters[param::draw_list].as_srv(D3D12_SHADER_VISIBILITY_ALL, 2);
+            parameters[param::draw_groups].as_srv(D3D12_SHADER_VISIBILITY_ALL, 3);
+            parameters[param::draw_arguments].as_uav(D3D12_SHADER_VISIBILITY_ALL, 0);
+            parameters[param::draw_counts].as_uav(D3D12_SHADER_VISIBILITY_ALL, 1);
+            parameters[param::hi_z_out].as_uav(D3D12_SHADER_VISIBILITY_ALL, 2);
+
+            draw_culling_root_signature = d3dx::d3d12_root_signature_desc{ &parameters[0], _countof(parameters) }.create();
+            NAME_D3D12_OBJECT(draw_culling_root_signature, L"Draw Culling Root Signature");
+
+            return draw_culling_root_signature != nullptr;
+        }
+
+        bool create_psos()
+        {
+            {
+                assert(!cull_draws_pso);
+                struct {
+                    d3dx::d3d12_pipeline_state_subobject_root_signature root_signature{ draw_culling_root_signature };
+                    d3dx::d3d12_pipeline_state_subobject_cs cs{ shaders::get_engine_shader(shaders::engine_shader::cull_draws_cs) };
+                } stream;
+
+                cull_draws_pso = d3dx::create_pipeline_state(&stream, sizeof(stream));
+                NAME_D3D12_OBJECT(cull_draws_pso, L"Cull Draws PSO");
+            }
+            {
+                assert(!build_hi_z_pso);
+                struct {
+                    d3dx::d3d12_pipeline_state_subobject_root_signature root_signature{ draw_culling_root_signature };
+                    d3dx::d3d12_pipeline_state_subobject_cs cs{ shaders::get_engine_shader(shaders::engine_shader::build_hi_z_cs) };
+                } stream;
+
+                build_hi_z_pso = d3dx::create_pipeline_state(&stream, sizeof(stream));
+                NAME_D3D12_OBJECT(build_hi_z_pso, L"Build Hi-Z PSO");
+            }
+            return cull_draws_pso != nullptr && build_hi_z_pso != nullptr;
+        }
+
+        // Upload buffers are only written by the CPU, so they stay mapped.
+        u8* resize_upload_buffer(d3d12_buffer& buffer, u32 size, u32 frame_index, const wchar_t* const name)
+        {
+            buffer = d3d12_buffer{ constant_buffer::get_default_init_info(size), true };
+            NAME_D3D12_OBJECT_INDEXED(buffer.buffer(), frame_index, name);
+
+            u8* cpu_address{ nullptr };
+            D3D12_RANGE range{};
+            DXCall(buffer.buffer()->Map(0, &range, (void**)(&cpu_address)));
+            assert(cpu_address);
+            return cpu_address;
+        }
+
+        void resize_buffers(draw_buffers& buffers, u32 frame_index)
+        {
+            // NOTE: the draw list starts at a 16 byte boundary, like the structured buffers we create.
+            buffers.draw_list_offset = (u32)math::align_size_up<sizeof(math::v4)>(buffers.state_count * sizeof(indirect_draw_slot));
+            const u32 inputs_size{ buffers.draw_list_offset + buffers.item_count * (u32)sizeof(u32) };
+            // NOTE: both passes have their own argument slots for every item.
+            const u32 arguments_size{ 2 * buffers.item_count * sizeof(hlsl::IndirectDrawArguments) };
+            const u32 counts_size{ buffers.group_count * sizeof(u32) };
+
+            if (inputs_size > buffers.inputs.size())
+            {
+                buffers.inputs_cpu_address = resize_upload_buffer(buffers.inputs, inputs_size, frame_index, L"Indirect Draw Inputs Buffer");
+            }
+
+            d3d12_buffer_init_info info{};
+            info.alignment = sizeof(math::v4);
+            info.flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+            // NOTE: between frames, the argument and count buffers stay in the state that ExecuteIndirect needs.
+            info.initial_state = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+
+            if (arguments_size > buffers.arguments.size())
+            {
+                info.size = arguments_size;
+                buffers.arguments = d3d12_buffer{ info, false };
+                NAME_D3D12_OBJECT_INDEXED(buffers.arguments.buffer(), frame_index, L"Indirect Draw Arguments Buffer");
+            }
+
+            if (counts_size > buffers.counts.size())
+            {
+                info.size = counts_size;
+                buffers.counts = uav_clearable_buffer{ info };
+                NAME_D3D12_OBJECT_INDEXED(buffers.counts.buffer(), frame_index, L"Indirect Draw Counts Buffer");
+            }
+        }
+
+        // Copies runs of updated records with consecutive slots with one copy per buffer.
+        void copy_updated_records(id3d12_graphics_command_list* const cmd_list, const draw_buffers& buffers)
+        {
+            const record_buffers& persistent{ persistent_records };
+            const u32* const slots{ buffers.updated_slots.data() };
+            const u32 count{ (u32)buffers.updated_slots.size() };
+            constexpr u32 record_size{ sizeof(hlsl::IndirectDrawRecord) };
+
+            u32 first{ 0 };
+            while (first < count)
+            {
+                u32 end{ first + 1 };
+                while (end < count && slots[end] == slots[end - 1] + 1) ++end;
+
+                const u32 run{ end - first };
+                cmd_list->CopyBufferRegion(persistent.per_object_data.buffer(), (u64)slots[first] * per_object_data_stride,
+                                           buffers.updates.buffer(), (u64)first * per_object_data_stride, (u64)run * per_object_data_stride);
+                cmd_list->CopyBufferRegion(persistent.records.buffer(), (u64)slots[first] * record_size,
+                                           buffers.updates.buffer(), buffers.updated_records_offset + (u64)first * record_size, (u64)run * record_size);
+                first = end;
+            }
+        }
+
+        void resize_hi_z(u32 width, u32 height)
+        {
+            hi_z.layout = make_hi_z_layout(width, height);
+            hi_z.depth_size = { width, height };
+            const u32 size{ hi_z.layout.size * sizeof(f32) };
+            if (size <= hi_z.buffer.size()) return;
+
+            d3d12_buffer_init_info info{};
+            info.alignment = sizeof(math::v4);
+            info.flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+            info.initial_state = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+            info.size = size;
+            hi_z.buffer = d3d12_buffer{ info, false };
+            NAME_D3D12_OBJECT(hi_z.buffer.buffer(), L"Hi-Z Buffer");
+        }
+
+    } // anonymous namespace
+
+    bool initialize()
+    {
+        return create_root_signature() && create_psos();
+    }
+
+    void shutdown()
+    {
+        for (auto& [id, signature] : command_signatures)
+        {
+            core::deferred_release(signature);
+        }
+        command_signatures.clear();
+
+        for (u32 i{ 0 }; i < frame_buffer_count; ++i)
+        {
+            draw_buffers& buffers{ frame_buffers[i] };
+            buffers.inputs.release();
+            buffers.inputs_cpu_address = nullptr;
+            buffers.updates.release();
+            buffers.updates_cpu_address = nullptr;
+            buffers.updated_slots.clear();
+            buffers.arguments.release();
+            buffers.counts.release();
+            buffers.item_count = buffers.state_count = buffers.group_count = 0;
+        }
+
+        persistent_records.records.release();
+        persistent_records.per_object_data.release();
+        persistent_records.capacity = 0;
+
+        hi_z.buffer.release();
+        hi_z.is_valid = false;
+
+        assert(draw_culling_root_signature && cull_draws_pso && build_hi_z_pso);
+        core::deferred_release(draw_culling_root_signature);
+        core::deferred_release(cull_draws_pso);
+        core::deferred_release(build_hi_z_pso);
+    }
+
+    ID3D12CommandSignature* command_signature(id::id_type root_signature_id, ID3D12RootSignature* root_signature)
+    {
+        assert(id::is_valid(root_signature_id) && root_signature);
+        auto pair = command_signatures.find(root_signature_id);
+        if (pair != command_signatures.end()) return pair->second;
+
+        // Same order as the members of hlsl::IndirectDrawArguments.
+        using params = gpass::opaque_root_parameter;
+        D3D12_INDIRECT_ARGUMENT_DESC arguments[5]{};
+        arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+        arguments[0].ConstantBufferView.RootParameterIndex = params::per_object_data;
+        arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+        arguments[1].ShaderResourceView.RootParameterIndex = params::position_buffer;
+        arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+        arguments[2].ShaderResourceView.RootParameterIndex = params::element_buffer;
+        arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+        arguments[4].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC desc{};
+        desc.ByteStride = sizeof(hlsl::IndirectDrawArguments);
+        desc.NumArgumentDescs = _countof(arguments);
+        desc.pArgumentDescs = &arguments[0];
+
+        ID3D12CommandSignature* signature{ nullptr };
+        DXCall(core::device()->CreateCommandSignature(&desc, root_signature, IID_PPV_ARGS(&signature)));
+        NAME_D3D12_OBJECT_INDEXED(signature, root_signature_id, L"Indirect Draw Command Signature - root signature");
+        command_signatures[root_signature_id] = signature;
+        return signature;
+    }
+
+    bool reserve_records(u32 record_count)
+    {
+        record_buffers& persistent{ persistent_records };
+        if (record_count <= persistent.capacity) return false;
+
+        // NOTE: the buffers grow by half their size at least, so that they're rarely created again.
+        persistent.capacity = std::max(record_count, persistent.capacity + persistent.capacity / 2);
+
+        d3d12_buffer_init_info info{};
+        info.alignment = per_object_data_stride;
+        info.size = persistent.capacity * per_object_data_stride;
+        info.initial_state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+        persistent.per_object_data = d3d12_buffer{ info, false };
+        NAME_D3D12_OBJECT(persistent.per_object_data.buffer(), L"Indirect Draw Per Object Data Buffer");
+
+        info.alignment = sizeof(math::v4);
+        info.size = persistent.capacity * sizeof(hlsl::IndirectDrawRecord);
+        info.initial_state = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        persistent.records = d3d12_buffer{ info, false };
+        NAME_D3D12_OBJECT(persistent.records.buffer(), L"Indirect Draw Records Buffer");
+        return true;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS per_object_data(u32 record)
+    {
+        assert(record < persistent_records.capacity);
+        return persistent_records.per_object_data.gpu_address() + (u64)record * per_object_data_stride;
+    }
+
+    record_updates prepare_record_updates(u32 frame_index, const u32* const slots, u32 count)
+    {
+        assert(frame_index < frame_buffer_count && slots && count);
+        draw_buffers& buffers{ frame_buffers[frame_index] };
+        buffers.updated_slots.resize(count);
+        memcpy(buffers.updated_slots.data(), slots, count * sizeof(u32));
+
+        buffers.updated_records_offset = count * per_object_data_stride;
+        const u32 size{ buffers.updated_records_offset + count * (u32)sizeof(hlsl::IndirectDrawRecord) };
+        if (size > buffers.updates.size())
+        {
+            buffers.updates_cpu_address = resize_upload_buffer(buffers.updates, size, frame_index, L"Indirect Draw Record Updates Buffer");
+        }
+
+        return { (hlsl::IndirectDrawRecord*)(buffers.updates_cpu_address + buffers.updated_records_offset), buffers.updates_cpu_address };
+    }
+
+    draw_inputs prepare_draws(u32 frame_index, u32 item_count, u32 state_count, u32 group_count)
+    {
+        assert(frame_index < frame_buffer_count && item_count && state_count && group_count);
+        draw_buffers& buffers{ frame_buffers[frame_index] };
+        buffers.item_count = item_count;
+        buffers.state_count = state_count;
+        buffers.group_count = group_count;
+        resize_buffers(buffers, frame_index);
+        return { (u32*)(buffers.inputs_cpu_address + buffers.draw_list_offset), (indirect_draw_slot*)buffers.inputs_cpu_address };
+    }
+
+    void cull_draws(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, d3dx::d3d12_resource_barrier& barriers)
+    {
+        draw_buffers& buffers{ frame_buffers[d3d12_info.frame_index] };
+        const record_buffers& persistent{ persistent_records };
+        assert(buffers.item_count && buffers.group_count && persistent.capacity);
+
+        constant_buffer& cbuffer{ core::cbuffer() };
+        hlsl::DrawCullingParameters* const params{ cbuffer.allocate<hlsl::DrawCullingParameters>() };
+        {
+            hlsl::DrawCullingParameters data{};
+            math::m4x4 view_projection;
+            DirectX::XMStoreFloat4x4(&view_projection, d3d12_info.camera->view_projection());
+            const frustum view_frustum{ make_frustum(view_projection) };
+            memcpy(&data.FrustumPlanes[0], &view_frustum.planes[0], sizeof(data.FrustumPlanes));
+            data.NumItems = buffers.item_count;
+
+            if (hi_z.is_valid)
+            {
+                DirectX::XMStoreFloat4x4A(&data.HiZViewProjection, DirectX::XMLoadFloat4x4(&hi_z.view_projection));
+                data.HiZMipCount = hi_z.layout.mip_count;
+                data.HiZDepthSize = hi_z.depth_size;
+                for (u32 i{ 0 }; i < hi_z.layout.mip_count; ++i)
+                {
+                    const hi_z_mip& mip{ hi_z.layout.mips[i] };
+                    data.HiZMips[i] = { mip.width, mip.height, mip.offset, 0 };
+                }
+            }
+
+            memcpy(params, &data, sizeof(hlsl::DrawCullingParameters));
+        }
+
+        const bool has_updates{ !buffers.updated_slots.empty() };
+        if (has_updates)
+        {
+            barriers.add(persistent.records.buffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+            barriers.add(persistent.per_object_data.buffer(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+
+        // Make the argument and count buffers writable and reset the draw counts.
+        barriers.add(buffers.arguments.buffer(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        barriers.add(buffers.counts.buffer(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        barriers.apply(cmd_list);
+
+        if (has_updates)
+        {
+            copy_updated_records(cmd_list, buffers);
+            buffers.updated_slots.clear();
+            barriers.add(persistent.records.buffer(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            barriers.add(persistent.per_object_data.buffer(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+        }
+
+        const math::u32v4 clear_value{ 0, 0, 0, 0 };
+        buffers.counts.clear_uav(cmd_list, &clear_value.x);
+        // NOTE: this also applies the transitions of the record buffers back to their usual states.
+        barriers.add(buffers.counts.buffer());
+        barriers.apply(cmd_list);
+
+        using param = draw_culling_root_parameter;
+        cmd_list->SetComputeRootSignature(draw_culling_root_signature);
+        cmd_list->SetPipelineState(cull_draws_pso);
+        cmd_list->SetComputeRootConstantBufferView(param::constants, cbuffer.gpu_address(params));
+        cmd_list->SetComputeRootShaderResourceView(param::draw_records, persistent.records.gpu_address());
+        // NOTE: the root SRV must be a valid address, even if the shader doesn't read the Hi-Z buffer.
+        cmd_list->SetComputeRootShaderResourceView(param::hi_z_in, hi_z.buffer.buffer() ? hi_z.buffer.gpu_address() : persistent.records.gpu_address());
+        cmd_list->SetComputeRootShaderResourceView(param::draw_list, buffers.inputs.gpu_address() + buffers.draw_list_offset);
+        cmd_list->SetComputeRootShaderResourceView(param::draw_groups, buffers.inputs.gpu_address());
+        cmd_list->SetComputeRootUnorderedAccessView(param::draw_arguments, buffers.arguments.gpu_address());
+        cmd_list->SetComputeRootUnorderedAccessView(param::draw_counts, buffers.counts.gpu_address());
+        cmd_list->Dispatch((u32)math::align_size_up<cull_group_size>(buffers.item_count) / cull_group_size, 1, 1);
+
+        // NOTE: the draws are executed right after culling, so we apply these transitions here.
+        barriers.add(buffers.arguments.buffer(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        barriers.add(buffers.counts.buffer(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        barriers.apply(cmd_list);
+
+        hi_z.is_valid = false;
+    }
+
+    void execute_draws(id3d12_graphics_command_list* const cmd_list, u32 frame_index, ID3D12CommandSignature* const signature,
+                       const indirect_draw_group& group, u32 group_index)
+    {
+        assert(frame_index < frame_buffer_count && signature);
+        const draw_buffers& buffers{ frame_buffers[frame_index] };
+        assert(group_index < buffers.group_count && group.first_argument + group.max_draw_count <= 2 * buffers.item_count);
+        cmd_list->ExecuteIndirect(signature, group.max_draw_count,
+                                  buffers.arguments.buffer(), (u64)group.first_argument * sizeof(hlsl::IndirectDrawArguments),
+                                  buffers.counts.buffer(), (u64)group_index * sizeof(u32));
+    }
+
+    void build_hi_z(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, d3dx::d3d12_resource_barrier& barriers)
+    {
+        if (d3d12_info.surface_width != hi_z.depth_size.x || d3d12_info.surface_height != hi_z.depth_size.y)
+        {
+            resize_hi_z(d3d12_info.surface_width, d3d12_info.surface_height);
+        }
+
+        barriers.add(hi_z.buffer.buffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        barriers.apply(cmd_list);
+
+        using param = draw_culling_root_parameter;
+        cmd_list->SetComputeRootSignature(draw_culling_root_signature);
+        cmd_list->SetPipelineState(build_hi_z_pso);
+        cmd_list->SetComputeRootUnorderedAccessView(param::hi_z_out, hi_z.buffer.gpu_address());
+
+        constant_buffer& cbuffer{ core::cbuffer() };
+        const hi_z_layout& layout{ hi_z.layout };
+        for (u32 i{ 0 }; i < layout.mip_count; ++i)
+        {
+            const hi_z_mip& mip{ layout.mips[i] };
+            hlsl::HiZParameters* const params{ cbuffer.allocate<hlsl::HiZParameters>() };
+            hlsl::HiZParameters data{};
+            data.SourceSize = i ? math::u32v2{ layout.mips[i - 1].width, layout.mips[i - 1].height } : hi_z.depth_size;
+            data.DestinationSize = { mip.width, mip.height };
+            data.SourceOffset = i ? layout.mips[i - 1].offset : 0;
+            data.DestinationOffset = mip.offset;
+            data.DepthBufferSrvIndex = gpass::depth_buffer().srv().index;
+            data.IsFirstMip = i == 0;
+            memcpy(params, &data, sizeof(hlsl::HiZParameters));
+
+            // Each mip is built from the one before it.
+            if (i)
+            {
+                barriers.add(hi_z.buffer.buffer());
+                barriers.apply(cmd_list);
+            }
+
+            cmd_list->SetComputeRootConstantBufferView(param::constants, cbuffer.gpu_address(params));
+            cmd_list->Dispatch((u32)math::align_size_up<hi_z_tile_size>(mip.width) / hi_z_tile_size,
+                               (u32)math::align_size_up<hi_z_tile_size>(mip.height) / hi_z_tile_size, 1);
+        }
+
+        DirectX::XMStoreFloat4x4(&hi_z.view_projection, d3d12_info.camera->view_projection());
+        hi_z.is_valid = true;
+
+        // Make the Hi-Z buffer readable by the culling shader of the next frame.
+        // NOTE: this transition barrier will be applied by the caller of this function.
+        barriers.add(hi_z.buffer.buffer(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    }
+}
@@ -0,0 +1,62 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+#pragma once
+#include "D3D12CommonHeaders.h"
+#include "Graphics/IndirectDraw.h"
+
+namespace Quantum::graphics::d3d12 {
+    struct d3d12_frame_info;
+    namespace hlsl { struct IndirectDrawRecord; }
+}
+
+// GPU-driven draws: a compute shader culls the render items against the view frustum and the Hi-Z buffer of the
+// last frame and writes the draw arguments of the visible items. Each draw group is then drawn with one
+// ExecuteIndirect call, whatever the number of items in it.
+// The draw records and the per object data of the items are in persistent buffers, in which the caller only
+// rewrites the records that changed. Each frame only needs the list of records to draw and the draw group of each
+// draw state.
+namespace Quantum::graphics::d3d12::indirect {
+
+    // Size of the per object data of one record. Root CBVs must be aligned to it.
+    constexpr u32 per_object_data_stride{ D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT };
+
+    struct record_updates
+    {
+        hlsl::IndirectDrawRecord*       records;
+        u8*                             per_object_data;    // per_object_data_stride bytes per record.
+    };
+
+    struct draw_inputs
+    {
+        u32*                            draw_list;          // record of each item.
+        indirect_draw_slot*             state_slots;        // draw group of each draw state.
+    };
+
+    bool initialize();
+    void shutdown();
+
+    // Command signature for drawing with root signature 'root_signature_id', which must have the opaque root parameters.
+    // Command signatures are created on first use and kept until shutdown.
+    [[nodiscard]] ID3D12CommandSignature* command_signature(id::id_type root_signature_id, ID3D12RootSignature* root_signature);
+
+    // Makes room for 'record_count' persistent records. Returns true if the record buffers were created again. Then
+    // all records are lost and the caller must write them again.
+    [[nodiscard]] bool reserve_records(u32 record_count);
+    // GPU address of the per object data of a record, for the root CBV in its draw arguments.
+    [[nodiscard]] D3D12_GPU_VIRTUAL_ADDRESS per_object_data(u32 record);
+    // Makes room for rewriting 'count' records in this frame and returns where the caller writes them. Record i and
+    // its per object data are copied to record slots[i] before the draws are culled.
+    [[nodiscard]] record_updates prepare_record_updates(u32 frame_index, const u32* const slots, u32 count);
+    // Makes room for this frame's draws and returns their inputs, which the caller fills. Only the slots of the draw
+    // states that have draws need to be written.
+    [[nodiscard]] draw_inputs prepare_draws(u32 frame_index, u32 item_count, u32 state_count, u32 group_count);
+    // Copies the updated records to the record buffers and culls the items of prepare_draws(). The argument and
+    // count buffers are ready for ExecuteIndirect afterwards.
+    void cull_draws(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, d3dx::d3d12_resource_barrier& barriers);
+    void execute_draws(id3d12_graphics_command_list* const cmd_list, u32 frame_index, ID3D12CommandSignature* const signature,
+                       const indirect_draw_group& group, u32 group_index);
+
+    // Builds the Hi-Z buffer from the gpass depth buffer, for culling the draws of the next frame.
+    // NOTE: the depth buffer must be readable by compute shaders. The caller applies the last transition.
+    void build_hi_z(id3d12_graphics_command_list* const cmd_list, const d3d12_frame_info& d3d12_info, d3dx::d3d12_resource_barrier& barriers);
+}
@@ -63,7 +63,7 @@ namespace Quantum::graphics::d3d12::light {
                             params.Intensity = info.intensity;
 							
                             light_owner owner{ game_entity::entity_id{ info.entity_id}, index, info.type, info.is_enabled };
-                            const light_id id{ _owners.add(owner) };
+                            const light_id id{ add_owner(owner) };
                             _non_cullable_owners[index] = id;
 							
                             return graphics::light{ id, info.light_set_key };
@@ -91,8 +91,8 @@ namespace Quantum::graphics::d3d12::light {
 						
                         add_cullable_light_parameters(info, index);
                         add_light_culling_info(info, index);
-                        const light_id id{ _owners.add(light_owner{game_entity::entity_id{info.entity_id}, index, info.type, info.is_enabled}) };
-                        _cullable_entity_ids[index] = _owners[id].entity_id;
+                        const light_id id{ add_owner(light_owner{game_entity::entity_id{info.entity_id}, index, info.type, info.is_enabled}) };
+                        _cullable_entity_ids[index] = get_owner(id).entity_id;
                         _cullable_owners[index] = id;
                         make_dirty(index);
                         enable(id, info.is_enabled);
@@ -103,19 +103,20 @@ namespace Quantum::graphics::d3d12::light {
                 }
 				
                 constexpr void remove(light_id id) {
+                    assert(_owner_ids.is_alive(id));
                     enable(id, false);
 					
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
 					
                     if (owner.type == graphics::light::directional) {
                         _non_cullable_owners[owner.data_index] = light_id{ id::invalid_id };
                     }
                     else {
-                        assert(_owners[_cullable_owners[owner.data_index]].data_index == owner.data_index);
+                        assert(get_owner(_cullable_owners[owner.data_index]).data_index == owner.data_index);
                         _cullable_owners[owner.data_index] = light_id{ id::invalid_id };
                     }
 					
-                    _owners.remove(id);
+                    _owner_ids.release(id);
                 }
 				
                 void update_transforms() {
@@ -123,7 +124,7 @@ namespace Quantum::graphics::d3d12::light {
                     for (const auto& id : _non_cullable_owners) {
                         if (!id::is_valid(id)) continue;
 						
-                        const light_owner& owner{ _owners[id] };
+                        const light_owner& owner{ get_owner(id) };
                         if (owner.is_enabled)
                         {
                             const game_entity::entity entity{ game_entity::entity_id{ owner.entity_id} };
@@ -149,14 +150,14 @@ namespace Quantum::graphics::d3d12::light {
                 }
 				
                 constexpr void enable(light_id id, bool is_enabled) {
-                    _owners[id].is_enabled = is_enabled;
+                    get_owner(id).is_enabled = is_enabled;
 					
-                    if (_owners[id].type == graphics::light::directional) {
+                    if (get_owner(id).type == graphics::light::directional) {
                         return;
                     }
 					
                     // Cullable lights
-                    const u32 data_index{ _owners[id].data_index };
+                    const u32 data_index{ get_owner(id).data_index };
 					
                     // NOTE: this is a reference to _enable_light_count and will change its value!
                     u32& count{ _enabled_light_count };
@@ -186,7 +187,7 @@ namespace Quantum::graphics::d3d12::light {
                 constexpr void intensity(light_id id, f32 intensity) {
                     if (intensity < 0.f) intensity = 0.f;
 					
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
 					
                     if (owner.type == graphics::light::directional) {
@@ -194,7 +195,7 @@ namespace Quantum::graphics::d3d12::light {
                         _non_cullable_lights[index].Intensity = intensity;
                     }
                     else {
-                        assert(_owners[_cullable_owners[index]].data_index == index);
+                        assert(get_owner(_cullable_owners[index]).data_index == index);
                         assert(index < _cullable_lights.size());
                         _cullable_lights[index].Intensity = intensity;
                         make_dirty(index);
@@ -205,14 +206,14 @@ namespace Quantum::graphics::d3d12::light {
                     assert(color.x <= 1.f && color.y <= 1.f && color.z <= 1.f);
                     assert(color.x >= 0.f && color.y >= 0.f && color.z >= 0.f);
 					
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
                     if (owner.type == graphics::light::directional) {
                         assert(index < _non_cullable_lights.size());
                         _non_cullable_lights[index].Intensity;
                     }
                     else {
-                        assert(_owners[_cullable_owners[index]].data_index == index);
+                        assert(get_owner(_cullable_owners[index]).data_index == index);
                         assert(index < _cullable_lights.size());
                         _cullable_lights[index].Color = color;
                         make_dirty(index);
@@ -221,9 +222,9 @@ namespace Quantum::graphics::d3d12::light {
 				
                 CONSTEXPR void attenuation(light_id id, math::v3 attenuation) {
                     assert(attenuation.x >= 0.f && attenuation.y >= 0.f && attenuation.z >= 0.f);
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type != graphics::light::directional);
                     assert(index < _cullable_lights.size());
                     _cullable_lights[index].Attenuation = attenuation;
@@ -232,9 +233,9 @@ namespace Quantum::graphics::d3d12::light {
 				
                 CONSTEXPR void range(light_id id, f32 range) {
                     assert(range > 0.f);
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type != graphics::light::directional);
                     assert(index < _cullable_lights.size());
                     _cullable_lights[index].Range = range;
@@ -256,9 +257,9 @@ namespace Quantum::graphics::d3d12::light {
                 }
 				
                 void umbra(light_id id, f32 umbra) {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type == graphics::light::spot);
                     assert(index < _cullable_lights.size());
 					
@@ -273,9 +274,9 @@ namespace Quantum::graphics::d3d12::light {
                 }
 				
                 void penumbra(light_id id, f32 penumbra) {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type == graphics::light::spot);
                     assert(index < _cullable_lights.size());
 					
@@ -292,11 +293,11 @@ namespace Quantum::graphics::d3d12::light {
                 }
 				
                 constexpr bool is_enabled(light_id id) const {
-                    return _owners[id].is_enabled;
+                    return get_owner(id).is_enabled;
                 }
 				
                 constexpr f32 intensity(light_id id) const {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
                     if (owner.type == graphics::light::directional)
                     {
@@ -304,13 +305,13 @@ namespace Quantum::graphics::d3d12::light {
                         return _non_cullable_lights[index].Intensity;
                     }
 					
-	                assert(_owners[_cullable_owners[index]].data_index == index);
+	                assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(index < _cullable_lights.size());
                     return _cullable_lights[index].Intensity;
                 }
 				
                 constexpr math::v3 color(light_id id) const {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
                     if (owner.type == graphics::light::directional)
                     {
@@ -318,53 +319,53 @@ namespace Quantum::graphics::d3d12::light {
                         return _non_cullable_lights[index].Color;
                     }
              
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(index < _cullable_lights.size());
                     return _cullable_lights[index].Color;
                 }
 				
                 CONSTEXPR math::v3 attenuation(light_id id) const {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type != graphics::light::directional);
                     assert(index < _cullable_lights.size());
                     return _cullable_lights[index].Attenuation;
                 }
 				
                 CONSTEXPR f32 range(light_id id) const {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type != graphics::light::directional);
                     assert(index < _cullable_lights.size());
                     return _cullable_lights[index].Range;
                 }
 				
                 f32 umbra(light_id id) const {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type != graphics::light::spot);
                     assert(index < _cullable_lights.size());
                     return DirectX::XMScalarACos(_cullable_lights[index].CosUmbra) * 2.f;
                 }
 				
                 f32 penumbra(light_id id) const {
-                    const light_owner& owner{ _owners[id] };
+                    const light_owner& owner{ get_owner(id) };
                     const u32 index{ owner.data_index };
-                    assert(_owners[_cullable_owners[index]].data_index == index);
+                    assert(get_owner(_cullable_owners[index]).data_index == index);
                     assert(owner.type != graphics::light::spot);
                     assert(index < _cullable_lights.size());
                     return DirectX::XMScalarACos(_cullable_lights[index].CosPenumbra) * 2.f;
                 }
 				
                 constexpr graphics::light::type type(light_id id) const {
-                    return _owners[id].type;
+                    return get_owner(id).type;
                 }
 				
                 constexpr id::id_type entity_id(light_id id) const {
-                    return _owners[id].entity_id;
+                    return get_owner(id).entity_id;
                 }
 				
                 // Return the number of enabled directional lights
@@ -372,7 +373,7 @@ namespace Quantum::graphics::d3d12::light {
                     u32 count{ 0 };
                     for (const auto& id : _non_cullable_owners)
                     {
-                        if (id::is_valid(id) && _owners[id].is_enabled) ++count;
+                        if (id::is_valid(id) && get_owner(id).is_enabled) ++count;
                     }
 					
                     return count;
@@ -386,10 +387,10 @@ namespace Quantum::graphics::d3d12::light {
                     {
                         if (!id::is_valid(_non_cullable_owners[i])) continue;
 						
-                        const light_owner& owner{ _owners[_non_cullable_owners[i]] };
+                        const light_owner& owner{ get_owner(_non_cullable_owners[i]) };
                         if (owner.is_enabled)
                         {
-                            assert(_owners[_non_cullable_owners[i]].data_index == i);
+                            assert(get_owner(_non_cullable_owners[i]).data_index == i);
                             lights[index] = _non_cullable_lights[i];
                             ++index;
                         }
@@ -401,11 +402,35 @@ namespace Quantum::graphics::d3d12::light {
                 }
 				
                 constexpr bool has_lights() const {
-                    return _owners.size() > 0;
+                    return _owner_ids.size() > 0;
                 }
 				
             private:
 				
+                // NOTE: ids are checked, so that a stale light id asserts instead of reading the light that reused its slot.
+                CONSTEXPR light_owner& get_owner(light_id id) {
+                    assert(_owner_ids.is_alive(id));
+                    return _owners[_owner_ids.index(id)];
+                }
+				
+                CONSTEXPR const light_owner& get_owner(light_id id) const {
+                    assert(_owner_ids.is_alive(id));
+                    return _owners[_owner_ids.index(id)];
+                }
+				
+                CONSTEXPR light_id add_owner(const light_owner& owner) {
+                    const light_id id{ _owner_ids.allocate() };
+                    const id::id_type index{ _owner_ids.index(id) };
+                    if (index >= _owners.size())
+                    {
+                        assert(index == _owners.size());
+                        _owners.emplace_back();
+                    }
+					
+                    _owners[index] = owner;
+                    return id;
+                }
+				
                 f32 calculate_cone_radius(f32 range, f32 cos_penumbra) {
                     const f32 sin_penumbra{ sqrt(1.f - cos_penumbra * cos_penumbra) };
                     return sin_penumbra * range;
@@ -438,7 +463,7 @@ namespace Quantum::graphics::d3d12::light {
                     hlsl::LightCullingLightInfo& culling_info{ _culling_info[index] };
                     culling_info.Position = _bounding_spheres[index].Center = params.Position;
 					
-                    if (_owners[_cullable_owners[index]].type == graphics::light::spot)
+                    if (get_owner(_cullable_owners[index]).type == graphics::light::spot)
                     {
                         culling_info.Direction = params.Direction = entity.orientation();
                         calculate_cone_bounding_sphere(params, _bounding_spheres[index]);
@@ -513,7 +538,7 @@ namespace Quantum::graphics::d3d12::light {
                     }
                        
                     if (!id::is_valid(_cullable_owners[index1])) {
-                        light_owner& owner2{ _owners[_cullable_owners[index2]] };
+                        light_owner& owner2{ get_owner(_cullable_owners[index2]) };
                         assert(owner2.data_index == index2);
                         owner2.data_index = index1;
                         
@@ -523,12 +548,12 @@ namespace Quantum::graphics::d3d12::light {
                         _cullable_entity_ids[index1] = _cullable_entity_ids[index2];
                         std::swap(_cullable_owners[index1], _cullable_owners[index2]);
                         make_dirty(index1);
-                        assert(_owners[_cullable_owners[index1]].entity_id == _cullable_entity_ids[index1]);
+                        assert(get_owner(_cullable_owners[index1]).entity_id == _cullable_entity_ids[index1]);
                         assert(!id::is_valid(_cullable_owners[index2]));
                     }
                     else {
-                        light_owner& owner1{ _owners[_cullable_owners[index1]] };
-                        light_owner& owner2{ _owners[_cullable_owners[index2]] };
+                        light_owner& owner1{ get_owner(_cullable_owners[index1]) };
+                        light_owner& owner2{ get_owner(_cullable_owners[index2]) };
                         assert(owner1.data_index == index1);
                         assert(owner2.data_index == index2);
                         owner1.data_index = index2;
@@ -540,8 +565,8 @@ namespace Quantum::graphics::d3d12::light {
                         std::swap(_cullable_entity_ids[index1], _cullable_entity_ids[index2]);
                         std::swap(_cullable_owners[index1], _cullable_owners[index2]);
                            
-                        assert(_owners[_cullable_owners[index1]].entity_id == _cullable_entity_ids[index1]);
-                        assert(_owners[_cullable_owners[index2]].entity_id == _cullable_entity_ids[index2]);
+                        assert(get_owner(_cullable_owners[index1]).entity_id == _cullable_entity_ids[index1]);
+                        assert(get_owner(_cullable_owners[index2]).entity_id == _cullable_entity_ids[index2]);
                             
                         // set dirty bits
                         make_dirty(index1);
@@ -555,7 +580,8 @@ namespace Quantum::graphics::d3d12::light {
                 }
                     
                 // NOTE: these are NOT tightly packed
-                util::free_list<light_owner>                        _owners;
+                id::allocator<>                                     _owner_ids;
+                util::vector<light_owner>                           _owners;
                 util::vector<hlsl::DirectionalLightParameters>      _non_cullable_lights;
                 util::vector<light_id>                              _non_cullable_owners;
                     
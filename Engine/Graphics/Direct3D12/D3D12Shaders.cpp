@@ -12,15 +12,15 @@ namespace Quantum::graphics::d3d12::shaders {
 
         // This is a chunk of memory that contains all compiled engine shaders.
         // The blob is an array of shader byte code consisting of a u64 size and
-        // an array of bytes.
-        std::unique_ptr<u8[]> engine_shaders_blob{};
+        // an array of bytes. It's mapped from the engine shaders file rather than read into memory.
+        platform::mapped_file engine_shaders_blob{};
 
         bool load_engine_shaders()
         {
-            assert(!engine_shaders_blob);
-            u64 size{ 0 };
-            bool result{ content::load_engine_shaders(engine_shaders_blob, size) };
-            assert(engine_shaders_blob && size);
+            assert(!engine_shaders_blob.is_open());
+            bool result{ content::load_engine_shaders(engine_shaders_blob) };
+            assert(engine_shaders_blob.is_open());
+            const u64 size{ engine_shaders_blob.size() };
 
             u64 offset{ 0 };
             u32 index{ 0 };
@@ -31,7 +31,7 @@ namespace Quantum::graphics::d3d12::shaders {
                 assert(!shader);
                 result &= index < engine_shader::count && !shader;
                 if (!result) break;
-                shader = reinterpret_cast<const content::compiled_shader_ptr>(&engine_shaders_blob[offset]);
+                shader = reinterpret_cast<const content::compiled_shader_ptr>(&engine_shaders_blob.data()[offset]);
                 offset += shader->buffer_size();
                 ++index;
             }
@@ -52,7 +52,7 @@ namespace Quantum::graphics::d3d12::shaders {
         {
             engine_shaders[i] = {};
         }
-        engine_shaders_blob.reset();
+        engine_shaders_blob.close();
     }
 
     D3D12_SHADER_BYTECODE get_engine_shader(engine_shader::id id)
@@ -13,6 +13,8 @@ namespace Quantum::graphics::d3d12::shaders {
             post_process_ps = 2,
             grid_frustums_cs = 3,
             light_culling_cs = 4,
+            cull_draws_cs = 5,
+            build_hi_z_cs = 6,
 
             count
         };
@@ -0,0 +1,35 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+#include "Common.hlsli"
+
+ConstantBuffer<HiZParameters>                       ShaderParams                    : register(b0, space0);
+RWStructuredBuffer<float>                           HiZ                             : register(u2, space0);
+
+#define TILE_SIZE 8
+
+float SourceDepth(uint2 texel)
+{
+    if (ShaderParams.IsFirstMip)
+    {
+        Texture2D<float> depthBuffer = ResourceDescriptorHeap[ShaderParams.DepthBufferSrvIndex];
+        return depthBuffer[texel];
+    }
+
+    return HiZ[ShaderParams.SourceOffset + texel.y * ShaderParams.SourceSize.x + texel.x];
+}
+
+// Writes one texel of a Hi-Z mip with the farthest depth of the 2x2 texels below it. We use reversed depth,
+// so the farthest depth is the smallest. The last row and column of odd sized mips are read twice.
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void BuildHiZCS(ComputeShaderInput csIn)
+{
+    const uint2 texel = csIn.DispatchThreadID.xy;
+    if (any(texel >= ShaderParams.DestinationSize)) return;
+
+    const uint2 source = texel * 2;
+    const uint2 last = ShaderParams.SourceSize - 1;
+    const float depth = min(min(SourceDepth(source), SourceDepth(min(source + uint2(1, 0), last))),
+                            min(SourceDepth(min(source + uint2(0, 1), last)), SourceDepth(min(source + 1, last))));
+
+    HiZ[ShaderParams.DestinationOffset + texel.y * ShaderParams.DestinationSize.x + texel.x] = depth;
+}
@@ -24,11 +24,12 @@ struct GlobalShaderData
     float           DeltaTime;
 };
 
+// NOTE: nothing in here depends on the camera, so GPU-driven draws keep it in a persistent buffer and only
+//       rewrite it when the transform changes. Shaders multiply World by GlobalShaderData.ViewProjection.
 struct PerObjectData
 {
     float4x4 World;
     float4x4 InvWorld;
-    float4x4 WorldViewProjection;
 };
 
 struct Plane
@@ -146,9 +147,78 @@ struct DirectionalLightParameters
     float _padding;
 };
 
+// Arguments of one indirect draw, in the order of the command signature's arguments: the root CBV of the
+// per object data, the root SRVs of the position and element buffers, the index buffer view and the
+// arguments of DrawIndexedInstanced. GPU virtual addresses are split in their low and high 32 bits.
+struct IndirectDrawArguments
+{
+    uint2   PerObjectData;
+    uint2   PositionBuffer;
+    uint2   ElementBuffer;
+
+    uint2   IndexBufferLocation;
+    uint    IndexBufferSize;
+    uint    IndexFormat;
+
+    uint    IndexCountPerInstance;
+    uint    InstanceCount;
+    uint    StartIndexLocation;
+    int     BaseVertexLocation;
+
+    uint    StartInstanceLocation;
+    uint    _padding;
+};
+
+// One render item for the draw culling shader. Records are kept in a persistent buffer from frame to frame and
+// only rewritten when the item or its transform changes. If the item is visible, the shader copies its draw
+// arguments to the argument slots of the draw groups of its draw states in the depth prepass and the gpass.
+struct IndirectDrawRecord
+{
+    float4                  Sphere;                 // world space bounding sphere (center and radius).
+    IndirectDrawArguments   Arguments;
+
+    uint                    DepthStateId;
+    uint                    GPassStateId;
+    uint2                   _padding;
+};
+
+struct DrawCullingParameters
+{
+    // View-projection matrix of the frame whose depth buffer is in the Hi-Z buffer.
+    float4x4    HiZViewProjection;
+    // Frustum planes of the current camera in world space, pointing inwards.
+    float4      FrustumPlanes[6];
+
+    // Number of items in this frame's draw list.
+    uint        NumItems;
+    // 0 if there's no Hi-Z buffer from the last frame. Then items are only culled against the frustum.
+    uint        HiZMipCount;
+    // Size of the depth buffer that the Hi-Z buffer was built from.
+    uint2       HiZDepthSize;
+
+    // Width, height and offset of each Hi-Z mip.
+    uint4       HiZMips[16];
+};
+
+struct HiZParameters
+{
+    uint2   SourceSize;
+    uint2   DestinationSize;
+
+    // Offsets in the Hi-Z buffer. SourceOffset isn't used for the first mip, which is read from the depth buffer.
+    uint    SourceOffset;
+    uint    DestinationOffset;
+    uint    DepthBufferSrvIndex;
+    uint    IsFirstMip;
+};
+
 #ifdef __cplusplus 
 static_assert((sizeof(PerObjectData) % 16) == 0,"Make sure PerObjectData is formatted in 16-byte chunks without any implicit padding.");
 static_assert((sizeof(LightParameters) % 16) == 0,"Make sure LightParameters is formatted in 16-bite chunks without any implicit padding.");
 static_assert((sizeof(LightCullingLightInfo) % 16) == 0,"Make sure LightCullingLightInfo is formatted in 16-bite chunks without any implicit padding.");
 static_assert((sizeof(DirectionalLightParameters) % 16) == 0,"Make sure DirectionalLightParameters is formatted in 16-byte chunks without any implicit padding.");
+static_assert((sizeof(IndirectDrawArguments) % 16) == 0,"Make sure IndirectDrawArguments is formatted in 16-byte chunks without any implicit padding.");
+static_assert((sizeof(IndirectDrawRecord) % 16) == 0,"Make sure IndirectDrawRecord is formatted in 16-byte chunks without any implicit padding.");
+static_assert((sizeof(DrawCullingParameters) % 16) == 0,"Make sure DrawCullingParameters is formatted in 16-byte chunks without any implicit padding.");
+static_assert((sizeof(HiZParameters) % 16) == 0,"Make sure HiZParameters is formatted in 16-byte chunks without any implicit padding.");
 #endif
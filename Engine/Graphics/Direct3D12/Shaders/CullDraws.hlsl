@@ -0,0 +1,96 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+#include "Common.hlsli"
+
+ConstantBuffer<DrawCullingParameters>               ShaderParams                    : register(b0, space0);
+StructuredBuffer<IndirectDrawRecord>                DrawRecords                     : register(t0, space0);
+StructuredBuffer<float>                             HiZ                             : register(t1, space0);
+// Records of this frame's items.
+StructuredBuffer<uint>                              DrawList                        : register(t2, space0);
+// First argument slot and draw counter of the draw group of each draw state in this frame.
+StructuredBuffer<uint2>                             DrawGroups                      : register(t3, space0);
+
+RWStructuredBuffer<IndirectDrawArguments>           DrawArguments                   : register(u0, space0);
+RWStructuredBuffer<uint>                            DrawCounts                      : register(u1, space0);
+
+#define GROUP_SIZE 64
+
+bool IsInFrustum(float4 sphere)
+{
+    for (uint i = 0; i < 6; ++i)
+    {
+        const float4 plane = ShaderParams.FrustumPlanes[i];
+        if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w) return false;
+    }
+
+    return true;
+}
+
+float HiZDepth(uint mip, uint2 texel)
+{
+    const uint4 m = ShaderParams.HiZMips[mip];
+    texel = min(texel, m.xy - 1);
+    return HiZ[m.z + texel.y * m.x + texel.x];
+}
+
+// Tests the bounding box of the sphere against the depth buffer of the last frame. We use reversed depth, so
+// an item is occluded if its nearest point is farther (smaller) than the farthest depth in its screen rectangle.
+bool IsOccluded(float4 sphere)
+{
+    if (ShaderParams.HiZMipCount == 0) return false;
+
+    float2 minUV = 1.f;
+    float2 maxUV = 0.f;
+    float nearestDepth = 0.f;
+    for (uint i = 0; i < 8; ++i)
+    {
+        const float3 corner = sphere.xyz + sphere.w * float3((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f);
+        const float4 clip = mul(ShaderParams.HiZViewProjection, float4(corner, 1.f));
+        // The box is (partly) behind the camera, so we can't tell where it is on the screen.
+        if (clip.w <= 0.f) return false;
+
+        const float3 ndc = clip.xyz / clip.w;
+        const float2 uv = ndc.xy * float2(0.5f, -0.5f) + 0.5f;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        nearestDepth = max(nearestDepth, ndc.z);
+    }
+
+    if (nearestDepth >= 1.f) return false;
+
+    const float2 depthSize = (float2)ShaderParams.HiZDepthSize;
+    const uint2 minPixel = (uint2)(saturate(minUV) * depthSize);
+    const uint2 maxPixel = min((uint2)(saturate(maxUV) * depthSize), ShaderParams.HiZDepthSize - 1);
+
+    // A texel of mip m covers 2^(m+1) pixels, so in the first mip with 2^(m+1) > extent, the rectangle
+    // covers at most 2x2 texels.
+    const uint extent = max(maxPixel.x - minPixel.x, maxPixel.y - minPixel.y);
+    const uint mip = min(extent ? firstbithigh(extent) : 0, ShaderParams.HiZMipCount - 1);
+    const uint2 minTexel = minPixel >> (mip + 1);
+    const uint2 maxTexel = maxPixel >> (mip + 1);
+
+    const float farthestDepth = min(min(HiZDepth(mip, minTexel), HiZDepth(mip, uint2(maxTexel.x, minTexel.y))),
+                                    min(HiZDepth(mip, uint2(minTexel.x, maxTexel.y)), HiZDepth(mip, maxTexel)));
+
+    return nearestDepth < farthestDepth;
+}
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CullDrawsCS(ComputeShaderInput csIn)
+{
+    const uint index = csIn.DispatchThreadID.x;
+    if (index >= ShaderParams.NumItems) return;
+
+    const IndirectDrawRecord record = DrawRecords[DrawList[index]];
+    if (!IsInFrustum(record.Sphere) || IsOccluded(record.Sphere)) return;
+
+    // Both passes draw the same items, each in the argument slots of its own draw group.
+    uint slot;
+    const uint2 depthGroup = DrawGroups[record.DepthStateId];
+    InterlockedAdd(DrawCounts[depthGroup.y], 1, slot);
+    DrawArguments[depthGroup.x + slot] = record.Arguments;
+
+    const uint2 gpassGroup = DrawGroups[record.GPassStateId];
+    InterlockedAdd(DrawCounts[gpassGroup.y], 1, slot);
+    DrawArguments[gpassGroup.x + slot] = record.Arguments;
+}
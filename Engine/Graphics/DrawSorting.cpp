@@ -0,0 +1,100 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "DrawSorting.h"
+#include "Core/JobSystem.h"
+
+namespace Quantum::graphics {
+    namespace {
+
+        constexpr u32 radix_bits{ 8 };
+        constexpr u32 radix{ 1 << radix_bits };
+        constexpr u32 radix_mask{ radix - 1 };
+        constexpr u32 min_batch_size{ 8192 };
+        constexpr u32 max_batches{ 64 };
+        static_assert(max_batches * radix == radix_sort_histogram_size);
+
+    } // anonymous namespace
+
+    void
+    radix_sort(u64* const keys, u32* const values, u32 count, u64* const temp_keys, u32* const temp_values,
+               u32* const histograms)
+    {
+        assert(keys && values && temp_keys && temp_values && histograms);
+        if (count < 2) return;
+
+        // NOTE: each batch needs its own histogram to know where to put its keys. We use a fixed number of
+        //       batches that we split between the workers, so the scatter is the same with any number of workers.
+        const u32 batch_size{ std::max(min_batch_size, (count + max_batches - 1) / max_batches) };
+        const u32 batch_count{ (count + batch_size - 1) / batch_size };
+        const auto for_each_batch = [batch_size, batch_count, count](auto&& fn) {
+            jobs::parallel_for(batch_count, 1, [&](u32 begin, u32 end) {
+                for (u32 batch{ begin }; batch < end; ++batch)
+                {
+                    fn(batch, batch * batch_size, std::min((batch + 1) * batch_size, count));
+                }
+            });
+        };
+
+        // Find the bytes that are different in some keys. We don't have to sort by the others.
+        u64 batch_differences[max_batches];
+        for_each_batch([&](u32 batch, u32 begin, u32 end) {
+            u64 difference{ 0 };
+            for (u32 i{ begin }; i < end; ++i) difference |= keys[i] ^ keys[0];
+            batch_differences[batch] = difference;
+        });
+
+        u64 difference{ 0 };
+        for (u32 i{ 0 }; i < batch_count; ++i) difference |= batch_differences[i];
+
+        u64* source_keys{ keys };
+        u32* source_values{ values };
+        u64* target_keys{ temp_keys };
+        u32* target_values{ temp_values };
+
+        for (u32 shift{ 0 }; shift < 64; shift += radix_bits)
+        {
+            if (!((difference >> shift) & radix_mask)) continue;
+
+            for_each_batch([&](u32 batch, u32 begin, u32 end) {
+                u32* const histogram{ &histograms[batch * radix] };
+                memset(histogram, 0, radix * sizeof(u32));
+                for (u32 i{ begin }; i < end; ++i) ++histogram[(source_keys[i] >> shift) & radix_mask];
+            });
+
+            // Turn the counts into the first index of each digit in each batch. Batches come one after the other
+            // within a digit, which keeps the sort stable.
+            u32 offset{ 0 };
+            for (u32 digit{ 0 }; digit < radix; ++digit)
+            {
+                for (u32 batch{ 0 }; batch < batch_count; ++batch)
+                {
+                    u32& histogram_entry{ histograms[batch * radix + digit] };
+                    const u32 digit_count{ histogram_entry };
+                    histogram_entry = offset;
+                    offset += digit_count;
+                }
+            }
+            assert(offset == count);
+
+            for_each_batch([&](u32 batch, u32 begin, u32 end) {
+                u32* const offsets{ &histograms[batch * radix] };
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    const u32 index{ offsets[(source_keys[i] >> shift) & radix_mask]++ };
+                    target_keys[index] = source_keys[i];
+                    target_values[index] = source_values[i];
+                }
+            });
+
+            std::swap(source_keys, target_keys);
+            std::swap(source_values, target_values);
+        }
+
+        if (source_keys != keys)
+        {
+            memcpy(keys, source_keys, count * sizeof(u64));
+            memcpy(values, source_values, count * sizeof(u32));
+        }
+    }
+}
@@ -0,0 +1,58 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include <bit>
+
+// Sort keys for draw calls and a radix sort to order draws by them. Sorting by the key groups draws that use the
+// same root signature and pipeline state, so that the command list changes them as rarely as possible, and draws
+// them front to back within a group. Nothing in here depends on a graphics API.
+namespace Quantum::graphics {
+
+    // Layout of a sort key, from the most significant bits to the least significant bits.
+    // NOTE: ids that don't fit in their bits wrap around. That only makes the ordering less good, not wrong.
+    struct sort_key {
+        static constexpr u32 pass_bits{ 4 };
+        static constexpr u32 root_signature_bits{ 8 };
+        static constexpr u32 pipeline_state_bits{ 16 };
+        static constexpr u32 material_bits{ 16 };
+        static constexpr u32 depth_bits{ 20 };
+
+        static constexpr u32 depth_shift{ 0 };
+        static constexpr u32 material_shift{ depth_shift + depth_bits };
+        static constexpr u32 pipeline_state_shift{ material_shift + material_bits };
+        static constexpr u32 root_signature_shift{ pipeline_state_shift + pipeline_state_bits };
+        static constexpr u32 pass_shift{ root_signature_shift + root_signature_bits };
+        static_assert(pass_shift + pass_bits == 64);
+    };
+
+    // The depth bucket is the upper bits of the float, which keep the order of non-negative floats. So, buckets
+    // are smaller close to the camera and bigger far away. Negative depths go to the first bucket.
+    [[nodiscard]] constexpr u64 depth_bucket(f32 depth)
+    {
+        const u32 bits{ depth > 0.f ? std::bit_cast<u32>(depth) : 0 };
+        return bits >> (32 - sort_key::depth_bits);
+    }
+
+    [[nodiscard]] constexpr u64 make_sort_key(u32 pass, u32 root_signature, u32 pipeline_state, u32 material, f32 depth)
+    {
+        constexpr auto field = [](u64 value, u32 bits, u32 shift) { return (value & ((1ull << bits) - 1)) << shift; };
+        return field(pass, sort_key::pass_bits, sort_key::pass_shift) |
+               field(root_signature, sort_key::root_signature_bits, sort_key::root_signature_shift) |
+               field(pipeline_state, sort_key::pipeline_state_bits, sort_key::pipeline_state_shift) |
+               field(material, sort_key::material_bits, sort_key::material_shift) |
+               depth_bucket(depth) << sort_key::depth_shift;
+    }
+
+    // Number of u32 that radix_sort() needs for its histograms, whatever the number of keys.
+    constexpr u32 radix_sort_histogram_size{ 64 * 256 };
+
+    // Stable LSD radix sort of keys and their values, 8 bits per pass. Bytes that are the same in all keys are
+    // skipped, so keys with few different passes, root signatures and pipeline states sort in fewer passes.
+    // Each pass counts and scatters the keys in batches with jobs::parallel_for(). temp_keys and temp_values
+    // must have room for count elements and histograms for radix_sort_histogram_size elements, so that sorting
+    // doesn't allocate. The result is in keys and values.
+    void radix_sort(u64* const keys, u32* const values, u32 count, u64* const temp_keys, u32* const temp_values,
+                    u32* const histograms);
+}
@@ -0,0 +1,66 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "IndirectDraw.h"
+#include <algorithm>
+
+namespace Quantum::graphics {
+
+    void
+    count_indirect_draw_states(const u32* const state_ids, u32 count, u32* const state_counts)
+    {
+        assert(state_ids && state_counts);
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            ++state_counts[state_ids[i]];
+        }
+    }
+
+    u32
+    build_indirect_draw_groups(const u32* const state_counts, const u64* const state_keys, u32 state_count,
+                               indirect_draw_group* const groups, indirect_draw_slot* const state_slots)
+    {
+        assert(state_counts && state_keys && groups && state_slots);
+        u32 group_count{ 0 };
+        for (u32 s{ 0 }; s < state_count; ++s)
+        {
+            if (state_counts[s]) groups[group_count++] = { 0, state_counts[s], s };
+        }
+
+        // NOTE: there are only as many groups as different states, so sorting them costs next to nothing.
+        std::sort(groups, groups + group_count, [state_keys](const indirect_draw_group& a, const indirect_draw_group& b) {
+            return state_keys[a.state_id] < state_keys[b.state_id];
+        });
+
+        u32 first_argument{ 0 };
+        for (u32 g{ 0 }; g < group_count; ++g)
+        {
+            indirect_draw_group& group{ groups[g] };
+            group.first_argument = first_argument;
+            state_slots[group.state_id] = { first_argument, g };
+            first_argument += group.max_draw_count;
+        }
+
+        return group_count;
+    }
+
+    hi_z_layout
+    make_hi_z_layout(u32 depth_width, u32 depth_height)
+    {
+        assert(depth_width && depth_height);
+        hi_z_layout layout{};
+        u32 width{ depth_width }, height{ depth_height };
+        do
+        {
+            assert(layout.mip_count < max_hi_z_mips);
+            // NOTE: odd sizes round up, so that the last row and column of the mip below are covered too.
+            width = (width + 1) >> 1;
+            height = (height + 1) >> 1;
+            layout.mips[layout.mip_count] = { width, height, layout.size };
+            layout.size += width * height;
+            ++layout.mip_count;
+        } while ((width > 1 || height > 1) && layout.mip_count < max_hi_z_mips);
+
+        return layout;
+    }
+}
@@ -0,0 +1,61 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include "DrawSorting.h"
+
+// CPU side layout of GPU-driven draws. A culling shader writes the draw arguments of the visible items in an
+// argument buffer, and each group of draws that share the state ExecuteIndirect can't change (root signature,
+// pipeline state and primitive topology) is drawn with one ExecuteIndirect call. Each such state has a draw state id
+// and the draws of a frame are grouped with a counting pass over the state ids of their items, so that no per-item
+// sort is needed. The layout is built here, so that it can be tested without a device. Nothing in here depends on a
+// graphics API.
+namespace Quantum::graphics {
+
+    struct indirect_draw_group
+    {
+        u32     first_argument;     // index of the group's first argument slot in the argument buffer.
+        u32     max_draw_count;     // number of draws in the group before culling.
+        u32     state_id;           // draw state of all draws in the group.
+    };
+
+    // Where the culling shader writes the draw arguments of the items of a draw state: the group's argument slots
+    // start at first_argument and group_index is the index of the group's draw counter.
+    struct indirect_draw_slot
+    {
+        u32     first_argument;
+        u32     group_index;
+    };
+
+    constexpr u32 max_hi_z_mips{ 16 };
+
+    struct hi_z_mip
+    {
+        u32     width;
+        u32     height;
+        u32     offset;             // in elements, from the start of the Hi-Z buffer.
+    };
+
+    // Mips of a Hi-Z (hierarchical depth) buffer, one after the other in a linear buffer. Mip 0 has half the size
+    // of the depth buffer (rounded up) and each texel has the farthest depth of the 2x2 texels below it.
+    struct hi_z_layout
+    {
+        hi_z_mip    mips[max_hi_z_mips];
+        u32         mip_count;
+        u32         size;           // in elements.
+    };
+
+    // Adds each of 'count' draws to the draw count of its state, i.e. increments state_counts[state_ids[i]].
+    void count_indirect_draw_states(const u32* const state_ids, u32 count, u32* const state_counts);
+
+    // Makes one group for each of the 'state_count' draw states that have draws. Groups are in the order of the sort
+    // keys of their states, so that groups with the same root signature and pipeline state are next to each other,
+    // and their argument slots follow each other from slot 0. Writes the slot of each state that has draws to
+    // state_slots and leaves the others as they are. 'groups' needs room for state_count groups.
+    // Returns the number of groups.
+    [[nodiscard]] u32 build_indirect_draw_groups(const u32* const state_counts, const u64* const state_keys, u32 state_count,
+                                                 indirect_draw_group* const groups, indirect_draw_slot* const state_slots);
+
+    [[nodiscard]] hi_z_layout make_hi_z_layout(u32 depth_width, u32 depth_height);
+}
@@ -0,0 +1,62 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "LodSelection.h"
+
+namespace Quantum::graphics {
+
+    lod_camera
+    make_lod_camera(math::v3 position, f32 projection_scale)
+    {
+        assert(projection_scale >= 0.f);
+        return { position, projection_scale > 0.f ? lod_reference_projection_scale / projection_scale : 0.f };
+    }
+
+    void
+    calculate_lod_distances(const lod_camera& camera, const math::v4* const spheres, const f32* const scales, u32 count, f32* const distances)
+    {
+        assert(spheres && scales && distances);
+        const __m128 camera_x{ _mm_set1_ps(camera.position.x) };
+        const __m128 camera_y{ _mm_set1_ps(camera.position.y) };
+        const __m128 camera_z{ _mm_set1_ps(camera.position.z) };
+        const __m128 distance_scale{ _mm_set1_ps(camera.distance_scale) };
+        const __m128 zero{ _mm_setzero_ps() };
+
+        u32 i{ 0 };
+        for (; i + 4 <= count; i += 4)
+        {
+            // Transpose 4 spheres, so that each lane works on a different item.
+            __m128 x{ _mm_loadu_ps(&spheres[i].x) };
+            __m128 y{ _mm_loadu_ps(&spheres[i + 1].x) };
+            __m128 z{ _mm_loadu_ps(&spheres[i + 2].x) };
+            __m128 r{ _mm_loadu_ps(&spheres[i + 3].x) };
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+
+            x = _mm_sub_ps(x, camera_x);
+            y = _mm_sub_ps(y, camera_y);
+            z = _mm_sub_ps(z, camera_z);
+            const __m128 length{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))) };
+            const __m128 distance{ _mm_max_ps(_mm_sub_ps(length, r), zero) };
+            _mm_storeu_ps(&distances[i], _mm_div_ps(_mm_mul_ps(distance, distance_scale), _mm_loadu_ps(&scales[i])));
+        }
+
+        for (; i < count; ++i)
+        {
+            const math::v4& s{ spheres[i] };
+            const f32 x{ s.x - camera.position.x }, y{ s.y - camera.position.y }, z{ s.z - camera.position.z };
+            const f32 distance{ std::max(sqrtf(x * x + y * y + z * z) - s.w, 0.f) };
+            distances[i] = distance * camera.distance_scale / scales[i];
+        }
+    }
+
+    u32
+    select_lod(const f32* const thresholds, u32 lod_count, f32 distance, u32 previous_lod)
+    {
+        assert(thresholds && lod_count);
+        u32 lod{ std::min(previous_lod, lod_count - 1) };
+        while (lod + 1 < lod_count && distance >= thresholds[lod + 1] * (1.f + lod_hysteresis)) ++lod;
+        // NOTE: if we just switched to a coarser LOD, the distance is past its threshold, so we don't switch back.
+        while (lod > 0 && distance < thresholds[lod] * (1.f - lod_hysteresis)) --lod;
+        return lod;
+    }
+}
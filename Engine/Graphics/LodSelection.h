@@ -0,0 +1,41 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+
+// Picks LODs from how big render items are on the screen. The LOD thresholds of a geometry are camera distances
+// (in the geometry's units) for a reference projection: a 1080 pixel high screen with a 60 degree vertical field
+// of view (see generate_lods() in ContentTools). So, instead of the screen size of every item, we compute the
+// distance at which the item would have the same screen size with the reference projection, and compare that
+// with the thresholds.
+namespace Quantum::graphics {
+
+    // Pixels per unit at a distance of 1 for the reference projection.
+    constexpr f32 lod_reference_projection_scale{ 1080.f / (2.f * 0.57735027f) };
+    // The distance has to be this fraction past a threshold before we switch to another LOD, so that items
+    // that are close to a threshold don't switch back and forth (popping) when the camera moves a little.
+    constexpr f32 lod_hysteresis{ 0.1f };
+
+    struct lod_camera
+    {
+        math::v3    position;
+        f32         distance_scale;     // converts distances of this camera to the reference projection.
+    };
+
+    // projection_scale is the number of pixels per unit at a distance of 1, i.e. screen height / (2 * tan(fov / 2)).
+    // For a perspective projection matrix that's _22 * screen height / 2. Use 0 for orthographic projections,
+    // where the screen size doesn't depend on the distance. Then all distances are 0 (full detail).
+    [[nodiscard]] lod_camera make_lod_camera(math::v3 position, f32 projection_scale);
+
+    // Sets distances[i] to the distance from the camera to the bounding sphere spheres[i] (0 if the camera is
+    // inside), converted to the reference projection and divided by scales[i], the scale of the item's world
+    // matrix, so that it's in the units of the item's geometry. Works on 4 items at a time with SSE.
+    void calculate_lod_distances(const lod_camera& camera, const math::v4* const spheres, const f32* const scales, u32 count, f32* const distances);
+
+    // Returns the LOD for 'distance', given the LOD that was used before. LOD i is used from thresholds[i] to
+    // thresholds[i + 1], and thresholds have to be increasing (thresholds[0] isn't used). We only switch to a
+    // coarser LOD when the distance is lod_hysteresis past its threshold, and only switch back when it's
+    // lod_hysteresis below it. Usually, the LOD doesn't change, so this doesn't scan all thresholds.
+    [[nodiscard]] u32 select_lod(const f32* const thresholds, u32 lod_count, f32 distance, u32 previous_lod);
+}
@@ -0,0 +1,52 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "ParallelRecording.h"
+#include "Core/JobSystem.h"
+
+namespace Quantum::graphics {
+
+    u32
+    partition_draws(u32 draw_count, u32 max_ranges, u32 min_draws, draw_range* const ranges)
+    {
+        assert(ranges && max_ranges);
+        const u32 range_count{ std::max(std::min(max_ranges, draw_count / std::max(min_draws, 1u)), 1u) };
+        const u32 range_size{ draw_count / range_count };
+        const u32 remainder{ draw_count % range_count };
+
+        u32 begin{ 0 };
+        for (u32 i{ 0 }; i < range_count; ++i)
+        {
+            // The first 'remainder' ranges get one more draw.
+            const u32 end{ begin + range_size + (i < remainder ? 1 : 0) };
+            ranges[i] = { begin, end };
+            begin = end;
+        }
+
+        assert(begin == draw_count);
+        return range_count;
+    }
+
+    u32
+    record_draws(const command_recorder& recorder, u32 draw_count, u32 max_lists, u32 min_draws)
+    {
+        assert(recorder.begin && recorder.record && recorder.end);
+        assert(max_lists && max_lists <= max_command_lists_per_pass);
+
+        draw_range ranges[max_command_lists_per_pass];
+        const u32 max_ranges{ std::min(max_lists, std::max(jobs::worker_count(), 1u)) };
+        const u32 list_count{ partition_draws(draw_count, max_ranges, min_draws, &ranges[0]) };
+
+        recorder.begin(recorder.data, list_count);
+        // NOTE: each range is a batch of its own, so every command list is recorded by one worker.
+        jobs::parallel_for(list_count, 1, [&](u32 begin, u32 end) {
+            for (u32 i{ begin }; i < end; ++i)
+            {
+                recorder.record(recorder.data, i, ranges[i]);
+            }
+        });
+        recorder.end(recorder.data, list_count);
+
+        return list_count;
+    }
+}
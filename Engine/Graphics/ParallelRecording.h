@@ -0,0 +1,42 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+
+// Records the (sorted) draws of a pass into several command lists on the workers of the job system. The draws are
+// split in consecutive ranges, one per command list, so that executing the lists in order gives the same order
+// of draws as recording them all in one list. The graphics API is behind command_recorder, so that the
+// partitioning and scheduling can be tested with a recorder that doesn't record anything.
+namespace Quantum::graphics {
+
+    struct draw_range
+    {
+        u32     begin;
+        u32     end;
+    };
+
+    // Recording fewer draws than this in a command list isn't worth the cost of another command list.
+    constexpr u32 min_draws_per_command_list{ 512 };
+    constexpr u32 max_command_lists_per_pass{ 16 };
+
+    struct command_recorder
+    {
+        // Called on the calling thread before recording. The recorder prepares list_count command lists.
+        void(*begin)(void* data, u32 list_count);
+        // Records the draws of 'range' in command list list_index. Called once for each command list, on any worker.
+        void(*record)(void* data, u32 list_index, draw_range range);
+        // Called on the calling thread after all command lists are recorded.
+        void(*end)(void* data, u32 list_count);
+        void* data;
+    };
+
+    // Splits draw_count draws in at most max_ranges ranges with at least min_draws draws each (except if there
+    // are fewer draws than that), with sizes that differ by at most 1. Returns the number of ranges.
+    [[nodiscard]] u32 partition_draws(u32 draw_count, u32 max_ranges, u32 min_draws, draw_range* const ranges);
+
+    // Records draw_count draws with one command list per worker, or fewer if there aren't enough draws. Range i
+    // goes to command list i. Returns the number of command lists.
+    u32 record_draws(const command_recorder& recorder, u32 draw_count,
+                     u32 max_lists = max_command_lists_per_pass, u32 min_draws = min_draws_per_command_list);
+}
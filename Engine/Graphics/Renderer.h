@@ -11,12 +11,13 @@ namespace Quantum::graphics {
 
     struct frame_info {
         id::id_type*        render_item_ids{ nullptr };
-        f32*                thresholds{ nullptr };
+        f32*                thresholds{ nullptr };  // optional. Without them, LODs are picked from the screen size of the items.
         u64                 light_set_key{ 0 };
         f32                 last_frame_time{ 16.7f };
         f32                 average_frame_time{ 16.7f };
         u32                 render_item_count{ 0 };
         camera_id           camera_id{ id::invalid_id };
+        bool                gpu_driven_draws{ false };  // cull the items on the GPU and draw them with ExecuteIndirect.
     };
 	
     DEFINE_TYPED_ID(surface_id);
@@ -0,0 +1,90 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#include "MappedFile.h"
+
+#ifdef _WIN64
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Quantum::platform {
+
+#ifdef _WIN64
+    bool
+    mapped_file::open(const std::filesystem::path& path)
+    {
+        close();
+        HANDLE file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size) || !size.QuadPart)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        // NOTE: the view keeps the mapping and the file open, so we don't need the handles after this.
+        HANDLE mapping{ CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+        CloseHandle(file);
+        if (!mapping) return false;
+
+        _data = (const u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (!_data) return false;
+
+        _size = (u64)size.QuadPart;
+        return true;
+    }
+
+    void
+    mapped_file::close()
+    {
+        if (_data) UnmapViewOfFile(_data);
+        _data = nullptr;
+        _size = 0;
+    }
+#else
+    bool
+    mapped_file::open(const std::filesystem::path& path)
+    {
+        close();
+        const int file{ ::open(path.c_str(), O_RDONLY) };
+        if (file < 0) return false;
+
+        struct stat info {};
+        if (fstat(file, &info) || !info.st_size)
+        {
+            ::close(file);
+            return false;
+        }
+
+        // NOTE: the mapping keeps the file open, so we don't need the descriptor after this.
+        void* const data{ mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0) };
+        ::close(file);
+        if (data == MAP_FAILED) return false;
+
+        madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+        _data = (const u8*)data;
+        _size = (u64)info.st_size;
+        return true;
+    }
+
+    void
+    mapped_file::close()
+    {
+        if (_data) munmap((void*)_data, _size);
+        _data = nullptr;
+        _size = 0;
+    }
+#endif
+}
@@ -0,0 +1,53 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include <filesystem>
+
+namespace Quantum::platform {
+
+    // Read-only view of a whole file. The file isn't read when it's opened: the OS pages it in when the data
+    // is first accessed, so content can be parsed and copied to upload buffers straight from the file cache
+    // without a copy on the heap. Views start at a page boundary, so offsets into the file keep their alignment.
+    // data() stays valid until the file is closed or the mapped_file is destroyed.
+    class mapped_file
+    {
+    public:
+        DISABLE_COPY(mapped_file);
+        mapped_file() = default;
+        explicit mapped_file(const std::filesystem::path& path) { open(path); }
+        mapped_file(mapped_file&& o) noexcept : _data{ o._data }, _size{ o._size }
+        {
+            o._data = nullptr;
+            o._size = 0;
+        }
+
+        mapped_file& operator=(mapped_file&& o) noexcept
+        {
+            if (this != &o)
+            {
+                close();
+                _data = o._data;
+                _size = o._size;
+                o._data = nullptr;
+                o._size = 0;
+            }
+            return *this;
+        }
+
+        ~mapped_file() { close(); }
+
+        // Maps the file at 'path'. Returns false if it doesn't exist, is empty or can't be mapped.
+        bool open(const std::filesystem::path& path);
+        void close();
+
+        [[nodiscard]] constexpr const u8* const data() const { return _data; }
+        [[nodiscard]] constexpr u64 size() const { return _size; }
+        [[nodiscard]] constexpr bool is_open() const { return _data != nullptr; }
+
+    private:
+        const u8*   _data{ nullptr };
+        u64         _size{ 0 };
+    };
+}
@@ -0,0 +1,576 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "CommonHeaders.h"
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+
+namespace Quantum::util {
+
+    // Subsystems that memory is accounted to. Every allocator takes one of these as a template argument.
+    struct memory_tag {
+        enum tag : u32 {
+            general = 0,
+            entities,
+            transforms,
+            scripts,
+            content,
+            geometry,
+            materials,
+            shaders,
+            render_items,
+            renderer,
+
+            count
+        };
+    };
+
+    struct allocator_type {
+        enum type : u32 {
+            heap = 0,
+            pool,
+            frame,
+            scratch,
+
+            count
+        };
+    };
+
+    namespace memory {
+        // NOTE: all allocators return memory that is aligned to at least this many bytes.
+        constexpr u64 default_alignment{ 16 };
+
+        struct counter
+        {
+            std::atomic<s64>    bytes{ 0 };
+            std::atomic<s64>    peak_bytes{ 0 };
+            std::atomic<u64>    allocations{ 0 };
+        };
+
+        inline counter counters[allocator_type::count][memory_tag::count]{};
+
+        inline void track(u32 type, u32 tag, s64 bytes, u64 allocations = 0)
+        {
+            assert(type < allocator_type::count && tag < memory_tag::count);
+            counter& c{ counters[type][tag] };
+            const s64 total{ c.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes };
+            s64 peak{ c.peak_bytes.load(std::memory_order_relaxed) };
+            while (total > peak && !c.peak_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {}
+            if (allocations) c.allocations.fetch_add(allocations, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] inline s64 bytes(u32 type, u32 tag)
+        {
+            return counters[type][tag].bytes.load(std::memory_order_relaxed);
+        }
+
+        // Calls print for every counter that has been used, one line per allocator type and subsystem.
+        inline void dump_counters(void(*print)(const char* line))
+        {
+            assert(print);
+            constexpr const char* type_names[allocator_type::count]{ "heap", "pool", "frame", "scratch" };
+            constexpr const char* tag_names[memory_tag::count]{
+                "general", "entities", "transforms", "scripts", "content", "geometry", "materials", "shaders", "render_items", "renderer"
+            };
+
+            char line[256];
+            for (u32 type{ 0 }; type < allocator_type::count; ++type)
+            {
+                for (u32 tag{ 0 }; tag < memory_tag::count; ++tag)
+                {
+                    const counter& c{ counters[type][tag] };
+                    const u64 allocations{ c.allocations.load(std::memory_order_relaxed) };
+                    if (!allocations) continue;
+                    snprintf(line, sizeof(line), "%-8s %-13s | current: %10lld bytes | peak: %10lld bytes | allocations: %llu\n",
+                             type_names[type], tag_names[tag], (long long)c.bytes.load(std::memory_order_relaxed),
+                             (long long)c.peak_bytes.load(std::memory_order_relaxed), (unsigned long long)allocations);
+                    print(line);
+                }
+            }
+        }
+    } // namespace memory
+
+    // NOTE: allocators are stateless types with static functions, so containers don't get any bigger.
+    //       reallocate() with a null pointer allocates and deallocate() takes the size that was allocated.
+
+    // General purpose allocator. Uses realloc()/free().
+    template<u32 tag = memory_tag::general>
+    struct heap_allocator
+    {
+        [[nodiscard]] static void* allocate(u64 size)
+        {
+            return reallocate(nullptr, 0, size);
+        }
+
+        [[nodiscard]] static void* reallocate(void* const p, u64 old_size, u64 new_size)
+        {
+            void* const new_p{ realloc(p, new_size) };
+            // NOTE: growing or shrinking a block goes to the heap too, so it counts as an allocation.
+            if (new_p) memory::track(allocator_type::heap, tag, (s64)new_size - (s64)old_size, 1);
+            return new_p;
+        }
+
+        static void deallocate(void* const p, u64 size)
+        {
+            if (!p) return;
+            free(p);
+            memory::track(allocator_type::heap, tag, -(s64)size);
+        }
+    };
+
+    // Hands out blocks of one size from chunks of about 64 KB (at least 8 blocks for big block sizes).
+    // Freed blocks are linked through their own memory.
+    // NOTE: not thread-safe. pool_allocator puts a lock around it.
+    class block_pool
+    {
+    public:
+        constexpr explicit block_pool(u64 block_size)
+            : _block_size{ block_size }, _blocks_per_chunk{ std::max(chunk_size / block_size, min_blocks_per_chunk) }
+        {
+            assert(block_size >= sizeof(void*) && !(block_size & (memory::default_alignment - 1)));
+        }
+        DISABLE_COPY_AND_MOVE(block_pool);
+        ~block_pool()
+        {
+            while (_chunks)
+            {
+                chunk* const next{ _chunks->next };
+                free(_chunks);
+                _chunks = next;
+            }
+        }
+
+        [[nodiscard]] void* allocate()
+        {
+            if (_free_blocks)
+            {
+                void* const block{ _free_blocks };
+                _free_blocks = *(void**)block;
+                return block;
+            }
+
+            if (!_chunks || _chunks->used == _blocks_per_chunk)
+            {
+                chunk* const new_chunk{ (chunk*)malloc(chunk_header_size + _block_size * _blocks_per_chunk) };
+                assert(new_chunk);
+                if (!new_chunk) return nullptr;
+                new_chunk->next = _chunks;
+                new_chunk->used = 0;
+                _chunks = new_chunk;
+            }
+
+            u8* const data{ (u8*)_chunks + chunk_header_size };
+            return data + _block_size * _chunks->used++;
+        }
+
+        void deallocate(void* const block)
+        {
+            assert(block);
+            *(void**)block = _free_blocks;
+            _free_blocks = block;
+        }
+
+        [[nodiscard]] constexpr u64 block_size() const { return _block_size; }
+
+    private:
+        struct chunk
+        {
+            chunk*  next;
+            u64     used;
+        };
+
+        static constexpr u64 chunk_size{ 64 * 1024 };
+        static constexpr u64 min_blocks_per_chunk{ 8 };
+        static constexpr u64 chunk_header_size{ math::align_size_up<memory::default_alignment>(sizeof(chunk)) };
+
+        const u64   _block_size;
+        const u64   _blocks_per_chunk;
+        chunk*      _chunks{ nullptr };
+        void*       _free_blocks{ nullptr };
+    };
+
+    // Allocator for small, short-lived buffers. Sizes up to 2 KB come from block pools with one
+    // pool per power of 2 size class. Bigger sizes go to the heap. Thread-safe.
+    template<u32 tag = memory_tag::general>
+    struct pool_allocator
+    {
+        static constexpr u64 min_block_size{ 16 };
+        static constexpr u64 max_block_size{ 2048 };
+        static constexpr u32 size_class_count{ 8 };
+
+        [[nodiscard]] static void* allocate(u64 size)
+        {
+            return reallocate(nullptr, 0, size);
+        }
+
+        [[nodiscard]] static void* reallocate(void* const p, u64 old_size, u64 new_size)
+        {
+            assert(p || !old_size);
+            const u32 old_class{ p ? size_class(old_size) : u32_invalid_id };
+            const u32 new_class{ size_class(new_size) };
+            if (p && old_class == new_class && new_class != u32_invalid_id)
+            {
+                memory::track(allocator_type::pool, tag, (s64)new_size - (s64)old_size);
+                return p;
+            }
+
+            void* new_p{ nullptr };
+            if (new_class == u32_invalid_id)
+            {
+                new_p = malloc(new_size);
+            }
+            else
+            {
+                std::lock_guard lock{ pools()[new_class].mutex };
+                new_p = pools()[new_class].pool.allocate();
+            }
+
+            assert(new_p);
+            if (!new_p) return nullptr;
+
+            memory::track(allocator_type::pool, tag, (s64)new_size, 1);
+            if (p)
+            {
+                memcpy(new_p, p, std::min(old_size, new_size));
+                deallocate(p, old_size);
+            }
+
+            return new_p;
+        }
+
+        static void deallocate(void* const p, u64 size)
+        {
+            if (!p) return;
+            const u32 block_class{ size_class(size) };
+            if (block_class == u32_invalid_id)
+            {
+                free(p);
+            }
+            else
+            {
+                std::lock_guard lock{ pools()[block_class].mutex };
+                pools()[block_class].pool.deallocate(p);
+            }
+
+            memory::track(allocator_type::pool, tag, -(s64)size);
+        }
+
+    private:
+        struct locked_pool
+        {
+            block_pool  pool;
+            std::mutex  mutex;
+        };
+
+        [[nodiscard]] static constexpr u32 size_class(u64 size)
+        {
+            if (size > max_block_size) return u32_invalid_id;
+            u32 index{ 0 };
+            for (u64 block_size{ min_block_size }; block_size < size; block_size <<= 1) ++index;
+            return index;
+        }
+
+        static locked_pool* pools()
+        {
+            // NOTE: static in a function, so the pools exist before the first allocation.
+            static locked_pool p[size_class_count]{
+                { block_pool{ 16 } }, { block_pool{ 32 } }, { block_pool{ 64 } }, { block_pool{ 128 } },
+                { block_pool{ 256 } }, { block_pool{ 512 } }, { block_pool{ 1024 } }, { block_pool{ 2048 } },
+            };
+            return p;
+        }
+    };
+
+    struct arena_marker
+    {
+        u32 block{ 0 };
+        u64 offset{ 0 };
+    };
+
+    // Bump allocator over a list of memory blocks. Individual allocations aren't freed (except for
+    // the last one). Instead, the whole arena is reset, either completely or back to a marker.
+    // The blocks themselves are heap memory and are accounted to the tag.
+    // NOTE: not thread-safe.
+    template<u32 tag = memory_tag::general, u64 first_block_size = 64 * 1024>
+    class linear_arena
+    {
+    public:
+        using marker = arena_marker;
+        static_assert(first_block_size > 0);
+
+        linear_arena() = default;
+        DISABLE_COPY_AND_MOVE(linear_arena);
+        ~linear_arena() { release(); }
+
+        [[nodiscard]] void* allocate(u64 size, u64 alignment = memory::default_alignment)
+        {
+            assert(size && alignment <= memory::default_alignment);
+            if (_block_count)
+            {
+                block& b{ _blocks[_block_count - 1] };
+                const u64 offset{ math::align_size_up(b.used, alignment) };
+                if (offset + size <= b.size)
+                {
+                    b.used = offset + size;
+                    _last_allocation = b.data + offset;
+                    return _last_allocation;
+                }
+            }
+
+            // NOTE: blocks double in size, so only a few blocks are needed even if the first one was too small.
+            const u64 last_size{ _block_count ? _blocks[_block_count - 1].size : 0 };
+            if (!add_block(std::max(std::max(first_block_size, last_size * 2), size))) return nullptr;
+            block& b{ _blocks[_block_count - 1] };
+            b.used = size;
+            _last_allocation = b.data;
+            return _last_allocation;
+        }
+
+        [[nodiscard]] void* reallocate(void* const p, u64 old_size, u64 new_size)
+        {
+            if (p && p == _last_allocation)
+            {
+                // The last allocation can grow or shrink in place if it still fits in its block.
+                block& b{ _blocks[_block_count - 1] };
+                const u64 offset{ (u64)((u8*)p - b.data) };
+                if (offset + new_size <= b.size)
+                {
+                    b.used = offset + new_size;
+                    return p;
+                }
+            }
+
+            void* const new_p{ allocate(new_size) };
+            if (p && new_p) memcpy(new_p, p, std::min(old_size, new_size));
+            return new_p;
+        }
+
+        // Only the last allocation is actually freed.
+        void deallocate(void* const p, [[maybe_unused]] u64 size)
+        {
+            if (p && p == _last_allocation)
+            {
+                block& b{ _blocks[_block_count - 1] };
+                b.used = (u64)((u8*)p - b.data);
+                _last_allocation = nullptr;
+            }
+        }
+
+        [[nodiscard]] marker get_marker() const
+        {
+            return _block_count ? marker{ _block_count - 1, _blocks[_block_count - 1].used } : marker{};
+        }
+
+        // Frees everything that was allocated after the marker was taken.
+        void reset(const marker& m)
+        {
+            assert(!_block_count || m.block < _block_count);
+            while (_block_count > m.block + 1)
+            {
+                --_block_count;
+                free_block(_blocks[_block_count]);
+            }
+
+            if (_block_count) _blocks[_block_count - 1].used = m.offset;
+            _last_allocation = nullptr;
+        }
+
+        // Frees everything. If the arena needed more than one block since the last reset,
+        // the blocks are merged into one, so that it fits in one block from now on.
+        void reset()
+        {
+            if (_block_count > 1)
+            {
+                u64 total_size{ 0 };
+                for (u32 i{ 0 }; i < _block_count; ++i) total_size += _blocks[i].size;
+                release();
+                add_block(total_size);
+            }
+
+            if (_block_count) _blocks[0].used = 0;
+            _last_allocation = nullptr;
+        }
+
+        [[nodiscard]] u64 used() const
+        {
+            u64 used{ 0 };
+            for (u32 i{ 0 }; i < _block_count; ++i) used += _blocks[i].used;
+            return used;
+        }
+
+        [[nodiscard]] u64 capacity() const
+        {
+            u64 capacity{ 0 };
+            for (u32 i{ 0 }; i < _block_count; ++i) capacity += _blocks[i].size;
+            return capacity;
+        }
+
+    private:
+        struct block
+        {
+            u8*     data{ nullptr };
+            u64     size{ 0 };
+            u64     used{ 0 };
+        };
+
+        static constexpr u32 max_blocks{ 32 };
+
+        bool add_block(u64 size)
+        {
+            assert(_block_count < max_blocks);
+            if (_block_count == max_blocks) return false;
+            u8* const data{ (u8*)malloc(size) };
+            assert(data);
+            if (!data) return false;
+            _blocks[_block_count++] = { data, size, 0 };
+            memory::track(allocator_type::heap, tag, (s64)size, 1);
+            return true;
+        }
+
+        void free_block(block& b)
+        {
+            free(b.data);
+            memory::track(allocator_type::heap, tag, -(s64)b.size);
+            b = {};
+        }
+
+        void release()
+        {
+            for (u32 i{ 0 }; i < _block_count; ++i) free_block(_blocks[i]);
+            _block_count = 0;
+            _last_allocation = nullptr;
+        }
+
+        block       _blocks[max_blocks]{};
+        u32         _block_count{ 0 };
+        void*       _last_allocation{ nullptr };
+    };
+
+    namespace memory {
+        // NOTE: the frame arena is only used from the main thread. Use the scratch arena on other threads.
+        using frame_arena_type = linear_arena<memory_tag::general, 1024 * 1024>;
+        using scratch_arena_type = linear_arena<memory_tag::general, 256 * 1024>;
+
+        inline frame_arena_type& frame_arena()
+        {
+            static frame_arena_type arena{};
+            return arena;
+        }
+
+        inline scratch_arena_type& scratch_arena()
+        {
+            thread_local scratch_arena_type arena{};
+            return arena;
+        }
+
+        // Number of allocations that went to the heap or to block pools for one subsystem.
+        // NOTE: allocations from frame and scratch arenas don't count. Only new arena blocks do.
+        [[nodiscard]] inline u64 allocation_count(u32 tag)
+        {
+            assert(tag < memory_tag::count);
+            return counters[allocator_type::heap][tag].allocations.load(std::memory_order_relaxed) +
+                   counters[allocator_type::pool][tag].allocations.load(std::memory_order_relaxed);
+        }
+
+        // Number of allocations that went to the heap or to block pools for all subsystems.
+        [[nodiscard]] inline u64 allocation_count()
+        {
+            u64 count{ 0 };
+            for (u32 tag{ 0 }; tag < memory_tag::count; ++tag) count += allocation_count(tag);
+            return count;
+        }
+
+        // Frees everything that was allocated from the frame arena. Called once at the start of every frame.
+        inline void begin_frame()
+        {
+            frame_arena().reset();
+            for (u32 tag{ 0 }; tag < memory_tag::count; ++tag)
+            {
+                counters[allocator_type::frame][tag].bytes.store(0, std::memory_order_relaxed);
+            }
+        }
+    } // namespace memory
+
+    // Memory that is only valid until the end of the frame. The frame counters show how much was allocated this frame.
+    template<u32 tag = memory_tag::general>
+    struct frame_allocator
+    {
+        [[nodiscard]] static void* allocate(u64 size)
+        {
+            return reallocate(nullptr, 0, size);
+        }
+
+        [[nodiscard]] static void* reallocate(void* const p, u64 old_size, u64 new_size)
+        {
+            void* const new_p{ memory::frame_arena().reallocate(p, old_size, new_size) };
+            if (new_p) memory::track(allocator_type::frame, tag, (s64)new_size - (s64)(new_p == p ? old_size : 0), new_p == p ? 0 : 1);
+            return new_p;
+        }
+
+        static void deallocate(void* const p, u64 size)
+        {
+            if (!p) return;
+            memory::frame_arena().deallocate(p, size);
+        }
+    };
+
+    // Temporary memory of the calling thread. Allocations are freed when the innermost scratch_scope ends.
+    template<u32 tag = memory_tag::general>
+    struct scratch_allocator
+    {
+        [[nodiscard]] static void* allocate(u64 size)
+        {
+            return reallocate(nullptr, 0, size);
+        }
+
+        [[nodiscard]] static void* reallocate(void* const p, u64 old_size, u64 new_size)
+        {
+            void* const new_p{ memory::scratch_arena().reallocate(p, old_size, new_size) };
+            // NOTE: a moved allocation is counted as freed, since its memory goes back to the arena when the scope ends.
+            if (new_p) memory::track(allocator_type::scratch, tag, (s64)new_size - (s64)old_size, new_p == p ? 0 : 1);
+            return new_p;
+        }
+
+        static void deallocate(void* const p, u64 size)
+        {
+            if (!p) return;
+            memory::scratch_arena().deallocate(p, size);
+            memory::track(allocator_type::scratch, tag, -(s64)size);
+        }
+    };
+
+    // Resets the scratch arena of the calling thread to where it was when the scope started.
+    class scratch_scope
+    {
+    public:
+        scratch_scope() : _marker{ memory::scratch_arena().get_marker() } {}
+        DISABLE_COPY_AND_MOVE(scratch_scope);
+        ~scratch_scope() { memory::scratch_arena().reset(_marker); }
+
+    private:
+        const arena_marker _marker;
+    };
+
+    // Owning pointer to an array from a heap_allocator. Keeps the size so that it can be accounted for when freed.
+    // NOTE: the array items aren't constructed or destructed, so only use it for trivial types.
+    template<u32 tag, typename T = u8>
+    struct buffer_deleter
+    {
+        u64 size{ 0 };
+        void operator()(T* const p) const { heap_allocator<tag>::deallocate(p, size); }
+    };
+
+    template<u32 tag, typename T = u8>
+    using unique_buffer = std::unique_ptr<T[], buffer_deleter<tag, T>>;
+
+    template<u32 tag, typename T = u8>
+    [[nodiscard]] unique_buffer<tag, T> make_unique_buffer(u64 count)
+    {
+        static_assert(std::is_trivial_v<T>);
+        assert(count);
+        const u64 size{ count * sizeof(T) };
+        return unique_buffer<tag, T>{ (T*)heap_allocator<tag>::allocate(size), buffer_deleter<tag, T>{ size } };
+    }
+}
@@ -8,7 +8,7 @@ namespace Quantum::util {
 #pragma message("WARNING: using util::free_list with std::vector result in duplicate calls to class constructor!")
 #endif
 
-    template<typename T>
+    template<typename T, typename allocator = heap_allocator<>>
     class free_list {
         static_assert(sizeof(T) >= sizeof(u32));
     public:
@@ -92,7 +92,7 @@ namespace Quantum::util {
 #if USE_STL_VECTOR
         util::vector<T>                 _array;
 #else
-        util::vector<T, false>          _array;
+        util::vector<T, false, allocator> _array;
 #endif
         u32                             _next_free_index{ u32_invalid_id };
         u32                             _size{ 0 };
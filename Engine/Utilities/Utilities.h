@@ -6,12 +6,15 @@
 #define USE_STL_VECTOR 0
 #define USE_STL_DEQUE 1
 
+#include "Allocators.h"
+
 #if USE_STL_VECTOR
 
 #include <vector>
 namespace Quantum::util
 {
-    template<typename T>
+    // NOTE: std::vector ignores the destruct and allocator arguments.
+    template<typename T, bool destruct = true, typename allocator = heap_allocator<>>
     using vector = std::vector<T>;
 	
     template<typename T>
@@ -8,8 +8,9 @@ namespace Quantum::util {
     // A vector class similar to std::vector with basic functionality.
     // The user can specify in the template argument whether they want
     // element's destructor to be called when being removed or while
-    // clearing/destructing the vector.
-    template<typename T, bool destruct = true> 
+    // clearing/destructing the vector. The allocator argument decides where
+    // the memory comes from and which subsystem it's accounted to (see Allocators.h).
+    template<typename T, bool destruct = true, typename allocator = heap_allocator<>> 
     class  vector
     {
     public:
@@ -165,9 +166,9 @@ namespace Quantum::util {
          {
              if (new_capacity > _capacity)
              {
-                 // NOTE: realoc() will automatically copy the data in the buffer
+                 // NOTE: reallocate() will automatically copy the data in the buffer
                  //       if a new region of memory is allocated.
-                 void* new_buffer{ realloc(_data, new_capacity * sizeof(T)) };
+                 void* new_buffer{ allocator::reallocate(_data, _capacity * sizeof(T), new_capacity * sizeof(T)) };
                  assert(new_buffer);
                  if (new_buffer)
                  {
@@ -377,8 +378,8 @@ namespace Quantum::util {
         {
             assert([&] { return _capacity ? _data != nullptr : _data == nullptr; }());
             clear();
+            if (_data) allocator::deallocate(_data, _capacity * sizeof(T));
             _capacity = 0;
-            if (_data) free(_data);
             _data = nullptr;
         }
 
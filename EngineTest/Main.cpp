@@ -11,6 +11,30 @@
 #include "TestWindow.h"
 #elif TEST_RENDERER
 #include "TestRenderer.h"
+#elif TEST_JOB_SYSTEM
+#include "TestJobSystem.h"
+#elif TEST_SCRIPT_UPDATE
+#include "TestScriptUpdate.h"
+#elif TEST_ENTITY_CHURN
+#include "TestEntityChurn.h"
+#elif TEST_GEOMETRY
+#include "TestGeometry.h"
+#elif TEST_CONTENT_LOADING
+#include "TestContentLoading.h"
+#elif TEST_CONTENT_STREAMING
+#include "TestContentStreaming.h"
+#elif TEST_CONTENT_CACHE
+#include "TestContentCache.h"
+#elif TEST_CULLING
+#include "TestCulling.h"
+#elif TEST_LOD_SELECTION
+#include "TestLodSelection.h"
+#elif TEST_DRAW_SORTING
+#include "TestDrawSorting.h"
+#elif TEST_PARALLEL_RECORDING
+#include "TestParallelRecording.h"
+#elif TEST_INDIRECT_DRAW
+#include "TestIndirectDraw.h"
 #else
 #error One of the tests need to be enabled
 #endif
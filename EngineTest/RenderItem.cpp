@@ -2,6 +2,7 @@
 // Distributed under the MIT license. See the LICENSE file in the project root for more information.
 #include <filesystem>
 #include "CommonHeaders.h"
+#include "Content/ContentCache.h"
 #include "Content/ContentToEngine.h"
 #include "Graphics/Renderer.h"
 #include "ShaderCompilation.h"
@@ -12,7 +13,6 @@ using namespace Quantum;
 
 game_entity::entity create_one_game_entity(math::v3 position, math::v3 rotation, const char* script_name);
 void remove_game_entity(game_entity::entity_id id);
-bool read_file(std::filesystem::path, std::unique_ptr<u8[]>& data, u64&);
 
 namespace {
     id::id_type fan_model_id{ id::invalid_id };
@@ -35,11 +35,7 @@ namespace {
 
     [[nodiscard]] id::id_type load_model(const char* path)
     {
-        std::unique_ptr<u8[]> model;
-        u64 size{ 0 };
-        read_file(path, model, size);
-
-        const id::id_type model_id{ content::create_resource(model.get(), content::asset_type::mesh) };
+        const id::id_type model_id{ content::acquire_resource(path, content::asset_type::mesh) };
         assert(id::is_valid(model_id));
         return model_id;
     }
@@ -54,10 +50,12 @@ namespace {
 
         const char* shader_path{ "..\\..\\enginetest\\" };
 
-        std::wstring defines[]{ L"ELEMENTS_TYPE=1", L"ELEMENTS_TYP#=3"};
+        std::wstring defines[]{ L"ELEMENTS_TYPE=1", L"ELEMENTS_TYP#=3", L"ELEMENTS_TYPE=17", L"ELEMENTS_TYPE=19" };
         util::vector<u32> keys;
         keys.emplace_back(tools::elements::elements_type::static_normal);
         keys.emplace_back(tools::elements::elements_type::static_normal_texture);
+        keys.emplace_back(tools::elements::elements_type::static_normal | tools::elements::elements_type::quantized);
+        keys.emplace_back(tools::elements::elements_type::static_normal_texture | tools::elements::elements_type::quantized);
 
         util::vector<std::wstring> extra_args{};
         util::vector<std::unique_ptr<u8[]>> vertex_shaders;
@@ -108,7 +106,7 @@ namespace {
 
             if (id::is_valid(model_id))
             {
-                content::destroy_resource(model_id, content::asset_type::mesh);
+                content::release_resource(model_id, content::asset_type::mesh);
             }
         }
     }
@@ -156,6 +154,9 @@ void destroy_render_item()
     remove_item(fan_entity_id, fan_item_id, fan_model_id);
     remove_item(int_entity_id, int_item_id, int_model_id);
 
+    // The models stay resident after they're released, in case they're used again.
+    content::trim_cache();
+
     // remove material 
     if (id::is_valid(mtl_id))
     {
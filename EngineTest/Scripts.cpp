@@ -12,6 +12,9 @@ REGISTER_SCRIPT(rotator_script);
 class rotator_script : public script::entity_script
 {
 public:
+    // NOTE: only touches its own transform, so these scripts can be updated in parallel.
+    static constexpr script::update_schedule schedule{ 0, script::access::none, script::access::none };
+
     constexpr explicit rotator_script(game_entity::entity entity) : script::entity_script{ entity } {}
 
     void begin_play() override {}
@@ -35,6 +38,9 @@ REGISTER_SCRIPT(fan_script);
 class fan_script : public script::entity_script
 {
 public:
+    // NOTE: only touches its own transform, so these scripts can be updated in parallel.
+    static constexpr script::update_schedule schedule{ 0, script::access::none, script::access::none };
+
     constexpr explicit fan_script(game_entity::entity entity) : script::entity_script{ entity } {}
 
     void begin_play() override {}
@@ -58,6 +64,9 @@ REGISTER_SCRIPT(wibbly_wobbly_script);
 class wibbly_wobbly_script : public script::entity_script
 {
 public:
+    // NOTE: only touches its own transform, so these scripts can be updated in parallel.
+    static constexpr script::update_schedule schedule{ 0, script::access::none, script::access::none };
+
     constexpr explicit wibbly_wobbly_script(game_entity::entity entity) : script::entity_script{ entity } {}
 
     void begin_play() override {}
@@ -37,6 +37,8 @@ namespace {
         { engine_shader::post_process_ps,            {"PostProcess.hlsl", "PostProcessPS", shader_type::pixel} },
         { engine_shader::grid_frustums_cs,           {"GridFrustums.hlsl", "ComputeGridFrustumsCS", shader_type::compute} },
         { engine_shader::light_culling_cs,           {"CullLights.hlsl", "CullLightsCS", shader_type::compute} },
+        { engine_shader::cull_draws_cs,              {"CullDraws.hlsl", "CullDrawsCS", shader_type::compute} },
+        { engine_shader::build_hi_z_cs,              {"BuildHiZ.hlsl", "BuildHiZCS", shader_type::compute} },
     };
 
     static_assert(_countof(engine_shader_files) == engine_shader::count);
@@ -9,6 +9,18 @@
 #define TEST_ENTITY_COMPONENTS 0
 #define TEST_WINDOW 0
 #define TEST_RENDERER 1
+#define TEST_JOB_SYSTEM 0
+#define TEST_SCRIPT_UPDATE 0
+#define TEST_ENTITY_CHURN 0
+#define TEST_GEOMETRY 0
+#define TEST_CONTENT_LOADING 0
+#define TEST_CONTENT_STREAMING 0
+#define TEST_CONTENT_CACHE 0
+#define TEST_CULLING 0
+#define TEST_LOD_SELECTION 0
+#define TEST_DRAW_SORTING 0
+#define TEST_PARALLEL_RECORDING 0
+#define TEST_INDIRECT_DRAW 0
 
 class test
 {
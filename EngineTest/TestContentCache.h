@@ -0,0 +1,247 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "ShaderCompilation.h"
+#include "..\Engine\Content\ContentCache.h"
+#include "..\Engine\Graphics\Renderer.h"
+#include "..\Engine\Utilities\IOStream.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace Quantum;
+
+// Checks the resident asset cache with real geometry resources. Writes a few mesh files whose submesh is
+// compressed with the submesh codec of ContentTools.dll, then checks that:
+// - resources are counted with their decoded size, not the size of their file,
+// - acquiring a resident file returns the same resource and adds a reference,
+// - referenced resources are never evicted, even with a budget of 0,
+// - unreferenced resources are evicted in least recently used order when they don't fit in the budget,
+// - trim_cache() destroys all unreferenced resources and the stats add up after each step.
+// The renderer runs without surfaces, since only resource creation is needed. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        _tools_dll = LoadLibrary(L"ContentTools.dll");
+        if (!_tools_dll) return false;
+        _encode_submesh = (encode_submesh)GetProcAddress(_tools_dll, "EncodeSubmesh");
+        _get_encoded_submesh_size_bound = (get_encoded_submesh_size_bound)GetProcAddress(_tools_dll, "GetEncodedSubmeshSizeBound");
+        if (!_encode_submesh || !_get_encoded_submesh_size_bound) return false;
+
+        while (!compile_shaders())
+        {
+            if (MessageBox(nullptr, L"Failed to compile engine shaders.", L"Shader Compilation Error", MB_RETRYCANCEL) != IDRETRY)
+                return false;
+        }
+
+        if (!graphics::initialize(graphics::graphics_platform::direct3d12)) return false;
+        return write_content_set();
+    }
+
+    void run() override
+    {
+        u32 errors{ 0 };
+        errors += check("resource size", &engine_test::validate_size);
+        errors += check("reference counting", &engine_test::validate_references);
+        errors += check("LRU eviction", &engine_test::validate_eviction);
+        errors += check("trim and missing files", &engine_test::validate_trim);
+        assert(errors == 0);
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override
+    {
+        content::trim_cache();
+        graphics::shutdown();
+        FreeLibrary(_tools_dll);
+    }
+
+private:
+    using encode_submesh = u32(*)(u8*, const u8*, u32, const u8*, u32, u32, const u8*, u32, u32);
+    using get_encoded_submesh_size_bound = u32(*)(u32, u32, u32, u32);
+
+    static constexpr u32 _file_count{ 4 };
+    static constexpr u32 _grid_size{ 64 };
+    static constexpr u32 _vertex_count{ _grid_size * _grid_size };
+    static constexpr u32 _index_count{ (_grid_size - 1) * (_grid_size - 1) * 6 };
+    static constexpr u32 _element_size{ 20 };   // same as elements::static_normal_texture
+    // What the submesh uploads: positions, elements and 16 bit indices.
+    static constexpr u64 _resource_size{ sizeof(math::v3) * _vertex_count + _element_size * _vertex_count + sizeof(u16) * _index_count };
+
+    static std::filesystem::path file_path(u32 index)
+    {
+        return std::filesystem::path{ "content_cache_test" } / ("geometry" + std::to_string(index) + ".bin");
+    }
+
+    // Writes geometry blobs with one LOD and one compressed submesh, in the same layout that the editor packs
+    // for the engine. The files only differ in the height of their grid.
+    bool write_content_set()
+    {
+        std::filesystem::create_directories("content_cache_test");
+
+        util::vector<math::v3> positions(_vertex_count);
+        util::vector<u8> elements(_element_size * _vertex_count, 0);
+        util::vector<u16> indices;
+        for (u32 z{ 0 }; z < _grid_size; ++z)
+        {
+            for (u32 x{ 0 }; x < _grid_size; ++x)
+            {
+                if (x + 1 < _grid_size && z + 1 < _grid_size)
+                {
+                    const u16 i{ (u16)(z * _grid_size + x) };
+                    const u16 quad[6]{ i, (u16)(i + _grid_size), (u16)(i + 1), (u16)(i + 1), (u16)(i + _grid_size), (u16)(i + _grid_size + 1) };
+                    for (u16 index : quad) indices.emplace_back(index);
+                }
+            }
+        }
+        assert(indices.size() == _index_count);
+
+        util::vector<u8> compressed(_get_encoded_submesh_size_bound(sizeof(math::v3), _element_size, _vertex_count, _index_count));
+        for (u32 i{ 0 }; i < _file_count; ++i)
+        {
+            for (u32 v{ 0 }; v < _vertex_count; ++v)
+            {
+                positions[v] = { (f32)(v % _grid_size), (f32)i, (f32)(v / _grid_size) };
+            }
+
+            const u32 compressed_size{ _encode_submesh(compressed.data(), (const u8*)positions.data(), sizeof(math::v3), elements.data(), _element_size,
+                                                       _vertex_count, (const u8*)indices.data(), sizeof(u16), _index_count) };
+
+            const u32 submesh_size{ 6 * sizeof(u32) + compressed_size };
+            util::vector<u8> buffer(4 * sizeof(u32) + submesh_size);
+            util::blob_stream_writer blob{ buffer.data(), buffer.size() };
+            blob.write((u32)1);                         // LOD count
+            blob.write(0.f);                            // LOD threshold
+            blob.write((u32)1);                         // submesh count
+            blob.write(submesh_size);
+            blob.write(_element_size);
+            blob.write(_vertex_count);
+            blob.write(_index_count);
+            blob.write((u32)0x03);                      // elements_type::static_normal_texture
+            blob.write((u32)4 | (content::submesh_flags::compressed << 16)); // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+            blob.write(compressed_size);
+            blob.write(compressed.data(), compressed_size);
+            assert(blob.offset() == buffer.size());
+
+            std::ofstream file{ file_path(i), std::ios::out | std::ios::binary | std::ios::trunc };
+            file.write((const char*)buffer.data(), buffer.size());
+            if (!file) return false;
+        }
+
+        return true;
+    }
+
+    u32 check(const char* name, u32 (engine_test::*validate)())
+    {
+        const u32 errors{ (this->*validate)() };
+        char line[256];
+        sprintf_s(line, "Content cache | %-24s | %s (%u errors)\n", name, errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        return errors;
+    }
+
+    static id::id_type acquire(u32 index)
+    {
+        return content::acquire_resource(file_path(index).string().c_str(), content::asset_type::mesh);
+    }
+
+    static void release(id::id_type id)
+    {
+        content::release_resource(id, content::asset_type::mesh);
+    }
+
+    // Number of stats that aren't what we expect.
+    static u32 compare(u64 hits, u64 misses, u64 evictions, u32 resident_count, u32 referenced_count)
+    {
+        const content::cache_stats stats{ content::get_cache_stats() };
+        return (stats.hits != hits) + (stats.misses != misses) + (stats.evictions != evictions) +
+               (stats.resident_count != resident_count) + (stats.referenced_count != referenced_count) +
+               (stats.resident_bytes != resident_count * _resource_size);
+    }
+
+    u32 validate_size()
+    {
+        const id::id_type id{ acquire(0) };
+        u32 errors{ !id::is_valid(id) };
+        // The file is compressed, so the resource must be bigger than the file.
+        errors += content::get_cache_stats().resident_bytes != _resource_size;
+        errors += std::filesystem::file_size(file_path(0)) >= _resource_size;
+        errors += compare(0, 1, 0, 1, 1);
+
+        release(id);
+        errors += compare(0, 1, 0, 1, 0);
+        return errors;
+    }
+
+    u32 validate_references()
+    {
+        content::trim_cache();
+        const content::cache_stats start{ content::get_cache_stats() };
+        const u64 hits{ start.hits }, misses{ start.misses }, evictions{ start.evictions };
+
+        const id::id_type id{ acquire(1) };
+        u32 errors{ acquire(1) != id };
+        errors += compare(hits + 1, misses + 1, evictions, 1, 1);
+
+        // Referenced resources stay, whatever the budget.
+        content::set_cache_budget(0);
+        release(id);
+        errors += compare(hits + 1, misses + 1, evictions, 1, 1);
+
+        // The last reference is gone and the resource doesn't fit in the budget any more.
+        release(id);
+        errors += compare(hits + 1, misses + 1, evictions + 1, 0, 0);
+        return errors;
+    }
+
+    u32 validate_eviction()
+    {
+        content::set_cache_budget(3 * _resource_size);
+        const content::cache_stats start{ content::get_cache_stats() };
+        const u64 hits{ start.hits }, misses{ start.misses }, evictions{ start.evictions };
+
+        for (u32 i{ 0 }; i < 3; ++i) release(acquire(i));
+        u32 errors{ compare(hits, misses + 3, evictions, 3, 0) };
+
+        // Using file 0 again makes file 1 the least recently used one, so loading file 3 evicts it.
+        release(acquire(0));
+        release(acquire(3));
+        errors += compare(hits + 1, misses + 4, evictions + 1, 3, 0);
+
+        release(acquire(2));
+        release(acquire(0));
+        errors += compare(hits + 3, misses + 4, evictions + 1, 3, 0);
+
+        // File 1 was evicted, so it's loaded again and evicts file 3, which is now the least recently used.
+        release(acquire(1));
+        errors += compare(hits + 3, misses + 5, evictions + 2, 3, 0);
+        release(acquire(3));
+        errors += compare(hits + 3, misses + 6, evictions + 3, 3, 0);
+        return errors;
+    }
+
+    u32 validate_trim()
+    {
+        content::set_cache_budget(_file_count * _resource_size);
+        const id::id_type id{ acquire(0) };
+        content::trim_cache();
+        const content::cache_stats stats{ content::get_cache_stats() };
+        u32 errors{ compare(stats.hits, stats.misses, stats.evictions, 1, 1) };
+
+        release(id);
+        content::trim_cache();
+        errors += compare(stats.hits, stats.misses, stats.evictions + 1, 0, 0);
+
+        // Files that can't be opened don't change the cache.
+        errors += id::is_valid(content::acquire_resource("content_cache_test/missing.bin", content::asset_type::mesh));
+        errors += compare(stats.hits, stats.misses, stats.evictions + 1, 0, 0);
+        return errors;
+    }
+
+    HMODULE                             _tools_dll{ nullptr };
+    encode_submesh                      _encode_submesh{ nullptr };
+    get_encoded_submesh_size_bound      _get_encoded_submesh_size_bound{ nullptr };
+};
@@ -0,0 +1,251 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Platform\MappedFile.h"
+#include "..\Engine\Utilities\IOStream.h"
+#include "..\Engine\Content\ContentToEngine.h"
+#include <filesystem>
+#include <fstream>
+#include <Psapi.h>
+
+using namespace Quantum;
+
+// Headless benchmark for content loading. Writes a content set of geometry blobs (2 GB by default) next to
+// the executable, then loads all of it twice: once by reading every file into a heap buffer and once by
+// mapping the files. Both walk the blobs like submesh::add() and copy the vertex and index buffers into an
+// upload buffer. The load time and the growth of the working set and of private (heap) memory while the
+// whole set is loaded are reported. The files are in the OS file cache for both runs, since they were
+// just written or read. Before that, a blob with odd vertex counts is packed and read back, to check that
+// packing, content::get_resource_size() and the reader agree on the padding of vertex buffers.
+// Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        return write_content_set();
+    }
+
+    void run() override
+    {
+        const u32 errors{ validate_odd_vertex_counts() };
+        char line[128];
+        sprintf_s(line, "Content | odd vertex counts: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        measure("mapped", &engine_test::load_mapped);
+        measure("read", &engine_test::load_read);
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _file_count{ 16 };
+    static constexpr u64 _file_size{ 128ull * 1024 * 1024 };
+    // Vertices and indices of each submesh. Fewer than 2^16 vertices, so indices are 16 bit.
+    static constexpr u32 _vertex_count{ 60000 };
+    static constexpr u32 _index_count{ _vertex_count * 6 };
+    static constexpr u32 _element_size{ 20 };   // same as elements::static_normal_texture
+    static_assert((sizeof(math::v3) * _vertex_count) % content::submesh_buffer_alignment == 0 &&
+                  (_element_size * _vertex_count) % content::submesh_buffer_alignment == 0);
+    static constexpr u32 _submesh_size{ 5 * sizeof(u32) + (sizeof(math::v3) + _element_size) * _vertex_count + sizeof(u16) * _index_count };
+    static constexpr u32 _submesh_count{ (u32)((_file_size - 4 * sizeof(u32)) / _submesh_size) };
+    static constexpr u64 _blob_size{ 4 * sizeof(u32) + (u64)_submesh_size * _submesh_count };
+
+    struct memory_counters
+    {
+        u64 working_set;
+        u64 private_bytes;
+    };
+
+    static memory_counters get_memory_counters()
+    {
+        PROCESS_MEMORY_COUNTERS_EX counters{};
+        GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters));
+        return { counters.WorkingSetSize, counters.PrivateUsage };
+    }
+
+    static std::filesystem::path file_path(u32 index)
+    {
+        return std::filesystem::path{ "content_loading_test" } / ("geometry" + std::to_string(index) + ".bin");
+    }
+
+    // Writes a geometry blob with one LOD, in the same layout that the editor packs for the engine.
+    // Files that are already there from a previous run are kept.
+    bool write_content_set()
+    {
+        std::filesystem::create_directories("content_loading_test");
+        util::vector<u8> submesh(_submesh_size);
+        for (u32 i{ 0 }; i < _submesh_size; ++i) submesh[i] = (u8)(i * 131);
+
+        util::blob_stream_writer blob{ submesh.data(), submesh.size() };
+        blob.write(_element_size);
+        blob.write(_vertex_count);
+        blob.write(_index_count);
+        blob.write((u32)0x03);                  // elements_type::static_normal_texture
+        blob.write((u32)4);                     // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, no submesh flags
+
+        for (u32 i{ 0 }; i < _file_count; ++i)
+        {
+            const std::filesystem::path path{ file_path(i) };
+            if (std::filesystem::exists(path) && std::filesystem::file_size(path) == _blob_size) continue;
+
+            std::ofstream file{ path, std::ios::out | std::ios::binary };
+            const u32 header[4]{ 1, 0, _submesh_count, _submesh_size * _submesh_count };   // LOD count, threshold, submesh count and size
+            file.write((const char*)&header[0], sizeof(header));
+            for (u32 j{ 0 }; j < _submesh_count; ++j) file.write((const char*)submesh.data(), submesh.size());
+            if (!file) return false;
+        }
+
+        return true;
+    }
+
+    // Copies the vertex and index buffers of every submesh to 'upload', like submesh::add() does
+    // when it creates the GPU buffers. Returns the number of bytes that were copied.
+    static u64 upload_geometry(const u8* const data, util::vector<u8>& upload)
+    {
+        util::blob_stream_reader blob{ data };
+        const u32 lod_count{ blob.read<u32>() };
+        u64 bytes{ 0 };
+        for (u32 lod_idx{ 0 }; lod_idx < lod_count; ++lod_idx)
+        {
+            blob.skip(sizeof(f32));             // LOD threshold
+            const u32 submesh_count{ blob.read<u32>() };
+            blob.skip(sizeof(u32));             // size of submeshes
+            for (u32 i{ 0 }; i < submesh_count; ++i)
+            {
+                const u32 element_size{ blob.read<u32>() };
+                const u32 vertex_count{ blob.read<u32>() };
+                const u32 index_count{ blob.read<u32>() };
+                blob.skip(2 * sizeof(u32));     // elements type, primitive topology
+                const u32 index_size{ (vertex_count < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
+                const u32 total_buffer_size{ (u32)math::align_size_up<content::submesh_buffer_alignment>(sizeof(math::v3) * vertex_count) +
+                                             (u32)math::align_size_up<content::submesh_buffer_alignment>(element_size * vertex_count) +
+                                             index_size * index_count };
+
+                if (upload.size() < total_buffer_size) upload.resize(total_buffer_size);
+                memcpy(upload.data(), blob.position(), total_buffer_size);
+                blob.skip(total_buffer_size);
+                bytes += total_buffer_size;
+            }
+        }
+        return bytes;
+    }
+
+    // Packs submeshes with odd vertex counts and element sizes (so their vertex buffers need padding) like the
+    // editor does, then reads them back like submesh::add() does. Every submesh must start where the previous
+    // one ended, and the index buffers must come back unchanged.
+    static u32 validate_odd_vertex_counts()
+    {
+        constexpr u32 vertex_counts[]{ 3, 5, 7 };
+        constexpr u32 element_sizes[]{ 2, 6, 0 };
+        constexpr u32 submesh_count{ _countof(vertex_counts) };
+        constexpr u32 alignment{ content::submesh_buffer_alignment };
+
+        util::vector<u8> data(4096);
+        util::blob_stream_writer blob{ data.data(), data.size() };
+        blob.write((u32)1);                     // LOD count
+        blob.write(0.f);                        // threshold
+        blob.write(submesh_count);
+        const u32 size_of_submeshes_offset{ (u32)blob.offset() };
+        blob.skip(sizeof(u32));
+
+        u64 expected_size{ 0 };
+        for (u32 i{ 0 }; i < submesh_count; ++i)
+        {
+            const u32 vertex_count{ vertex_counts[i] };
+            const u32 element_size{ element_sizes[i] };
+            blob.write(element_size);
+            blob.write(vertex_count);
+            blob.write(vertex_count);           // index count
+            blob.write((u32)0);                 // elements type
+            blob.write((u32)4);                 // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, no submesh flags
+
+            const u32 position_buffer_size{ (u32)math::align_size_up<alignment>(sizeof(math::v3) * vertex_count) };
+            const u32 element_buffer_size{ (u32)math::align_size_up<alignment>(element_size * vertex_count) };
+            for (u32 j{ 0 }; j < position_buffer_size + element_buffer_size; ++j) blob.write((u8)0xcd);
+            for (u32 j{ 0 }; j < vertex_count; ++j) blob.write((u16)(i * 100 + j));
+            expected_size += position_buffer_size + element_buffer_size + sizeof(u16) * vertex_count;
+        }
+        const u32 blob_size{ (u32)blob.offset() };
+        const u32 submeshes_size{ blob_size - size_of_submeshes_offset - (u32)sizeof(u32) };
+        memcpy(&data[size_of_submeshes_offset], &submeshes_size, sizeof(u32));
+
+        u32 errors{ content::get_resource_size(data.data(), content::asset_type::mesh) != expected_size };
+
+        util::blob_stream_reader reader{ data.data() };
+        reader.skip(3 * sizeof(u32));
+        errors += reader.read<u32>() != submeshes_size;
+        for (u32 i{ 0 }; i < submesh_count; ++i)
+        {
+            const u32 element_size{ reader.read<u32>() };
+            const u32 vertex_count{ reader.read<u32>() };
+            const u32 index_count{ reader.read<u32>() };
+            reader.skip(2 * sizeof(u32));
+            errors += element_size != element_sizes[i] || vertex_count != vertex_counts[i];
+            reader.skip(math::align_size_up<alignment>(sizeof(math::v3) * vertex_count) + math::align_size_up<alignment>(element_size * vertex_count));
+            for (u32 j{ 0 }; j < index_count; ++j) errors += reader.read<u16>() != i * 100 + j;
+        }
+        errors += reader.offset() != blob_size;
+
+        return errors;
+    }
+
+    u64 load_mapped(memory_counters& loaded)
+    {
+        util::vector<platform::mapped_file> files(_file_count);
+        util::vector<u8> upload;
+        u64 bytes{ 0 };
+        for (u32 i{ 0 }; i < _file_count; ++i)
+        {
+            if (!files[i].open(file_path(i))) return 0;
+            bytes += upload_geometry(files[i].data(), upload);
+        }
+
+        loaded = get_memory_counters();
+        return bytes;
+    }
+
+    // Same as the old read_file() of the content loader.
+    u64 load_read(memory_counters& loaded)
+    {
+        util::vector<std::unique_ptr<u8[]>> files(_file_count);
+        util::vector<u8> upload;
+        u64 bytes{ 0 };
+        for (u32 i{ 0 }; i < _file_count; ++i)
+        {
+            const std::filesystem::path path{ file_path(i) };
+            const u64 size{ std::filesystem::file_size(path) };
+            files[i] = std::make_unique<u8[]>(size);
+            std::ifstream file{ path, std::ios::in | std::ios::binary };
+            if (!file || !file.read((char*)files[i].get(), size)) return 0;
+            bytes += upload_geometry(files[i].get(), upload);
+        }
+
+        loaded = get_memory_counters();
+        return bytes;
+    }
+
+    void measure(const char* name, u64(engine_test::* load)(memory_counters&))
+    {
+        const memory_counters before{ get_memory_counters() };
+        memory_counters loaded{};
+        const auto start{ clock::now() };
+        const u64 bytes{ (this->*load)(loaded) };
+        const f32 ms{ (f32)std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count() * 0.001f };
+        assert(bytes);
+
+        constexpr f32 mb{ 1.f / (1024.f * 1024.f) };
+        char line[256];
+        sprintf_s(line, "Content | %-6s | files: %2u | %7.1f MB | %8.1f ms | %5.2f GB/s | working set: %+8.1f MB | private: %+8.1f MB\n",
+                  name, _file_count, (f32)(_blob_size * _file_count) * mb, ms, (f32)bytes * 1e-6f / std::max(ms, 1e-3f),
+                  (f32)((s64)loaded.working_set - (s64)before.working_set) * mb, (f32)((s64)loaded.private_bytes - (s64)before.private_bytes) * mb);
+        OutputDebugStringA(line);
+    }
+};
@@ -0,0 +1,205 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "ShaderCompilation.h"
+#include "..\Engine\Content\ContentStreaming.h"
+#include "..\Engine\Core\JobSystem.h"
+#include "..\Engine\Graphics\Renderer.h"
+#include "..\Engine\Platform\MappedFile.h"
+#include "..\Engine\Utilities\IOStream.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+using namespace Quantum;
+
+// Measures frame time stalls while geometry is streamed in. A simulated game loop runs for a fixed
+// number of frames with a fixed amount of work per frame and needs a new geometry file every few frames,
+// like a player moving through an open world. Some requests are cancelled right away (the player turned
+// around) and the priority of the newest request is bumped. The files are loaded once synchronously, the
+// way create_resource() is used today, and once with request_resource() and poll_requests(). The renderer
+// runs without surfaces, since only resource creation is needed. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        while (!compile_shaders())
+        {
+            if (MessageBox(nullptr, L"Failed to compile engine shaders.", L"Shader Compilation Error", MB_RETRYCANCEL) != IDRETRY)
+                return false;
+        }
+
+        if (!graphics::initialize(graphics::graphics_platform::direct3d12)) return false;
+        if (!jobs::initialize()) return false;
+        if (!content::initialize_streaming()) return false;
+        return write_content_set();
+    }
+
+    void run() override
+    {
+        measure("sync", false);
+        measure("async", true);
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override
+    {
+        content::shutdown_streaming();
+        jobs::shutdown();
+        graphics::shutdown();
+    }
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _file_count{ 32 };
+    static constexpr u32 _submesh_count{ 4 };
+    static constexpr u32 _vertex_count{ 60000 };
+    static constexpr u32 _index_count{ _vertex_count * 6 };
+    static constexpr u32 _element_size{ 20 };   // same as elements::static_normal_texture
+    static constexpr u32 _submesh_size{ 5 * sizeof(u32) + (sizeof(math::v3) + _element_size) * _vertex_count + sizeof(u16) * _index_count };
+
+    static constexpr u32 _frame_count{ 600 };
+    static constexpr u32 _frames_per_request{ 8 };
+    static constexpr f32 _frame_work_ms{ 8.f };
+    static constexpr f32 _hitch_ms{ 1000.f / 60.f };
+    // Every n-th request is cancelled the frame after it was made.
+    static constexpr u32 _cancel_interval{ 5 };
+
+    static std::filesystem::path file_path(u32 index)
+    {
+        return std::filesystem::path{ "content_streaming_test" } / ("geometry" + std::to_string(index) + ".bin");
+    }
+
+    // Writes geometry blobs with one LOD and a few submeshes, in the same layout that the editor packs for
+    // the engine. Files that are already there from a previous run are kept.
+    bool write_content_set()
+    {
+        std::filesystem::create_directories("content_streaming_test");
+        util::vector<u8> submesh(_submesh_size);
+        for (u32 i{ 0 }; i < _submesh_size; ++i) submesh[i] = (u8)(i * 131);
+
+        util::blob_stream_writer blob{ submesh.data(), submesh.size() };
+        blob.write(_element_size);
+        blob.write(_vertex_count);
+        blob.write(_index_count);
+        blob.write((u32)0x03);                  // elements_type::static_normal_texture
+        blob.write((u32)4);                     // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, no submesh flags
+
+        const u64 file_size{ 4 * sizeof(u32) + (u64)_submesh_size * _submesh_count };
+        for (u32 i{ 0 }; i < _file_count; ++i)
+        {
+            const std::filesystem::path path{ file_path(i) };
+            if (std::filesystem::exists(path) && std::filesystem::file_size(path) == file_size) continue;
+
+            std::ofstream file{ path, std::ios::out | std::ios::binary };
+            const u32 header[4]{ 1, 0, _submesh_count, _submesh_size * _submesh_count };   // LOD count, threshold, submesh count and size
+            file.write((const char*)&header[0], sizeof(header));
+            for (u32 j{ 0 }; j < _submesh_count; ++j) file.write((const char*)submesh.data(), submesh.size());
+            if (!file) return false;
+        }
+
+        return true;
+    }
+
+    static void simulate_frame_work()
+    {
+        const auto start{ clock::now() };
+        while (std::chrono::duration<f32, std::milli>(clock::now() - start).count() < _frame_work_ms) {}
+    }
+
+    void measure(const char* name, bool async)
+    {
+        util::vector<f32> frame_times;
+        util::vector<id::id_type> resources;
+        util::vector<content::request_result> results;
+        content::request_id last_request{ id::invalid_id };
+        u32 request_count{ 0 };
+        u32 cancelled_count{ 0 };
+
+        const auto start{ clock::now() };
+        for (u32 frame{ 0 }; frame < _frame_count; ++frame)
+        {
+            const auto frame_start{ clock::now() };
+            simulate_frame_work();
+
+            if (async)
+            {
+                // The request from the last frame turned out to be unneeded.
+                if (id::is_valid(last_request) && (request_count % _cancel_interval) == 0)
+                {
+                    content::cancel_request(last_request);
+                    last_request = content::request_id{ id::invalid_id };
+                }
+
+                if ((frame % _frames_per_request) == 0)
+                {
+                    // The player is getting closer to the area of the previous request.
+                    if (id::is_valid(last_request)) content::set_request_priority(last_request, content::request_priority::high);
+                    const std::string path{ file_path(request_count % _file_count).string() };
+                    last_request = content::request_resource(path.c_str(), content::asset_type::mesh);
+                    ++request_count;
+                }
+
+                results.clear();
+                content::poll_requests(results);
+                for (const content::request_result& result : results)
+                {
+                    if (result.status == content::request_status::completed) resources.emplace_back(result.resource_id);
+                    else if (result.status == content::request_status::cancelled) ++cancelled_count;
+                    else assert(false);
+                    // NOTE: polled ids are released, so we can't cancel or bump this request anymore.
+                    if ((id::id_type)result.id == (id::id_type)last_request) last_request = content::request_id{ id::invalid_id };
+                }
+            }
+            else if ((frame % _frames_per_request) == 0)
+            {
+                // NOTE: the synchronous path doesn't load the files that the async path cancels.
+                ++request_count;
+                if ((request_count % _cancel_interval) != 0)
+                {
+                    const platform::mapped_file file{ file_path((request_count - 1) % _file_count) };
+                    resources.emplace_back(content::create_resource(file.data(), content::asset_type::mesh));
+                }
+                else ++cancelled_count;
+            }
+
+            frame_times.emplace_back(std::chrono::duration<f32, std::milli>(clock::now() - frame_start).count());
+        }
+
+        // Collect what's still loading.
+        while (async && resources.size() + cancelled_count < request_count)
+        {
+            results.clear();
+            content::poll_requests(results);
+            for (const content::request_result& result : results)
+            {
+                if (result.status == content::request_status::completed) resources.emplace_back(result.resource_id);
+                else ++cancelled_count;
+            }
+            std::this_thread::yield();
+        }
+        const f32 total_ms{ std::chrono::duration<f32, std::milli>(clock::now() - start).count() };
+
+        for (id::id_type id : resources) content::destroy_resource(id, content::asset_type::mesh);
+
+        f32 average{ 0.f };
+        u32 hitches{ 0 };
+        for (f32 t : frame_times)
+        {
+            average += t;
+            hitches += t > _hitch_ms;
+        }
+        average /= (f32)frame_times.size();
+        std::sort(frame_times.begin(), frame_times.end());
+        const f32 p99{ frame_times[frame_times.size() * 99 / 100] };
+
+        char line[256];
+        sprintf_s(line, "Streaming | %-5s | loaded: %3u | cancelled: %3u | frame avg: %6.2f ms | p99: %6.2f ms | max: %7.2f ms | hitches: %3u | total: %8.1f ms\n",
+                  name, (u32)resources.size(), cancelled_count, average, p99, frame_times.back(), hitches, total_ms);
+        OutputDebugStringA(line);
+    }
+};
@@ -0,0 +1,197 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Core\JobSystem.h"
+#include "..\Engine\Graphics\Culling.h"
+
+#include <random>
+
+using namespace Quantum;
+
+// Headless test and benchmark for the CPU frustum culling of submesh bounding spheres. First checks the
+// frustum planes against points projected with the view-projection matrix and the SIMD culling against a
+// plain scalar version. Then measures the culling stage of the GPass (transform the bounding spheres to world
+// space and test them) for 200k items, on one worker with a scalar loop, on one worker and on all workers.
+// Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        using namespace DirectX;
+        std::mt19937 rng{ 17 };
+        std::uniform_real_distribution<f32> unit{ -1.f, 1.f };
+        std::uniform_real_distribution<f32> radius{ 0.1f, 2.f };
+
+        _worlds.resize(_entity_count);
+        for (u32 i{ 0 }; i < _entity_count; ++i)
+        {
+            const XMVECTOR position{ XMVectorSet(unit(rng) * _world_size, unit(rng) * _world_size, unit(rng) * _world_size, 0.f) };
+            const XMVECTOR rotation{ XMQuaternionRotationRollPitchYaw(unit(rng) * math::pi, unit(rng) * math::pi, unit(rng) * math::pi) };
+            const XMVECTOR scale{ XMVectorReplicate(1.5f + unit(rng)) };
+            XMStoreFloat4x4(&_worlds[i], XMMatrixAffineTransformation(scale, XMQuaternionIdentity(), rotation, position));
+        }
+
+        _spheres.resize(_item_count);
+        _world_spheres.resize(_item_count);
+        _visible.resize(_item_count);
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            _spheres[i] = { unit(rng) * 4.f, unit(rng) * 4.f, unit(rng) * 4.f, radius(rng) };
+        }
+
+        // Same kind of camera as the renderer's: right handed, with near and far swapped for reversed depth.
+        const XMMATRIX view{ XMMatrixLookToRH(XMVectorSet(0.f, 0.f, 0.f, 1.f), XMVectorSet(0.3f, 0.1f, -1.f, 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f)) };
+        const XMMATRIX projection{ XMMatrixPerspectiveFovRH(0.25f * math::pi, 16.f / 9.f, 1000.f, 0.1f) };
+        XMStoreFloat4x4(&_view_projection, XMMatrixMultiply(view, projection));
+        return true;
+    }
+
+    void run() override
+    {
+        const graphics::frustum view_frustum{ graphics::make_frustum(_view_projection) };
+        const u32 frustum_errors{ validate_frustum(view_frustum) };
+        const u32 simd_errors{ validate_simd(view_frustum) };
+
+        char line[256];
+        sprintf_s(line, "Culling | frustum planes: %s (%u errors) | SIMD vs scalar: %s (%u errors)\n",
+                  frustum_errors ? "FAILED" : "OK", frustum_errors, simd_errors ? "FAILED" : "OK", simd_errors);
+        OutputDebugStringA(line);
+        assert(frustum_errors == 0 && simd_errors == 0);
+
+        jobs::initialize(1);
+        measure("scalar, 1 worker", view_frustum, false);
+        measure("SIMD, 1 worker", view_frustum, true);
+        jobs::shutdown();
+
+        jobs::initialize();
+        sprintf_s(line, "SIMD, %u workers", jobs::worker_count());
+        measure(line, view_frustum, true);
+        jobs::shutdown();
+
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _item_count{ 200'000 };
+    static constexpr u32 _submeshes_per_entity{ 4 };
+    static constexpr u32 _entity_count{ _item_count / _submeshes_per_entity };
+    static constexpr f32 _world_size{ 300.f };
+    static constexpr u32 _batch_size{ 4096 };
+    static constexpr u32 _iterations{ 32 };
+    // Results closer than this to a plane can go either way because of rounding.
+    static constexpr f32 _tolerance{ 1e-3f };
+
+    // Signed distance to the closest plane, plus the radius. Negative means the sphere is outside.
+    static f32 distance_to_frustum(const graphics::frustum& view_frustum, const math::v4& sphere)
+    {
+        f32 min_distance{ FLT_MAX };
+        for (const math::v4& p : view_frustum.planes)
+        {
+            min_distance = std::min(min_distance, p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w + sphere.w);
+        }
+
+        return min_distance;
+    }
+
+    // Points (spheres with 0 radius) should be visible if and only if they're in the clip space volume.
+    u32 validate_frustum(const graphics::frustum& view_frustum)
+    {
+        using namespace DirectX;
+        const XMMATRIX view_projection{ XMLoadFloat4x4(&_view_projection) };
+        std::mt19937 rng{ 3 };
+        std::uniform_real_distribution<f32> unit{ -1.f, 1.f };
+
+        constexpr u32 point_count{ 100'000 };
+        util::vector<math::v4> points(point_count);
+        util::vector<u8> visible(point_count);
+        for (math::v4& p : points)
+        {
+            // Mostly in front of the camera, so that about half of them are inside.
+            p = { unit(rng) * 100.f, unit(rng) * 60.f, -150.f * (unit(rng) + 1.f), 0.f };
+        }
+
+        graphics::cull_spheres(view_frustum, points.data(), point_count, visible.data());
+
+        u32 errors{ 0 };
+        for (u32 i{ 0 }; i < point_count; ++i)
+        {
+            math::v4 clip;
+            XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(points[i].x, points[i].y, points[i].z, 1.f), view_projection));
+            const f32 margin{ std::min({ clip.w - abs(clip.x), clip.w - abs(clip.y), clip.z, clip.w - clip.z }) };
+            if (abs(margin) < _tolerance * abs(clip.w)) continue;
+            errors += (margin > 0.f) != (visible[i] != 0);
+        }
+
+        return errors;
+    }
+
+    u32 validate_simd(const graphics::frustum& view_frustum)
+    {
+        transform_spheres(0, _item_count);
+        graphics::cull_spheres(view_frustum, _world_spheres.data(), _item_count, _visible.data());
+
+        u32 errors{ 0 };
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            const f32 distance{ distance_to_frustum(view_frustum, _world_spheres[i]) };
+            if (abs(distance) < _tolerance) continue;
+            errors += (distance >= 0.f) != (_visible[i] != 0);
+        }
+
+        return errors;
+    }
+
+    void transform_spheres(u32 begin, u32 end)
+    {
+        for (u32 i{ begin }; i < end; ++i)
+        {
+            _world_spheres[i] = graphics::transform_bounding_sphere(_worlds[i / _submeshes_per_entity], _spheres[i]);
+        }
+    }
+
+    void measure(const char* name, const graphics::frustum& view_frustum, bool simd)
+    {
+        u32 visible_count{ 0 };
+        const auto start{ clock::now() };
+        for (u32 iteration{ 0 }; iteration < _iterations; ++iteration)
+        {
+            std::atomic<u32> count{ 0 };
+            jobs::parallel_for(_item_count, _batch_size, [&](u32 begin, u32 end) {
+                transform_spheres(begin, end);
+                if (simd)
+                {
+                    count += graphics::cull_spheres(view_frustum, &_world_spheres[begin], end - begin, &_visible[begin]);
+                    return;
+                }
+
+                u32 batch_count{ 0 };
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    _visible[i] = distance_to_frustum(view_frustum, _world_spheres[i]) >= 0.f;
+                    batch_count += _visible[i];
+                }
+                count += batch_count;
+            });
+            visible_count = count;
+        }
+        const f32 ms{ std::chrono::duration<f32, std::milli>(clock::now() - start).count() / (f32)_iterations };
+
+        char line[256];
+        sprintf_s(line, "Culling | %-18s | %u items | visible: %6u | %7.3f ms | %6.2f ns/item\n",
+                  name, _item_count, visible_count, ms, ms * 1e6f / (f32)_item_count);
+        OutputDebugStringA(line);
+    }
+
+    util::vector<math::m4x4>    _worlds;
+    util::vector<math::v4>      _spheres;
+    util::vector<math::v4>      _world_spheres;
+    util::vector<u8>            _visible;
+    math::m4x4                  _view_projection;
+};
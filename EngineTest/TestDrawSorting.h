@@ -0,0 +1,158 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Core\JobSystem.h"
+#include "..\Engine\Graphics\DrawSorting.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace Quantum;
+
+// Headless test and benchmark for sorting draws by their sort keys. Makes keys for a scene where each material
+// has its own pipeline state and a few root signatures are shared by all pipeline states, like the GPass does.
+// Checks the radix sort against std::stable_sort, counts root signature and pipeline state changes before and
+// after sorting and measures the sort on one worker, on all workers and with std::sort. Results go to the
+// debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        std::mt19937 rng{ 23 };
+        std::uniform_int_distribution<u32> material{ 0, _material_count - 1 };
+        std::uniform_real_distribution<f32> depth{ 0.1f, 1000.f };
+
+        _keys.resize(_item_count);
+        _sorted_keys.resize(_item_count);
+        _order.resize(_item_count);
+        _temp_keys.resize(_item_count);
+        _temp_order.resize(_item_count);
+        _histograms.resize(graphics::radix_sort_histogram_size);
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            const u32 m{ material(rng) };
+            const u32 pipeline_state{ m % _pipeline_state_count };
+            const u32 root_signature{ pipeline_state % _root_signature_count };
+            _keys[i] = graphics::make_sort_key(1, root_signature, pipeline_state, m, depth(rng));
+        }
+
+        return true;
+    }
+
+    void run() override
+    {
+        const u32 errors{ validate() };
+        char line[256];
+        sprintf_s(line, "Draw sorting | radix sort vs std::stable_sort: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        count_state_changes("unsorted", _keys.data());
+        count_state_changes("sorted", _sorted_keys.data());
+
+        jobs::initialize(1);
+        measure("radix sort, 1 worker", true);
+        jobs::shutdown();
+
+        jobs::initialize();
+        sprintf_s(line, "radix sort, %u workers", jobs::worker_count());
+        measure(line, true);
+        jobs::shutdown();
+
+        measure("std::sort", false);
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _item_count{ 200'000 };
+    static constexpr u32 _material_count{ 512 };
+    static constexpr u32 _pipeline_state_count{ 64 };
+    static constexpr u32 _root_signature_count{ 4 };
+    static constexpr u32 _iterations{ 32 };
+
+    void reset_order()
+    {
+        memcpy(_sorted_keys.data(), _keys.data(), _item_count * sizeof(u64));
+        for (u32 i{ 0 }; i < _item_count; ++i) _order[i] = i;
+    }
+
+    u32 validate()
+    {
+        util::vector<std::pair<u64, u32>> expected(_item_count);
+        for (u32 i{ 0 }; i < _item_count; ++i) expected[i] = { _keys[i], i };
+        std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        u32 errors{ 0 };
+        for (u32 workers : { 1u, 0u })
+        {
+            jobs::initialize(workers);
+            reset_order();
+            graphics::radix_sort(_sorted_keys.data(), _order.data(), _item_count, _temp_keys.data(), _temp_order.data(), _histograms.data());
+            jobs::shutdown();
+
+            for (u32 i{ 0 }; i < _item_count; ++i)
+            {
+                errors += _sorted_keys[i] != expected[i].first || _order[i] != expected[i].second;
+            }
+        }
+
+        return errors;
+    }
+
+    void count_state_changes(const char* name, const u64* const keys)
+    {
+        using key = graphics::sort_key;
+        constexpr u64 root_signature_mask{ ((1ull << key::root_signature_bits) - 1) << key::root_signature_shift };
+        constexpr u64 pipeline_state_mask{ ((1ull << key::pipeline_state_bits) - 1) << key::pipeline_state_shift };
+
+        u32 root_signature_changes{ 1 }, pipeline_state_changes{ 1 };
+        for (u32 i{ 1 }; i < _item_count; ++i)
+        {
+            root_signature_changes += (keys[i] & root_signature_mask) != (keys[i - 1] & root_signature_mask);
+            pipeline_state_changes += (keys[i] & pipeline_state_mask) != (keys[i - 1] & pipeline_state_mask);
+        }
+
+        char line[256];
+        sprintf_s(line, "Draw sorting | %-8s | %u draws | root signature changes: %6u | pipeline state changes: %6u\n",
+                  name, _item_count, root_signature_changes, pipeline_state_changes);
+        OutputDebugStringA(line);
+    }
+
+    void measure(const char* name, bool radix)
+    {
+        f32 total_ms{ 0.f };
+        for (u32 iteration{ 0 }; iteration < _iterations; ++iteration)
+        {
+            reset_order();
+            const auto start{ clock::now() };
+            if (radix)
+            {
+                graphics::radix_sort(_sorted_keys.data(), _order.data(), _item_count, _temp_keys.data(), _temp_order.data(), _histograms.data());
+            }
+            else
+            {
+                std::sort(_sorted_keys.begin(), _sorted_keys.end());
+            }
+            total_ms += std::chrono::duration<f32, std::milli>(clock::now() - start).count();
+        }
+        const f32 ms{ total_ms / (f32)_iterations };
+
+        char line[256];
+        sprintf_s(line, "Draw sorting | %-22s | %u keys | %7.3f ms | %5.2f ns/key\n", name, _item_count, ms, ms * 1e6f / (f32)_item_count);
+        OutputDebugStringA(line);
+    }
+
+    util::vector<u64>   _keys;
+    util::vector<u64>   _sorted_keys;
+    util::vector<u32>   _order;
+    util::vector<u64>   _temp_keys;
+    util::vector<u32>   _temp_order;
+    util::vector<u32>   _histograms;
+};
@@ -0,0 +1,129 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Components\Entity.h"
+#include "..\Engine\Components\Transform.h"
+
+#include <random>
+
+using namespace Quantum;
+
+// Headless benchmark for id recycling. Keeps 1M ids (and entities) alive and replaces a random
+// part of them every round, so freed slots are reused right away. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        _ids.resize(_live_count);
+        return true;
+    }
+
+    void run() override
+    {
+        measure_id_allocator();
+        measure_entities();
+        util::memory::dump_counters([](const char* line) { OutputDebugStringA(line); });
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static f32 elapsed_ns(clock::time_point start, u32 operation_count)
+    {
+        return (f32)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / (f32)operation_count;
+    }
+
+    void measure_id_allocator()
+    {
+        id::allocator<> allocator{};
+
+        auto start{ clock::now() };
+        for (u32 i{ 0 }; i < _live_count; ++i) _ids[i] = allocator.allocate();
+        const f32 allocate_ns{ elapsed_ns(start, _live_count) };
+
+        start = clock::now();
+        for (u32 round{ 0 }; round < _round_count; ++round)
+        {
+            for (u32 i{ 0 }; i < _churn_count; ++i)
+            {
+                const u32 slot{ (u32)(_random() % _live_count) };
+                allocator.release(_ids[slot]);
+                _ids[slot] = allocator.allocate();
+            }
+        }
+        const f32 churn_ns{ elapsed_ns(start, _round_count * _churn_count) };
+
+        for (u32 i{ 0 }; i < _live_count; ++i)
+        {
+            assert(allocator.is_alive(_ids[i]));
+            allocator.release(_ids[i]);
+        }
+        assert(!allocator.size() && allocator.capacity() == _live_count + allocator.retired_count());
+
+        // NOTE: a smaller generation field retires slots sooner. Check that ids of another split are decoded
+        //       with the allocator's own index() and generation().
+        id::allocator<28, 4> small_allocator{};
+        id::id_type small_id{ small_allocator.allocate() };
+        const id::id_type small_index{ small_allocator.index(small_id) };
+        for (id::id_type generation{ 1 }; generation <= small_allocator.max_generation; ++generation)
+        {
+            small_allocator.release(small_id);
+            small_id = small_allocator.allocate();
+            assert(small_allocator.index(small_id) == small_index && small_allocator.generation(small_id) == generation);
+        }
+        small_allocator.release(small_id);
+        assert(small_allocator.retired_count() == 1 && small_allocator.allocate() != small_id);
+
+        char line[256];
+        sprintf_s(line, "id::allocator | %u ids | allocate: %.1f ns | release + allocate: %.1f ns | slots: %u | retired: %u\n",
+                  _live_count, allocate_ns, churn_ns, allocator.capacity(), allocator.retired_count());
+        OutputDebugStringA(line);
+    }
+
+    void measure_entities()
+    {
+        transform::init_info transform_info{};
+        game_entity::entity_info entity_info{ &transform_info };
+
+        auto start{ clock::now() };
+        for (u32 i{ 0 }; i < _live_count; ++i) _ids[i] = game_entity::create(entity_info).get_id();
+        const f32 create_ns{ elapsed_ns(start, _live_count) };
+
+        start = clock::now();
+        for (u32 round{ 0 }; round < _round_count; ++round)
+        {
+            for (u32 i{ 0 }; i < _churn_count; ++i)
+            {
+                const u32 slot{ (u32)(_random() % _live_count) };
+                game_entity::remove(game_entity::entity_id{ _ids[slot] });
+                _ids[slot] = game_entity::create(entity_info).get_id();
+            }
+        }
+        const f32 churn_ns{ elapsed_ns(start, _round_count * _churn_count) };
+
+        start = clock::now();
+        for (u32 i{ 0 }; i < _live_count; ++i)
+        {
+            assert(game_entity::is_alive(game_entity::entity_id{ _ids[i] }));
+            game_entity::remove(game_entity::entity_id{ _ids[i] });
+        }
+        const f32 remove_ns{ elapsed_ns(start, _live_count) };
+
+        char line[256];
+        sprintf_s(line, "entities | %u entities | create: %.1f ns | remove + create: %.1f ns | remove: %.1f ns\n",
+                  _live_count, create_ns, churn_ns, remove_ns);
+        OutputDebugStringA(line);
+    }
+
+    static constexpr u32        _live_count{ 1'000'000 };
+    static constexpr u32        _churn_count{ 100'000 };
+    static constexpr u32        _round_count{ 20 };
+    util::vector<id::id_type>   _ids;
+    std::mt19937                _random{ 1234 };
+};
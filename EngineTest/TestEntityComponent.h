@@ -6,6 +6,7 @@
 #include "Test.h"
 #include "..\Engine\Components\Entity.h"
 #include "..\Engine\Components\Transform.h"
+#include "..\Engine\Core\JobSystem.h"
 
 #include <iostream>
 #include <ctime>
@@ -16,7 +17,7 @@ class engine_test : public test {
 public:
     bool initialize() override {
         srand((u32)time(nullptr));
-        return true;
+        return jobs::initialize();
     }
 
     void run() override {
@@ -26,11 +27,12 @@ public:
                 remove_random();
                 _num_entities = (u32)_entities.size();
             }
+            create_deferred();
             print_results();
         } while (getchar() != 'q');
     }
 
-    void shutdown() override { }
+    void shutdown() override { jobs::shutdown(); }
 
 private:
     void create_random() {
@@ -42,7 +44,7 @@ private:
             &transform_info,
         };
 
-        while (count < 0) {
+        while (count > 0) {
             ++_added;
             game_entity::entity entity{ game_entity::create(entity_info) };
             assert(entity.is_valid());
@@ -55,7 +57,7 @@ private:
     void remove_random() {
         u32 count = rand() % 20;
         if (_entities.size() < 1000) return;
-        while (count < 0) {
+        while (count > 0) {
             ++_removed;
             const u32 index{ (u32)rand() % (u32)_entities.size() };
             const game_entity::entity entity{ _entities[index] };
@@ -69,10 +71,50 @@ private:
         }
     }
 
+    // Creates entities from worker threads and removes some of them again in the same frame.
+    void create_deferred()
+    {
+        constexpr u32 count{ 10000 };
+        util::vector<game_entity::entity_id> ids(count);
+        jobs::parallel_for(count, 256, [&ids](u32 begin, u32 end) {
+            transform::init_info transform_info{};
+            game_entity::entity_info entity_info{ &transform_info };
+            for (u32 i{ begin }; i < end; ++i)
+            {
+                ids[i] = game_entity::defer_create(entity_info);
+                assert(id::is_valid(ids[i]) && !game_entity::is_alive(ids[i]));
+                if (i & 1) game_entity::defer_remove(ids[i]);
+            }
+        });
+        game_entity::apply_commands();
+
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            assert(game_entity::is_alive(ids[i]) == !(i & 1));
+            if (!(i & 1)) _entities.emplace_back(ids[i]);
+        }
+        _added += count;
+        _removed += count / 2;
+        _num_entities = (u32)_entities.size();
+    }
+
     void print_results()
     {
+        // All entities have a transform, so iterating the transform chunks should visit every living entity.
+        u32 chunk_entities{ 0 };
+        game_entity::for_each_chunk(game_entity::component_type::transform, [&chunk_entities](const game_entity::entity_chunk& chunk) {
+            for (u32 i{ 0 }; i < chunk.count; ++i)
+            {
+                assert(game_entity::is_alive(chunk.ids[i]));
+                assert(chunk.transforms[i].is_valid());
+            }
+            chunk_entities += chunk.count;
+        });
+        assert(chunk_entities == _num_entities);
+
         std::cout << "Entities created: " << _added << "\n";
         std::cout << "Entities removed: " << _removed << "\n";
+        std::cout << "Entities in chunks: " << chunk_entities << "\n";
     }
 
     util::vector<game_entity::entity> _entities;
@@ -0,0 +1,480 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\ContentTools\Geometry.h"
+#include "..\ContentTools\PrimitiveMesh.h"
+#include "..\Engine\Content\MeshDecoder.h"
+#include <DirectXPackedVector.h>
+
+using namespace Quantum;
+
+// Headless benchmark for geometry import. Generates planes and uv spheres of increasing size with
+// ContentTools.dll and measures how long it takes to process and pack them. The time per triangle
+// should stay about the same as meshes grow. Every mesh is generated with and without vertex cache
+// optimization, and the vertex cache efficiency of the packed indices is reported as ACMR (transformed
+// vertices per triangle) and ATVR (transformed vertices per vertex) for a 16 entry FIFO cache.
+// LODs are generated for a uv sphere and their triangle counts and switch distances are listed.
+// Meshlets are built for each primitive and checked against the vertex and triangle limits.
+// Finally, primitives are packed with quantized vertices and the reconstructed positions and uvs are
+// checked against the unquantized ones. The packed buffers of a uv sphere are then compressed with the
+// submesh codec, decoded again and compared with the originals, and the compression ratio and decoding
+// throughput are reported. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        _tools_dll = LoadLibrary(L"ContentTools.dll");
+        if (!_tools_dll) return false;
+        _create_primitive_mesh = (create_primitive_mesh)GetProcAddress(_tools_dll, "CreatePrimitiveMesh");
+        _encode_submesh = (encode_submesh)GetProcAddress(_tools_dll, "EncodeSubmesh");
+        _get_encoded_submesh_size_bound = (get_encoded_submesh_size_bound)GetProcAddress(_tools_dll, "GetEncodedSubmeshSizeBound");
+        return _create_primitive_mesh && _encode_submesh && _get_encoded_submesh_size_bound;
+    }
+
+    void run() override
+    {
+        constexpr u32 segments[]{ 64, 128, 256, 512, 1024 };
+        for (u32 s : segments)
+        {
+            for (u8 optimize{ 0 }; optimize < 2; ++optimize)
+            {
+                measure(tools::primitive_mesh_type::plane, "plane", s, 45.f, optimize);
+                measure(tools::primitive_mesh_type::uv_sphere, "uv_sphere", s, 45.f, optimize);
+                measure(tools::primitive_mesh_type::uv_sphere, "uv_sphere (hard edges)", s, 180.f, optimize);
+            }
+        }
+
+        measure_lods(tools::primitive_mesh_type::uv_sphere, 256, 5);
+
+        measure_meshlets(tools::primitive_mesh_type::plane, "plane", 256, 45.f);
+        measure_meshlets(tools::primitive_mesh_type::uv_sphere, "uv_sphere", 256, 45.f);
+        measure_meshlets(tools::primitive_mesh_type::uv_sphere, "uv_sphere (hard edges)", 256, 180.f);
+
+        measure_quantization(tools::primitive_mesh_type::plane, "plane", 256);
+        measure_quantization(tools::primitive_mesh_type::uv_sphere, "uv_sphere", 256);
+
+        measure_codec(tools::primitive_mesh_type::plane, "plane", 512, 0);
+        measure_codec(tools::primitive_mesh_type::uv_sphere, "uv_sphere", 512, 0);
+        measure_codec(tools::primitive_mesh_type::uv_sphere, "uv_sphere (quantized)", 512, 1);
+
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override
+    {
+        if (_tools_dll) FreeLibrary(_tools_dll);
+        _tools_dll = nullptr;
+    }
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+    using create_primitive_mesh = void(*)(tools::scene_data*, tools::primitive_init_info*);
+    using encode_submesh = u32(*)(u8*, const u8*, u32, const u8*, u32, u32, const u8*, u32, u32);
+    using get_encoded_submesh_size_bound = u32(*)(u32, u32, u32, u32);
+
+    // Number of vertices that miss a FIFO post-transform cache of cache_size entries.
+    static u32 count_cache_misses(const util::vector<u32>& indices, u32 vertex_count, u32 cache_size)
+    {
+        util::vector<u32> timestamps(vertex_count, 0u);
+        u32 time{ cache_size + 1 };
+        u32 misses{ 0 };
+        for (u32 index : indices)
+        {
+            if (time - timestamps[index] >= cache_size)
+            {
+                timestamps[index] = time++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+
+    void measure(tools::primitive_mesh_type type, const char* name, u32 segment_count, f32 smoothing_angle, u8 optimize)
+    {
+        tools::primitive_init_info info{};
+        info.type = type;
+        info.segments[0] = info.segments[1] = info.segments[2] = segment_count;
+
+        tools::scene_data data{};
+        data.settings.smothing_angle = smoothing_angle;
+        data.settings.calculate_normals = 1;
+        data.settings.optimize_vertex_cache = optimize;
+
+        const auto start{ clock::now() };
+        _create_primitive_mesh(&data, &info);
+        const auto dt{ clock::now() - start };
+        assert(data.buffer && data.buffer_size);
+
+        // NOTE: same layout as pack_data(): scene name, LOD count, LOD name, mesh count, then the first mesh.
+        //       We skip ahead to the vertex and index data of that mesh.
+        const u8* at{ data.buffer };
+        auto read_u32{ [&at]() { u32 v; memcpy(&v, at, sizeof(u32)); at += sizeof(u32); return v; } };
+        at += read_u32();                       // scene name
+        read_u32();                             // LOD count
+        at += read_u32();                       // LOD name
+        read_u32();                             // mesh count
+        at += read_u32();                       // mesh name
+        read_u32();                             // lod id
+        const u32 element_size{ read_u32() };
+        read_u32();                             // element type
+        const u32 vertex_count{ read_u32() };
+        const u32 index_size{ read_u32() };
+        const u32 index_count{ read_u32() };
+        const u32 triangle_count{ index_count / 3 };
+        at += sizeof(f32);                      // LOD threshold
+        at += (sizeof(math::v3) + element_size) * vertex_count;
+
+        util::vector<u32> indices(index_count);
+        for (u32 i{ 0 }; i < index_count; ++i)
+        {
+            if (index_size == sizeof(u16)) { u16 index; memcpy(&index, at, sizeof(u16)); indices[i] = index; }
+            else memcpy(&indices[i], at, sizeof(u32));
+            at += index_size;
+        }
+        const u32 misses{ count_cache_misses(indices, vertex_count, 16) };
+
+        CoTaskMemFree(data.buffer);
+
+        const f32 ms{ (f32)std::chrono::duration_cast<std::chrono::microseconds>(dt).count() * 0.001f };
+        char line[256];
+        sprintf_s(line, "%-24s | %-9s | segments: %4u | triangles: %8u | vertices: %8u | %9.2f ms | %6.1f ns/triangle | ACMR: %5.3f | ATVR: %5.3f\n",
+                  name, optimize ? "optimized" : "source", segment_count, triangle_count, vertex_count, ms, ms * 1e6f / (f32)triangle_count,
+                  (f32)misses / (f32)triangle_count, (f32)misses / (f32)vertex_count);
+        OutputDebugStringA(line);
+    }
+
+    void measure_lods(tools::primitive_mesh_type type, u32 segment_count, u8 lod_count)
+    {
+        tools::primitive_init_info info{};
+        info.type = type;
+        info.segments[0] = info.segments[1] = info.segments[2] = segment_count;
+
+        tools::scene_data data{};
+        data.settings.smothing_angle = 45.f;
+        data.settings.calculate_normals = 1;
+        data.settings.optimize_vertex_cache = 1;
+        data.settings.generated_lod_count = lod_count;
+
+        const auto start{ clock::now() };
+        _create_primitive_mesh(&data, &info);
+        const auto dt{ clock::now() - start };
+        assert(data.buffer && data.buffer_size);
+
+        const u8* at{ data.buffer };
+        auto read_u32{ [&at]() { u32 v; memcpy(&v, at, sizeof(u32)); at += sizeof(u32); return v; } };
+        at += read_u32();                       // scene name
+        read_u32();                             // LOD count
+        at += read_u32();                       // LOD name
+        const u32 mesh_count{ read_u32() };
+
+        char line[256];
+        sprintf_s(line, "LODs | segments: %4u | meshes: %u | %9.2f ms\n", segment_count, mesh_count,
+                  (f32)std::chrono::duration_cast<std::chrono::microseconds>(dt).count() * 0.001f);
+        OutputDebugStringA(line);
+
+        f32 previous_threshold{ -1.f };
+        for (u32 i{ 0 }; i < mesh_count; ++i)
+        {
+            at += read_u32();                   // mesh name
+            const u32 lod_id{ read_u32() };
+            const u32 element_size{ read_u32() };
+            read_u32();                         // element type
+            const u32 vertex_count{ read_u32() };
+            const u32 index_size{ read_u32() };
+            const u32 index_count{ read_u32() };
+            f32 threshold;
+            memcpy(&threshold, at, sizeof(f32));
+            at += sizeof(f32);
+            at += (sizeof(math::v3) + element_size) * vertex_count + index_size * index_count;
+            at += sizeof(tools::meshlet) * read_u32();
+
+            // LODs have to switch at strictly increasing distances.
+            assert(lod_id == i && (i == 0 || threshold > previous_threshold));
+            previous_threshold = threshold;
+
+            sprintf_s(line, "  LOD %u | threshold: %9.3f | triangles: %8u | vertices: %8u\n", lod_id, threshold, index_count / 3, vertex_count);
+            OutputDebugStringA(line);
+        }
+
+        CoTaskMemFree(data.buffer);
+    }
+
+    void measure_meshlets(tools::primitive_mesh_type type, const char* name, u32 segment_count, f32 smoothing_angle)
+    {
+        tools::primitive_init_info info{};
+        info.type = type;
+        info.segments[0] = info.segments[1] = info.segments[2] = segment_count;
+
+        tools::scene_data data{};
+        data.settings.smothing_angle = smoothing_angle;
+        data.settings.calculate_normals = 1;
+        data.settings.optimize_vertex_cache = 1;
+        data.settings.build_meshlets = 1;
+
+        _create_primitive_mesh(&data, &info);
+        assert(data.buffer && data.buffer_size);
+
+        const u8* at{ data.buffer };
+        auto read_u32{ [&at]() { u32 v; memcpy(&v, at, sizeof(u32)); at += sizeof(u32); return v; } };
+        at += read_u32();                       // scene name
+        read_u32();                             // LOD count
+        at += read_u32();                       // LOD name
+        read_u32();                             // mesh count
+        at += read_u32();                       // mesh name
+        read_u32();                             // lod id
+        const u32 element_size{ read_u32() };
+        read_u32();                             // element type
+        const u32 vertex_count{ read_u32() };
+        const u32 index_size{ read_u32() };
+        const u32 index_count{ read_u32() };
+        at += sizeof(f32);                      // LOD threshold
+
+        util::vector<math::v3> positions(vertex_count);
+        memcpy(positions.data(), at, sizeof(math::v3) * vertex_count);
+        at += (sizeof(math::v3) + element_size) * vertex_count;
+
+        util::vector<u32> indices(index_count);
+        for (u32 i{ 0 }; i < index_count; ++i)
+        {
+            if (index_size == sizeof(u16)) { u16 index; memcpy(&index, at, sizeof(u16)); indices[i] = index; }
+            else memcpy(&indices[i], at, sizeof(u32));
+            at += index_size;
+        }
+
+        const u32 meshlet_count{ read_u32() };
+        util::vector<tools::meshlet> meshlets(meshlet_count);
+        memcpy(meshlets.data(), at, sizeof(tools::meshlet) * meshlet_count);
+
+        // Meshlets have to cover the index buffer without gaps, stay within the limits
+        // and their bounding spheres have to contain all of their vertices.
+        util::vector<u32> vertex_meshlet(vertex_count, u32_invalid_id);
+        u32 next_index{ 0 };
+        u32 total_vertices{ 0 };
+        for (u32 i{ 0 }; i < meshlet_count; ++i)
+        {
+            const tools::meshlet& m{ meshlets[i] };
+            assert(m.first_index == next_index && m.index_count && m.index_count <= 124 * 3);
+            next_index += m.index_count;
+
+            u32 meshlet_vertices{ 0 };
+            for (u32 j{ m.first_index }; j < m.first_index + m.index_count; ++j)
+            {
+                const u32 v{ indices[j] };
+                if (vertex_meshlet[v] == i) continue;
+                vertex_meshlet[v] = i;
+                ++meshlet_vertices;
+
+                using namespace DirectX;
+                const f32 distance{ XMVectorGetX(XMVector3Length(XMLoadFloat3(&positions[v]) - XMLoadFloat3(&m.center))) };
+                assert(distance <= m.radius * 1.001f + 1e-6f);
+            }
+            assert(meshlet_vertices <= 64);
+            total_vertices += meshlet_vertices;
+        }
+        assert(next_index == index_count);
+
+        CoTaskMemFree(data.buffer);
+
+        char line[256];
+        sprintf_s(line, "Meshlets | %-24s | segments: %4u | triangles: %8u | meshlets: %6u | vertices/meshlet: %5.1f | triangles/meshlet: %5.1f\n",
+                  name, segment_count, index_count / 3, meshlet_count, (f32)total_vertices / (f32)meshlet_count, (f32)index_count / (3.f * (f32)meshlet_count));
+        OutputDebugStringA(line);
+    }
+
+    struct packed_vertices
+    {
+        tools::elements::elements_type::type    elements_type;
+        u32                                     vertex_count;
+        u32                                     element_size;
+        math::v3                                position_offset;
+        math::v3                                position_scale;
+        const u8*                               positions;
+        const u8*                               elements;
+        u32                                     index_size;
+        u32                                     index_count;
+        const u8*                               indices;
+    };
+
+    // Reads the vertices of the first mesh in the scene buffer of ContentTools.
+    static packed_vertices read_first_mesh(const u8* at)
+    {
+        auto read_u32{ [&at]() { u32 v; memcpy(&v, at, sizeof(u32)); at += sizeof(u32); return v; } };
+        at += read_u32();                       // scene name
+        read_u32();                             // LOD count
+        at += read_u32();                       // LOD name
+        read_u32();                             // mesh count
+        at += read_u32();                       // mesh name
+        read_u32();                             // lod id
+
+        packed_vertices result{};
+        result.element_size = read_u32();
+        result.elements_type = (tools::elements::elements_type::type)read_u32();
+        result.vertex_count = read_u32();
+        result.index_size = read_u32();
+        result.index_count = read_u32();
+        at += sizeof(f32);                      // LOD threshold
+
+        const bool quantized{ (result.elements_type & tools::elements::elements_type::quantized) != 0 };
+        if (quantized)
+        {
+            memcpy(&result.position_offset, at, sizeof(math::v3)); at += sizeof(math::v3);
+            memcpy(&result.position_scale, at, sizeof(math::v3)); at += sizeof(math::v3);
+        }
+
+        result.positions = at;
+        at += (quantized ? sizeof(tools::elements::position_quantized) : sizeof(math::v3)) * result.vertex_count;
+        result.elements = at;
+        at += result.element_size * result.vertex_count;
+        result.indices = at;
+        return result;
+    }
+
+    void measure_quantization(tools::primitive_mesh_type type, const char* name, u32 segment_count)
+    {
+        tools::primitive_init_info info{};
+        info.type = type;
+        info.segments[0] = info.segments[1] = info.segments[2] = segment_count;
+        info.size = { 3.f, 2.f, 1.f };
+
+        tools::scene_data data{};
+        data.settings.smothing_angle = 45.f;
+        data.settings.calculate_normals = 1;
+        data.settings.optimize_vertex_cache = 1;
+
+        _create_primitive_mesh(&data, &info);
+        assert(data.buffer && data.buffer_size);
+        const packed_vertices reference{ read_first_mesh(data.buffer) };
+
+        tools::scene_data quantized_data{};
+        quantized_data.settings = data.settings;
+        quantized_data.settings.quantize_vertices = 1;
+        _create_primitive_mesh(&quantized_data, &info);
+        assert(quantized_data.buffer && quantized_data.buffer_size);
+        const packed_vertices quantized{ read_first_mesh(quantized_data.buffer) };
+
+        using namespace tools::elements;
+        assert(quantized.elements_type == (reference.elements_type | elements_type::quantized));
+        assert(quantized.vertex_count == reference.vertex_count);
+        const u32 vertex_count{ reference.vertex_count };
+
+        // Rounding to the nearest step is off by at most half a step on each axis.
+        // The extra margin covers the float math of quantization and reconstruction.
+        const math::v3& scale{ quantized.position_scale };
+        const math::v3 max_position_error{ scale.x * 0.52f + 1e-6f, scale.y * 0.52f + 1e-6f, scale.z * 0.52f + 1e-6f };
+        math::v3 position_error{};
+        for (u32 i{ 0 }; i < vertex_count; ++i)
+        {
+            math::v3 p;
+            position_quantized q;
+            memcpy(&p, reference.positions + i * sizeof(math::v3), sizeof(math::v3));
+            memcpy(&q, quantized.positions + i * sizeof(position_quantized), sizeof(position_quantized));
+            const math::v3 r{ quantized.position_offset.x + q.position[0] * scale.x,
+                              quantized.position_offset.y + q.position[1] * scale.y,
+                              quantized.position_offset.z + q.position[2] * scale.z };
+            position_error.x = std::max(position_error.x, std::abs(r.x - p.x));
+            position_error.y = std::max(position_error.y, std::abs(r.y - p.y));
+            position_error.z = std::max(position_error.z, std::abs(r.z - p.z));
+        }
+        assert(position_error.x <= max_position_error.x && position_error.y <= max_position_error.y && position_error.z <= max_position_error.z);
+
+        // Half floats have 11 significant bits, so uvs in [0, 1] are off by at most 2^-12.
+        f32 uv_error{ 0.f };
+        if ((reference.elements_type & elements_type::static_normal_texture) == elements_type::static_normal_texture)
+        {
+            constexpr u32 uv_offset{ offsetof(static_normal_texture, uv) };
+            static_assert(uv_offset == offsetof(static_normal_texture_quantized, uv));
+            for (u32 i{ 0 }; i < vertex_count; ++i)
+            {
+                math::v2 uv;
+                u16 half_uv[2];
+                memcpy(&uv, reference.elements + i * reference.element_size + uv_offset, sizeof(math::v2));
+                memcpy(half_uv, quantized.elements + i * quantized.element_size + uv_offset, sizeof(half_uv));
+                uv_error = std::max(uv_error, std::abs(DirectX::PackedVector::XMConvertHalfToFloat(half_uv[0]) - uv.x));
+                uv_error = std::max(uv_error, std::abs(DirectX::PackedVector::XMConvertHalfToFloat(half_uv[1]) - uv.y));
+            }
+            assert(uv_error <= 1.f / 4096.f);
+        }
+
+        const u32 vertex_size{ (u32)sizeof(math::v3) + reference.element_size };
+        const u32 quantized_vertex_size{ (u32)sizeof(position_quantized) + quantized.element_size };
+
+        CoTaskMemFree(data.buffer);
+        CoTaskMemFree(quantized_data.buffer);
+
+        char line[256];
+        sprintf_s(line, "Quantize | %-24s | vertices: %8u | bytes/vertex: %2u -> %2u | position error: %.2e %.2e %.2e | uv error: %.2e\n",
+                  name, vertex_count, vertex_size, quantized_vertex_size, position_error.x, position_error.y, position_error.z, uv_error);
+        OutputDebugStringA(line);
+    }
+
+    void measure_codec(tools::primitive_mesh_type type, const char* name, u32 segment_count, u8 quantize)
+    {
+        tools::primitive_init_info info{};
+        info.type = type;
+        info.segments[0] = info.segments[1] = info.segments[2] = segment_count;
+
+        tools::scene_data data{};
+        data.settings.smothing_angle = 45.f;
+        data.settings.calculate_normals = 1;
+        data.settings.optimize_vertex_cache = 1;
+        data.settings.quantize_vertices = quantize;
+
+        _create_primitive_mesh(&data, &info);
+        assert(data.buffer && data.buffer_size);
+        const packed_vertices mesh{ read_first_mesh(data.buffer) };
+        const bool quantized{ (mesh.elements_type & tools::elements::elements_type::quantized) != 0 };
+        const u32 position_size{ quantized ? (u32)sizeof(tools::elements::position_quantized) : (u32)sizeof(math::v3) };
+        const u32 vertex_count{ mesh.vertex_count };
+        const u32 index_count{ mesh.index_count };
+
+        util::vector<u8> encoded(_get_encoded_submesh_size_bound(position_size, mesh.element_size, vertex_count, index_count));
+        const u32 encoded_size{ _encode_submesh(encoded.data(), mesh.positions, position_size, mesh.elements, mesh.element_size,
+                                                vertex_count, mesh.indices, mesh.index_size, index_count) };
+        assert(encoded_size && encoded_size <= encoded.size());
+
+        util::vector<u8> positions(position_size * vertex_count);
+        util::vector<u8> elements(mesh.element_size * vertex_count);
+        util::vector<u8> indices(mesh.index_size * index_count);
+        u64 vertex_bytes{ 0 };
+        u64 index_bytes{ 0 };
+
+        constexpr u32 iterations{ 16 };
+        const auto start{ clock::now() };
+        for (u32 i{ 0 }; i < iterations; ++i)
+        {
+            vertex_bytes = content::decode_vertex_buffer(positions.data(), vertex_count, position_size, encoded.data(), encoded_size);
+            if (mesh.element_size)
+            {
+                vertex_bytes += content::decode_vertex_buffer(elements.data(), vertex_count, mesh.element_size,
+                                                              encoded.data() + vertex_bytes, encoded_size - vertex_bytes);
+            }
+            index_bytes = content::decode_index_buffer(indices.data(), index_count, mesh.index_size,
+                                                       encoded.data() + vertex_bytes, encoded_size - vertex_bytes);
+        }
+        const auto dt{ clock::now() - start };
+
+        assert(vertex_bytes + index_bytes == encoded_size);
+        assert(!memcmp(positions.data(), mesh.positions, positions.size()));
+        assert(elements.empty() || !memcmp(elements.data(), mesh.elements, elements.size()));
+        assert(!memcmp(indices.data(), mesh.indices, indices.size()));
+
+        CoTaskMemFree(data.buffer);
+
+        const u64 vertex_size{ positions.size() + elements.size() };
+        const u64 decoded_size{ vertex_size + indices.size() };
+        const f32 seconds{ (f32)std::chrono::duration_cast<std::chrono::microseconds>(dt).count() * 1e-6f / (f32)iterations };
+        char line[256];
+        sprintf_s(line, "Codec    | %-24s | vertices: %8u | indices: %8u | vertex bytes: %5.1f%% | index bytes: %5.1f%% | total: %5.1f%% | decode: %5.2f GB/s\n",
+                  name, vertex_count, index_count, 100.f * (f32)vertex_bytes / (f32)vertex_size, 100.f * (f32)index_bytes / (f32)indices.size(),
+                  100.f * (f32)encoded_size / (f32)decoded_size, (f32)decoded_size * 1e-9f / std::max(seconds, 1e-6f));
+        OutputDebugStringA(line);
+    }
+
+    HMODULE                         _tools_dll{ nullptr };
+    create_primitive_mesh           _create_primitive_mesh{ nullptr };
+    encode_submesh                  _encode_submesh{ nullptr };
+    get_encoded_submesh_size_bound  _get_encoded_submesh_size_bound{ nullptr };
+};
@@ -0,0 +1,245 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Graphics\IndirectDraw.h"
+
+#include <random>
+
+using namespace Quantum;
+
+// Headless test and benchmark for the CPU side layout of GPU-driven draws. Counts the draw states of the items of
+// two passes like the GPass does, builds the draw groups and checks that they cover the argument slots in the order
+// of the state keys, with one group per state. Then it culls random items like the culling shader does, with one
+// counter per group, and checks that no two draws write the same argument slot. Also checks the Hi-Z mip layout for
+// a few depth buffer sizes and that the mip the culling shader picks covers any screen rectangle with 2x2 texels.
+// Last, measures building the groups for 200k items. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        std::mt19937 rng{ 29 };
+        std::uniform_int_distribution<u32> material{ 0, _material_count - 1 };
+        std::uniform_int_distribution<u32> topology{ 0, 3 };
+
+        // Like the GPass, each pass, pipeline state and topology is a draw state. The depth prepass uses the same
+        // pipeline state ids here.
+        _state_keys.resize(_state_count);
+        for (u32 s{ 0 }; s < _state_count; ++s)
+        {
+            const u32 pass{ s / (2 * _pipeline_state_count) };
+            const u32 pipeline_state{ (s / 2) % _pipeline_state_count };
+            _state_keys[s] = graphics::make_sort_key(pass, pipeline_state % _root_signature_count, pipeline_state, state_topology(s), 0.f);
+        }
+
+        // Topologies are mostly triangle lists, like D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST (4).
+        _state_ids.resize(2 * _item_count);
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            const u32 state{ (material(rng) % _pipeline_state_count) * 2 + (topology(rng) ? 0 : 1) };
+            _state_ids[i] = state;
+            _state_ids[_item_count + i] = 2 * _pipeline_state_count + state;
+        }
+
+        _state_counts.resize(_state_count);
+        _groups.resize(_state_count);
+        _state_slots.resize(_state_count);
+        return true;
+    }
+
+    void run() override
+    {
+        char line[256];
+        u32 errors{ validate_groups() };
+        sprintf_s(line, "Indirect draws | %u items, groups: %u depth prepass, %u gpass | draw groups: %s (%u errors)\n",
+                  _item_count, _depth_group_count, _group_count - _depth_group_count, errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        errors = validate_culling();
+        sprintf_s(line, "Indirect draws | argument slots after culling: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        errors = validate_hi_z();
+        sprintf_s(line, "Indirect draws | Hi-Z layout and mip selection: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        measure();
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _item_count{ 200'000 };
+    static constexpr u32 _material_count{ 512 };
+    static constexpr u32 _pipeline_state_count{ 64 };
+    static constexpr u32 _root_signature_count{ 4 };
+    static constexpr u32 _state_count{ 2 * 2 * _pipeline_state_count };
+    static constexpr u32 _iterations{ 32 };
+
+    static constexpr u32 state_topology(u32 state) { return state & 1 ? 5 : 4; }
+
+    // Same steps as the GPass for GPU-driven draws: a counting pass over the state ids of the items of both
+    // passes, then one group per state that has draws.
+    void build_groups()
+    {
+        memset(_state_counts.data(), 0, _state_count * sizeof(u32));
+        graphics::count_indirect_draw_states(_state_ids.data(), 2 * _item_count, _state_counts.data());
+        _group_count = graphics::build_indirect_draw_groups(_state_counts.data(), _state_keys.data(), _state_count,
+                                                            _groups.data(), _state_slots.data());
+    }
+
+    u32 validate_groups()
+    {
+        build_groups();
+
+        u32 errors{ 0 };
+        util::vector<u32> counts(_state_count, 0);
+        for (u32 n{ 0 }; n < 2 * _item_count; ++n) ++counts[_state_ids[n]];
+
+        // Groups cover all argument slots without gaps, in the order of their state keys, and each state that has
+        // draws has exactly one group with all of its draws.
+        u32 next_argument{ 0 };
+        util::vector<u32> groups_of_state(_state_count, 0);
+        for (u32 g{ 0 }; g < _group_count; ++g)
+        {
+            const graphics::indirect_draw_group& group{ _groups[g] };
+            errors += group.state_id >= _state_count;
+            if (group.state_id >= _state_count) continue;
+
+            errors += group.first_argument != next_argument || group.max_draw_count != counts[group.state_id];
+            errors += g && _state_keys[_groups[g - 1].state_id] > _state_keys[group.state_id];
+            ++groups_of_state[group.state_id];
+            next_argument = group.first_argument + group.max_draw_count;
+        }
+
+        errors += next_argument != 2 * _item_count;
+        for (u32 s{ 0 }; s < _state_count; ++s)
+        {
+            errors += groups_of_state[s] != (counts[s] ? 1u : 0u);
+            if (!counts[s]) continue;
+
+            // The slot of each state points to its group.
+            const graphics::indirect_draw_slot& slot{ _state_slots[s] };
+            errors += slot.group_index >= _group_count ||
+                      _groups[slot.group_index].state_id != s || _groups[slot.group_index].first_argument != slot.first_argument;
+        }
+
+        // The depth prepass is in the highest bits of the keys, so all of its groups come first.
+        u32 depth_groups{ 0 };
+        while (depth_groups < _group_count && _groups[depth_groups].state_id < _state_count / 2) ++depth_groups;
+        for (u32 g{ depth_groups }; g < _group_count; ++g) errors += _groups[g].state_id < _state_count / 2;
+        errors += depth_groups && _groups[depth_groups - 1].first_argument + _groups[depth_groups - 1].max_draw_count != _item_count;
+        _depth_group_count = depth_groups;
+
+        return errors;
+    }
+
+    // Writes the draws of random visible items like CullDrawsCS does and checks that each slot is written once
+    // and that no group gets more draws than it has slots.
+    u32 validate_culling()
+    {
+        std::mt19937 rng{ 31 };
+        std::uniform_int_distribution<u32> visible{ 0, 2 };
+        const u32 group_count{ _group_count };
+        util::vector<u32> counts(group_count, 0);
+        util::vector<u32> writes(2 * _item_count, 0);
+
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            if (!visible(rng)) continue;
+
+            for (const graphics::indirect_draw_slot* slot : { &_state_slots[_state_ids[i]], &_state_slots[_state_ids[_item_count + i]] })
+            {
+                const u32 index{ counts[slot->group_index]++ };
+                if (index < _groups[slot->group_index].max_draw_count) ++writes[slot->first_argument + index];
+            }
+        }
+
+        u32 errors{ 0 };
+        for (u32 g{ 0 }; g < group_count; ++g)
+        {
+            const graphics::indirect_draw_group& group{ _groups[g] };
+            errors += counts[g] > group.max_draw_count;
+            // ExecuteIndirect draws the first counts[g] slots of the group, which must all be written.
+            for (u32 n{ 0 }; n < std::min(counts[g], group.max_draw_count); ++n)
+            {
+                errors += writes[group.first_argument + n] != 1;
+            }
+        }
+
+        return errors;
+    }
+
+    u32 validate_hi_z()
+    {
+        constexpr math::u32v2 sizes[]{ { 1, 1 }, { 7, 3 }, { 1366, 768 }, { 1920, 1080 }, { 2560, 1440 }, { 4096, 1 } };
+        std::mt19937 rng{ 37 };
+        u32 errors{ 0 };
+
+        for (const math::u32v2& size : sizes)
+        {
+            const graphics::hi_z_layout layout{ graphics::make_hi_z_layout(size.x, size.y) };
+            u32 width{ size.x }, height{ size.y }, offset{ 0 };
+            for (u32 m{ 0 }; m < layout.mip_count; ++m)
+            {
+                width = (width + 1) / 2;
+                height = (height + 1) / 2;
+                const graphics::hi_z_mip& mip{ layout.mips[m] };
+                errors += mip.width != width || mip.height != height || mip.offset != offset;
+                offset += width * height;
+            }
+
+            errors += width != 1 || height != 1 || layout.size != offset;
+
+            // Same mip selection as IsOccluded() in CullDraws.hlsl.
+            std::uniform_int_distribution<u32> x{ 0, size.x - 1 };
+            std::uniform_int_distribution<u32> y{ 0, size.y - 1 };
+            for (u32 i{ 0 }; i < 10'000; ++i)
+            {
+                u32 x0{ x(rng) }, x1{ x(rng) }, y0{ y(rng) }, y1{ y(rng) };
+                if (x0 > x1) std::swap(x0, x1);
+                if (y0 > y1) std::swap(y0, y1);
+
+                const u32 extent{ std::max(x1 - x0, y1 - y0) };
+                const u32 mip{ std::min(extent ? (u32)std::bit_width(extent) - 1 : 0, layout.mip_count - 1) };
+                const graphics::hi_z_mip& m{ layout.mips[mip] };
+                const u32 shift{ mip + 1 };
+                errors += (x1 >> shift) - (x0 >> shift) > 1 || (y1 >> shift) - (y0 >> shift) > 1;
+                errors += (x1 >> shift) >= m.width || (y1 >> shift) >= m.height;
+            }
+        }
+
+        return errors;
+    }
+
+    void measure()
+    {
+        const auto start{ clock::now() };
+        for (u32 iteration{ 0 }; iteration < _iterations; ++iteration)
+        {
+            build_groups();
+        }
+        const f32 ms{ std::chrono::duration<f32, std::milli>(clock::now() - start).count() / (f32)_iterations };
+
+        char line[256];
+        sprintf_s(line, "Indirect draws | count states and build groups, %u items | %7.3f ms | %u ExecuteIndirect calls for %u draws\n",
+                  _item_count, ms, _group_count, 2 * _item_count);
+        OutputDebugStringA(line);
+    }
+
+    util::vector<u32>                               _state_ids;         // depth prepass state of each item, then gpass state.
+    util::vector<u64>                               _state_keys;
+    util::vector<u32>                               _state_counts;
+    util::vector<graphics::indirect_draw_group>     _groups;
+    util::vector<graphics::indirect_draw_slot>      _state_slots;
+    u32                                             _group_count{ 0 };
+    u32                                             _depth_group_count{ 0 };
+};
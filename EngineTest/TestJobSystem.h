@@ -0,0 +1,98 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Core\JobSystem.h"
+
+#include <thread>
+
+using namespace Quantum;
+
+// Headless benchmark for the job system. Measures the cost of scheduling an empty job
+// and how a data-parallel workload scales from 1 to N workers. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        _data.resize(_element_count);
+        for (u32 i{ 0 }; i < _element_count; ++i) _data[i] = (f32)(i % 1024) * 0.01f;
+        return true;
+    }
+
+    void run() override
+    {
+        const u32 max_workers{ std::max(std::thread::hardware_concurrency(), 1u) };
+        f32 single_worker_ms{ 0.f };
+
+        for (u32 worker_count{ 1 }; worker_count <= max_workers; ++worker_count)
+        {
+            jobs::initialize(worker_count);
+
+            const f32 overhead_ns{ measure_scheduling_overhead() };
+            const f32 parallel_for_ms{ measure_parallel_for() };
+            if (worker_count == 1) single_worker_ms = parallel_for_ms;
+
+            jobs::shutdown();
+
+            char line[256];
+            sprintf_s(line, "Workers: %2u | empty job: %7.1f ns | parallel_for: %8.3f ms | speedup: %5.2fx\n",
+                      worker_count, overhead_ns, parallel_for_ms, single_worker_ms / parallel_for_ms);
+            OutputDebugStringA(line);
+        }
+
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static void empty_job(void*) {}
+
+    // Average time in nanoseconds to queue, execute and retire one empty job.
+    f32 measure_scheduling_overhead()
+    {
+        constexpr u32 batch_size{ 1024 };
+        constexpr u32 batch_count{ 512 };
+        jobs::job_decl batch[batch_size];
+        for (auto& job : batch) job = { &empty_job, nullptr };
+
+        const auto start{ clock::now() };
+        for (u32 i{ 0 }; i < batch_count; ++i)
+        {
+            jobs::counter counter{};
+            jobs::run(&batch[0], batch_size, &counter);
+            jobs::wait(&counter);
+        }
+        const auto dt{ clock::now() - start };
+
+        return (f32)std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count() / (f32)(batch_size * batch_count);
+    }
+
+    // Average time in milliseconds of a parallel_for that does a bit of math on every element.
+    f32 measure_parallel_for()
+    {
+        constexpr u32 iterations{ 16 };
+        f32* const data{ _data.data() };
+
+        const auto start{ clock::now() };
+        for (u32 i{ 0 }; i < iterations; ++i)
+        {
+            jobs::parallel_for(_element_count, 16 * 1024, [data](u32 begin, u32 end) {
+                for (u32 j{ begin }; j < end; ++j)
+                {
+                    data[j] = sqrtf(data[j] * data[j] + 1.f) * 0.5f;
+                }
+            });
+        }
+        const auto dt{ clock::now() - start };
+
+        return (f32)std::chrono::duration_cast<std::chrono::microseconds>(dt).count() * 0.001f / (f32)iterations;
+    }
+
+    static constexpr u32    _element_count{ 16 * 1024 * 1024 };
+    util::vector<f32>       _data;
+};
@@ -0,0 +1,150 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Graphics\LodSelection.h"
+
+#include <random>
+
+using namespace Quantum;
+
+// Headless test and benchmark for screen size based LOD selection. Checks the SIMD distance calculation against
+// a scalar version, then moves a camera back and forth in front of a field of items with 4 LODs and counts how
+// often items switch LODs with and without hysteresis. Last, measures distance calculation and selection for
+// 200k items. Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        std::mt19937 rng{ 11 };
+        std::uniform_real_distribution<f32> unit{ -1.f, 1.f };
+        std::uniform_real_distribution<f32> radius{ 0.5f, 5.f };
+        std::uniform_real_distribution<f32> scale{ 0.5f, 2.f };
+
+        _spheres.resize(_item_count);
+        _scales.resize(_item_count);
+        _distances.resize(_item_count);
+        _lods.resize(_item_count);
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            _spheres[i] = { unit(rng) * _world_size, unit(rng) * 20.f, unit(rng) * _world_size, radius(rng) };
+            _scales[i] = scale(rng);
+        }
+
+        return true;
+    }
+
+    void run() override
+    {
+        const u32 errors{ validate_distances() };
+        char line[256];
+        sprintf_s(line, "LOD selection | SIMD vs scalar distances: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        count_switches(false);
+        count_switches(true);
+        measure();
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _item_count{ 200'000 };
+    static constexpr f32 _world_size{ 2000.f };
+    static constexpr u32 _iterations{ 32 };
+    // Like the thresholds that ContentTools generates, for a geometry with 4 LODs.
+    static constexpr f32 _thresholds[4]{ 0.f, 50.f, 150.f, 400.f };
+    // Pixels per unit at distance 1 for a 1440 pixel high screen with a 70 degree field of view.
+    static constexpr f32 _projection_scale{ 1440.f * 0.5f * 1.42814801f };
+
+    // The last LOD whose threshold is closer than the distance, like content::get_lod_offset() does with
+    // thresholds from the application.
+    static u32 select_lod_without_hysteresis(f32 distance)
+    {
+        for (u32 i{ _countof(_thresholds) - 1 }; i > 0; --i)
+        {
+            if (_thresholds[i] <= distance) return i;
+        }
+
+        return 0;
+    }
+
+    u32 validate_distances()
+    {
+        const graphics::lod_camera camera{ graphics::make_lod_camera({ 10.f, 2.f, -30.f }, _projection_scale) };
+        graphics::calculate_lod_distances(camera, _spheres.data(), _scales.data(), _item_count, _distances.data());
+
+        u32 errors{ 0 };
+        for (u32 i{ 0 }; i < _item_count; ++i)
+        {
+            const math::v4& s{ _spheres[i] };
+            const f32 x{ s.x - camera.position.x }, y{ s.y - camera.position.y }, z{ s.z - camera.position.z };
+            const f32 expected{ std::max(sqrtf(x * x + y * y + z * z) - s.w, 0.f) * camera.distance_scale / _scales[i] };
+            errors += abs(expected - _distances[i]) > 1e-4f * std::max(expected, 1.f);
+        }
+
+        return errors;
+    }
+
+    // The camera goes forward and back a little every frame (like a player that walks while looking around),
+    // and slowly moves away from the items. Without hysteresis, items near a threshold switch every frame.
+    void count_switches(bool hysteresis)
+    {
+        constexpr u32 frame_count{ 600 };
+        for (u32& lod : _lods) lod = 0;
+
+        u64 switches{ 0 };
+        for (u32 frame{ 0 }; frame < frame_count; ++frame)
+        {
+            const f32 z{ -(f32)frame * 0.5f + ((frame & 1) ? 1.f : -1.f) };
+            const graphics::lod_camera camera{ graphics::make_lod_camera({ 0.f, 2.f, z }, _projection_scale) };
+            graphics::calculate_lod_distances(camera, _spheres.data(), _scales.data(), _item_count, _distances.data());
+            for (u32 i{ 0 }; i < _item_count; ++i)
+            {
+                const u32 lod{ hysteresis ? graphics::select_lod(&_thresholds[0], _countof(_thresholds), _distances[i], _lods[i])
+                                          : select_lod_without_hysteresis(_distances[i]) };
+                // NOTE: the first frame sets the LODs of all items, so it doesn't count.
+                switches += frame > 0 && lod != _lods[i];
+                _lods[i] = lod;
+            }
+        }
+
+        char line[256];
+        sprintf_s(line, "LOD selection | hysteresis: %-3s | LOD switches in %u frames: %llu\n",
+                  hysteresis ? "on" : "off", frame_count, switches);
+        OutputDebugStringA(line);
+    }
+
+    void measure()
+    {
+        u32 lod_counts[_countof(_thresholds)]{};
+        const auto start{ clock::now() };
+        for (u32 iteration{ 0 }; iteration < _iterations; ++iteration)
+        {
+            const graphics::lod_camera camera{ graphics::make_lod_camera({ 0.f, 2.f, (f32)iteration }, _projection_scale) };
+            graphics::calculate_lod_distances(camera, _spheres.data(), _scales.data(), _item_count, _distances.data());
+            for (u32 i{ 0 }; i < _item_count; ++i)
+            {
+                _lods[i] = graphics::select_lod(&_thresholds[0], _countof(_thresholds), _distances[i], _lods[i]);
+            }
+        }
+        const f32 ms{ std::chrono::duration<f32, std::milli>(clock::now() - start).count() / (f32)_iterations };
+
+        for (u32 lod : _lods) ++lod_counts[lod];
+        char line[256];
+        sprintf_s(line, "LOD selection | %u items | %7.3f ms | %5.2f ns/item | LOD 0: %u, 1: %u, 2: %u, 3: %u\n",
+                  _item_count, ms, ms * 1e6f / (f32)_item_count, lod_counts[0], lod_counts[1], lod_counts[2], lod_counts[3]);
+        OutputDebugStringA(line);
+    }
+
+    util::vector<math::v4>  _spheres;
+    util::vector<f32>       _scales;
+    util::vector<f32>       _distances;
+    util::vector<u32>       _lods;
+};
@@ -0,0 +1,185 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Core\JobSystem.h"
+#include "..\Engine\Graphics\ParallelRecording.h"
+
+#include <thread>
+
+using namespace Quantum;
+
+// Headless test and benchmark for recording draws on several threads. Uses a command recorder that doesn't
+// record anything, but marks which command list got each draw and spends some time per draw, like recording
+// commands does. Checks the partitioning for many draw counts and that every draw is recorded once, in order of
+// command lists, then measures recording 30k draws on one worker and on all workers. Results go to the debug
+// output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        _list_of_draw.resize(_max_draw_count);
+        return true;
+    }
+
+    void run() override
+    {
+        const u32 partition_errors{ validate_partitions() };
+        const u32 recording_errors{ validate_recording() };
+
+        char line[256];
+        sprintf_s(line, "Parallel recording | partitions: %s (%u errors) | recording: %s (%u errors)\n",
+                  partition_errors ? "FAILED" : "OK", partition_errors, recording_errors ? "FAILED" : "OK", recording_errors);
+        OutputDebugStringA(line);
+        assert(partition_errors == 0 && recording_errors == 0);
+
+        jobs::initialize(1);
+        measure("1 worker");
+        jobs::shutdown();
+
+        jobs::initialize();
+        sprintf_s(line, "%u workers", jobs::worker_count());
+        measure(line);
+        jobs::shutdown();
+
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override {}
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr u32 _max_draw_count{ 100'000 };
+    static constexpr u32 _benchmark_draw_count{ 30'000 };
+    static constexpr u32 _iterations{ 16 };
+    // About as much work per draw as setting the root parameters and index buffer and recording the draw.
+    static constexpr u32 _work_per_draw{ 64 };
+
+    struct null_recorder
+    {
+        util::vector<u32>&  list_of_draw;
+        std::thread::id     calling_thread;
+        u32                 begin_calls{ 0 };
+        u32                 end_calls{ 0 };
+        std::atomic<u32>    record_calls{ 0 };
+        std::atomic<u32>    wrong_thread{ 0 };
+        std::atomic<u32>    checksum{ 0 };
+
+        static void begin(void* data, u32)
+        {
+            null_recorder& r{ *(null_recorder*)data };
+            ++r.begin_calls;
+            r.wrong_thread += std::this_thread::get_id() != r.calling_thread;
+        }
+
+        static void record(void* data, u32 list_index, graphics::draw_range range)
+        {
+            null_recorder& r{ *(null_recorder*)data };
+            ++r.record_calls;
+            u32 hash{ list_index };
+            for (u32 i{ range.begin }; i < range.end; ++i)
+            {
+                r.list_of_draw[i] = list_index;
+                for (u32 j{ 0 }; j < _work_per_draw; ++j) hash = hash * 16777619u ^ (i + j);
+            }
+            r.checksum += hash;
+        }
+
+        static void end(void* data, u32)
+        {
+            null_recorder& r{ *(null_recorder*)data };
+            ++r.end_calls;
+            r.wrong_thread += std::this_thread::get_id() != r.calling_thread;
+        }
+    };
+
+    u32 validate_partitions()
+    {
+        u32 errors{ 0 };
+        graphics::draw_range ranges[graphics::max_command_lists_per_pass];
+        for (u32 draw_count : { 0u, 1u, 511u, 512u, 1023u, 1024u, 5000u, 8191u, 30'000u, 99'999u })
+        {
+            for (u32 max_ranges{ 1 }; max_ranges <= graphics::max_command_lists_per_pass; ++max_ranges)
+            {
+                const u32 count{ graphics::partition_draws(draw_count, max_ranges, graphics::min_draws_per_command_list, &ranges[0]) };
+                errors += count < 1 || count > max_ranges;
+                // Use as many ranges as we can.
+                errors += count < std::min(max_ranges, std::max(draw_count / graphics::min_draws_per_command_list, 1u));
+
+                u32 next{ 0 }, min_size{ u32_invalid_id }, max_size{ 0 };
+                for (u32 i{ 0 }; i < count; ++i)
+                {
+                    errors += ranges[i].begin != next || ranges[i].end < ranges[i].begin;
+                    const u32 size{ ranges[i].end - ranges[i].begin };
+                    min_size = std::min(min_size, size);
+                    max_size = std::max(max_size, size);
+                    next = ranges[i].end;
+                }
+
+                errors += next != draw_count;
+                errors += max_size - min_size > 1;
+                errors += count > 1 && min_size < graphics::min_draws_per_command_list;
+            }
+        }
+
+        return errors;
+    }
+
+    // NOTE: also with more workers than hardware threads, so that we get several command lists on any machine.
+    u32 validate_recording()
+    {
+        u32 errors{ 0 };
+        for (u32 workers : { 1u, 5u, 0u })
+        {
+            jobs::initialize(workers);
+            errors += validate_recording_with_workers();
+            jobs::shutdown();
+        }
+
+        return errors;
+    }
+
+    u32 validate_recording_with_workers()
+    {
+        u32 errors{ 0 };
+        for (u32 draw_count : { 0u, 100u, 4096u, 30'000u, _max_draw_count })
+        {
+            for (u32& list : _list_of_draw) list = u32_invalid_id;
+            null_recorder r{ _list_of_draw, std::this_thread::get_id() };
+            const u32 list_count{ graphics::record_draws({ &null_recorder::begin, &null_recorder::record, &null_recorder::end, &r }, draw_count) };
+
+            errors += r.begin_calls != 1 || r.end_calls != 1 || r.wrong_thread != 0 || r.record_calls != list_count;
+            // Every draw is recorded once, and concatenating the lists in order gives the draws in order.
+            u32 previous_list{ 0 };
+            for (u32 i{ 0 }; i < draw_count; ++i)
+            {
+                const u32 list{ _list_of_draw[i] };
+                errors += list >= list_count || list < previous_list;
+                previous_list = list;
+            }
+        }
+
+        return errors;
+    }
+
+    void measure(const char* name)
+    {
+        u32 list_count{ 0 };
+        const auto start{ clock::now() };
+        for (u32 iteration{ 0 }; iteration < _iterations; ++iteration)
+        {
+            null_recorder r{ _list_of_draw, std::this_thread::get_id() };
+            list_count = graphics::record_draws({ &null_recorder::begin, &null_recorder::record, &null_recorder::end, &r }, _benchmark_draw_count);
+        }
+        const f32 ms{ std::chrono::duration<f32, std::milli>(clock::now() - start).count() / (f32)_iterations };
+
+        char line[256];
+        sprintf_s(line, "Parallel recording | %-10s | %u draws | %2u command lists | %7.3f ms\n", name, _benchmark_draw_count, list_count, ms);
+        OutputDebugStringA(line);
+    }
+
+    util::vector<u32>   _list_of_draw;
+};
@@ -3,21 +3,46 @@
 
 #include "Platform/PlatformTypes.h"
 #include "Platform/Platform.h"
+#include "Platform/MappedFile.h"
 #include "Graphics/Renderer.h"
 #include "Graphics/Direct3D12\D3D12Core.h"
 #include "Content/ContentToEngine.h"
 #include "Components/Entity.h"
 #include "Components/Transform.h"
 #include "Components/Script.h"
+#include "Core/JobSystem.h"
 #include "Input/Input.h"
 #include "TestRenderer.h"
 #include "ShaderCompilation.h"
 #include <filesystem>
-#include <fstream>
 #if TEST_RENDERER
+#include <atomic>
+#include <new>
 
 using namespace Quantum;
 
+// Counts every allocation that goes through global operator new (STL containers, strings, std::function, ...),
+// so that we can check that steady-state frames don't allocate. The engine's own allocators are counted by
+// util::memory::allocation_count().
+std::atomic<u64> new_count{ 0 };
+
+void* operator new(size_t size)
+{
+    new_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* const p{ malloc(size ? size : 1) }) return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+[[nodiscard]] u64 total_allocation_count()
+{
+    return new_count.load(std::memory_order_relaxed) + util::memory::allocation_count();
+}
+
 // Multithreading test worker spawn code //////////////////////////////////////////////
 #define ENABLE_TEST_WORKERS 0
 
@@ -187,24 +212,6 @@ void remove_game_entity(game_entity::entity_id id) {
     game_entity::remove(id);
 }
 
-bool read_file(std::filesystem::path path, std::unique_ptr<u8[]>& data, u64& size) {
-    if (!std::filesystem::exists(path)) return false;
-	
-    size = std::filesystem::file_size(path);
-    assert(size);
-    if (!size) return false;
-    data = std::make_unique<u8[]>(size);
-    std::ifstream file{ path, std::ios::in | std::ios::binary };
-    if (!file || !file.read((char*)data.get(), size))
-    {
-        file.close();
-        return false;
-    }
-	
-    file.close();
-    return true;
-}
-
 void create_camera_surface(camera_surface& surface, platform::window_init_info info) {
     surface.surface.window = platform::create_window(&info);
     surface.surface.surface = graphics::create_surface(surface.surface.window);
@@ -241,12 +248,11 @@ bool test_initialize() {
 	
     for (u32 i{ 0 }; i < _countof(_surfaces); ++i) create_camera_surface(_surfaces[i], info[i]);
 	
-    // load test model
-    std::unique_ptr<u8[]> model;
-    u64 size{ 0 };
-    if (!read_file("..\\..\\enginetest\\model.model", model, size)) return false;
+    // load test model. The renderer copies what it needs, so the file is unmapped right after.
+    platform::mapped_file model{ "..\\..\\enginetest\\model.model" };
+    if (!model.is_open()) return false;
 	
-    model_id = content::create_resource(model.get(), content::asset_type::mesh);
+    model_id = content::create_resource(model.data(), content::asset_type::mesh);
     if (!id::is_valid(model_id)) return false;
 	
     init_test_workers(buffer_test_worker);
@@ -308,6 +314,7 @@ void test_shutdown()
 
 bool engine_test::initialize()
 {
+    if (!jobs::initialize()) return false;
     return test_initialize();
 }
 
@@ -319,37 +326,43 @@ void engine_test::run()
     // if ((counter % 90) == 0) light_set_key = (light_set_key + 1) % 2;
 	
     timer.begin();
+    const u64 allocations{ total_allocation_count() };
+    util::memory::begin_frame();
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
     const f32 dt{ timer.dt_avg() };
     script::update(dt);
+    game_entity::apply_commands();
+    transform::update_world_matrices();
     // test_lights(dt);
     for (u32 i{ 0 }; i < _countof(_surfaces); ++i)
     {
         if (_surfaces[i].surface.surface.is_valid())
         {
-            f32 thresholds[3]{};
-			
             id::id_type render_items[3]{};
             get_render_items(&render_items[0], 3);
 			
             graphics::frame_info info{};
             info.render_item_ids = &render_items[0];
             info.render_item_count = 3;
-            info.thresholds = &thresholds[0];
             info.light_set_key = light_set_key;
             info.average_frame_time = dt;
             info.camera_id = _surfaces[i].camera.get_id();
-			
-            assert(_countof(thresholds) >= info.render_item_count);
+
             _surfaces[i].surface.surface.render(info);
         }
     }
+
+    // NOTE: after a few frames the transient memory and caches of the engine are big enough for a whole frame.
+    //       From then on, a frame shouldn't allocate any memory, with any allocator or memory tag.
+    constexpr u32 warm_up_frames{ 30 };
+    assert(counter <= warm_up_frames || total_allocation_count() == allocations);
     timer.end();
 }
 
 void engine_test::shutdown()
 {
     test_shutdown();
+    jobs::shutdown();
 }
 
 #endif // TEST_RENDERER
@@ -0,0 +1,234 @@
+// Copyright (c) Andrey Trepalin. 
+// Distributed under the MIT license. See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "Test.h"
+#include "..\Engine\Components\Entity.h"
+#include "..\Engine\Components\Transform.h"
+#include "..\Engine\Components\Script.h"
+#include "..\Engine\Core\JobSystem.h"
+
+using namespace Quantum;
+
+class bench_mover_script;
+REGISTER_SCRIPT(bench_mover_script);
+class bench_mover_script : public script::entity_script
+{
+public:
+    static constexpr script::update_schedule schedule{ 0, script::access::none, script::access::none };
+
+    constexpr explicit bench_mover_script(game_entity::entity entity) : script::entity_script{ entity } {}
+
+    void update(f32 dt) override
+    {
+        _time += dt;
+        set_position({ _time, 0.f, (f32)get_id() });
+    }
+
+private:
+    f32 _time{ 0.f };
+};
+
+// Scripts of both types write the position of another entity. Targets are taken in the order the scripts are created.
+util::vector<game_entity::entity> order_targets;
+u32 next_order_target{ 0 };
+
+template<u32 group, u32 x>
+class order_script : public script::entity_script
+{
+public:
+    static constexpr script::update_schedule schedule{ group, script::access::none, script::access::none };
+
+    void update(f32) override
+    {
+        set_position(&_target, { (f32)x, 0.f, 0.f });
+    }
+
+protected:
+    explicit order_script(game_entity::entity entity) : script::entity_script{ entity }, _target{ order_targets[next_order_target++] } {}
+
+private:
+    game_entity::entity _target;
+};
+
+class order_first_script;
+REGISTER_SCRIPT(order_first_script);
+class order_first_script : public order_script<1, 1>
+{
+public:
+    explicit order_first_script(game_entity::entity entity) : order_script{ entity } {}
+};
+
+class order_last_script;
+REGISTER_SCRIPT(order_last_script);
+class order_last_script : public order_script<2, 2>
+{
+public:
+    explicit order_last_script(game_entity::entity entity) : order_script{ entity } {}
+};
+
+// Headless benchmark for script updates. Every script writes one transform per frame,
+// which goes through the script module's transform cache. Also checks that a transform that is read (and so
+// computed lazily) and then set again in the same frame is only updated once by update_world_matrices(),
+// and that transform changes of scripts in a later group win, whichever worker updated the scripts.
+// Results go to the debug output.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        jobs::initialize();
+
+        transform::init_info transform_info{};
+        script::init_info script_info{};
+        script_info.script_creator = script::detail::get_script_creator_internal(script::detail::string_hash()("bench_mover_script"));
+        assert(script_info.script_creator);
+
+        game_entity::entity_info entity_info{};
+        entity_info.transform = &transform_info;
+        entity_info.script = &script_info;
+
+        _entities.reserve(_script_count);
+        for (u32 i{ 0 }; i < _script_count; ++i)
+        {
+            _entities.emplace_back(game_entity::create(entity_info));
+            assert(_entities.back().is_valid());
+        }
+
+        return true;
+    }
+
+    void run() override
+    {
+        char line[256];
+        u32 errors{ validate_lazy_read_then_set() };
+        sprintf_s(line, "transforms | lazy read, then set in the same frame: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        errors = validate_update_order();
+        sprintf_s(line, "scripts | transform changes in update order: %s (%u errors)\n", errors ? "FAILED" : "OK", errors);
+        OutputDebugStringA(line);
+        assert(errors == 0);
+
+        using clock = std::chrono::high_resolution_clock;
+        constexpr u32 warmup_frames{ 10 };
+        constexpr u32 frame_count{ 200 };
+        constexpr f32 dt{ 1.f / 60.f };
+
+        for (u32 i{ 0 }; i < warmup_frames; ++i) script::update(dt);
+
+        const auto start{ clock::now() };
+        for (u32 i{ 0 }; i < frame_count; ++i)
+        {
+            script::update(dt);
+        }
+        const auto script_time{ clock::now() - start };
+
+        const auto transform_start{ clock::now() };
+        transform::update_world_matrices();
+        const auto transform_time{ clock::now() - transform_start };
+
+        sprintf_s(line, "%u scripts | %u workers | script::update: %.3f ms/frame | update_world_matrices: %.3f ms\n", _script_count, jobs::worker_count(),
+                  (f32)std::chrono::duration_cast<std::chrono::microseconds>(script_time).count() * 0.001f / (f32)frame_count,
+                  (f32)std::chrono::duration_cast<std::chrono::microseconds>(transform_time).count() * 0.001f);
+        OutputDebugStringA(line);
+
+        PostQuitMessage(0);
+    }
+
+    void shutdown() override
+    {
+        for (auto& entity : _entities) game_entity::remove(entity.get_id());
+        _entities.clear();
+        jobs::shutdown();
+    }
+
+private:
+    static void set_position(game_entity::entity entity, f32 x)
+    {
+        transform::component_cache cache{};
+        cache.position = { x, 0.f, 0.f };
+        cache.id = transform::transform_id{ entity.get_id() };
+        cache.flags = transform::component_flags::position;
+        transform::update(&cache, 1);
+    }
+
+    // Each recalculation of a world matrix adds one to the transform's world version, so a transform that would
+    // be in the list of dirty transforms twice gets one more.
+    u32 validate_lazy_read_then_set()
+    {
+        transform::init_info transform_info{};
+        game_entity::entity_info entity_info{};
+        entity_info.transform = &transform_info;
+        const game_entity::entity entity{ game_entity::create(entity_info) };
+        const game_entity::entity_id id{ entity.get_id() };
+        transform::update_world_matrices();
+
+        u32 start_version{ 0 };
+        transform::get_world_versions(&id, 1, &start_version);
+
+        set_position(entity, 1.f);
+        math::m4x4 world, inverse_world;
+        transform::get_transform_matrics(id, world, inverse_world);
+        u32 errors{ world._41 != 1.f };
+
+        set_position(entity, 2.f);
+        transform::update_world_matrices();
+        transform::get_transform_matrics(id, world, inverse_world);
+        errors += world._41 != 2.f;
+
+        // One lazy recalculation and one in update_world_matrices().
+        u32 version{ 0 };
+        transform::get_world_versions(&id, 1, &version);
+        errors += version != start_version + 2;
+
+        game_entity::remove(id);
+        return errors;
+    }
+
+    // The first group has many scripts, so they're spread over all workers, and the last group only a few,
+    // so they're updated on the calling thread. If the worker caches were only applied at the end of script::update(),
+    // changes of the first group in other workers' caches would be applied after the ones of the last group.
+    u32 validate_update_order()
+    {
+        constexpr u32 first_count{ 65536 };
+        constexpr u32 last_count{ 64 };
+        transform::init_info transform_info{};
+        script::init_info script_info{};
+        game_entity::entity_info entity_info{};
+        entity_info.transform = &transform_info;
+
+        util::vector<game_entity::entity> entities;
+        for (u32 i{ 0 }; i < first_count; ++i) order_targets.emplace_back(game_entity::create(entity_info));
+
+        entity_info.script = &script_info;
+        script_info.script_creator = script::detail::get_script_creator_internal(script::detail::string_hash()("order_first_script"));
+        for (u32 i{ 0 }; i < first_count; ++i) entities.emplace_back(game_entity::create(entity_info));
+
+        // NOTE: scripts of the last group write the same targets as the first last_count scripts of the first group.
+        for (u32 i{ 0 }; i < last_count; ++i) order_targets.emplace_back(order_targets[i * (first_count / last_count)]);
+        script_info.script_creator = script::detail::get_script_creator_internal(script::detail::string_hash()("order_last_script"));
+        for (u32 i{ 0 }; i < last_count; ++i) entities.emplace_back(game_entity::create(entity_info));
+
+        script::update(1.f / 60.f);
+        // NOTE: so that the benchmark doesn't update the world matrices of these transforms.
+        transform::update_world_matrices();
+
+        u32 errors{ 0 };
+        for (u32 i{ 0 }; i < first_count; ++i)
+        {
+            const f32 expected{ i % (first_count / last_count) ? 1.f : 2.f };
+            errors += order_targets[i].position().x != expected;
+        }
+
+        for (auto& entity : entities) game_entity::remove(entity.get_id());
+        for (u32 i{ 0 }; i < first_count; ++i) game_entity::remove(order_targets[i].get_id());
+        order_targets.clear();
+        next_order_target = 0;
+        return errors;
+    }
+
+    static constexpr u32                _script_count{ 50'000 };
+    util::vector<game_entity::entity>   _entities;
+};
@@ -25,24 +25,34 @@ struct PixelOut
 #define ElementsTypeSkeletalNormalColor         ElementsTypeSkeletalNormal | ElementsTypeStaticColor
 #define ElementsTypeSkeletalNormalTexture       ElementsTypeSkeletal | ElementsTypeStaticNormalTexture
 #define ElementsTypeSkeletalNormalTextureColor  ElementsTypeSkeletalNormalTexture | ElementsTypeStaticColor
+// Flag for 16 bit positions relative to the submesh bounds and half float uvs. The positions are decoded
+// by the world matrices in PerObjectData.
+#define ElementsTypeQuantized                   0x10
+
+#define QUANTIZED (ELEMENTS_TYPE & ElementsTypeQuantized)
+#define ELEMENTS_LAYOUT (ELEMENTS_TYPE & ~ElementsTypeQuantized)
 
 struct VertexElement
 {
-#if ELEMENTS_TYPE == ElementsTypeStaticNormal
+#if ELEMENTS_LAYOUT == ElementsTypeStaticNormal
     uint        ColorTSign;
     uint16_t2   Normal;
-#elif ELEMENTS_TYPE == ElementsTypeStaticNormalTexture
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticNormalTexture
     uint        ColorTSign;
     uint16_t2   Normal;
     uint16_t2   Tangent;
+#if QUANTIZED
+    uint        UV;         // two half floats
+#else
     float2      UV;
-#elif ELEMENTS_TYPE == ElementsTypeStaticColor
-#elif ELEMENTS_TYPE == ElementsTypeSkeletal
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalColor
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormal
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormalColor
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormalTexture
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormalTextureColor
+#endif
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticColor
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletal
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalColor
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormal
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormalColor
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormalTexture
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormalTextureColor
 #endif
 };
 
@@ -50,7 +60,11 @@ const static float InvIntervals = 2.f / ((1 << 16) - 1);
 
 ConstantBuffer<GlobalShaderData>                GlobalData                      : register(b0, space0);
 ConstantBuffer<PerObjectData>                   PerObjectBuffer                 : register(b1, space0);
+#if QUANTIZED
+StructuredBuffer<uint2>                         VertexPositions                 : register(t0, space0);
+#else
 StructuredBuffer<float3>                        VertexPositions                 : register(t0, space0);
+#endif
 ConstantBuffer<VertexElement>                   Elements                        : register(t1, space0);
 
 StructuredBuffer<DirectionalLightParameters>    DirectionalLights               : register(t3, space0);
@@ -62,10 +76,15 @@ VertexOut TestShaderVS(in uint VertexIdx: SV_VertexID)
 {
     VertexOut vsOut;
     
+#if QUANTIZED
+    const uint2 quantizedPosition = VertexPositions[VertexIdx];
+    float4 position = float4(quantizedPosition.x & 0xffff, quantizedPosition.x >> 16, quantizedPosition.y & 0xffff, 1.f);
+#else
     float4 position = float4(VertexPositions[VertexIdx], 1.f);
+#endif
     float4 worldPosition = mul(PerObjectBuffer.World, position);
     
-#if ELEMENTS_TYPE == ElementsTypeStaticNormal
+#if ELEMENTS_LAYOUT == ElementsTypeStaticNormal
 
     VertexElement element = Elements[VertexIdx];
     float2 nXY = element.NOrmal * InvIntervals - 1.f;
@@ -73,13 +92,13 @@ VertexOut TestShaderVS(in uint VertexIdx: SV_VertexID)
     float nSign = float(signs & 0x02) - 1;
     float3 normal = float3(mXY.x, nXY.y, sqrt(saturate(1.f - dot(nXY, nXY))) * nSign;
     
-    vsOut.HomogeneousPosition = mul(PerObjectBuffer.WorldViewProjection, position);
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
     vsOut.WorldPosition = worldPosition.xyz;
     vsOut.WorldNormal = mul(float4(normal, 0.f), PerObjectBuffer.InvWorld).xyz;
     vsOut.WorldTangent = 0.f;
     vsOut.UV = 0.f;
 
-#elif ELEMENTS_TYPE == ElementsTypeStaticNormalTexture
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticNormalTexture
     
     VertexElement element = Elements[VertexIdx];
     float2 nXY = element.NOrmal * InvIntervals - 1.f;
@@ -87,7 +106,7 @@ VertexOut TestShaderVS(in uint VertexIdx: SV_VertexID)
     float nSign = float(signs & 0x02) - 1;
     float3 normal = float3(nXY.x, nXY.y, sqrt(saturate(1.f - dot(nXY, nXY))) * nSign;
     
-    vsOut.HomogeneousPosition = mul(PerObjectBuffer.WorldViewProjection, position);
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
     vsOut.WorldPosition = worldPosition.xyz;
     vsOut.WorldNormal = mul(float4(normal, 0.f), PerObjectBuffer.InvWorld).xyz;
     vsOut.WorldTangent = 0.f;
@@ -95,7 +114,7 @@ VertexOut TestShaderVS(in uint VertexIdx: SV_VertexID)
     
 #else
 #undef ELEMENTS_TYPE
-    vsOut.HomogeneousPosition = mul(PerObjectBuffer.WorldViewProjection, position);
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
     vsOut.WorldPosition = worldPosition.xyz;
     vsOut.WorldNormal = 0.f;
     vsOut.WorldTangent = 0.f;